@@ -0,0 +1,157 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <chrono>
+#include "Calaos.h"
+#include "ListeRoom.h"
+#include "ListeRule.h"
+#include "OutputLightDimmer.h"
+
+using namespace Calaos;
+
+/*
+ * Rule actions benchmark.
+ *
+ * Runs a scene of 50 dimmers (one standard action setting all of them) and
+ * prints the number of scenes per second with the parsed action plans of
+ * ActionStd, and with the old code that looked up the params and parsed the
+ * action string of each output on every run.
+ */
+
+#define BENCH_OUTPUTS   50
+
+//A dimmer that doesn't talk to any hardware
+class BenchDimmer: public OutputLightDimmer
+{
+public:
+    BenchDimmer(Params &p): OutputLightDimmer(p) {}
+
+protected:
+    virtual bool set_value_real(int val) { return true; }
+};
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos rule actions benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--scenes <n>\tNumber of scenes executed (default 10000).\n");
+    cout << endl;
+}
+
+//This is what ActionStd::Execute() did for string outputs before the plans
+static bool legacyExecute(ActionStd *action, Params &params)
+{
+    bool ret = true;
+
+    for (int i = 0;i < action->get_size();i++)
+    {
+        Output *out = action->get_output(i);
+        std::string tmp = params[out->get_param("id")];
+        if (tmp != "" && !out->set_value(tmp))
+            ret = false;
+    }
+
+    return ret;
+}
+
+template<typename F>
+static double scenesPerSec(int nb_scenes, F execute)
+{
+    double elapsed = 0.0;
+
+    for (int done = 0;done < nb_scenes;)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0;i < 100 && done < nb_scenes;i++, done++)
+            execute();
+        auto end = std::chrono::steady_clock::now();
+        elapsed += std::chrono::duration<double>(end - start).count();
+
+        //let the EventManager send the queued events, not measured
+        ecore_main_loop_iterate();
+    }
+
+    return nb_scenes / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("action_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_scenes = 10000;
+    char *s = argvOptionParam(argv, argv + argc, "--scenes");
+    if (s) from_string(string(s), nb_scenes);
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    //Ensure calling order of destructors
+    ListeRule::Instance();
+    ListeRoom::Instance();
+
+    eina_init();
+    ecore_init();
+
+    vector<Output *> outputs;
+    ActionStd *action = new ActionStd();
+    Params params;
+
+    for (int i = 0;i < BENCH_OUTPUTS;i++)
+    {
+        Params p;
+        p.Add("name", "bench_dimmer_" + Utils::to_string(i));
+        p.Add("id", "bench_dimmer_" + Utils::to_string(i));
+        Output *out = new BenchDimmer(p);
+        outputs.push_back(out);
+
+        action->Add(out);
+        params.Add(out->get_param("id"), "set " + Utils::to_string(i * 2));
+    }
+    action->set_param(params);
+
+    double legacy = scenesPerSec(nb_scenes, [=, &params]() { legacyExecute(action, params); });
+    double plans = scenesPerSec(nb_scenes, [=]() { action->Execute(); });
+
+    cout << BENCH_OUTPUTS << " outputs scene, parse per run:\t" << legacy << " scenes/s" << endl;
+    cout << BENCH_OUTPUTS << " outputs scene, action plans:\t" << plans << " scenes/s" << endl;
+
+    delete action;
+    for (Output *out: outputs)
+        delete out;
+
+    ecore_shutdown();
+    eina_shutdown();
+
+    return 0;
+}
@@ -0,0 +1,271 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <chrono>
+#include "Calaos.h"
+#include "ListeRoom.h"
+#include "JsonApiV3.h"
+#include "HomeModel.h"
+#include "MsgPack.h"
+
+using namespace Calaos;
+
+/*
+ * JSON/MessagePack encoding benchmark.
+ *
+ * Creates a synthetic home and compares the two encodings of the V3 API for
+ * get_home and events: size of the messages on the wire, time to encode
+ * them on the server and time to decode them on the client. The decoded
+ * MessagePack messages are checked against the json ones.
+ */
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos API encoding benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--rooms <n>\tNumber of rooms of the home (default 30).\n");
+    cout << _("\t--ios <n>\tNumber of IOs per room (default 20).\n");
+    cout << _("\t--events <n>\tNumber of events encoded (default 10000).\n");
+    cout << _("\t--loops <n>\tNumber of get_home encoded and decoded (default 100).\n");
+    cout << endl;
+}
+
+static vector<Output *> bench_outputs;
+
+static void createHome(int nb_rooms, int nb_ios)
+{
+    const char *types[] = { "InternalBool", "InternalInt", "InternalString" };
+
+    for (int r = 0;r < nb_rooms;r++)
+    {
+        //non ascii names are escaped in json
+        Room *room = new Room("Pièce de séjour " + Utils::to_string(r), "lounge", 0);
+        ListeRoom::Instance().Add(room);
+
+        for (int i = 0;i < nb_ios;i++)
+        {
+            string id = "bench_" + Utils::to_string(r) + "_" + Utils::to_string(i);
+
+            Params p;
+            p.Add("type", types[i % 3]);
+            p.Add("name", "Lumière " + Utils::to_string(i) + " de la pièce " + Utils::to_string(r));
+            p.Add("id", id);
+            p.Add("visible", "true");
+
+            Output *o = dynamic_cast<Output *>(ListeRoom::Instance().createInput(p, room));
+            if (o) bench_outputs.push_back(o);
+        }
+    }
+}
+
+template<typename F>
+static double usPerCall(int nb, F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0;i < nb;i++)
+        func();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(end - start).count() * 1000000.0 / nb;
+}
+
+static uint64_t wireSize(const string &payload, bool binary)
+{
+    return WebSocketFrame::makeFrames(binary?WebSocketFrame::OpCodeBinary:WebSocketFrame::OpCodeText,
+                                      payload, FRAME_SIZE_IN_BYTES).size();
+}
+
+//the MessagePack message must decode to the same tree as the json one
+static void checkSame(const string &json, const string &msgpack)
+{
+    json_t *j1 = json_loads(json.c_str(), 0, nullptr);
+    json_t *j2 = MsgPack::decode(msgpack);
+
+    if (!j1 || !j2 || !json_equal(j1, j2))
+    {
+        cError() << "MessagePack message differs from json!";
+        exit(1);
+    }
+
+    json_decref(j1);
+    json_decref(j2);
+}
+
+static void printResult(const string &name, uint64_t json_size, uint64_t msgpack_size,
+                        double json_encode, double msgpack_encode,
+                        double json_decode, double msgpack_decode)
+{
+    cout << name << endl;
+    cout << "\tsize:\t\tjson " << json_size << " bytes, msgpack " << msgpack_size << " bytes ("
+         << 100.0 * msgpack_size / json_size << "%)" << endl;
+    cout << "\tencode:\t\tjson " << json_encode << " us, msgpack " << msgpack_encode << " us" << endl;
+    cout << "\tdecode:\t\tjson " << json_decode << " us, msgpack " << msgpack_decode << " us" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("api_encoding_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_rooms = 30, nb_ios = 20, nb_events = 10000, nb_loops = 100;
+    char *s = argvOptionParam(argv, argv + argc, "--rooms");
+    if (s) from_string(string(s), nb_rooms);
+    s = argvOptionParam(argv, argv + argc, "--ios");
+    if (s) from_string(string(s), nb_ios);
+    s = argvOptionParam(argv, argv + argc, "--events");
+    if (s) from_string(string(s), nb_events);
+    s = argvOptionParam(argv, argv + argc, "--loops");
+    if (s) from_string(string(s), nb_loops);
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    //Ensure calling order of destructors
+    ListeRoom::Instance();
+
+    eina_init();
+    ecore_init();
+
+    createHome(nb_rooms, nb_ios);
+    if (bench_outputs.empty())
+    {
+        cError() << "No IO created";
+        exit(1);
+    }
+
+    //get_home as received by a json and a msgpack client
+    JsonApiV3 api(nullptr);
+
+    string home_json, home_msgpack;
+    api.sendData.connect([&home_json](const string &data) { home_json = data; });
+    api.sendBinaryData.connect([&home_msgpack](const string &data) { home_msgpack = data; });
+
+    json_t *jlogin = json_pack("{s:s, s:{s:s, s:s}}",
+                               "msg", "login",
+                               "data",
+                               "cn_user", Utils::get_config_option("calaos_user").c_str(),
+                               "cn_pass", Utils::get_config_option("calaos_password").c_str());
+    char *d = json_dumps(jlogin, JSON_COMPACT);
+    api.processApi(d);
+    free(d);
+    json_decref(jlogin);
+
+    home_json.clear();
+    api.processApi("{\"msg\":\"get_home\"}");
+    api.setEncoding(JsonApiV3::EncodingMsgPack);
+    api.processApi("{\"msg\":\"get_home\"}");
+    if (home_json.empty() || home_msgpack.empty())
+    {
+        cError() << "get_home failed, check the calaos_user/calaos_password options";
+        exit(1);
+    }
+
+    checkSame(home_json, home_msgpack);
+
+    //encoding of the home tree, what is done again after a change
+    json_t *jhome = HomeModel::Instance().getHome();
+    double home_json_encode = usPerCall(nb_loops, [=]()
+    {
+        char *dump = json_dumps(jhome, JSON_COMPACT | JSON_ENSURE_ASCII);
+        free(dump);
+    });
+    double home_msgpack_encode = usPerCall(nb_loops, [=]()
+    {
+        MsgPackWriter writer;
+        writer.writeJson(jhome);
+    });
+
+    double home_json_decode = usPerCall(nb_loops, [&]()
+    {
+        json_decref(json_loads(home_json.c_str(), 0, nullptr));
+    });
+    double home_msgpack_decode = usPerCall(nb_loops, [&]()
+    {
+        json_decref(MsgPack::decode(home_msgpack));
+    });
+
+    printResult("get_home (" + Utils::to_string(bench_outputs.size()) + " IOs)",
+                wireSize(home_json, false), wireSize(home_msgpack, true),
+                home_json_encode, home_msgpack_encode,
+                home_json_decode, home_msgpack_decode);
+
+    //events, the same as the clients get for state changes
+    vector<CalaosEvent> events;
+    for (int i = 0;i < nb_events;i++)
+    {
+        Output *o = bench_outputs[i % bench_outputs.size()];
+        events.push_back(EventManager::create(CalaosEvent::EventOutputChanged,
+                                              { { "id", o->get_param("id") },
+                                                { "state", Utils::to_string(i) } }));
+    }
+
+    vector<string> ev_json(nb_events), ev_msgpack(nb_events);
+    int idx = 0;
+    double ev_json_encode = usPerCall(nb_events, [&]()
+    {
+        JsonApiV3::encodeEvent(events[idx], JsonApiV3::EncodingJson, ev_json[idx]);
+        idx++;
+    });
+    idx = 0;
+    double ev_msgpack_encode = usPerCall(nb_events, [&]()
+    {
+        JsonApiV3::encodeEvent(events[idx], JsonApiV3::EncodingMsgPack, ev_msgpack[idx]);
+        idx++;
+    });
+
+    idx = 0;
+    double ev_json_decode = usPerCall(nb_events, [&]()
+    {
+        json_decref(json_loads(ev_json[idx++].c_str(), 0, nullptr));
+    });
+    idx = 0;
+    double ev_msgpack_decode = usPerCall(nb_events, [&]()
+    {
+        json_decref(MsgPack::decode(ev_msgpack[idx++]));
+    });
+
+    uint64_t ev_json_size = 0, ev_msgpack_size = 0;
+    for (int i = 0;i < nb_events;i++)
+    {
+        checkSame(ev_json[i], ev_msgpack[i]);
+        ev_json_size += wireSize(ev_json[i], false);
+        ev_msgpack_size += wireSize(ev_msgpack[i], true);
+    }
+
+    printResult("events (" + Utils::to_string(nb_events) + ", per event)",
+                ev_json_size / nb_events, ev_msgpack_size / nb_events,
+                ev_json_encode, ev_msgpack_encode,
+                ev_json_decode, ev_msgpack_decode);
+
+    return 0;
+}
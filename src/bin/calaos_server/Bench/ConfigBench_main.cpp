@@ -0,0 +1,124 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <chrono>
+#include "Calaos.h"
+
+using namespace Calaos;
+
+/*
+ * Config options benchmark.
+ *
+ * A login on the TCP or websocket API reads 4 config options. This measures
+ * the number of logins per second with the options cache and with the old
+ * code that parsed local_config.xml for every option.
+ */
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos config options benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--logins <n>\tNumber of simulated logins (default 10000).\n");
+    cout << endl;
+}
+
+//This is what get_config_option() did before the cache
+static string legacyGetOption(string key)
+{
+    string value = "";
+    TiXmlDocument document(getConfigFile(LOCAL_CONFIG).c_str());
+
+    if (!document.LoadFile())
+        return value;
+
+    TiXmlHandle docHandle(&document);
+
+    TiXmlElement *key_node = docHandle.FirstChildElement("calaos:config").FirstChildElement().ToElement();
+    for(; key_node; key_node = key_node->NextSiblingElement())
+    {
+        if (key_node->ValueStr() == "calaos:option" &&
+            key_node->Attribute("name") &&
+            key_node->Attribute("name") == key &&
+            key_node->Attribute("value"))
+        {
+            value = key_node->Attribute("value");
+            break;
+        }
+    }
+
+    return value;
+}
+
+template<typename F>
+static double loginsPerSec(int nb_logins, F getOption)
+{
+    int ok = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0;i < nb_logins;i++)
+    {
+        //same options as the login of JsonApiV3/TCPConnection
+        string user = getOption("calaos_user");
+        string pass = getOption("calaos_password");
+
+        if (getOption("cn_user") != "" &&
+            getOption("cn_pass") != "")
+            ok++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    VAR_UNUSED(ok);
+
+    return nb_logins / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("config_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_logins = 10000;
+    char *s = argvOptionParam(argv, argv + argc, "--logins");
+    if (s) from_string(string(s), nb_logins);
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    double legacy = loginsPerSec(nb_logins / 10 + 1, legacyGetOption);
+    double cached = loginsPerSec(nb_logins, Utils::get_config_option);
+
+    cout << "parse per option:\t" << legacy << " logins/s" << endl;
+    cout << "options cache:\t\t" << cached << " logins/s" << endl;
+
+    return 0;
+}
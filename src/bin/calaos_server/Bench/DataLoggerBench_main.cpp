@@ -0,0 +1,124 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <chrono>
+#include <cmath>
+#include "Calaos.h"
+#include "DataLogger.h"
+
+using namespace Calaos;
+
+/*
+ * DataLogger benchmark.
+ *
+ * Logs one value per minute for a number of sensors, flushing to disk every
+ * DATALOGGER_FLUSH_INTERVAL seconds of simulated time like the flush timer
+ * does, then queries raw values and hourly aggregates of one day.
+ * Use --cache to point to a scratch directory, data is written there.
+ */
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos DataLogger benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--sensors <n>\tNumber of logged sensors (default 200).\n");
+    cout << _("\t--minutes <n>\tNumber of minutes of values to log (default 1440).\n");
+    cout << endl;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("datalogger_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_sensors = 200;
+    int nb_minutes = 1440;
+    char *s = argvOptionParam(argv, argv + argc, "--sensors");
+    if (s) from_string(string(s), nb_sensors);
+    s = argvOptionParam(argv, argv + argc, "--minutes");
+    if (s) from_string(string(s), nb_minutes);
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    eina_init();
+    ecore_init();
+
+    int64_t t0 = DataLogger::periodStart(DataLogger::RES_DAY, time(NULL)) - nb_minutes * 60;
+    int64_t last_flush = t0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int m = 0;m < nb_minutes;m++)
+    {
+        int64_t t = t0 + m * 60;
+
+        for (int i = 0;i < nb_sensors;i++)
+            DataLogger::Instance().log("bench_sensor_" + Utils::to_string(i), 20.0 + 5.0 * sin(m / 60.0 + i), t);
+
+        if (t - last_flush >= DATALOGGER_FLUSH_INTERVAL)
+        {
+            DataLogger::Instance().flush();
+            last_flush = t;
+        }
+    }
+    DataLogger::Instance().flush();
+    double t_log = elapsedMs(start);
+
+    long nb_values = (long)nb_sensors * nb_minutes;
+    cout << nb_values << " values logged in " << t_log << "ms (" << t_log * 1000.0 / nb_values << "us/value)" << endl;
+
+    int64_t qstart = t0 + (nb_minutes > 1440?(nb_minutes - 1440) * 60:0);
+    int64_t qend = t0 + nb_minutes * 60;
+
+    start = std::chrono::steady_clock::now();
+    vector<DataLoggerSample> values;
+    DataLogger::Instance().getValues("bench_sensor_0", qstart, qend, values);
+    cout << "raw query: " << values.size() << " values in " << elapsedMs(start) << "ms" << endl;
+
+    start = std::chrono::steady_clock::now();
+    vector<DataLoggerAggregate> aggr;
+    DataLogger::Instance().getAggregates("bench_sensor_0", DataLogger::RES_HOUR, qstart, qend, aggr);
+    cout << "hourly query: " << aggr.size() << " periods in " << elapsedMs(start) << "ms" << endl;
+
+    DataLogger::Instance().shutdown();
+
+    ecore_shutdown();
+    eina_shutdown();
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <sys/resource.h>
+#include "Calaos.h"
+#include "ListeRoom.h"
+#include "ListeRule.h"
+#include "EcoreTimer.h"
+
+using namespace Calaos;
+
+/*
+ * Input event loop benchmark.
+ *
+ * Creates a number of InputTime and InPlageHoraire inputs and runs the main
+ * loop for a while, first with the old 10ms polling of all inputs, then with
+ * the deadline based scheduler of ListeRule. Wakeups and CPU time used by
+ * the process are reported for both.
+ */
+
+static vector<Input *> bench_inputs;
+static unsigned long legacy_wakeups = 0;
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos input event loop benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--inputs <n>\tNumber of inputs of each type (default 200).\n");
+    cout << _("\t--duration <s>\tDuration of each run in seconds (default 10).\n");
+    cout << endl;
+}
+
+static void createInputs(Room *room, int count)
+{
+    for (int i = 0;i < count;i++)
+    {
+        Params p;
+        p.Add("type", "InputTime");
+        p.Add("name", "bench_time_" + Utils::to_string(i));
+        p.Add("id", "bench_time_" + Utils::to_string(i));
+        p.Add("hour", Utils::to_string(i % 24));
+        p.Add("min", Utils::to_string(i % 60));
+        p.Add("sec", "0");
+        bench_inputs.push_back(ListeRoom::Instance().createInput(p, room));
+
+        Params pp;
+        pp.Add("type", "InPlageHoraire");
+        pp.Add("name", "bench_plage_" + Utils::to_string(i));
+        pp.Add("id", "bench_plage_" + Utils::to_string(i));
+        InPlageHoraire *plage = dynamic_cast<InPlageHoraire *>(ListeRoom::Instance().createInput(pp, room));
+
+        TimeRange tr;
+        tr.shour = Utils::to_string(i % 24);
+        tr.smin = "0";
+        tr.ssec = "0";
+        tr.ehour = Utils::to_string(i % 24);
+        tr.emin = "30";
+        tr.esec = "0";
+        plage->AddLundi(tr);
+        plage->AddMercredi(tr);
+        plage->AddSamedi(tr);
+
+        bench_inputs.push_back(plage);
+    }
+}
+
+static void legacyEventLoop()
+{
+    legacy_wakeups++;
+
+    for (uint i = 0;i < bench_inputs.size();i++)
+        bench_inputs[i]->hasChanged();
+}
+
+static double cpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+}
+
+static void runMainLoop(double duration)
+{
+    EcoreTimer::singleShot(duration, [] { ecore_main_loop_quit(); });
+    ecore_main_loop_begin();
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("eventloop_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_inputs = 200;
+    double duration = 10.0;
+    char *s = argvOptionParam(argv, argv + argc, "--inputs");
+    if (s) from_string(string(s), nb_inputs);
+    s = argvOptionParam(argv, argv + argc, "--duration");
+    if (s) from_string(string(s), duration);
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    //Ensure calling order of destructors
+    ListeRule::Instance();
+    ListeRoom::Instance();
+
+    eina_init();
+    ecore_init();
+
+    Room *room = new Room("bench", "bench", 0);
+    ListeRoom::Instance().Add(room);
+
+    createInputs(room, nb_inputs);
+
+    cout << bench_inputs.size() << " inputs, " << duration << "s per run" << endl;
+    cout << "mode\t\twakeups\tcpu (s)" << endl;
+
+    //Old behaviour: check all inputs every 10ms
+    {
+        EcoreTimer *timer = new EcoreTimer(10. / 1000., (sigc::slot<void>)sigc::ptr_fun(legacyEventLoop));
+        double cpu = cpuTime();
+        runMainLoop(duration);
+        cpu = cpuTime() - cpu;
+        delete timer;
+
+        cout << "10ms polling\t" << legacy_wakeups << "\t" << cpu << endl;
+    }
+
+    //Scheduler: only inputs that reached their deadline are checked
+    {
+        double cpu = cpuTime();
+        ListeRule::Instance().RunEventLoop();
+        runMainLoop(duration);
+        ListeRule::Instance().StopLoop();
+        cpu = cpuTime() - cpu;
+
+        cout << "scheduler\t" << ListeRule::Instance().getEventLoopWakeups() << "\t" << cpu << endl;
+    }
+
+    ecore_shutdown();
+    eina_shutdown();
+
+    return 0;
+}
@@ -0,0 +1,786 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <unordered_set>
+#include "Calaos.h"
+#include "ListeRoom.h"
+#include "ListeRule.h"
+#include "IOFactory.h"
+#include "InputSwitch.h"
+#include "InputSwitchLongPress.h"
+#include "InputSwitchTriple.h"
+#include "InputTemp.h"
+#include "InputAnalog.h"
+#include "InputString.h"
+#include "OutputLight.h"
+#include "OutputLightDimmer.h"
+#include "OutputLightRGB.h"
+#include "OutputShutter.h"
+#include "OutputShutterSmart.h"
+#include "OutputAnalog.h"
+#include "OutputString.h"
+
+using namespace Calaos;
+
+/*
+ * Rules engine replay benchmark.
+ *
+ * Loads a home from an io.xml and a rules.xml, or generates a synthetic home
+ * with N rooms and M rules. All IOs that need hardware are replaced by in
+ * memory fakes, then a trace of IO changes is replayed. For each event the
+ * dispatch time (the rules of the IO and all the rules they cascade to) is
+ * measured. Latency percentiles, rules checked/fired and the number of
+ * memory allocations are reported.
+ *
+ * Trace format, one event per line, ordered by time:
+ *     <time in seconds> <io id> <value>
+ * Without a trace, random changes of the home inputs are replayed.
+ */
+
+static std::atomic<unsigned long> alloc_count(0);
+
+//Count all allocations of the process
+void *operator new(size_t size)
+{
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+
+    void *p = malloc(size?size:1);
+    if (!p) throw std::bad_alloc();
+
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+//In memory fakes, they keep the behavior of the generic IO classes but
+//don't talk to any hardware. Values are injected with force_input_xxx()
+class BenchInputSwitch: public InputSwitch
+{
+protected:
+    virtual bool readValue() { return value; }
+
+public:
+    BenchInputSwitch(Params &p): InputSwitch(p) {}
+};
+REGISTER_INPUT(BenchInputSwitch)
+
+class BenchInputSwitchLongPress: public InputSwitchLongPress
+{
+protected:
+    virtual bool readValue() { return false; }
+
+public:
+    BenchInputSwitchLongPress(Params &p): InputSwitchLongPress(p) {}
+};
+REGISTER_INPUT(BenchInputSwitchLongPress)
+
+class BenchInputSwitchTriple: public InputSwitchTriple
+{
+protected:
+    virtual bool readValue() { return false; }
+
+public:
+    BenchInputSwitchTriple(Params &p): InputSwitchTriple(p) {}
+};
+REGISTER_INPUT(BenchInputSwitchTriple)
+
+class BenchInputTemp: public InputTemp
+{
+protected:
+    virtual void readValue() { }
+
+public:
+    BenchInputTemp(Params &p): InputTemp(p) {}
+};
+REGISTER_INPUT(BenchInputTemp)
+
+class BenchInputAnalog: public InputAnalog
+{
+protected:
+    virtual void readValue() { }
+
+public:
+    BenchInputAnalog(Params &p): InputAnalog(p) {}
+};
+REGISTER_INPUT(BenchInputAnalog)
+
+class BenchInputString: public InputString
+{
+protected:
+    virtual void readValue() { }
+
+public:
+    BenchInputString(Params &p): InputString(p) {}
+
+    virtual void force_input_string(std::string v)
+    {
+        if (!isEnabled()) return;
+
+        value = v;
+        emitChange();
+    }
+};
+REGISTER_INPUT(BenchInputString)
+
+class BenchOutputLight: public OutputLight
+{
+protected:
+    virtual bool set_value_real(bool val) { return true; }
+
+public:
+    BenchOutputLight(Params &p): OutputLight(p) {}
+};
+REGISTER_OUTPUT(BenchOutputLight)
+
+class BenchOutputLightDimmer: public OutputLightDimmer
+{
+protected:
+    virtual bool set_value_real(int val) { return true; }
+
+public:
+    BenchOutputLightDimmer(Params &p): OutputLightDimmer(p) {}
+};
+REGISTER_OUTPUT(BenchOutputLightDimmer)
+
+class BenchOutputLightRGB: public OutputLightRGB
+{
+protected:
+    virtual void setColorReal(const ColorValue &color, bool state) { }
+
+public:
+    BenchOutputLightRGB(Params &p): OutputLightRGB(p) {}
+};
+REGISTER_OUTPUT(BenchOutputLightRGB)
+
+class BenchOutputShutter: public OutputShutter
+{
+public:
+    BenchOutputShutter(Params &p): OutputShutter(p) {}
+};
+REGISTER_OUTPUT(BenchOutputShutter)
+
+class BenchOutputShutterSmart: public OutputShutterSmart
+{
+public:
+    BenchOutputShutterSmart(Params &p): OutputShutterSmart(p) {}
+};
+REGISTER_OUTPUT(BenchOutputShutterSmart)
+
+class BenchOutputAnalog: public OutputAnalog
+{
+protected:
+    virtual void set_value_real(double val) { }
+
+public:
+    BenchOutputAnalog(Params &p): OutputAnalog(p) {}
+};
+REGISTER_OUTPUT(BenchOutputAnalog)
+
+class BenchOutputString: public OutputString
+{
+protected:
+    virtual void set_value_real(string val) { }
+
+public:
+    BenchOutputString(Params &p): OutputString(p) {}
+};
+REGISTER_OUTPUT(BenchOutputString)
+
+//Fake used for each hardware IO type (lower case, like in IOFactory).
+//Unknown types are replaced by a BenchInputSwitch or an OutputFake.
+static const unordered_map<string, string> fake_types =
+{
+    { "gpioinputswitch", "BenchInputSwitch" },
+    { "mysensorsinputswitch", "BenchInputSwitch" },
+    { "pinginputswitch", "BenchInputSwitch" },
+    { "widigitalbp", "BenchInputSwitch" },
+    { "widigital", "BenchInputSwitch" },
+    { "wagoinputswitch", "BenchInputSwitch" },
+    { "zibasedigitalin", "BenchInputSwitch" },
+    { "gpioinputswitchlongpress", "BenchInputSwitchLongPress" },
+    { "mysensorsinputswitchlongpress", "BenchInputSwitchLongPress" },
+    { "widigitallong", "BenchInputSwitchLongPress" },
+    { "wagoinputswitchlongpress", "BenchInputSwitchLongPress" },
+    { "gpioinputswitchtriple", "BenchInputSwitchTriple" },
+    { "mysensorsinputswitchtriple", "BenchInputSwitchTriple" },
+    { "widigitaltriple", "BenchInputSwitchTriple" },
+    { "wagoinputswitchtriple", "BenchInputSwitchTriple" },
+    { "mysensorsinputtemp", "BenchInputTemp" },
+    { "owtemp", "BenchInputTemp" },
+    { "witemp", "BenchInputTemp" },
+    { "wagoinputtemp", "BenchInputTemp" },
+    { "webinputtemp", "BenchInputTemp" },
+    { "zibasetemp", "BenchInputTemp" },
+    { "mysensorsinputanalog", "BenchInputAnalog" },
+    { "wianalog", "BenchInputAnalog" },
+    { "wagoinputanalog", "BenchInputAnalog" },
+    { "webinputanalog", "BenchInputAnalog" },
+    { "zibaseanalogin", "BenchInputAnalog" },
+    { "mysensorsinputstring", "BenchInputString" },
+    { "webinputstring", "BenchInputString" },
+    { "gpiooutputswitch", "BenchOutputLight" },
+    { "mysensorsoutputlight", "BenchOutputLight" },
+    { "wodigital", "BenchOutputLight" },
+    { "wagooutputlight", "BenchOutputLight" },
+    { "weboutputlight", "BenchOutputLight" },
+    { "zibasedigitalout", "BenchOutputLight" },
+    { "mysensorsoutputdimmer", "BenchOutputLightDimmer" },
+    { "olaoutputlightdimmer", "BenchOutputLightDimmer" },
+    { "wodali", "BenchOutputLightDimmer" },
+    { "wagooutputdimmer", "BenchOutputLightDimmer" },
+    { "x10output", "BenchOutputLightDimmer" },
+    { "blinkstickoutputlightrgb", "BenchOutputLightRGB" },
+    { "hueoutputlightrgb", "BenchOutputLightRGB" },
+    { "milightoutputlightrgb", "BenchOutputLightRGB" },
+    { "mysensorsoutputlightrgb", "BenchOutputLightRGB" },
+    { "olaoutputlightrgb", "BenchOutputLightRGB" },
+    { "wodalirvb", "BenchOutputLightRGB" },
+    { "wagooutputdimmerrgb", "BenchOutputLightRGB" },
+    { "weboutputlightrgb", "BenchOutputLightRGB" },
+    { "gpiooutputshutter", "BenchOutputShutter" },
+    { "mysensorsoutputshutter", "BenchOutputShutter" },
+    { "wovolet", "BenchOutputShutter" },
+    { "wagooutputshutter", "BenchOutputShutter" },
+    { "gpiooutputshuttersmart", "BenchOutputShutterSmart" },
+    { "mysensorsoutputshuttersmart", "BenchOutputShutterSmart" },
+    { "wovoletsmart", "BenchOutputShutterSmart" },
+    { "wagooutputshuttersmart", "BenchOutputShutterSmart" },
+    { "mysensorsoutputanalog", "BenchOutputAnalog" },
+    { "woanalog", "BenchOutputAnalog" },
+    { "wagooutputanalog", "BenchOutputAnalog" },
+    { "mysensorsoutputstring", "BenchOutputString" },
+    { "weboutputstring", "BenchOutputString" },
+};
+
+//These types don't need any hardware and are loaded as is
+static const unordered_set<string> soft_types =
+{
+    "internalbool", "internalint", "internalstring", "scenario",
+    "inplagehoraire", "timerange", "inputtime", "inputtimer", "outputfake",
+};
+
+class TraceEvent
+{
+public:
+    double time = 0.0;
+    string id;
+    string value;
+};
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos rules engine replay benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--io <file>\tLoad the home from this io.xml.\n");
+    cout << _("\t--rules <file>\tLoad the rules from this rules.xml.\n");
+    cout << _("\t--trace <file>\tReplay this trace instead of random events.\n");
+    cout << _("\t--rooms <n>\tNumber of rooms of the synthetic home (default 10).\n");
+    cout << _("\t--rule-count <n>\tNumber of rules of the synthetic home (default 100).\n");
+    cout << _("\t--events <n>\tNumber of random events (default 10000).\n");
+    cout << _("\t--save <path>\tSave io.xml, rules.xml and trace.txt to <path>.\n");
+    cout << _("\t--realtime\tReplay events at the time of the trace.\n");
+    cout << endl;
+}
+
+static TiXmlElement *addIO(TiXmlElement *room, const string &node, const string &type, const string &id)
+{
+    TiXmlElement *io = new TiXmlElement(node);
+    io->SetAttribute("type", type);
+    io->SetAttribute("id", id);
+    io->SetAttribute("name", id);
+    room->LinkEndChild(io);
+
+    return io;
+}
+
+static void addRule(TiXmlElement *rules, const string &type, const string &name,
+                    const string &in_id, const string &oper, const string &in_val,
+                    const string &out_id, const string &out_val)
+{
+    TiXmlElement *rule = new TiXmlElement("calaos:rule");
+    rule->SetAttribute("type", type);
+    rule->SetAttribute("name", name);
+    rules->LinkEndChild(rule);
+
+    TiXmlElement *cond = new TiXmlElement("calaos:condition");
+    cond->SetAttribute("type", "standard");
+    cond->SetAttribute("trigger", "true");
+    rule->LinkEndChild(cond);
+
+    TiXmlElement *in = new TiXmlElement("calaos:input");
+    in->SetAttribute("id", in_id);
+    in->SetAttribute("oper", oper);
+    in->SetAttribute("val", in_val);
+    cond->LinkEndChild(in);
+
+    TiXmlElement *action = new TiXmlElement("calaos:action");
+    action->SetAttribute("type", "standard");
+    rule->LinkEndChild(action);
+
+    TiXmlElement *out = new TiXmlElement("calaos:output");
+    out->SetAttribute("id", out_id);
+    out->SetAttribute("val", out_val);
+    action->LinkEndChild(out);
+}
+
+//Generate a home with hardware IO types, like a real installation
+static void generateHome(int nb_rooms, int nb_rules, TiXmlDocument &io_doc, TiXmlDocument &rules_doc)
+{
+    io_doc.LinkEndChild(new TiXmlDeclaration("1.0", "UTF-8", ""));
+    TiXmlElement *ionode = new TiXmlElement("calaos:ioconfig");
+    ionode->SetAttribute("xmlns:calaos", "http://www.calaos.fr");
+    io_doc.LinkEndChild(ionode);
+    TiXmlElement *home = new TiXmlElement("calaos:home");
+    ionode->LinkEndChild(home);
+
+    for (int r = 0;r < nb_rooms;r++)
+    {
+        string prefix = "room" + Utils::to_string(r) + "_";
+
+        TiXmlElement *room = new TiXmlElement("calaos:room");
+        room->SetAttribute("name", "room " + Utils::to_string(r));
+        room->SetAttribute("type", "bench");
+        room->SetAttribute("hits", "0");
+        home->LinkEndChild(room);
+
+        addIO(room, "calaos:input", "WagoInputSwitch", prefix + "switch0");
+        addIO(room, "calaos:input", "WagoInputSwitch", prefix + "switch1");
+        addIO(room, "calaos:input", "WagoInputTemp", prefix + "temp");
+        addIO(room, "calaos:output", "WagoOutputLight", prefix + "light0");
+        addIO(room, "calaos:output", "WagoOutputLight", prefix + "light1");
+        addIO(room, "calaos:output", "WagoOutputDimmer", prefix + "dimmer");
+        addIO(room, "calaos:output", "WagoOutputShutter", prefix + "shutter")->SetAttribute("time", "30");
+        addIO(room, "calaos:internal", "InternalBool", prefix + "presence");
+    }
+
+    rules_doc.LinkEndChild(new TiXmlDeclaration("1.0", "UTF-8", ""));
+    TiXmlElement *rules = new TiXmlElement("calaos:rules");
+    rules->SetAttribute("xmlns:calaos", "http://www.calaos.fr");
+    rules_doc.LinkEndChild(rules);
+
+    for (int i = 0;i < nb_rules;i++)
+    {
+        int r = i % nb_rooms;
+        string prefix = "room" + Utils::to_string(r) + "_";
+        string type = "room " + Utils::to_string(r);
+        string name = "rule_" + Utils::to_string(i);
+
+        switch ((i / nb_rooms) % 5)
+        {
+        case 0: addRule(rules, type, name, prefix + "switch0", "==", "true", prefix + "light0", "toggle"); break;
+        case 1: addRule(rules, type, name, prefix + "switch1", "==", "true", prefix + "dimmer", "set 50"); break;
+        case 2: addRule(rules, type, name, prefix + "temp", "SUP", "25", prefix + "shutter", "down"); break;
+        case 3: addRule(rules, type, name, prefix + "switch0", "==", "true", prefix + "presence", "true"); break;
+        case 4:
+            //presence cascades to the next room
+            if (r + 1 < nb_rooms)
+                addRule(rules, type, name, prefix + "presence", "==", "true",
+                        "room" + Utils::to_string(r + 1) + "_presence", "true");
+            else
+                addRule(rules, type, name, prefix + "presence", "==", "true", prefix + "light1", "true");
+            break;
+        }
+    }
+}
+
+//Replace hardware IOs of a room by fakes, return the number of IOs replaced
+static int substituteIO(TiXmlElement *room_node)
+{
+    int count = 0;
+
+    TiXmlElement *node = room_node->FirstChildElement();
+    while (node)
+    {
+        TiXmlElement *next = node->NextSiblingElement();
+
+        if (node->ValueStr() == "calaos:audio" ||
+            node->ValueStr() == "calaos:camera" ||
+            node->ValueStr() == "calaos:avr")
+        {
+            //there is no fake for these devices
+            cWarning() << "Skipping " << node->ValueStr() << " "
+                       << (node->Attribute("id")?node->Attribute("id"):"");
+            room_node->RemoveChild(node);
+        }
+        else if (node->ValueStr() == "calaos:input" ||
+                 node->ValueStr() == "calaos:output")
+        {
+            string type = node->Attribute("type")?node->Attribute("type"):"";
+            std::transform(type.begin(), type.end(), type.begin(), Utils::to_lower());
+
+            if (soft_types.find(type) == soft_types.end() &&
+                type.compare(0, 5, "bench") != 0)
+            {
+                string fake;
+
+                auto it = fake_types.find(type);
+                if (it != fake_types.end())
+                    fake = it->second;
+                else if (node->ValueStr() == "calaos:input")
+                    fake = "BenchInputSwitch";
+                else
+                    fake = "OutputFake";
+
+                node->SetAttribute("type", fake);
+                count++;
+            }
+        }
+
+        node = next;
+    }
+
+    return count;
+}
+
+static void loadHome(TiXmlDocument &document)
+{
+    TiXmlHandle docHandle(&document);
+    int nb_fakes = 0;
+
+    TiXmlElement *room_node = docHandle.FirstChildElement("calaos:ioconfig").FirstChildElement("calaos:home").FirstChildElement().ToElement();
+    for(; room_node; room_node = room_node->NextSiblingElement())
+    {
+        if (room_node->ValueStr() == "calaos:room" &&
+            room_node->Attribute("name") &&
+            room_node->Attribute("type"))
+        {
+            nb_fakes += substituteIO(room_node);
+
+            int hits = 0;
+            if (room_node->Attribute("hits"))
+                room_node->Attribute("hits", &hits);
+
+            Room *room = new Room(room_node->Attribute("name"), room_node->Attribute("type"), hits);
+            ListeRoom::Instance().Add(room);
+
+            room->LoadFromXml(room_node);
+        }
+    }
+
+    cout << "home:\t\t" << ListeRoom::Instance().size() << " rooms, "
+         << ListeRoom::Instance().get_nb_input() << " inputs, "
+         << ListeRoom::Instance().get_nb_output() << " outputs ("
+         << nb_fakes << " fakes)" << endl;
+}
+
+static void loadRules(TiXmlDocument &document)
+{
+    TiXmlHandle docHandle(&document);
+
+    TiXmlElement *rule_node = docHandle.FirstChildElement("calaos:rules").FirstChildElement().ToElement();
+    for(; rule_node; rule_node = rule_node->NextSiblingElement())
+    {
+        if (rule_node->ValueStr() == "calaos:rule" &&
+            rule_node->Attribute("name") &&
+            rule_node->Attribute("type"))
+        {
+            Rule *rule = new Rule(rule_node->Attribute("type"), rule_node->Attribute("name"));
+            rule->LoadFromXml(rule_node);
+
+            ListeRule::Instance().Add(rule);
+        }
+    }
+
+    cout << "rules:\t\t" << ListeRule::Instance().size() << endl;
+}
+
+static bool loadTrace(const string &file, vector<TraceEvent> &trace)
+{
+    std::ifstream f(file.c_str());
+    if (!f.is_open())
+        return false;
+
+    string line;
+    while (std::getline(f, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream iss(line);
+        TraceEvent ev;
+        if (!(iss >> ev.time >> ev.id)) continue;
+
+        //the value is the rest of the line, it may contain spaces
+        std::getline(iss >> std::ws, ev.value);
+
+        trace.push_back(ev);
+    }
+
+    std::stable_sort(trace.begin(), trace.end(),
+                     [](const TraceEvent &a, const TraceEvent &b) { return a.time < b.time; });
+
+    return true;
+}
+
+//Random changes of the fake and internal inputs of the home
+static void generateTrace(int nb_events, vector<TraceEvent> &trace)
+{
+    vector<Input *> inputs;
+    for (int i = 0;i < ListeRoom::Instance().get_nb_input();i++)
+    {
+        Input *in = ListeRoom::Instance().get_input(i);
+        string type = in->get_param("type");
+
+        if (type.compare(0, 5, "Bench") == 0 || type.compare(0, 8, "Internal") == 0)
+            inputs.push_back(in);
+    }
+
+    if (inputs.empty()) return;
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, inputs.size() - 1);
+    std::uniform_int_distribution<int> temp(150, 300);
+    std::uniform_int_distribution<int> press(1, 3);
+    unordered_map<Input *, bool> states;
+
+    for (int i = 0;i < nb_events;i++)
+    {
+        Input *in = inputs[dist(gen)];
+
+        TraceEvent ev;
+        ev.time = i * 0.1;
+        ev.id = in->get_param("id");
+
+        switch (in->get_type())
+        {
+        case TBOOL:
+            states[in] = !states[in];
+            ev.value = states[in]?"true":"false";
+            break;
+        case TINT:
+            if (in->get_param("type").find("Switch") != string::npos)
+                ev.value = Utils::to_string(press(gen));
+            else
+                ev.value = Utils::to_string(temp(gen) / 10.0);
+            break;
+        default:
+            ev.value = "bench_" + Utils::to_string(i);
+            break;
+        }
+
+        trace.push_back(ev);
+    }
+}
+
+static void saveTrace(const string &file, const vector<TraceEvent> &trace)
+{
+    std::ofstream f(file.c_str());
+
+    f << "# time io_id value" << endl;
+    for (const TraceEvent &ev: trace)
+        f << ev.time << " " << ev.id << " " << ev.value << endl;
+}
+
+//Change the io like its hardware would do
+static bool injectEvent(const TraceEvent &ev)
+{
+    Input *in = ListeRoom::Instance().get_input(ev.id);
+    if (in)
+    {
+        double d = 0.0;
+
+        switch (in->get_type())
+        {
+        case TBOOL: in->force_input_bool(ev.value == "true"); break;
+        case TINT:
+            Utils::from_string(ev.value, d);
+            in->force_input_double(d);
+            break;
+        case TSTRING: in->force_input_string(ev.value); break;
+        default: break;
+        }
+
+        return true;
+    }
+
+    Output *out = ListeRoom::Instance().get_output(ev.id);
+    if (out)
+    {
+        out->set_value(ev.value);
+        return true;
+    }
+
+    return false;
+}
+
+static double percentile(const vector<double> &sorted, double p)
+{
+    if (sorted.empty()) return 0.0;
+
+    return sorted[(uint)(p * (sorted.size() - 1) + 0.5)];
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("replay_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_rooms = 10, nb_rules = 100, nb_events = 10000;
+    char *s = argvOptionParam(argv, argv + argc, "--rooms");
+    if (s) from_string(string(s), nb_rooms);
+    s = argvOptionParam(argv, argv + argc, "--rule-count");
+    if (s) from_string(string(s), nb_rules);
+    s = argvOptionParam(argv, argv + argc, "--events");
+    if (s) from_string(string(s), nb_events);
+    if (nb_rooms < 1) nb_rooms = 1;
+
+    char *io_file = argvOptionParam(argv, argv + argc, "--io");
+    char *rules_file = argvOptionParam(argv, argv + argc, "--rules");
+    char *trace_file = argvOptionParam(argv, argv + argc, "--trace");
+    char *save_dir = argvOptionParam(argv, argv + argc, "--save");
+    bool realtime = argvOptionCheck(argv, argv + argc, "--realtime");
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    //Ensure calling order of destructors
+    ListeRule::Instance();
+    ListeRoom::Instance();
+
+    eina_init();
+    ecore_init();
+
+    TiXmlDocument io_doc, rules_doc;
+
+    if (io_file)
+    {
+        if (!io_doc.LoadFile(io_file) ||
+            (rules_file && !rules_doc.LoadFile(rules_file)))
+        {
+            cError() << "Failed to load home: " << io_doc.ErrorDesc() << " " << rules_doc.ErrorDesc();
+            exit(1);
+        }
+    }
+    else
+    {
+        generateHome(nb_rooms, nb_rules, io_doc, rules_doc);
+    }
+
+    //save before loading, IOs are replaced by fakes in the documents
+    if (save_dir)
+    {
+        io_doc.SaveFile(string(save_dir) + "/io.xml");
+        rules_doc.SaveFile(string(save_dir) + "/rules.xml");
+    }
+
+    loadHome(io_doc);
+    loadRules(rules_doc);
+
+    vector<TraceEvent> trace;
+    if (trace_file)
+    {
+        if (!loadTrace(trace_file, trace))
+        {
+            cError() << "Failed to load trace " << trace_file;
+            exit(1);
+        }
+    }
+    else
+    {
+        generateTrace(nb_events, trace);
+    }
+
+    if (save_dir)
+        saveTrace(string(save_dir) + "/trace.txt", trace);
+
+    //let the IOs finish their initialisation
+    ecore_main_loop_iterate();
+
+    vector<double> latencies;
+    latencies.reserve(trace.size());
+    unsigned long rules_checked = 0, rules_fired = 0, allocs = 0, dispatched = 0, unknown = 0;
+
+    double start = ecore_time_get();
+
+    for (const TraceEvent &ev: trace)
+    {
+        if (realtime)
+        {
+            double wait = start + ev.time - ecore_time_get();
+            if (wait > 0.0) usleep(wait * 1000000.0);
+        }
+
+        unsigned long propagations = ListeRule::Instance().getPropagationCount();
+        unsigned long a = alloc_count.load(std::memory_order_relaxed);
+
+        auto t0 = std::chrono::steady_clock::now();
+        bool found = injectEvent(ev);
+        auto t1 = std::chrono::steady_clock::now();
+
+        allocs += alloc_count.load(std::memory_order_relaxed) - a;
+
+        if (!found)
+        {
+            unknown++;
+            continue;
+        }
+
+        latencies.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+
+        if (ListeRule::Instance().getPropagationCount() != propagations)
+        {
+            const RulesPropagationStats &stats = ListeRule::Instance().getLastPropagationStats();
+            rules_checked += stats.rules_checked;
+            rules_fired += stats.rules_fired;
+            dispatched++;
+        }
+
+        //run timers and events of the IOs, not measured
+        ecore_main_loop_iterate();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    double nb = latencies.empty()?1.0:latencies.size();
+
+    cout << "events:\t\t" << latencies.size() << " (" << dispatched << " dispatched to rules, "
+         << unknown << " unknown ios)" << endl;
+    cout << "latency (us):\tp50 " << percentile(latencies, 0.5)
+         << "\tp90 " << percentile(latencies, 0.9)
+         << "\tp99 " << percentile(latencies, 0.99)
+         << "\tmax " << percentile(latencies, 1.0) << endl;
+    cout << "rules checked:\t" << rules_checked << " (" << rules_checked / nb << "/event)" << endl;
+    cout << "rules fired:\t" << rules_fired << " (" << rules_fired / nb << "/event)" << endl;
+    cout << "max depth:\t" << ListeRule::Instance().getMaxDepth() << " ("
+         << ListeRule::Instance().getLoopsDetected() << " loops detected)" << endl;
+    cout << "allocations:\t" << allocs << " (" << allocs / nb << "/event)" << endl;
+
+    ecore_shutdown();
+    eina_shutdown();
+
+    return 0;
+}
@@ -0,0 +1,292 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <chrono>
+#include <random>
+#include "Calaos.h"
+#include "ListeRoom.h"
+#include "ListeRule.h"
+
+using namespace Calaos;
+
+/*
+ * Rules engine micro benchmark.
+ *
+ * Creates a synthetic home with a growing number of rules (each rule has one
+ * condition on its own InternalBool and one action on another InternalBool)
+ * and measures the cost of ListeRule::ExecuteRuleSignal() for each rule count.
+ * The old full scan of all rules/conditions is also measured to compare.
+ * The rules are run with the default log levels, the cost of a disabled
+ * debug log statement is measured at the end.
+ * A chain of cascading rules and a rules loop are then run to show the
+ * propagation statistics.
+ */
+
+static Room *bench_room = nullptr;
+static vector<Input *> bench_inputs;
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos rules engine benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--signals <n>\tNumber of signals dispatched for each rule count (default 10000).\n");
+    cout << endl;
+}
+
+static void growHome(int nb_rules)
+{
+    for (int i = bench_inputs.size();i < nb_rules;i++)
+    {
+        Params p;
+        p.Add("type", "InternalBool");
+        p.Add("name", "bench_in_" + Utils::to_string(i));
+        p.Add("id", "bench_in_" + Utils::to_string(i));
+        Input *in = ListeRoom::Instance().createInput(p, bench_room);
+
+        Params po;
+        po.Add("type", "InternalBool");
+        po.Add("name", "bench_out_" + Utils::to_string(i));
+        po.Add("id", "bench_out_" + Utils::to_string(i));
+        Output *out = dynamic_cast<Output *>(ListeRoom::Instance().createInput(po, bench_room));
+
+        Rule *rule = new Rule("bench", "rule_" + Utils::to_string(i));
+
+        ConditionStd *cond = new ConditionStd();
+        cond->Add(in);
+        cond->get_operator().Add(in->get_param("id"), "==");
+        cond->get_params().Add(in->get_param("id"), "true");
+        rule->AddCondition(cond);
+
+        ActionStd *action = new ActionStd();
+        action->Add(out);
+        action->get_params().Add(out->get_param("id"), "true");
+        rule->AddAction(action);
+
+        ListeRule::Instance().Add(rule);
+
+        bench_inputs.push_back(in);
+    }
+}
+
+//Rule "when in changes, toggle out"
+static void addToggleRule(const string &name, Input *in, Output *out)
+{
+    Rule *rule = new Rule("bench", name);
+
+    ConditionStd *cond = new ConditionStd();
+    cond->Add(in);
+    cond->get_operator().Add(in->get_param("id"), "==");
+    cond->get_params().Add(in->get_param("id"), "changed");
+    rule->AddCondition(cond);
+
+    ActionStd *action = new ActionStd();
+    action->Add(out);
+    action->get_params().Add(out->get_param("id"), "toggle");
+    rule->AddAction(action);
+
+    ListeRule::Instance().Add(rule);
+}
+
+static Output *createBool(const string &id)
+{
+    Params p;
+    p.Add("type", "InternalBool");
+    p.Add("name", id);
+    p.Add("id", id);
+
+    return dynamic_cast<Output *>(ListeRoom::Instance().createInput(p, bench_room));
+}
+
+static void printPropagation(const string &name)
+{
+    const RulesPropagationStats &stats = ListeRule::Instance().getLastPropagationStats();
+
+    cout << name << ":	" << stats.depth << " waves, "
+         << stats.rules_checked << " rules checked, "
+         << stats.rules_fired << " rules fired, "
+         << stats.duration * 1000000.0 << " us"
+         << (stats.loop_detected?", loop detected":"") << endl;
+}
+
+static void cascadeBench(int chain_length)
+{
+    vector<Output *> chain;
+    for (int i = 0;i <= chain_length;i++)
+        chain.push_back(createBool("bench_chain_" + Utils::to_string(i)));
+
+    for (int i = 0;i < chain_length;i++)
+        addToggleRule("chain_" + Utils::to_string(i),
+                      dynamic_cast<Input *>(chain[i]), chain[i + 1]);
+
+    Output *loop_a = createBool("bench_loop_a");
+    Output *loop_b = createBool("bench_loop_b");
+    addToggleRule("loop_a", dynamic_cast<Input *>(loop_a), loop_b);
+    addToggleRule("loop_b", dynamic_cast<Input *>(loop_b), loop_a);
+
+    cout << endl;
+
+    chain[0]->set_value(string("toggle"));
+    printPropagation("chain of " + Utils::to_string(chain_length) + " rules");
+
+    loop_a->set_value(string("toggle"));
+    printPropagation("loop of 2 rules");
+}
+
+//This is the lookup done by ExecuteRuleSignal() before the rules index
+static int legacyScan(const string &io_id)
+{
+    int found = 0;
+
+    for (int i = 0;i < ListeRule::Instance().size();i++)
+    {
+        Rule *rule = ListeRule::Instance().get_rule(i);
+        for (int j = 0;j < rule->get_size_conds();j++)
+        {
+            ConditionStd *cond = dynamic_cast<ConditionStd *>(rule->get_condition(j));
+            for (int k = 0;cond && k < cond->get_size();k++)
+            {
+                if (cond->get_input(k)->get_param("id") == io_id)
+                    found++;
+            }
+            if (cond)
+            {
+                vector<Input *> list;
+                cond->getVarIds(list);
+            }
+
+            ConditionScript *scond = dynamic_cast<ConditionScript *>(rule->get_condition(j));
+            for (int k = 0;scond && k < scond->get_size();k++)
+            {
+                if (scond->get_input(k)->get_param("id") == io_id)
+                    found++;
+            }
+
+            ConditionOutput *ocond = dynamic_cast<ConditionOutput *>(rule->get_condition(j));
+            if (ocond && ocond->getOutput()->get_param("id") == io_id)
+                found++;
+        }
+    }
+
+    return found;
+}
+
+template<typename F>
+static double measure(int nb_signals, F func)
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, bench_inputs.size() - 1);
+
+    vector<string> ids;
+    for (int i = 0;i < nb_signals;i++)
+        ids.push_back(bench_inputs[dist(gen)]->get_param("id"));
+
+    auto start = std::chrono::steady_clock::now();
+    for (const string &id: ids)
+        func(id);
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / nb_signals;
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("rules_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_signals = 10000;
+    char *s = argvOptionParam(argv, argv + argc, "--signals");
+    if (s) from_string(string(s), nb_signals);
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    //Ensure calling order of destructors
+    ListeRule::Instance();
+    ListeRoom::Instance();
+
+    eina_init();
+    ecore_init();
+
+    bench_room = new Room("bench", "bench", 0);
+    ListeRoom::Instance().Add(bench_room);
+
+    cout << "rules\tindexed (us/signal)\tfull scan (us/signal)" << endl;
+
+    for (int nb_rules: { 100, 250, 500, 1000, 1500, 3000, 6000 })
+    {
+        growHome(nb_rules);
+
+        //first signal rebuilds the index, don't count it
+        ListeRule::Instance().ExecuteRuleSignal(bench_inputs[0]->get_param("id"));
+
+        double t_index = measure(nb_signals, [](const string &id)
+        {
+            ListeRule::Instance().ExecuteRuleSignal(id);
+        });
+        double t_scan = measure(nb_signals / 10 + 1, [](const string &id)
+        {
+            legacyScan(id);
+        });
+
+        cout << nb_rules << "\t" << t_index << "\t\t\t" << t_scan << endl;
+    }
+
+    cascadeBench(10);
+
+    if (!cLoggerDom("rule")->isEnabled(EINA_LOG_LEVEL_DBG))
+    {
+        const int nb_logs = 1000000;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0;i < nb_logs;i++)
+            cDebugDom("rule") << "bench log " << i << " " << bench_room->get_name();
+        auto end = std::chrono::steady_clock::now();
+        double t_log = std::chrono::duration<double, std::nano>(end - start).count() / nb_logs;
+
+        //What a disabled statement cost before the level check
+        start = std::chrono::steady_clock::now();
+        for (int i = 0;i < nb_logs;i++)
+            Utils::einaLogger("rule")->EinaDebug(__FILE__, __PRETTY_FUNCTION__, __LINE__)
+                    << "bench log " << i << " " << bench_room->get_name();
+        end = std::chrono::steady_clock::now();
+        double t_old = std::chrono::duration<double, std::nano>(end - start).count() / nb_logs;
+
+        cout << endl << "disabled debug log: " << t_log << " ns/statement (" << t_old
+             << " ns without level check)" << endl;
+    }
+
+    ecore_shutdown();
+    eina_shutdown();
+
+    return 0;
+}
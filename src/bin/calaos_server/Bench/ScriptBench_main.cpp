@@ -0,0 +1,145 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <chrono>
+#include "Calaos.h"
+#include "ScriptManager.h"
+
+using namespace Calaos;
+
+/*
+ * Lua scripts benchmark.
+ *
+ * Runs the same small rule script over and over and prints the number of
+ * scripts per second with the pool of lua states, and with a new lua state
+ * opened, set up and closed for each run like ScriptManager used to do.
+ */
+
+static const char *bench_script =
+        "local total = 0\n"
+        "for i = 1, 20 do\n"
+        "    total = total + i\n"
+        "end\n"
+        "hour = tonumber(os.date(\"%H\"))\n"
+        "return total > 100 and hour >= 0\n";
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos lua scripts benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--runs <n>\tNumber of script runs (default 10000).\n");
+    cout << endl;
+}
+
+//This is what ExecuteScript() did for each run before the pool
+static bool legacyExecuteScript(const string &script)
+{
+    bool ret = false;
+    lua_State *L = lua_open();
+
+    for (const luaL_Reg *l = lua_libs; l->func; l++)
+    {
+        lua_pushcfunction(L, l->func);
+        lua_pushstring(L, l->name);
+        lua_call(L, 1, 0);
+    }
+
+    lua_register(L, "print", Lua_print);
+
+    Lunar<Lua_Calaos>::Register(L);
+
+    Lua_Calaos lc;
+    Lunar<Lua_Calaos>::push(L, &lc);
+    lua_setglobal(L, "calaos");
+
+    lua_sethook(L, Lua_DebugHook, LUA_MASKLINE | LUA_MASKCOUNT, 1);
+    ScriptManager::start_time = ecore_time_get();
+
+    if (luaL_loadbuffer(L, script.c_str(), script.length(), "CalaosScript") == 0 &&
+        lua_pcall(L, 0, 1, 0) == 0)
+        ret = lua_toboolean(L, -1);
+
+    lua_close(L);
+
+    return ret;
+}
+
+template<typename F>
+static double scriptsPerSec(int nb_runs, F execute)
+{
+    string script = bench_script;
+    int ok = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0;i < nb_runs;i++)
+    {
+        if (execute(script))
+            ok++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (ok != nb_runs)
+        cout << "Warning: script failed " << nb_runs - ok << " times" << endl;
+
+    return nb_runs / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("script_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_runs = 10000;
+    char *s = argvOptionParam(argv, argv + argc, "--runs");
+    if (s) from_string(string(s), nb_runs);
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    eina_init();
+    ecore_init();
+
+    double legacy = scriptsPerSec(nb_runs, legacyExecuteScript);
+    double pooled = scriptsPerSec(nb_runs, [](const string &script)
+    {
+        return ScriptManager::Instance().ExecuteScript(script);
+    });
+
+    cout << "new lua state per run:\t" << legacy << " scripts/s" << endl;
+    cout << "lua states pool:\t" << pooled << " scripts/s" << endl;
+
+    ecore_shutdown();
+    eina_shutdown();
+
+    return 0;
+}
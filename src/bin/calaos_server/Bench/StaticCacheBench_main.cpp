@@ -0,0 +1,238 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <chrono>
+#include <random>
+#include <unistd.h>
+#include <zlib.h>
+#include "Calaos.h"
+#include "StaticFileCache.h"
+
+using namespace Calaos;
+
+/*
+ * Static file cache benchmark.
+ *
+ * Writes a typical single page app bundle in a temporary directory and
+ * measures the requests per second for a reload of the whole app: with the
+ * old code that read each file in a string, with the cache sending the
+ * gzip variant installed next to the text files, and with the cache
+ * answering 304 to a revalidation.
+ */
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos static file cache benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--reloads <n>\tNumber of reloads of the app (default 200).\n");
+    cout << endl;
+}
+
+static string makeText(size_t size, std::mt19937 &gen)
+{
+    static const char *words[] = { "function", "return", "var", "this", "calaos", "=", "{", "}", "(", ")",
+                                   "io", "state", "if", "else", ";", "\n", "home", "room", "value", "." };
+    string s;
+    while (s.size() < size)
+    {
+        s += words[gen() % 20];
+        s += ' ';
+    }
+    s.resize(size);
+
+    return s;
+}
+
+static vector<string> writeBundle(const string &dir)
+{
+    std::mt19937 gen(42);
+    vector<string> files;
+
+    auto write = [&](const string &name, const string &content)
+    {
+        ofstream f(dir + "/" + name);
+        f << content;
+        files.push_back(dir + "/" + name);
+
+        //text files are installed with a gzip variant
+        if (name.find(".png") != string::npos) return;
+
+        gzFile gz = gzopen((dir + "/" + name + ".gz").c_str(), "wb9");
+        gzwrite(gz, content.data(), content.size());
+        gzclose(gz);
+    };
+
+    write("index.html", makeText(2 * 1024, gen));
+    write("app.3f2a9c1b.js", makeText(600 * 1024, gen));
+    write("vendor.9b8e7d61.js", makeText(1500 * 1024, gen));
+    write("app.5c4d3e2f.css", makeText(120 * 1024, gen));
+
+    string png(40 * 1024, 0);
+    for (uint i = 0;i < png.size();i++)
+        png[i] = gen();
+    write("logo.png", png);
+
+    for (int i = 0;i < 10;i++)
+        write("icon" + Utils::to_string(i) + ".svg", makeText(3 * 1024, gen));
+
+    return files;
+}
+
+//Same as HttpClient::buildHttpResponse without the client
+static string buildHeaders(string code, Params &headers, size_t size)
+{
+    stringstream res;
+    res << code << "\r\n";
+
+    if (!headers.Exists("Content-Length"))
+        headers.Add("Content-Length", Utils::to_string(size));
+
+    for (int i = 0;i < headers.size();i++)
+    {
+        string key, value;
+        headers.get_item(i, key, value);
+        res << key << ": " << value << "\r\n";
+    }
+    res << "\r\n";
+
+    return res.str();
+}
+
+//What was done for each file before, out is the buffer of ecore_con
+static size_t legacyRequest(const string &fileName, string &out)
+{
+    ifstream file(fileName);
+    string body((std::istreambuf_iterator<char>(file)),
+                std::istreambuf_iterator<char>());
+
+    Params headers;
+    headers.Add("Connection", "Close");
+    headers.Add("Content-Type", "application/javascript");
+    string res = buildHeaders("HTTP/1.0 200 OK", headers, body.size()) + body;
+
+    out.assign(res);
+
+    return res.size();
+}
+
+static size_t cachedRequest(const string &fileName, const string &if_none_match, string &out)
+{
+    StaticFilePtr file = StaticFileCache::Instance().get(fileName);
+    int encoding = file->selectEncoding("gzip, deflate, br");
+
+    Params headers;
+    headers.Add("Connection", "Close");
+    headers.Add("Content-Type", "application/javascript");
+    headers.Add("Content-Length", Utils::to_string(file->getSize(encoding)));
+    headers.Add("ETag", file->getEtag(encoding));
+    headers.Add("Cache-Control", file->isImmutable()?"public, max-age=31536000, immutable":"no-cache");
+
+    if (!if_none_match.empty() && file->matchEtag(if_none_match, encoding))
+    {
+        out.assign(buildHeaders("HTTP/1.1 304 Not Modified", headers, 0));
+        return out.size();
+    }
+
+    if (encoding != StaticFile::EncodingIdentity)
+        headers.Add("Content-Encoding", file->getContentEncoding(encoding));
+
+    out.assign(buildHeaders("HTTP/1.0 200 OK", headers, 0));
+    out.append(file->getData(encoding), file->getSize(encoding));
+
+    return out.size();
+}
+
+template<typename F>
+static double requestsPerSec(int reloads, const vector<string> &files, size_t &bytes, F request)
+{
+    bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0;i < reloads;i++)
+    {
+        for (const string &f: files)
+            bytes += request(f);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    bytes /= reloads;
+
+    return reloads * files.size() / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("static_cache_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int reloads = 200;
+    char *s = argvOptionParam(argv, argv + argc, "--reloads");
+    if (s) from_string(string(s), reloads);
+
+    char tmpl[] = "/tmp/calaos_static_bench_XXXXXX";
+    if (!mkdtemp(tmpl))
+    {
+        cerr << "Failed to create temporary directory" << endl;
+        return 1;
+    }
+    string dir = tmpl;
+
+    vector<string> files = writeBundle(dir);
+    string out;
+    size_t bytes;
+
+    double legacy = requestsPerSec(reloads, files, bytes, [&](const string &f) { return legacyRequest(f, out); });
+    cout << "read file:\t\t" << legacy << " requests/s, " << bytes / 1024 << " KB per reload" << endl;
+
+    double cold = requestsPerSec(1, files, bytes, [&](const string &f) { return cachedRequest(f, string(), out); });
+    cout << "cache, first load:\t" << cold << " requests/s, " << bytes / 1024 << " KB per reload" << endl;
+
+    double cached = requestsPerSec(reloads, files, bytes, [&](const string &f) { return cachedRequest(f, string(), out); });
+    cout << "cache, gzip:\t\t" << cached << " requests/s, " << bytes / 1024 << " KB per reload" << endl;
+
+    map<string, string> etags;
+    for (const string &f: files)
+    {
+        StaticFilePtr file = StaticFileCache::Instance().get(f);
+        etags[f] = file->getEtag(file->selectEncoding("gzip, deflate, br"));
+    }
+
+    double revalidate = requestsPerSec(reloads, files, bytes, [&](const string &f) { return cachedRequest(f, etags[f], out); });
+    cout << "cache, 304:\t\t" << revalidate << " requests/s, " << bytes / 1024 << " KB per reload" << endl;
+
+    cout << "cache memory: " << StaticFileCache::Instance().getMemory() / 1024 << " KB" << endl;
+
+    for (const string &f: files)
+    {
+        unlink(f.c_str());
+        unlink((f + ".gz").c_str());
+    }
+    rmdir(dir.c_str());
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <Ecore.h>
+#include <chrono>
+#include <random>
+#include "Calaos.h"
+#include "ListeRoom.h"
+#include "JsonApiV3.h"
+#include "WebSocketDeflate.h"
+
+using namespace Calaos;
+
+/*
+ * Websocket bandwidth benchmark.
+ *
+ * Creates a synthetic home, gets the get_home answer and a list of
+ * output_changed events from JsonApiV3, then computes the bytes sent on the
+ * wire for a client connecting and receiving the events: without
+ * compression and with permessage-deflate with and without context
+ * takeover. Compressed messages are inflated again to check them.
+ */
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos websocket bandwidth benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--config <path>\tSet <path> as the directory for config files.\n");
+    cout << _("\t--cache <path>\tSet <path> as the directory for cache files.\n");
+    cout << _("\t--rooms <n>\tNumber of rooms of the home (default 30).\n");
+    cout << _("\t--ios <n>\tNumber of IOs per room (default 20).\n");
+    cout << _("\t--events <n>\tNumber of events sent to the client (default 1000).\n");
+    cout << _("\t--threshold <n>\tMessages smaller than that are not compressed (default 256).\n");
+    cout << endl;
+}
+
+static vector<Output *> bench_outputs;
+
+static void createHome(int nb_rooms, int nb_ios)
+{
+    const char *types[] = { "InternalBool", "InternalInt", "InternalString" };
+
+    for (int r = 0;r < nb_rooms;r++)
+    {
+        Room *room = new Room("Bench room " + Utils::to_string(r), "lounge", 0);
+        ListeRoom::Instance().Add(room);
+
+        for (int i = 0;i < nb_ios;i++)
+        {
+            string id = "bench_" + Utils::to_string(r) + "_" + Utils::to_string(i);
+
+            Params p;
+            p.Add("type", types[i % 3]);
+            p.Add("name", "Bench IO " + Utils::to_string(i) + " of room " + Utils::to_string(r));
+            p.Add("id", id);
+            p.Add("visible", "true");
+
+            Output *o = dynamic_cast<Output *>(ListeRoom::Instance().createInput(p, room));
+            if (o) bench_outputs.push_back(o);
+        }
+    }
+}
+
+class WireStats
+{
+public:
+    uint64_t home_bytes = 0;
+    uint64_t event_bytes = 0;
+    uint64_t compressed = 0; //number of compressed messages
+    double compress_time = 0.0;
+};
+
+static uint64_t wireSize(const string &payload, WebSocketDeflate *server, WebSocketDeflate *client,
+                         int threshold, WireStats &stats)
+{
+    if (server && payload.size() >= (size_t)threshold)
+    {
+        string z, back;
+
+        auto start = std::chrono::steady_clock::now();
+        server->compress(payload, z);
+        auto end = std::chrono::steady_clock::now();
+        stats.compress_time += std::chrono::duration<double>(end - start).count();
+        stats.compressed++;
+
+        if (!client->decompress(z, back) || back != payload)
+        {
+            cError() << "Inflated message differs!";
+            exit(1);
+        }
+
+        return WebSocketFrame::makeFrames(WebSocketFrame::OpCodeText, z, FRAME_SIZE_IN_BYTES, true).size();
+    }
+
+    return WebSocketFrame::makeFrames(WebSocketFrame::OpCodeText, payload, FRAME_SIZE_IN_BYTES).size();
+}
+
+static void printStats(const string &name, const WireStats &stats, const WireStats &ref, int nb_events)
+{
+    uint64_t total = stats.home_bytes + stats.event_bytes;
+    uint64_t ref_total = ref.home_bytes + ref.event_bytes;
+
+    cout << name << endl;
+    cout << "\tget_home:\t" << stats.home_bytes << " bytes" << endl;
+    cout << "\tevents:\t\t" << stats.event_bytes << " bytes, "
+         << (double)stats.event_bytes / nb_events << " bytes/event" << endl;
+    cout << "\ttotal:\t\t" << total << " bytes, "
+         << 100.0 * total / ref_total << "% of uncompressed, "
+         << total * 8.0 / 1000000.0 << "s at 1Mbit/s" << endl;
+    if (stats.compressed > 0)
+        cout << "\tdeflate:\t" << stats.compressed << " messages, "
+             << stats.compress_time * 1000000.0 / stats.compressed << " us/message" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("websocket_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int nb_rooms = 30, nb_ios = 20, nb_events = 1000, threshold = WS_DEFLATE_THRESHOLD;
+    char *s = argvOptionParam(argv, argv + argc, "--rooms");
+    if (s) from_string(string(s), nb_rooms);
+    s = argvOptionParam(argv, argv + argc, "--ios");
+    if (s) from_string(string(s), nb_ios);
+    s = argvOptionParam(argv, argv + argc, "--events");
+    if (s) from_string(string(s), nb_events);
+    s = argvOptionParam(argv, argv + argc, "--threshold");
+    if (s) from_string(string(s), threshold);
+
+    char *confdir = argvOptionParam(argv, argv + argc, "--config");
+    char *cachedir = argvOptionParam(argv, argv + argc, "--cache");
+
+    Utils::initConfigOptions(confdir, cachedir, true);
+
+    //Ensure calling order of destructors
+    ListeRoom::Instance();
+
+    eina_init();
+    ecore_init();
+
+    createHome(nb_rooms, nb_ios);
+    if (bench_outputs.empty())
+    {
+        cError() << "No IO created";
+        exit(1);
+    }
+
+    //Get the messages from the api like a websocket client
+    JsonApiV3 api(nullptr);
+
+    string home;
+    api.sendData.connect([&home](const string &data) { home = data; });
+
+    vector<WebSocketMessagePtr> events;
+    api.sendMessage.connect([&events](const WebSocketMessagePtr &m) { events.push_back(m); });
+
+    json_t *jlogin = json_pack("{s:s, s:{s:s, s:s}}",
+                               "msg", "login",
+                               "data",
+                               "cn_user", Utils::get_config_option("calaos_user").c_str(),
+                               "cn_pass", Utils::get_config_option("calaos_password").c_str());
+    char *d = json_dumps(jlogin, JSON_COMPACT);
+    api.processApi(d);
+    free(d);
+    json_decref(jlogin);
+
+    home.clear();
+    api.processApi("{\"msg\":\"get_home\"}");
+    if (home.empty())
+    {
+        cError() << "get_home failed, check the calaos_user/calaos_password options";
+        exit(1);
+    }
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, bench_outputs.size() - 1);
+    for (int i = 0;i < nb_events;i++)
+    {
+        Output *o = bench_outputs[dist(gen)];
+        EventManager::create(CalaosEvent::EventOutputChanged,
+                             { { "id", o->get_param("id") },
+                               { "state", Utils::to_string(i) } });
+    }
+
+    //events are sent from the main loop
+    for (int i = 0;i < 1000 && (int)events.size() < nb_events;i++)
+        ecore_main_loop_iterate();
+
+    cout << "get_home: " << home.size() << " bytes, " << events.size() << " events" << endl << endl;
+
+    struct
+    {
+        const char *name;
+        bool deflate;
+        bool no_context;
+    } modes[] =
+    {
+        { "uncompressed", false, false },
+        { "permessage-deflate", true, false },
+        { "permessage-deflate, server_no_context_takeover", true, true },
+    };
+
+    WireStats ref;
+    for (auto &mode: modes)
+    {
+        WebSocketDeflate server, client;
+        string ext;
+        if (mode.deflate)
+        {
+            server.negotiate("permessage-deflate", mode.no_context, ext);
+            client.negotiate("permessage-deflate", false, ext);
+        }
+
+        WireStats stats;
+        WebSocketDeflate *srv = mode.deflate?&server:nullptr;
+
+        stats.home_bytes = wireSize(home, srv, &client, threshold, stats);
+        for (const WebSocketMessagePtr &m: events)
+            stats.event_bytes += wireSize(m->getData(), srv, &client, threshold, stats);
+
+        if (!mode.deflate) ref = stats;
+        printStats(mode.name, stats, ref, events.size());
+    }
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <chrono>
+#include <random>
+#include "Calaos.h"
+#include "WebSocketFrame.h"
+
+using namespace Calaos;
+
+/*
+ * Websocket frame codec micro benchmark.
+ *
+ * Measures the MB/s of payload parsed from a buffer holding many masked
+ * frames, and of payload framed for sending. The old parser (erase of the
+ * consumed bytes, payload copied, unmasking byte by byte) and the old way
+ * of sending (header and payload concatenated in a new string) are
+ * measured to compare.
+ */
+
+static void echoUsage(char **argv)
+{
+    cout << "Calaos websocket frame codec benchmark" << endl;
+    cout << _("Usage:\n\t") << argv[0] << _(" [options]") << endl;
+    cout << endl << _("\tOptions:\n");
+    cout << _("\t-h, --help\tDisplay this help.\n");
+    cout << _("\t--size <n>\tMegabytes of payload for each measure (default 64).\n");
+    cout << endl;
+}
+
+//Masked frames as sent by a client
+static string buildClientFrames(int frame_size, int count)
+{
+    std::mt19937 gen(42);
+    string payload(frame_size, 'a');
+    for (int i = 0;i < frame_size;i++)
+        payload[i] = 'a' + gen() % 26;
+
+    string buffer;
+    for (int i = 0;i < count;i++)
+    {
+        uint32_t mask = gen();
+        string p = payload;
+        WebSocketFrame::unmask(&p[0], p.size(), mask);
+
+        string frame;
+        WebSocketFrame::appendHeader(frame, WebSocketFrame::OpCodeText, p.size(), true);
+        frame[1] |= 0x80;
+        frame.push_back(char(mask >> 24));
+        frame.push_back(char(mask >> 16));
+        frame.push_back(char(mask >> 8));
+        frame.push_back(char(mask));
+        buffer += frame + p;
+    }
+
+    return buffer;
+}
+
+//What processFrameData() did before, reduced to the same work
+static uint64_t legacyParse(string data)
+{
+    uint64_t total = 0;
+
+    while (data.size() >= 2)
+    {
+        uint64_t len = uint8_t(data[1]) & 0x7F;
+        data.erase(0, 2);
+        if (len == 126)
+        {
+            len = (uint8_t(data[0]) << 8) | uint8_t(data[1]);
+            data.erase(0, 2);
+        }
+        else if (len == 127)
+        {
+            len = 0;
+            for (int i = 0;i < 8;i++)
+                len = (len << 8) | uint8_t(data[i]);
+            data.erase(0, 8);
+        }
+
+        const uint8_t m[] = { uint8_t(data[0]), uint8_t(data[1]), uint8_t(data[2]), uint8_t(data[3]) };
+        data.erase(0, 4);
+
+        string payload = data.substr(0, len);
+        data.erase(0, len);
+
+        char *p = (char *)payload.c_str();
+        int i = 0;
+        uint64_t size = payload.size();
+        while (size-- > 0)
+            *p++ ^= m[i++ % 4];
+
+        total += payload.size();
+    }
+
+    return total;
+}
+
+static uint64_t parse(string data)
+{
+    uint64_t total = 0;
+    size_t pos = 0;
+    WebSocketFrame frame;
+
+    while (frame.processFrameData(data, pos))
+    {
+        total += frame.getPayloadSize();
+        frame.clear();
+    }
+
+    return total;
+}
+
+template<typename F>
+static double measure(uint64_t bytes, F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+
+    return bytes / (1024.0 * 1024.0) / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    InitEinaLog("websocket_frame_bench");
+
+    if (argvOptionCheck(argv, argv + argc, "-h") ||
+        argvOptionCheck(argv, argv + argc, "--help"))
+    {
+        echoUsage(argv);
+        exit(0);
+    }
+
+    int megabytes = 64;
+    char *s = argvOptionParam(argv, argv + argc, "--size");
+    if (s) from_string(string(s), megabytes);
+
+    int sizes[] = { 64, 1024, 16 * 1024, 256 * 1024 };
+
+    cout << "frame size\tparse old\tparse new\tsend old\tsend new (MB/s)" << endl;
+
+    for (int frame_size: sizes)
+    {
+        uint64_t total = (uint64_t)megabytes * 1024 * 1024;
+        int count = total / frame_size;
+
+        //the old parser is quadratic, give it a smaller buffer
+        int legacy_count = count;
+        if ((uint64_t)legacy_count * frame_size > 4 * 1024 * 1024)
+            legacy_count = 4 * 1024 * 1024 / frame_size;
+
+        string frames = buildClientFrames(frame_size, count);
+        string legacy_frames = buildClientFrames(frame_size, legacy_count);
+
+        uint64_t n = 0;
+        double parse_old = measure((uint64_t)legacy_count * frame_size, [&]() { n += legacyParse(legacy_frames); });
+        double parse_new = measure((uint64_t)count * frame_size, [&]() { n += parse(frames); });
+
+        //ecore_con copies what it is given in its buffer, do the same
+        string payload(frame_size, 'x');
+        string out;
+        out.reserve(frame_size + 16);
+
+        double send_old = measure((uint64_t)count * frame_size, [&]()
+        {
+            for (int i = 0;i < count;i++)
+            {
+                string f = WebSocketFrame::makeFrames(WebSocketFrame::OpCodeText, payload, FRAME_SIZE_IN_BYTES);
+                out.assign(f);
+            }
+        });
+        double send_new = measure((uint64_t)count * frame_size, [&]()
+        {
+            for (int i = 0;i < count;i++)
+            {
+                string header;
+                WebSocketFrame::appendHeader(header, WebSocketFrame::OpCodeText, payload.size(), true);
+                out.assign(header);
+                out.append(payload);
+            }
+        });
+
+        VAR_UNUSED(n);
+
+        cout << frame_size << "\t\t" << parse_old << "\t\t" << parse_new << "\t\t"
+             << send_old << "\t\t" << send_new << endl;
+    }
+
+    return 0;
+}
@@ -20,6 +20,7 @@
  ******************************************************************************/
 #include "CalaosConfig.h"
 #include <Eet.h>
+#include <WorkerPool.h>
 
 using namespace Calaos;
 
@@ -50,12 +51,91 @@ typedef struct
 static Eet_Data_Descriptor *edd_state = NULL;
 static Eet_Data_Descriptor *edd_cache = NULL;
 
+//Header of a journal record, followed by the id and the value
+typedef struct
+{
+    uint32_t id_len;
+    uint32_t value_len;
+    uint32_t checksum;
+} ConfigJournalHeader;
+
+#define CONFIG_JOURNAL_MAX_ID       4096
+#define CONFIG_JOURNAL_MAX_VALUE    (1024 * 1024)
+
 static void _eina_hash_free_cb(void *data)
 {
     delete (ConfigStateValue *)data;
 }
 
-Config::Config()
+//FNV-1a of the record, to detect a partially written record
+static uint32_t _journal_checksum(const char *id, uint32_t id_len, const char *value, uint32_t value_len)
+{
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0;i < id_len;i++)
+        h = (h ^ (uint8_t)id[i]) * 16777619u;
+    h = (h ^ 0xFF) * 16777619u;
+    for (uint32_t i = 0;i < value_len;i++)
+        h = (h ^ (uint8_t)value[i]) * 16777619u;
+
+    return h;
+}
+
+//Write all states into iostates.cache, can be called from a thread
+static bool _write_snapshot(const vector<pair<string, string>> &states)
+{
+    string file = Utils::getCacheFile("iostates.cache");
+    string tmp = file + "_tmp";
+
+    Eina_Hash *hash = eina_hash_string_superfast_new(_eina_hash_free_cb);
+    for (const auto &st: states)
+    {
+        ConfigStateValue *v = new ConfigStateValue;
+        v->id = strdup(st.first.c_str());
+        v->value = strdup(st.second.c_str());
+        eina_hash_add(hash, v->id, v);
+    }
+
+    ConfigStateCache cache;
+    cache.version = CONFIG_STATES_CACHE_VERSION;
+    cache.states = hash;
+
+    Eet_File *ef = eet_open(tmp.c_str(), EET_FILE_MODE_WRITE);
+    if (!ef)
+    {
+        cWarning() <<  "Could not open iostates.cache for write !";
+        eina_hash_free(hash);
+        return false;
+    }
+
+    Eina_Bool ret = eet_data_write(ef, edd_cache, "calaos/states/cache", &cache, EINA_TRUE);
+
+    eet_close(ef);
+    eina_hash_free(hash);
+
+    if (!ret)
+        return false;
+
+    int fd = open(tmp.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+
+    if (rename(tmp.c_str(), file.c_str()) < 0)
+    {
+        cWarning() <<  "Could not replace iostates.cache: " << strerror(errno);
+        return false;
+    }
+
+    cInfo() <<  "State cache file written successfully (" << file << ")";
+
+    return true;
+}
+
+Config::Config():
+    journal_fd(-1),
+    journal_size(0)
 {
     //Init eet for States file
     eet_init();
@@ -64,12 +144,30 @@ Config::Config()
     //read config hash table
     cache_states = eina_hash_string_superfast_new(_eina_hash_free_cb);
     loadStateCache();
+    openJournal();
 
-    saveCacheTimer = new EcoreTimer(60.0, [=]() { saveStateCache(); });
+    double interval = CONFIG_STATES_SYNC_INTERVAL;
+    string opt = Utils::get_config_option("iostates_sync_interval");
+    if (!opt.empty()) Utils::from_string(opt, interval);
+    if (interval <= 0.0) interval = CONFIG_STATES_SYNC_INTERVAL;
+
+    syncJournalTimer = new EcoreTimer(interval, [=]() { syncJournal(); });
 }
 
 Config::~Config()
 {
+    DELETE_NULL(syncJournalTimer);
+
+    //No new snapshot is started on shutdown, the journal is replayed at
+    //next start. Only wait for the one being written.
+    flushJournal();
+
+    if (compactor)
+        compactor->wait();
+
+    if (journal_fd >= 0)
+        close(journal_fd);
+
     eina_hash_free(cache_states);
     releaseEetDescriptors();
     eet_shutdown();
@@ -273,72 +371,183 @@ void Config::loadStateCache()
     if (!ef)
     {
         cWarning() <<  "Could not open iostates.cache for read !";
-        return;
     }
-
-    cache = (ConfigStateCache *)eet_data_read(ef, edd_cache, "calaos/states/cache");
-    if (!cache)
+    else if (!(cache = (ConfigStateCache *)eet_data_read(ef, edd_cache, "calaos/states/cache")))
     {
         eet_close(ef);
         cWarning() <<  "Could not read iostates.cache, corrupted file?";
-        return;
+    }
+    else
+    {
+        if (cache->version < CONFIG_STATES_CACHE_VERSION)
+        {
+            cWarning() <<  "File version too old, upgrading to new format";
+            cache->version = CONFIG_STATES_CACHE_VERSION;
+        }
+
+        //read all states and put it in cache_states
+        Eina_Iterator *it = eina_hash_iterator_tuple_new(cache->states);
+        void *data;
+        while (eina_iterator_next(it, &data))
+        {
+            Eina_Hash_Tuple *t = (Eina_Hash_Tuple *)data;
+            ConfigStateValue *state = (ConfigStateValue *)t->data;
+            string skey = state->id;
+            string svalue = state->value;
+            SaveValueIO(skey, svalue, false);
+        }
+        eina_iterator_free(it);
+
+        eet_close(ef);
+
+        cInfo() <<  "States cache read successfully.";
     }
 
-    if (cache->version < CONFIG_STATES_CACHE_VERSION)
+    //Then apply changes done after the snapshot was written
+    string journal = Utils::getCacheFile("iostates.journal");
+    replayJournal(journal + ".old", false);
+    replayJournal(journal, true);
+}
+
+void Config::replayJournal(string file, bool repair)
+{
+    std::ifstream f(file.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!f) return;
+
+    string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    f.close();
+
+    size_t pos = 0;
+    int count = 0;
+    while (pos + sizeof(ConfigJournalHeader) <= data.size())
     {
-        cWarning() <<  "File version too old, upgrading to new format";
-        cache->version = CONFIG_STATES_CACHE_VERSION;
+        ConfigJournalHeader h;
+        memcpy(&h, data.data() + pos, sizeof(h));
+
+        if (h.id_len > CONFIG_JOURNAL_MAX_ID ||
+            h.value_len > CONFIG_JOURNAL_MAX_VALUE ||
+            pos + sizeof(h) + h.id_len + h.value_len > data.size())
+            break;
+
+        const char *id = data.data() + pos + sizeof(h);
+        const char *value = id + h.id_len;
+        if (_journal_checksum(id, h.id_len, value, h.value_len) != h.checksum)
+            break;
+
+        SaveValueIO(string(id, h.id_len), string(value, h.value_len), false);
+
+        pos += sizeof(h) + h.id_len + h.value_len;
+        count++;
     }
 
-    //read all states and put it in cache_states
-    Eina_Iterator *it = eina_hash_iterator_tuple_new(cache->states);
-    void *data;
-    while (eina_iterator_next(it, &data))
+    cInfo() << count << " state changes replayed from " << file;
+
+    if (pos != data.size())
     {
-        Eina_Hash_Tuple *t = (Eina_Hash_Tuple *)data;
-        ConfigStateValue *state = (ConfigStateValue *)t->data;
-        string skey = state->id;
-        string svalue = state->value;
-        SaveValueIO(skey, svalue, false);
+        cWarning() << "Journal " << file << " has a corrupted record at offset " << pos;
+
+        //new records are appended to this file, remove the garbage first
+        if (repair && truncate(file.c_str(), pos) < 0)
+            cWarning() << "Could not truncate " << file << ": " << strerror(errno);
     }
-    eina_iterator_free(it);
+}
 
-    eet_close(ef);
+void Config::openJournal()
+{
+    string file = Utils::getCacheFile("iostates.journal");
 
-    cInfo() <<  "States cache read successfully.";
+    journal_fd = open(file.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (journal_fd < 0)
+    {
+        cWarning() <<  "Could not open iostates.journal for write: " << strerror(errno);
+        return;
+    }
+
+    struct stat st;
+    journal_size = 0;
+    if (fstat(journal_fd, &st) == 0)
+        journal_size = st.st_size;
 }
 
-void Config::saveStateCache()
+bool Config::flushJournal()
 {
-    Eet_File *ef;
-    string file = Utils::getCacheFile("iostates.cache");
-    string tmp = file + "_tmp";
-    ConfigStateCache *cache;
+    if (journal_buffer.empty())
+        return true;
 
-    cache = new ConfigStateCache;
-    cache->version = CONFIG_STATES_CACHE_VERSION;
-    cache->states = cache_states;
+    if (journal_fd < 0)
+        openJournal();
+    if (journal_fd < 0)
+        return false; //keep the changes, try again next time
 
-    ef = eet_open(tmp.c_str(), EET_FILE_MODE_WRITE);
-    if (!ef)
+    ssize_t ret = write(journal_fd, journal_buffer.data(), journal_buffer.size());
+    if (ret != (ssize_t)journal_buffer.size())
     {
-        cWarning() <<  "Could not open iostates.cache for write !";
-        delete cache;
-        return;
+        cWarning() <<  "Could not write iostates.journal: " << strerror(errno);
+
+        //drop the partial record, it would be ignored when replayed anyway
+        if (ret > 0 && ftruncate(journal_fd, journal_size) < 0)
+            cWarning() << "Could not truncate iostates.journal: " << strerror(errno);
+
+        return false;
     }
 
-    Eina_Bool ret = eet_data_write(ef, edd_cache, "calaos/states/cache", cache, EINA_TRUE);
+    fdatasync(journal_fd);
 
-    eet_close(ef);
-    delete cache;
+    journal_size += journal_buffer.size();
+    journal_buffer.clear();
+
+    return true;
+}
+
+void Config::syncJournal()
+{
+    if (!flushJournal())
+        return;
+
+    if (journal_size > CONFIG_STATES_JOURNAL_MAX && !compactor)
+        compactStateCache();
+}
 
-    if (ret)
+void Config::compactStateCache()
+{
+    string file = Utils::getCacheFile("iostates.journal");
+    string old = file + ".old";
+
+    //If an old journal is still there (last snapshot failed) keep it and
+    //the current one, both are removed/obsoleted by the new snapshot
+    if (!ecore_file_exists(old.c_str()))
     {
-        ecore_file_unlink(file.c_str());
-        ecore_file_mv(tmp.c_str(), file.c_str());
+        close(journal_fd);
+        journal_fd = -1;
+
+        if (rename(file.c_str(), old.c_str()) < 0)
+            cWarning() << "Could not rename iostates.journal: " << strerror(errno);
+
+        openJournal();
     }
 
-    cInfo() <<  "State cache file written successfully (" << file << ")";
+    auto states = std::make_shared<vector<pair<string, string>>>();
+    states->reserve(eina_hash_population(cache_states));
+
+    Eina_Iterator *it = eina_hash_iterator_data_new(cache_states);
+    void *data;
+    while (eina_iterator_next(it, &data))
+    {
+        ConfigStateValue *state = (ConfigStateValue *)data;
+        states->push_back(make_pair(string(state->id), string(state->value)));
+    }
+    eina_iterator_free(it);
+
+    //Write the new snapshot, the old journal is removed when it's done
+    compactor = WorkerPool::Instance().Run([states, old](WorkerJob &)
+    {
+        if (_write_snapshot(*states))
+            unlink(old.c_str());
+    },
+    [this](WorkerJob &)
+    {
+        compactor.reset();
+    });
 }
 
 void Config::SaveValueIO(string id, string value, bool save)
@@ -360,7 +569,17 @@ void Config::SaveValueIO(string id, string value, bool save)
     }
 
     if (save)
-        saveStateCache();
+    {
+        //append the change to the journal, written by syncJournal()
+        ConfigJournalHeader h;
+        h.id_len = id.size();
+        h.value_len = value.size();
+        h.checksum = _journal_checksum(id.c_str(), h.id_len, value.c_str(), h.value_len);
+
+        journal_buffer.append((const char *)&h, sizeof(h));
+        journal_buffer.append(id);
+        journal_buffer.append(value);
+    }
 }
 
 bool Config::ReadValueIO(string id, string &value)
@@ -40,12 +40,25 @@
 #include <Scenario.h>
 #include <Calaos.h>
 #include <RulesFactory.h>
+#include <WorkerPool.h>
 
 namespace Calaos
 {
 
 #define CONFIG_STATES_CACHE_VERSION     1
+//Default interval in seconds between two writes of the states journal,
+//can be changed with the "iostates_sync_interval" option
+#define CONFIG_STATES_SYNC_INTERVAL     1.0
+//Size of the states journal from which a new snapshot is written
+#define CONFIG_STATES_JOURNAL_MAX       (512 * 1024)
 
+/*
+ * IO states are saved in iostates.cache (a snapshot of all states) and in
+ * iostates.journal where each change is appended. Changes are buffered and
+ * written to the journal periodically. When the journal is too big, it is
+ * moved to iostates.journal.old and a new snapshot is written by a worker.
+ * At startup, the snapshot is read and both journals are replayed.
+ */
 class Config
 {
 private:
@@ -54,10 +67,24 @@ private:
     void initEetDescriptors();
     void releaseEetDescriptors();
     void loadStateCache();
-    void saveStateCache();
+    void replayJournal(string file, bool repair);
+    void openJournal();
+    //write and sync the buffered changes to the journal
+    bool flushJournal();
+    //flushJournal() and start a new snapshot if the journal is too big
+    void syncJournal();
+    void compactStateCache();
 
     Eina_Hash *cache_states;
-    EcoreTimer *saveCacheTimer;
+    EcoreTimer *syncJournalTimer;
+
+    //changes not written to the journal yet
+    string journal_buffer;
+    int journal_fd;
+    off_t journal_size;
+
+    //snapshot being written by the worker pool
+    WorkerJobPtr compactor;
 
 public:
     static Config &Instance()
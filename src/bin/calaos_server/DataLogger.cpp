@@ -20,59 +20,75 @@
  ******************************************************************************/
 #include <DataLogger.h>
 #include <Eet.h>
+#include <Ecore_File.h>
 #include <IOBase.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 using namespace Calaos;
 
-typedef struct _Calaos_DataLogger_Mean Calaos_DataLogger_Mean;
-typedef struct _Calaos_DataLogger_Values Calaos_DataLogger_Values;
-typedef struct _Calaos_DataLogger_List Calaos_DataLogger_List;
+typedef struct _Calaos_DataLogger_Aggregate Calaos_DataLogger_Aggregate;
 
-struct _Calaos_DataLogger_Mean
+struct _Calaos_DataLogger_Aggregate
 {
-    double mean;
-
+    long long start;
+    double min;
+    double max;
+    double sum;
+    unsigned int count;
 };
 
-struct _Calaos_DataLogger_Values
-{
-    time_t timestamp;
-    double value;
+Eet_Data_Descriptor *calaos_datalogger_aggregate_edd = NULL;
 
-};
+#define CALAOS_EET_DATALOGGER_FILE "datalogger.eet"
+#define CALAOS_DATALOGGER_DIR      "datalogger"
+
+//Segment files are arrays of DataLoggerSample written as is
+static_assert(sizeof(DataLoggerSample) == 16, "DataLoggerSample must be a 16 bytes record");
+#define DATALOGGER_RECORD_SIZE      sizeof(DataLoggerSample)
 
-struct _Calaos_DataLogger_List
+//Aggregate files are arrays of these records
+struct DataLoggerAggregateRecord
 {
-    Eina_List *list;
+    int64_t start;
+    double min;
+    double max;
+    double sum;
+    int64_t count;
 };
+static_assert(sizeof(DataLoggerAggregateRecord) == 40, "DataLoggerAggregateRecord must be a 40 bytes record");
 
-Eet_Data_Descriptor *calaos_datalogger_values_eed;
-Eet_Data_Descriptor *calaos_datalogger_list_edd;
-Eet_Data_Descriptor *calaos_datalogger_mean_edd;
+static const char *resolution_names[DataLogger::RES_COUNT] = { "hour", "day", "month" };
 
-#define CALAOS_EET_DATALOGGER_FILE "datalogger.eet"
-
-static void
-_hash_values_free_cb(void *data)
+void DataLoggerAggregate::add(double v)
 {
-    free(data);
+    if (count == 0 || v < min) min = v;
+    if (count == 0 || v > max) max = v;
+    sum += v;
+    count++;
 }
 
-
-DataLogger::DataLogger()
+DataLogger::DataLogger():
+    flush_timer(NULL)
 {
     string db_file = getCacheFile(CALAOS_EET_DATALOGGER_FILE);
+    base_dir = getCacheFile(CALAOS_DATALOGGER_DIR);
 
     eet_init();
     initEetDescriptors();
 
     ef = eet_open(db_file.c_str(), EET_FILE_MODE_READ_WRITE);
-
-    hash_values = eina_hash_string_superfast_new(_hash_values_free_cb);
 }
 
 DataLogger::~DataLogger()
 {
+    flush();
+
+    for (auto it = series.begin();it != series.end();it++)
+        delete it->second;
+    series.clear();
+
     eet_close(ef);
     releaseEetDescriptors();
     eet_shutdown();
@@ -83,95 +99,491 @@ void DataLogger::initEetDescriptors()
     Eet_Data_Descriptor_Class eddc;
     Eet_Data_Descriptor *edd;
 
-
-    /* Data Descriptor for mean values */
-    EET_EINA_FILE_DATA_DESCRIPTOR_CLASS_SET(&eddc, Calaos_DataLogger_Mean);
+    /* Data Descriptor for min/max/mean of a period */
+    EET_EINA_FILE_DATA_DESCRIPTOR_CLASS_SET(&eddc, Calaos_DataLogger_Aggregate);
     edd = eet_data_descriptor_stream_new(&eddc);
 
-    EET_DATA_DESCRIPTOR_ADD_BASIC(edd, Calaos_DataLogger_Mean, "mean", mean, EET_T_DOUBLE);
+    EET_DATA_DESCRIPTOR_ADD_BASIC(edd, Calaos_DataLogger_Aggregate, "start", start, EET_T_LONG_LONG);
+    EET_DATA_DESCRIPTOR_ADD_BASIC(edd, Calaos_DataLogger_Aggregate, "min", min, EET_T_DOUBLE);
+    EET_DATA_DESCRIPTOR_ADD_BASIC(edd, Calaos_DataLogger_Aggregate, "max", max, EET_T_DOUBLE);
+    EET_DATA_DESCRIPTOR_ADD_BASIC(edd, Calaos_DataLogger_Aggregate, "sum", sum, EET_T_DOUBLE);
+    EET_DATA_DESCRIPTOR_ADD_BASIC(edd, Calaos_DataLogger_Aggregate, "count", count, EET_T_UINT);
 
-    calaos_datalogger_mean_edd = edd;
+    calaos_datalogger_aggregate_edd = edd;
+}
 
-    /* Data Descriptor for time/value */
-    EET_EINA_FILE_DATA_DESCRIPTOR_CLASS_SET(&eddc, Calaos_DataLogger_Values);
-    edd = eet_data_descriptor_stream_new(&eddc);
+void DataLogger::releaseEetDescriptors()
+{
+    DELETE_NULL_FUNC(eet_data_descriptor_free, calaos_datalogger_aggregate_edd);
+}
 
-    EET_DATA_DESCRIPTOR_ADD_BASIC(edd, Calaos_DataLogger_Values, "timestamp", timestamp, EET_T_INT);
-    EET_DATA_DESCRIPTOR_ADD_BASIC(edd, Calaos_DataLogger_Values, "value", value, EET_T_DOUBLE);
+string DataLogger::seriesDir(const string &id)
+{
+    //io ids are used as directory names
+    string dir = id;
+    replace(dir.begin(), dir.end(), '/', '_');
 
-    calaos_datalogger_values_eed = edd;
+    return base_dir + "/" + dir;
+}
 
-    /* Data Descriptor for list of values */
-    EET_EINA_FILE_DATA_DESCRIPTOR_CLASS_SET(&eddc, Calaos_DataLogger_List);
-    edd = eet_data_descriptor_stream_new(&eddc);
+string DataLogger::aggregateFile(const string &id, Resolution res)
+{
+    return seriesDir(id) + "/" + resolution_names[res] + ".agg";
+}
 
-    EET_DATA_DESCRIPTOR_ADD_LIST(edd, Calaos_DataLogger_List, "list", list, calaos_datalogger_values_eed);
+string DataLogger::segmentFile(const string &id, int64_t t)
+{
+    struct tm ctime;
+    time_t tt = t;
+    localtime_r(&tt, &ctime);
 
-    calaos_datalogger_list_edd = edd;
+    char f[32];
+    snprintf(f, sizeof(f), "/%04d%02d.seg", ctime.tm_year + 1900, ctime.tm_mon + 1);
+
+    return seriesDir(id) + f;
 }
 
-void DataLogger::releaseEetDescriptors()
+int64_t DataLogger::periodStart(Resolution res, int64_t t)
 {
+    struct tm ctime;
+    time_t tt = t;
+    localtime_r(&tt, &ctime);
+
+    ctime.tm_sec = 0;
+    ctime.tm_min = 0;
+    if (res == RES_DAY || res == RES_MONTH)
+        ctime.tm_hour = 0;
+    if (res == RES_MONTH)
+        ctime.tm_mday = 1;
+
+    //the start of the hour has the same offset as t, this matters for the
+    //hour that is repeated when DST ends. Midnight may not.
+    if (res != RES_HOUR)
+        ctime.tm_isdst = -1;
+
+    return mktime(&ctime);
+}
 
+int64_t DataLogger::periodNext(Resolution res, int64_t t)
+{
+    struct tm ctime;
+    time_t tt = t;
+    localtime_r(&tt, &ctime);
+
+    if (res == RES_HOUR)
+        return periodStart(res, t + 3600);
+    else if (res == RES_DAY)
+        ctime.tm_mday++;
+    else
+        ctime.tm_mon++;
+    ctime.tm_isdst = -1;
+
+    return periodStart(res, mktime(&ctime));
 }
 
-void DataLogger::log(IOBase *io)
+DataLogger::Series *DataLogger::getSeries(const string &id)
 {
-    char section[1024];
-    Calaos_DataLogger_List *list;
-    Calaos_DataLogger_Values *value;
-    Calaos_DataLogger_Mean *mean;
-    struct tm *ctime = NULL;
+    auto it = series.find(id);
+    if (it != series.end())
+        return it->second;
 
-    tzset(); //Force reload of timezone data
-    time_t t = time(NULL);
-    ctime = localtime(&t);
+    ecore_file_mkpath(seriesDir(id).c_str());
+
+    Series *s = new Series();
+    s->pending.reserve(DATALOGGER_MAX_PENDING);
+    series[id] = s;
 
+    //continue the periods started before a restart, the ones that are
+    //over by now are closed on the next value
+    for (int r = 0;r < RES_COUNT;r++)
+        readOpenAggregate(id, (Resolution)r, s->current[r]);
+
+    return s;
+}
+
+void DataLogger::log(IOBase *io)
+{
     // return immediatly if logged is not active for this IO
     if (io->get_param("logged") != "true")
         return;
 
-    snprintf(section, sizeof(section), "calaos/sonde/%s/%d/%d/%d/%d/values", io->get_param("id").c_str(), ctime->tm_year + 1900, ctime->tm_mon + 1, ctime->tm_mday, ctime->tm_hour);
+    tzset(); //Force reload of timezone data
+
+    log(io->get_param("id"), io->get_value_double(), time(NULL));
+}
+
+void DataLogger::log(const string &id, double value, int64_t t)
+{
+    Series *s = getSeries(id);
+
+    for (int r = 0;r < RES_COUNT;r++)
+    {
+        Resolution res = (Resolution)r;
+        DataLoggerAggregate &aggr = s->current[r];
+        int64_t start = periodStart(res, t);
+
+        if (aggr.count > 0 && aggr.start != start)
+        {
+            //period is over, store it and start a new one
+            s->closed[r].push_back(aggr);
+            aggr = DataLoggerAggregate();
+        }
+
+        if (aggr.count == 0)
+            aggr.start = start;
+
+        aggr.add(value);
+        s->dirty[r] = true;
+    }
+
+    s->pending.push_back(DataLoggerSample(t, value));
+
+    //this is retried every DATALOGGER_MAX_PENDING values if it fails
+    if (s->pending.size() % DATALOGGER_MAX_PENDING == 0 &&
+        writeSeries(id, s))
+        syncFiles();
+
+    if (!flush_timer)
+        flush_timer = new EcoreTimer(DATALOGGER_FLUSH_INTERVAL, (sigc::slot<void>)sigc::mem_fun(*this, &DataLogger::flush));
+}
+
+//Append records to a file of fixed-width records and returns the number of
+//records written. A partial record left by a failed write is dropped first.
+static size_t appendRecords(const string &file, const void *data, size_t count, size_t record_size)
+{
+    int fd = open(file.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        cErrorDom("datalogger") << "Failed to open " << file << ": " << strerror(errno);
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size % record_size != 0)
+    {
+        cWarningDom("datalogger") << "Truncating corrupted file " << file;
+        if (ftruncate(fd, st.st_size - st.st_size % record_size) < 0)
+        {
+            cErrorDom("datalogger") << "Failed to truncate " << file << ": " << strerror(errno);
+            close(fd);
+            return 0;
+        }
+    }
+
+    size_t len = count * record_size;
+    ssize_t w = write(fd, data, len);
+    if (w != (ssize_t)len)
+    {
+        cErrorDom("datalogger") << "Failed to write " << file << ": " << strerror(errno);
+        if (w < 0) w = 0;
+    }
+
+    close(fd);
+
+    return w / record_size;
+}
+
+static int64_t recordTime(const DataLoggerSample &r) { return r.timestamp; }
+static int64_t recordTime(const DataLoggerAggregateRecord &r) { return r.start; }
+
+//Read the records of a file in [start, end]
+template<typename T>
+static void readRecords(const string &file, int64_t start, int64_t end, vector<T> &values)
+{
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return;
+    }
+
+    off_t count = st.st_size / sizeof(T);
+
+    //records are appended in time order, find the first one >= start
+    off_t low = 0, high = count;
+    while (low < high)
+    {
+        off_t mid = low + (high - low) / 2;
+        T record;
+        if (pread(fd, &record, sizeof(T), mid * sizeof(T)) != (ssize_t)sizeof(T))
+            break;
+
+        if (recordTime(record) < start)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    T buffer[256];
+    off_t pos = low;
+    bool done = false;
+    while (!done && pos < count)
+    {
+        off_t n = count - pos;
+        if (n > 256) n = 256;
+
+        ssize_t r = pread(fd, buffer, n * sizeof(T), pos * sizeof(T));
+        if (r <= 0) break;
+        n = r / sizeof(T);
+
+        for (off_t i = 0;i < n;i++)
+        {
+            if (recordTime(buffer[i]) > end)
+            {
+                done = true;
+                break;
+            }
+            values.push_back(buffer[i]);
+        }
+
+        pos += n;
+    }
+
+    close(fd);
+}
+
+static bool readLastRecord(const string &file, DataLoggerAggregateRecord &record)
+{
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    bool ret = false;
+    struct stat st;
+    off_t count = 0;
+    if (fstat(fd, &st) == 0)
+        count = st.st_size / sizeof(record);
+
+    if (count > 0 &&
+        pread(fd, &record, sizeof(record), (count - 1) * sizeof(record)) == (ssize_t)sizeof(record))
+        ret = true;
+
+    close(fd);
+
+    return ret;
+}
+
+bool DataLogger::writeSeries(const string &id, Series *s)
+{
+    bool written = false;
+
+    uint i = 0;
+    while (i < s->pending.size())
+    {
+        //values of the same month go to the same segment
+        string file = segmentFile(id, s->pending[i].timestamp);
+        uint j = i + 1;
+        while (j < s->pending.size() && segmentFile(id, s->pending[j].timestamp) == file)
+            j++;
+
+        size_t n = appendRecords(file, &s->pending[i], j - i, DATALOGGER_RECORD_SIZE);
+        if (n > 0) written = true;
+        i += n;
+
+        //the values not written are kept for the next flush
+        if (i < j) break;
+    }
+
+    s->pending.erase(s->pending.begin(), s->pending.begin() + i);
+
+    if (s->pending.size() > DATALOGGER_MAX_UNWRITTEN)
+    {
+        size_t drop = s->pending.size() - DATALOGGER_MAX_UNWRITTEN;
+        cErrorDom("datalogger") << "Dropping " << drop << " values of " << id << " that could not be written";
+        s->pending.erase(s->pending.begin(), s->pending.begin() + drop);
+    }
+
+    for (int r = 0;r < RES_COUNT;r++)
+    {
+        vector<DataLoggerAggregate> &closed = s->closed[r];
+        if (closed.empty()) continue;
+
+        string file = aggregateFile(id, (Resolution)r);
+
+        //a period can be written already if the server stopped before
+        //the open periods were saved
+        DataLoggerAggregateRecord last;
+        int64_t last_start = INT64_MIN;
+        if (readLastRecord(file, last))
+            last_start = last.start;
+
+        vector<DataLoggerAggregateRecord> records;
+        for (const DataLoggerAggregate &aggr: closed)
+        {
+            if (aggr.start <= last_start) continue;
+
+            DataLoggerAggregateRecord rec;
+            rec.start = aggr.start;
+            rec.min = aggr.min;
+            rec.max = aggr.max;
+            rec.sum = aggr.sum;
+            rec.count = aggr.count;
+            records.push_back(rec);
+        }
+
+        size_t n = 0;
+        if (!records.empty())
+            n = appendRecords(file, records.data(), records.size(), sizeof(DataLoggerAggregateRecord));
+        if (n > 0)
+        {
+            written = true;
+            last_start = records[n - 1].start;
+        }
+
+        closed.erase(remove_if(closed.begin(), closed.end(),
+                               [=](const DataLoggerAggregate &a) { return a.start <= last_start; }),
+                     closed.end());
+    }
+
+    return written;
+}
+
+void DataLogger::syncFiles()
+{
+    //one sync of the filesystem instead of one per file
+    int fd = open(base_dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+    {
+        sync();
+        return;
+    }
+
+    if (syncfs(fd) < 0)
+        cErrorDom("datalogger") << "Failed to sync " << base_dir << ": " << strerror(errno);
+
+    close(fd);
+}
+
+void DataLogger::flush()
+{
+    if (series.empty()) return;
 
-    //TODO if month or year changed since last write remove list from hash to save ram
+    bool written = false;
+    bool open_written = false;
 
-    // Find the section in memory first
-    list = (Calaos_DataLogger_List*)eina_hash_find(hash_values, section);
-    // Then try to find it from disk
-    if (!list)
+    for (auto it = series.begin();it != series.end();it++)
     {
-        list = (Calaos_DataLogger_List*)eet_data_read(ef, calaos_datalogger_values_eed, section);
+        if (writeSeries(it->first, it->second))
+            written = true;
+
+        Series *s = it->second;
+        for (int r = 0;r < RES_COUNT;r++)
+        {
+            if (!s->dirty[r]) continue;
+            writeOpenAggregate(it->first, (Resolution)r, s->current[r]);
+            s->dirty[r] = false;
+            open_written = true;
+        }
+    }
+
+    if (written) syncFiles();
+    if (ef && open_written) eet_sync(ef);
+}
+
+void DataLogger::shutdown()
+{
+    flush();
+    DELETE_NULL(flush_timer);
+}
+
+void DataLogger::writeOpenAggregate(const string &id, Resolution res, const DataLoggerAggregate &aggr)
+{
+    if (!ef) return;
+
+    char section[1024];
+    snprintf(section, sizeof(section), "calaos/datalogger/%s/%s",
+             id.c_str(), resolution_names[res]);
+
+    Calaos_DataLogger_Aggregate a;
+    a.start = aggr.start;
+    a.min = aggr.min;
+    a.max = aggr.max;
+    a.sum = aggr.sum;
+    a.count = aggr.count;
+
+    eet_data_write(ef, calaos_datalogger_aggregate_edd, section, &a, EINA_TRUE);
+}
+
+bool DataLogger::readOpenAggregate(const string &id, Resolution res, DataLoggerAggregate &aggr)
+{
+    if (!ef) return false;
 
-        // And create an empty list if it's the first time we need it
-        if (!list)
-            list = (Calaos_DataLogger_List*)calloc(1, sizeof(Calaos_DataLogger_List));
-        eina_hash_add(hash_values, section, list);
+    char section[1024];
+    snprintf(section, sizeof(section), "calaos/datalogger/%s/%s",
+             id.c_str(), resolution_names[res]);
+
+    Calaos_DataLogger_Aggregate *a = (Calaos_DataLogger_Aggregate *)eet_data_read(ef, calaos_datalogger_aggregate_edd, section);
+    if (!a) return false;
+
+    aggr.start = a->start;
+    aggr.min = a->min;
+    aggr.max = a->max;
+    aggr.sum = a->sum;
+    aggr.count = a->count;
+
+    free(a);
+
+    return true;
+}
+
+void DataLogger::getValues(const string &id, int64_t start, int64_t end, vector<DataLoggerSample> &values)
+{
+    for (int64_t t = periodStart(RES_MONTH, start);t <= end;t = periodNext(RES_MONTH, t))
+        readRecords(segmentFile(id, t), start, end, values);
+
+    //values not written yet
+    auto it = series.find(id);
+    if (it == series.end()) return;
+
+    for (const DataLoggerSample &sample: it->second->pending)
+    {
+        if (sample.timestamp >= start && sample.timestamp <= end)
+            values.push_back(sample);
     }
+}
 
-    value = (Calaos_DataLogger_Values*)calloc(1, sizeof(Calaos_DataLogger_Values));
-    value->timestamp = time(NULL);
-    value->value = io->get_value_double();
+void DataLogger::getAggregates(const string &id, Resolution res, int64_t start, int64_t end, vector<DataLoggerAggregate> &values)
+{
+    start = periodStart(res, start);
 
-    list->list = eina_list_append(list->list, value);
-    eet_data_write(ef, calaos_datalogger_list_edd, section, list, EINA_TRUE);
+    vector<DataLoggerAggregateRecord> records;
+    readRecords(aggregateFile(id, res), start, end, records);
 
-    // Mean Value for month
-    snprintf(section, sizeof(section), "calaos/sonde/%s/%d/%d/mean", io->get_param("id").c_str(), ctime->tm_year + 1900, ctime->tm_mon + 1);
-    mean = (Calaos_DataLogger_Mean*)eina_hash_find(hash_values, section);
-    if (!mean)
+    for (const DataLoggerAggregateRecord &rec: records)
     {
-        mean = (Calaos_DataLogger_Mean*)calloc(1, sizeof(Calaos_DataLogger_Mean));
-        eina_hash_add(hash_values, section, mean);
+        DataLoggerAggregate aggr;
+        aggr.start = rec.start;
+        aggr.min = rec.min;
+        aggr.max = rec.max;
+        aggr.sum = rec.sum;
+        aggr.count = rec.count;
+        values.push_back(aggr);
     }
 
-    for (uint32_t i = 0; i < eina_list_count(list->list); i++)
+    //periods not written yet and the open one
+    vector<DataLoggerAggregate> mem;
+    auto it = series.find(id);
+    if (it != series.end())
     {
-        Calaos_DataLogger_Values *v = (Calaos_DataLogger_Values*)eina_list_nth(list->list, i);
-        mean->mean += v->value;
+        mem = it->second->closed[res];
+        mem.push_back(it->second->current[res]);
+    }
+    else
+    {
+        DataLoggerAggregate aggr;
+        if (readOpenAggregate(id, res, aggr))
+            mem.push_back(aggr);
     }
-    mean->mean /= eina_list_count(list->list);
 
-    eet_data_write(ef, calaos_datalogger_mean_edd, section, mean, EINA_TRUE);
+    for (const DataLoggerAggregate &aggr: mem)
+    {
+        if (aggr.count == 0 || aggr.start < start || aggr.start > end)
+            continue;
+        if (!values.empty() && aggr.start <= values.back().start)
+            continue;
 
-    eet_sync(ef);
+        values.push_back(aggr);
+    }
 }
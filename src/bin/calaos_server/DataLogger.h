@@ -24,19 +24,108 @@
 #include <Eet.h>
 
 #include <IOBase.h>
+#include <EcoreTimer.h>
+#include <unordered_map>
 
 namespace Calaos
 {
 
+//Interval between two writes of pending values to disk (group commit)
+#define DATALOGGER_FLUSH_INTERVAL       10.0
+//Maximum number of values kept in memory for an IO before it is flushed
+#define DATALOGGER_MAX_PENDING          256
+//Values kept for an IO when they can't be written, the oldest are dropped
+#define DATALOGGER_MAX_UNWRITTEN        (64 * DATALOGGER_MAX_PENDING)
+
+//Longest range that can be queried for raw values and for each resolution,
+//longer queries are answered with a coarser resolution
+#define DATALOGGER_MAX_RANGE_RAW        (7 * 24 * 3600LL)
+#define DATALOGGER_MAX_RANGE_HOUR       (93 * 24 * 3600LL)
+#define DATALOGGER_MAX_RANGE_DAY        (5 * 366 * 24 * 3600LL)
+#define DATALOGGER_MAX_RANGE_MONTH      (50 * 366 * 24 * 3600LL)
+
+class DataLoggerSample
+{
+public:
+    DataLoggerSample(): timestamp(0), value(0.0) {}
+    DataLoggerSample(int64_t t, double v): timestamp(t), value(v) {}
+
+    int64_t timestamp;
+    double value;
+};
+
+class DataLoggerAggregate
+{
+public:
+    DataLoggerAggregate(): start(0), min(0.0), max(0.0), sum(0.0), count(0) {}
+
+    int64_t start; //start time of the period
+    double min;
+    double max;
+    double sum;
+    unsigned int count;
+
+    double mean() const { return count > 0?sum / count:0.0; }
+    void add(double v);
+};
+
+/*
+ * Values of logged IOs are stored in append-only segment files, one per IO
+ * and per month, made of fixed-width (timestamp, value) records:
+ *     <cache>/datalogger/<io id>/<year><month>.seg
+ * Min/max/mean/count are computed incrementally for each hour, day and month.
+ * When a period is over its aggregate is appended to a file of fixed-width
+ * records for that resolution:
+ *     <cache>/datalogger/<io id>/{hour,day,month}.agg
+ * Only the periods still open are kept in the datalogger eet file, so that
+ * they can be continued after a restart.
+ *
+ * New values are buffered in memory and written to disk by a timer every
+ * DATALOGGER_FLUSH_INTERVAL seconds. All files are written first and then
+ * synced together with a single syncfs(). Values that could not be written
+ * are kept and written again on the next flush.
+ */
 class DataLogger
 {
+public:
+    enum Resolution { RES_HOUR = 0, RES_DAY, RES_MONTH, RES_COUNT };
+
 private:
     DataLogger();
 
+    class Series
+    {
+    public:
+        vector<DataLoggerSample> pending;
+
+        //running aggregates for the current hour/day/month
+        DataLoggerAggregate current[RES_COUNT];
+        bool dirty[RES_COUNT];
+
+        //periods over, not written yet
+        vector<DataLoggerAggregate> closed[RES_COUNT];
+
+        Series() { for (int i = 0;i < RES_COUNT;i++) dirty[i] = false; }
+    };
+
     void initEetDescriptors();
     void releaseEetDescriptors();
     Eet_File *ef;
-    Eina_Hash *hash_values;
+
+    unordered_map<string, Series *> series;
+    EcoreTimer *flush_timer;
+    string base_dir;
+
+    Series *getSeries(const string &id);
+    bool writeSeries(const string &id, Series *s);
+    void syncFiles();
+    void writeOpenAggregate(const string &id, Resolution res, const DataLoggerAggregate &aggr);
+    bool readOpenAggregate(const string &id, Resolution res, DataLoggerAggregate &aggr);
+
+    string seriesDir(const string &id);
+    string segmentFile(const string &id, int64_t t);
+    string aggregateFile(const string &id, Resolution res);
+
 public:
     static DataLogger &Instance()
     {
@@ -46,6 +135,22 @@ public:
     ~DataLogger();
 
     void log(IOBase *io);
+    void log(const string &id, double value, int64_t t);
+
+    //Write all pending values to disk
+    void flush();
+    //Flush and stop the flush timer, needs to be called before ecore_shutdown()
+    void shutdown();
+
+    //Get all raw values of an IO in [start, end]
+    void getValues(const string &id, int64_t start, int64_t end, vector<DataLoggerSample> &values);
+    //Get min/max/mean/count of each hour/day/month in [start, end]
+    void getAggregates(const string &id, Resolution res, int64_t start, int64_t end, vector<DataLoggerAggregate> &values);
+
+    //Start of the hour/day/month containing t (local time)
+    static int64_t periodStart(Resolution res, int64_t t);
+    //Start of the next hour/day/month after the one starting at t
+    static int64_t periodNext(Resolution res, int64_t t);
 };
 
 }
@@ -20,6 +20,7 @@
  ******************************************************************************/
 
 #include "EventManager.h"
+#include "MsgPack.h"
 
 EventManager::EventManager()
 {
@@ -161,6 +162,34 @@ json_t *CalaosEvent::toJson() const
     return ret;
 }
 
+void CalaosEvent::toMsgPack(MsgPackWriter &writer) const
+{
+    writer.writeMap(4);
+    writer.writeString("event_raw");
+    writer.writeString(toString());
+    writer.writeString("type");
+    writer.writeString(Utils::to_string(getType()));
+    writer.writeString("type_str");
+    writer.writeString(typeToString(getType()));
+
+    writer.writeString("data");
+    if (evParams.size() == 0)
+    {
+        writer.writeNil();
+        return;
+    }
+
+    writer.writeMap(evParams.size());
+    for (int i = 0;i < evParams.size();i++)
+    {
+        string key, val;
+        evParams.get_item(i, key, val);
+
+        writer.writeString(key);
+        writer.writeString(val);
+    }
+}
+
 string CalaosEvent::toString() const
 {
     string ret = typeToString(getType());
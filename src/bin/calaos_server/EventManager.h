@@ -25,6 +25,8 @@
 #include "Calaos.h"
 #include "Jansson_Addition.h"
 
+class MsgPackWriter;
+
 /*
  * This class handles all events that goes out of calaos_server, like IO changes
  * that are dispatched to all clients. only "externaly available" events are
@@ -75,6 +77,8 @@ public:
     const Params &getParam() const { return evParams; }
 
     json_t *toJson() const;
+    //same content as toJson() written to a MessagePack writer
+    void toMsgPack(MsgPackWriter &writer) const;
     string toString() const;
 
     static string typeToString(int type);
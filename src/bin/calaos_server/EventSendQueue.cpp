@@ -0,0 +1,89 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include "EventSendQueue.h"
+
+EventSendQueue::EventSendQueue(SendFunc send, std::function<int ()> pending):
+    sendFunc(send),
+    pendingFunc(pending)
+{
+}
+
+bool EventSendQueue::push(const EventData &data, const string &key, int tag)
+{
+    if (isIdle())
+    {
+        sent++;
+        return sendFunc(*data, tag);
+    }
+
+    if (!key.empty())
+    {
+        auto it = keys.find(key);
+        if (it != keys.end())
+        {
+            //keep the place of the old event, only the value changes
+            it->second->data = data;
+            it->second->tag = tag;
+            conflated++;
+
+            return true;
+        }
+    }
+
+    if ((int)queue.size() >= EVENTQUEUE_MAX_EVENTS)
+    {
+        dropped++;
+        cWarningDom("network") << "Client is too slow, " << queue.size()
+                               << " events queued, " << conflated << " conflated";
+        return false;
+    }
+
+    Entry e;
+    e.key = key;
+    e.data = data;
+    e.tag = tag;
+    queue.push_back(e);
+
+    if (!key.empty())
+        keys[key] = --queue.end();
+
+    if ((int)queue.size() > max_depth)
+        max_depth = queue.size();
+
+    return true;
+}
+
+bool EventSendQueue::flush()
+{
+    while (!queue.empty() && pendingFunc() < EVENTQUEUE_HIGH_WATER)
+    {
+        Entry e = queue.front();
+        queue.pop_front();
+        if (!e.key.empty())
+            keys.erase(e.key);
+
+        sent++;
+        if (!sendFunc(*e.data, e.tag))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,94 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef S_EventSendQueue_H
+#define S_EventSendQueue_H
+
+#include "Calaos.h"
+#include <list>
+#include <unordered_map>
+
+//Events are queued instead of being sent when the socket has that much data
+//not written yet
+#define EVENTQUEUE_HIGH_WATER   (64 * 1024)
+
+//A client with more queued events is too slow and is disconnected
+#define EVENTQUEUE_MAX_EVENTS   1000
+
+typedef std::shared_ptr<const string> EventData;
+
+/*
+ * Outbound events of a listening client (TCP listen mode or websocket).
+ *
+ * Events go straight to the socket while it keeps up. Once the data not yet
+ * written by ecore_con is over EVENTQUEUE_HIGH_WATER, they wait here and are
+ * sent when write events come back. A queued event with a key is replaced
+ * by a newer event with the same key (the state of an IO), so a slow client
+ * only gets the last value.
+ */
+class EventSendQueue
+{
+public:
+    //send data to the socket, return false on error. tag is the value given
+    //to push(), it tells the owner how to send the data
+    typedef std::function<bool (const string &data, int tag)> SendFunc;
+
+    //pending is the number of bytes given to ecore_con and not written yet
+    EventSendQueue(SendFunc send, std::function<int ()> pending);
+
+    //Send or queue an event. Return false if the client is too far behind
+    //or on send error, the connection should be closed.
+    bool push(const EventData &data, const string &key = string(), int tag = 0);
+
+    //Send queued events, to be called when data has been written
+    bool flush();
+
+    //true if data can be sent without queueing it
+    bool isIdle() const { return queue.empty() && pendingFunc() < EVENTQUEUE_HIGH_WATER; }
+
+    int getDepth() const { return queue.size(); }
+    int getMaxDepth() const { return max_depth; }
+    unsigned long getConflated() const { return conflated; }
+    unsigned long getSent() const { return sent; }
+    //events refused because the client was too slow
+    unsigned long getDropped() const { return dropped; }
+
+private:
+    class Entry
+    {
+    public:
+        string key;
+        EventData data;
+        int tag;
+    };
+
+    SendFunc sendFunc;
+    std::function<int ()> pendingFunc;
+
+    std::list<Entry> queue;
+    std::unordered_map<string, std::list<Entry>::iterator> keys;
+
+    int max_depth = 0;
+    unsigned long conflated = 0;
+    unsigned long sent = 0;
+    unsigned long dropped = 0;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include "EventSubscriptions.h"
+#include "ListeRoom.h"
+
+vector<string> EventKeys::fromEvent(const CalaosEvent &event)
+{
+    vector<string> keys;
+    const Params &p = event.getParam();
+
+    keys.push_back("type:" + CalaosEvent::typeToString(event.getType()));
+
+    if (p.Exists("id"))
+        keys.push_back("id:" + p["id"]);
+    if (p.Exists("player_id"))
+        keys.push_back("player:" + p["player_id"]);
+    if (p.Exists("room_name"))
+        keys.push_back("room:" + p["room_name"]);
+    if (p.Exists("old_room_name"))
+        keys.push_back("room:" + p["old_room_name"]);
+    if (p.Exists("new_room_name"))
+        keys.push_back("room:" + p["new_room_name"]);
+
+    return keys;
+}
+
+vector<string> EventKeys::fromEmission(const string &emission)
+{
+    vector<string> keys;
+    vector<string> tokens;
+    Utils::split(emission, tokens, " ");
+    if (tokens.empty()) return keys;
+
+    keys.push_back("type:" + tokens[0]);
+
+    //input <id> <param>
+    if ((tokens[0] == "input" || tokens[0] == "output") && tokens.size() >= 2)
+    {
+        keys.push_back("id:" + tokens[1]);
+        return keys;
+    }
+
+    //<event> id:<id> room_name:<name>
+    for (uint i = 1;i < tokens.size();i++)
+    {
+        string t = Utils::url_decode(tokens[i]);
+        if (Utils::strStartsWith(t, "id:"))
+            keys.push_back(t);
+        else if (Utils::strStartsWith(t, "room_name:"))
+            keys.push_back("room:" + t.substr(10));
+    }
+
+    return keys;
+}
+
+vector<string> EventKeys::roomIOs(const string &room_name)
+{
+    vector<string> keys;
+
+    for (int i = 0;i < ListeRoom::Instance().size();i++)
+    {
+        Room *room = ListeRoom::Instance().get_room(i);
+        if (room->get_name() != room_name) continue;
+
+        for (int j = 0;j < room->get_size<Input *>();j++)
+            keys.push_back("id:" + room->get_input(j)->get_param("id"));
+        for (int j = 0;j < room->get_size<Output *>();j++)
+            keys.push_back("id:" + room->get_output(j)->get_param("id"));
+    }
+
+    return keys;
+}
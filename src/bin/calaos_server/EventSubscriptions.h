@@ -0,0 +1,169 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef S_EventSubscriptions_H
+#define S_EventSubscriptions_H
+
+#include "Calaos.h"
+#include <unordered_map>
+#include <unordered_set>
+#include "EventManager.h"
+
+using namespace Calaos;
+
+/*
+ * Index of the clients subscribed to events, an event is only encoded and
+ * sent to the clients found with its keys instead of looking at every
+ * client.
+ *
+ * Keys are "id:<io id>", "room:<room name>", "type:<event type>" and
+ * "player:<player id>". A client added with add() receives all events
+ * until its first subscribe().
+ *
+ * A key is subscribed once per source: the client itself (empty source)
+ * or a room ("room:<name>") for the IOs of that room. It is kept until
+ * all its sources are unsubscribed, an IO subscribed by id is still sent
+ * when its room is unsubscribed.
+ */
+template<typename T>
+class EventSubscriptions
+{
+private:
+    unordered_map<string, vector<T *>> index;
+    //subscribed keys of a client, with their sources
+    unordered_map<T *, unordered_map<string, unordered_set<string>>> clients;
+    unordered_set<T *> all;
+
+public:
+    void add(T *client)
+    {
+        remove(client);
+        clients[client];
+        all.insert(client);
+    }
+
+    void remove(T *client)
+    {
+        auto it = clients.find(client);
+        if (it == clients.end()) return;
+
+        for (auto &k: it->second)
+        {
+            const string &key = k.first;
+            vector<T *> &v = index[key];
+            v.erase(std::find(v.begin(), v.end(), client));
+            if (v.empty()) index.erase(key);
+        }
+
+        clients.erase(it);
+        all.erase(client);
+    }
+
+    void subscribe(T *client, const string &key, const string &source = string())
+    {
+        auto it = clients.find(client);
+        if (it == clients.end()) return;
+
+        all.erase(client);
+
+        unordered_set<string> &sources = it->second[key];
+        if (sources.empty())
+            index[key].push_back(client);
+        sources.insert(source);
+    }
+
+    void unsubscribe(T *client, const string &key, const string &source = string())
+    {
+        auto it = clients.find(client);
+        if (it == clients.end()) return;
+
+        auto k = it->second.find(key);
+        if (k == it->second.end() || k->second.erase(source) == 0 || !k->second.empty())
+            return;
+        it->second.erase(k);
+
+        vector<T *> &v = index[key];
+        v.erase(std::find(v.begin(), v.end(), client));
+        if (v.empty()) index.erase(key);
+    }
+
+    //Remove all subscriptions, the client receives nothing
+    void clear(T *client)
+    {
+        if (!contains(client)) return;
+        remove(client);
+        clients[client];
+    }
+
+    bool contains(T *client) const { return clients.find(client) != clients.end(); }
+
+    //All clients, subscribed or not
+    vector<T *> getClients() const
+    {
+        vector<T *> result;
+        result.reserve(clients.size());
+        for (auto &c: clients)
+            result.push_back(c.first);
+        return result;
+    }
+
+    //Clients an event with those keys is sent to, each one once
+    vector<T *> lookup(const vector<string> &keys) const
+    {
+        vector<T *> result(all.begin(), all.end());
+        unordered_set<T *> seen;
+
+        for (const string &key: keys)
+        {
+            auto it = index.find(key);
+            if (it == index.end()) continue;
+
+            for (T *client: it->second)
+            {
+                if (all.find(client) == all.end() && seen.insert(client).second)
+                    result.push_back(client);
+            }
+        }
+
+        return result;
+    }
+
+    //Clients subscribed to that key, clients receiving everything are not included
+    vector<T *> subscribers(const string &key) const
+    {
+        auto it = index.find(key);
+        if (it == index.end()) return vector<T *>();
+        return it->second;
+    }
+};
+
+namespace EventKeys
+{
+//Keys of an event from the EventManager
+vector<string> fromEvent(const CalaosEvent &event);
+
+//Keys of an event sent through IPC to TCP listen clients
+vector<string> fromEmission(const string &emission);
+
+//Keys of the IOs that are in a room
+vector<string> roomIOs(const string &room_name);
+}
+
+#endif
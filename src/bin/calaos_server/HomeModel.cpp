@@ -0,0 +1,325 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include "HomeModel.h"
+#include "MsgPack.h"
+#include "ListeRoom.h"
+#include "IPC.h"
+
+#ifndef json_array_foreach
+#define json_array_foreach(array, index, value) \
+    for(index = 0; \
+    index < json_array_size(array) && (value = json_array_get(array, index)); \
+    index++)
+#endif
+
+HomeModel::HomeModel()
+{
+    seq = (uint64_t)time(nullptr) * 1000000;
+    structure_seq = seq;
+
+    EventManager::Instance().newEvent.connect(sigc::mem_fun(*this, &HomeModel::handleEvent));
+
+    //params of IOs and rooms are edited from the TCP API which only
+    //notifies through IPC
+    sig_events.connect(sigc::mem_fun(*this, &HomeModel::handleIPC));
+    IPC::Instance().AddHandler("events", "*", sig_events);
+}
+
+HomeModel::~HomeModel()
+{
+    if (jhome)
+        json_decref(jhome);
+}
+
+string HomeModel::getIOState(IOBase *io)
+{
+    if (io->get_type() == TINT)
+        return Utils::to_string(io->get_value_double());
+    else if (io->get_type() == TBOOL)
+        return io->get_value_bool()?"true":"false";
+    else if (io->get_type() == TSTRING)
+        return io->get_value_string();
+
+    return string();
+}
+
+template<typename T>
+json_t *HomeModel::buildRoomIO(Room *room)
+{
+    json_t *jdata = json_array();
+
+    static const vector<string> params =
+    { "id", "name", "type", "hits", "var_type", "visible",
+      "chauffage_id", "rw", "unit", "gui_type", "state",
+      "auto_scenario", "step" };
+
+    for (int i = 0;i < room->get_size<T *>();i++)
+    {
+        json_t *jinput = json_object();
+        T *io = room->get_io<T *>(i);
+
+        for (const string &param: params)
+        {
+            string value;
+
+            if (param == "state")
+                value = getIOState(io);
+            else if (param == "var_type")
+            {
+                if (io->get_type() == TINT) value = "float";
+                else if (io->get_type() == TBOOL) value = "bool";
+                else if (io->get_type() == TSTRING) value = "string";
+            }
+            else
+            {
+                if (!io->get_params().Exists(param))
+                    continue;
+                value = io->get_param(param);
+            }
+
+            json_object_set_new(jinput, param.c_str(),
+                                json_string(value.c_str()));
+        }
+
+        json_array_append_new(jdata, jinput);
+    }
+
+    return jdata;
+}
+
+void HomeModel::build()
+{
+    cDebugDom("network") << "Building home, structure version " << structure_version;
+
+    if (jhome)
+        json_decref(jhome);
+    jinputs.clear();
+    joutputs.clear();
+
+    jhome = json_array();
+
+    for (int iroom = 0;iroom < ListeRoom::Instance().size();iroom++)
+    {
+        Room *room = ListeRoom::Instance().get_room(iroom);
+        json_t *jroom = json_object();
+
+        json_t *jin = buildRoomIO<Input>(room);
+        json_t *jout = buildRoomIO<Output>(room);
+
+        //index the IOs to update their state in place
+        size_t idx;
+        json_t *value;
+        json_array_foreach(jin, idx, value)
+            jinputs[json_string_value(json_object_get(value, "id"))] = value;
+        json_array_foreach(jout, idx, value)
+            joutputs[json_string_value(json_object_get(value, "id"))] = value;
+
+        json_t *jitems = json_pack("{s:o, s:o}",
+                                   "inputs", jin,
+                                   "outputs", jout);
+
+        json_object_set_new(jroom, "type", json_string(room->get_type().c_str()));
+        json_object_set_new(jroom, "name", json_string(room->get_name().c_str()));
+        json_object_set_new(jroom, "hits", json_string(Utils::to_string(room->get_hits()).c_str()));
+        json_object_set_new(jroom, "items", jitems);
+
+        json_array_append_new(jhome, jroom);
+    }
+
+    dump_valid = false;
+    msgpack_valid = false;
+}
+
+json_t *HomeModel::getHome()
+{
+    if (!jhome)
+        build();
+
+    return jhome;
+}
+
+const string &HomeModel::getHomeDump()
+{
+    if (dump_valid)
+        return dump;
+
+    char *d = json_dumps(getHome(), JSON_COMPACT | JSON_ENSURE_ASCII);
+    if (!d)
+    {
+        cErrorDom("network") << "json_dumps failed!";
+        dump = "[]";
+        return dump;
+    }
+
+    dump = d;
+    free(d);
+    dump_valid = true;
+
+    return dump;
+}
+
+const string &HomeModel::getHomeMsgPack()
+{
+    if (msgpack_valid)
+        return msgpack;
+
+    MsgPackWriter writer;
+    writer.writeJson(getHome());
+
+    msgpack = std::move(writer.getData());
+    msgpack_valid = true;
+
+    return msgpack;
+}
+
+void HomeModel::structureChanged()
+{
+    structure_version++;
+    structure_seq = ++seq;
+
+    //no state change before that one can be given to a client
+    changes.clear();
+
+    if (jhome)
+        json_decref(jhome);
+    jhome = nullptr;
+    jinputs.clear();
+    joutputs.clear();
+
+    dump_valid = false;
+    msgpack_valid = false;
+}
+
+void HomeModel::stateChanged(IOBase *io, const string &id, bool output)
+{
+    HomeChange change;
+    change.seq = ++seq;
+    change.id = id;
+    change.output = output;
+    change.state = getIOState(io);
+
+    auto &index = output?joutputs:jinputs;
+    auto it = index.find(id);
+    if (it != index.end())
+        json_object_set_new(it->second, "state", json_string(change.state.c_str()));
+
+    changes.push_back(change);
+    if (changes.size() > HOME_CHANGELOG_SIZE)
+        changes.pop_front();
+
+    dump_valid = false;
+    msgpack_valid = false;
+}
+
+void HomeModel::handleEvent(const CalaosEvent &ev)
+{
+    switch (ev.getType())
+    {
+    case CalaosEvent::EventInputChanged:
+    case CalaosEvent::EventOutputChanged:
+    {
+        bool output = ev.getType() == CalaosEvent::EventOutputChanged;
+
+        //anything else than the state changes the home
+        for (int i = 0;i < ev.getParam().size();i++)
+        {
+            string key, value;
+            ev.getParam().get_item(i, key, value);
+            if (key != "id" && key != "state" && key != "state_int")
+            {
+                structureChanged();
+                return;
+            }
+        }
+
+        string id = ev.getParam()["id"];
+        IOBase *io = nullptr;
+        if (output)
+            io = ListeRoom::Instance().get_output(id);
+        else
+            io = ListeRoom::Instance().get_input(id);
+
+        if (io)
+            stateChanged(io, id, output);
+        break;
+    }
+    case CalaosEvent::EventInputAdded:
+    case CalaosEvent::EventInputDeleted:
+    case CalaosEvent::EventInputPropertyDelete:
+    case CalaosEvent::EventOutputAdded:
+    case CalaosEvent::EventOutputDeleted:
+    case CalaosEvent::EventOutputPropertyDelete:
+    case CalaosEvent::EventRoomAdded:
+    case CalaosEvent::EventRoomDeleted:
+    case CalaosEvent::EventRoomChanged:
+    case CalaosEvent::EventRoomPropertyDelete:
+    case CalaosEvent::EventScenarioAdded:
+    case CalaosEvent::EventScenarioDeleted:
+    case CalaosEvent::EventScenarioChanged:
+        structureChanged();
+        break;
+    default: break;
+    }
+}
+
+void HomeModel::handleIPC(string source, string emission, void *mydata, void *sender_data)
+{
+    if (source != "events") return;
+
+    //states are already handled with the EventManager
+    vector<string> tokens;
+    split(emission, tokens, " ", 4);
+    if (tokens.size() >= 3 &&
+        (tokens[0] == "input" || tokens[0] == "output") &&
+        Utils::strStartsWith(url_decode(tokens[2]), "state:"))
+        return;
+
+    structureChanged();
+}
+
+bool HomeModel::getChanges(uint64_t since, vector<HomeChange> &result)
+{
+    if (since > seq || since < structure_seq)
+        return false;
+
+    //the change right after since has been dropped from the log
+    if (since < seq && (changes.empty() || changes.front().seq > since + 1))
+        return false;
+
+    //only the last state of each IO
+    unordered_map<string, size_t> last;
+    for (const HomeChange &c: changes)
+    {
+        if (c.seq <= since) continue;
+
+        string key = (c.output?"o":"i") + c.id;
+        auto it = last.find(key);
+        if (it == last.end())
+        {
+            last[key] = result.size();
+            result.push_back(c);
+        }
+        else
+            result[it->second] = c;
+    }
+
+    return true;
+}
@@ -0,0 +1,121 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef S_HomeModel_H
+#define S_HomeModel_H
+
+#include "Calaos.h"
+#include <jansson.h>
+#include <unordered_map>
+#include "EventManager.h"
+#include "Room.h"
+
+using namespace Calaos;
+
+//Number of state changes kept for clients asking for the changes since
+//their last sequence number
+#define HOME_CHANGELOG_SIZE     1000
+
+class HomeChange
+{
+public:
+    uint64_t seq;
+    string id;
+    bool output;
+    string state;
+};
+
+/*
+ * Versioned model of the home as sent by get_home.
+ *
+ * The json tree is built once and the state of IOs is updated in it when
+ * they change, each state change increments the sequence number and is
+ * kept in a bounded change log. Structural changes (IO or room added,
+ * deleted, renamed or any param edited) increment the structure version
+ * and the tree is built again on the next request.
+ *
+ * The serialized document is cached until the next change, all clients
+ * reconnecting at the same time get the same string.
+ */
+class HomeModel: public sigc::trackable
+{
+private:
+    HomeModel();
+
+    json_t *jhome = nullptr;
+    unordered_map<string, json_t *> jinputs, joutputs;
+
+    string dump;
+    bool dump_valid = false;
+
+    string msgpack;
+    bool msgpack_valid = false;
+
+    //sequence numbers start from the boot time so that they keep
+    //increasing over a restart of calaos_server
+    uint64_t seq;
+    uint64_t structure_seq;
+    uint64_t structure_version = 1;
+
+    deque<HomeChange> changes;
+
+    sigc::signal<void, string, string, void*, void*> sig_events;
+
+    void handleEvent(const CalaosEvent &ev);
+    void handleIPC(string source, string emission, void *mydata, void *sender_data);
+
+    void build();
+    template<typename T> json_t *buildRoomIO(Room *room);
+
+    void stateChanged(IOBase *io, const string &id, bool output);
+
+public:
+    static HomeModel &Instance()
+    {
+        static HomeModel inst;
+        return inst;
+    }
+    ~HomeModel();
+
+    //state of an IO as sent to clients
+    static string getIOState(IOBase *io);
+
+    //The home tree, owned by HomeModel. It is only valid until the
+    //next return to the main loop.
+    json_t *getHome();
+
+    //The home tree serialized with JSON_COMPACT | JSON_ENSURE_ASCII
+    const string &getHomeDump();
+
+    //The home tree encoded with MessagePack
+    const string &getHomeMsgPack();
+
+    uint64_t getSeq() const { return seq; }
+    uint64_t getStructureVersion() const { return structure_version; }
+
+    //Get the last state of all IOs changed after seq. Returns false if
+    //those changes are not known anymore, the client needs a get_home.
+    bool getChanges(uint64_t since, vector<HomeChange> &result);
+
+    //force a rebuild of the home for changes that are not notified
+    void structureChanged();
+};
+
+#endif
@@ -26,6 +26,7 @@
 #include "CalaosConfig.h"
 #include <Ecore.h>
 #include "HttpCodes.h"
+#include "StaticFileCache.h"
 
 using namespace Calaos;
 
@@ -269,14 +270,7 @@ int HttpClient::processHeaders(const string &request)
             return HTTP_PROCESS_DONE;
         }
 
-        string filext = str_to_lower(path.substr(path.find_last_of(".") + 1));
-
-        Params headers;
-        headers.Add("Connection", "Close");
-        headers.Add("Content-Type", getMimeType(filext));
-        cDebug() << "send file " << fileName << "to Client";
-        string res = buildHttpResponseFromFile(HTTP_200, headers, fileName);
-        sendToClient(res);
+        sendStaticFile(fileName);
 
         return HTTP_PROCESS_DONE;
     }
@@ -322,14 +316,7 @@ int HttpClient::processHeaders(const string &request)
             return HTTP_PROCESS_DONE;
         }
 
-        string filext = str_to_lower(path.substr(path.find_last_of(".") + 1));
-
-        Params headers;
-        headers.Add("Connection", "Close");
-        headers.Add("Content-Type", getMimeType(filext));
-        cDebug() << "send file " << fileName << "to Client";
-        string res = buildHttpResponseFromFile(HTTP_200, headers, fileName);
-        sendToClient(res);
+        sendStaticFile(fileName);
 
         return HTTP_PROCESS_DONE;
     }
@@ -474,13 +461,75 @@ string HttpClient::buildHttpResponse(string code, Params &headers, string body)
     return res.str();
 }
 
+void HttpClient::sendStaticFile(const string &fileName)
+{
+    StaticFilePtr file = StaticFileCache::Instance().get(fileName);
+    if (!file)
+    {
+        cDebugDom("network") << "Filename not found: " << fileName;
+
+        Params headers;
+        headers.Add("Connection", "close");
+        headers.Add("Content-Type", "text/html");
+        string res = buildHttpResponse(HTTP_404, headers, HTTP_404_BODY);
+        sendToClient(res);
+
+        return;
+    }
+
+    int encoding = file->selectEncoding(request_headers["accept-encoding"]);
+    size_t size = file->getSize(encoding);
+
+    string filext = str_to_lower(fileName.substr(fileName.find_last_of(".") + 1));
+
+    Params headers;
+    headers.Add("Connection", "Close");
+    headers.Add("Content-Type", getMimeType(filext));
+    headers.Add("Content-Length", Utils::to_string(size));
+    headers.Add("ETag", file->getEtag(encoding));
+    if (file->isImmutable())
+        headers.Add("Cache-Control", "public, max-age=31536000, immutable");
+    else
+        headers.Add("Cache-Control", "no-cache");
+    if (file->isCompressible())
+        headers.Add("Vary", "Accept-Encoding");
+
+    if (request_headers.find("if-none-match") != request_headers.end() &&
+        file->matchEtag(request_headers["if-none-match"], encoding))
+    {
+        cDebugDom("network") << "File not modified " << fileName;
+
+        string res = buildHttpResponse(HTTP_304, headers, string());
+        sendToClient(res);
+
+        return;
+    }
+
+    if (encoding != StaticFile::EncodingIdentity)
+        headers.Add("Content-Encoding", file->getContentEncoding(encoding));
+
+    cDebugDom("network") << "send file " << fileName << " to Client, " << size << " bytes";
+
+    //the content is given to ecore_con without being copied in the response
+    string res = buildHttpResponse(HTTP_200, headers, string());
+    sendToClient(res);
+
+    if (request_method != HTTP_HEAD)
+        sendToClient(file->getData(encoding), size);
+}
+
 void HttpClient::sendToClient(string res)
 {
-    data_size += res.length();
+    sendToClient(res.c_str(), res.length());
+}
+
+void HttpClient::sendToClient(const char *data, size_t size)
+{
+    data_size += size;
 
-    cDebugDom("network") << "Sending " << res.length() << " bytes, data_size = " << data_size;
+    cDebugDom("network") << "Sending " << size << " bytes, data_size = " << data_size;
 
-    if (!client_conn || ecore_con_client_send(client_conn, res.c_str(), res.length()) == 0)
+    if (!client_conn || ecore_con_client_send(client_conn, data, size) == 0)
     {
         cCriticalDom("network")
                 << "Error sending data ! Closing connection.";
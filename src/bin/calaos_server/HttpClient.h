@@ -83,6 +83,10 @@ protected:
     void handleJsonRequest();
 
     void sendToClient(string res);
+    void sendToClient(const char *data, size_t size);
+
+    //Send a file of the web app or debug pages from the static file cache
+    void sendStaticFile(const string &fileName);
 
     string getMimeType(const string &file_ext);
 
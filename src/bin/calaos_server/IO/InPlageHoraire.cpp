@@ -21,6 +21,7 @@
 #include "InPlageHoraire.h"
 #include "ListeRule.h"
 #include "IOFactory.h"
+#include <sys/time.h>
 
 using namespace Calaos;
 
@@ -56,6 +57,23 @@ void InPlageHoraire::clear()
     plg_dimanche.clear();
 }
 
+vector<TimeRange> *InPlageHoraire::getPlageForDay(int wday)
+{
+    switch (wday)
+    {
+    case TimeRange::MONDAY: return &plg_lundi;
+    case TimeRange::TUESDAY: return &plg_mardi;
+    case TimeRange::WEDNESDAY: return &plg_mercredi;
+    case TimeRange::THURSDAY: return &plg_jeudi;
+    case TimeRange::FRIDAY: return &plg_vendredi;
+    case TimeRange::SATURDAY: return &plg_samedi;
+    case TimeRange::SUNDAY: return &plg_dimanche;
+    default: break;
+    }
+
+    return NULL;
+}
+
 void InPlageHoraire::hasChanged()
 {
     if (!isEnabled()) return;
@@ -68,17 +86,7 @@ void InPlageHoraire::hasChanged()
     time_t t = time(NULL);
     ctime = localtime(&t);
 
-    switch (ctime->tm_wday)
-    {
-    case TimeRange::MONDAY: plage = &plg_lundi; break;
-    case TimeRange::TUESDAY: plage = &plg_mardi; break;
-    case TimeRange::WEDNESDAY: plage = &plg_mercredi; break;
-    case TimeRange::THURSDAY: plage = &plg_jeudi; break;
-    case TimeRange::FRIDAY: plage = &plg_vendredi; break;
-    case TimeRange::SATURDAY: plage = &plg_samedi; break;
-    case TimeRange::SUNDAY: plage = &plg_dimanche; break;
-    default: break;
-    }
+    plage = getPlageForDay(ctime->tm_wday);
 
     if (!plage)
         return;
@@ -110,6 +118,44 @@ void InPlageHoraire::hasChanged()
     }
 }
 
+double InPlageHoraire::getNextDeadline()
+{
+    double now = ecore_time_get();
+
+    if (!isEnabled()) return now + EVENT_LOOP_MAX_SLEEP;
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    struct tm ctime;
+    time_t t = tv.tv_sec;
+    localtime_r(&t, &ctime);
+
+    long cur = ctime.tm_hour * 3600 +
+               ctime.tm_min * 60 +
+               ctime.tm_sec;
+
+    //by default check again at midnight, time ranges of the next day apply
+    long next = 24 * 3600;
+
+    vector<TimeRange> *plage = getPlageForDay(ctime.tm_wday);
+    for (uint i = 0;plage && i < plage->size();i++)
+    {
+        TimeRange &h = (*plage)[i];
+
+        long start_time = h.getStartTimeSec(ctime.tm_year + 1900, ctime.tm_mon + 1, ctime.tm_mday);
+        long end_time = h.getEndTimeSec(ctime.tm_year + 1900, ctime.tm_mon + 1, ctime.tm_mday);
+
+        //value becomes true at start_time and false after end_time
+        if (start_time > cur && start_time < next)
+            next = start_time;
+        if (end_time + 1 > cur && end_time + 1 < next)
+            next = end_time + 1;
+    }
+
+    return now + (next - cur) - tv.tv_usec / 1000000.0 + 0.01;
+}
+
 void InPlageHoraire::LoadPlage(TiXmlElement *node, vector<TimeRange> &plage)
 {
     TiXmlHandle docHandle(node);
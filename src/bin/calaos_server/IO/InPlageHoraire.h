@@ -44,6 +44,8 @@ protected:
     void LoadPlage(TiXmlElement *node, vector<TimeRange> &plage);
     void SavePlage(TiXmlElement *node, string day, vector<TimeRange> &plage);
 
+    vector<TimeRange> *getPlageForDay(int wday);
+
 public:
     InPlageHoraire(Params &p);
     ~InPlageHoraire();
@@ -82,6 +84,7 @@ public:
     void clear();
 
     virtual void hasChanged();
+    virtual double getNextDeadline();
 
     virtual bool LoadFromXml(TiXmlElement *node);
     virtual bool SaveToXml(TiXmlElement *node);
@@ -119,6 +119,15 @@ void InputAnalog::hasChanged()
     }
 }
 
+double InputAnalog::getNextDeadline()
+{
+    if (!isEnabled()) return ecore_time_get() + EVENT_LOOP_MAX_SLEEP;
+
+    readConfig();
+
+    return timer + frequency;
+}
+
 double InputAnalog::get_value_double()
 {
     readConfig();
@@ -54,6 +54,7 @@ public:
     virtual double get_value_double();
 
     virtual void hasChanged();
+    virtual double getNextDeadline();
 };
 
 }
@@ -89,6 +89,13 @@ void InputTemp::hasChanged()
     }
 }
 
+double InputTemp::getNextDeadline()
+{
+    if (!isEnabled()) return ecore_time_get() + EVENT_LOOP_MAX_SLEEP;
+
+    return timer + readTime;
+}
+
 double InputTemp::get_value_double()
 {
     double v;
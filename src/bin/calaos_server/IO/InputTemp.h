@@ -56,6 +56,7 @@ public:
     virtual double get_value_double();
 
     virtual void hasChanged();
+    virtual double getNextDeadline();
 };
 
 }
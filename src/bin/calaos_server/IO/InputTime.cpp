@@ -21,6 +21,7 @@
 #include "InputTime.h"
 #include "ListeRule.h"
 #include "IOFactory.h"
+#include <sys/time.h>
 
 using namespace Calaos;
 using namespace Utils;
@@ -107,3 +108,54 @@ void InputTime::hasChanged()
                                { "state", val?"true":"false" } });
     }
 }
+
+double InputTime::getNextDeadline()
+{
+    double now = ecore_time_get();
+
+    if (!isEnabled()) return now + EVENT_LOOP_MAX_SLEEP;
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    //delay until the start of the next second, with a small margin
+    double next_sec = 1.0 - tv.tv_usec / 1000000.0 + 0.01;
+
+    //value is true for one second only, check again to reset it
+    if (value) return now + next_sec;
+
+    struct tm ctime;
+    time_t t = tv.tv_sec;
+    localtime_r(&t, &ctime);
+
+    struct tm target = ctime;
+    target.tm_hour = hour;
+    target.tm_min = minute;
+    target.tm_sec = second;
+    target.tm_isdst = -1;
+    if (with_date)
+    {
+        target.tm_mday = day;
+        target.tm_mon = month - 1;
+        target.tm_year = year - 1900;
+    }
+
+    time_t tt = mktime(&target);
+    if (tt != (time_t)-1 && tt <= t && !with_date)
+    {
+        //already passed today, try tomorrow
+        target = ctime;
+        target.tm_mday++;
+        target.tm_hour = hour;
+        target.tm_min = minute;
+        target.tm_sec = second;
+        target.tm_isdst = -1;
+        tt = mktime(&target);
+    }
+
+    //invalid or passed date, the event loop will check it from time to time
+    if (tt == (time_t)-1 || tt <= t)
+        return now + EVENT_LOOP_MAX_SLEEP;
+
+    return now + (tt - t - 1) + next_sec;
+}
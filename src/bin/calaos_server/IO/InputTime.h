@@ -47,6 +47,7 @@ public:
     bool is_with_date() { return with_date; }
 
     virtual void hasChanged();
+    virtual double getNextDeadline();
 };
 
 }
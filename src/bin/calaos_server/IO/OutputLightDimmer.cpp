@@ -56,19 +56,108 @@ OutputLightDimmer::~OutputLightDimmer()
 **  hold stop
 **  impulse <params>
 */
+static int _dimmer_percent(const string &val)
+{
+    int percent = 0;
+    Utils::from_string(val, percent);
+    if (percent < 0) percent = 0;
+    if (percent > 100) percent = 100;
+
+    return percent;
+}
+
+OutputCommand OutputLightDimmer::parseCommand(const std::string &val)
+{
+    OutputCommand c(val);
+
+    if (val == "on" || val == "true")
+        c.cmd = CmdOn;
+    else if (val == "off" || val == "false")
+        c.cmd = CmdOff;
+    else if (val == "toggle")
+        c.cmd = CmdToggle;
+    else if (val.compare(0, 8, "set off ") == 0)
+    {
+        c.cmd = CmdSetOff;
+        c.ivalue = _dimmer_percent(val.substr(8));
+    }
+    else if (val.compare(0, 4, "set ") == 0)
+    {
+        c.cmd = CmdSet;
+        c.ivalue = _dimmer_percent(val.substr(4));
+    }
+    else if (val.compare(0, 3, "up ") == 0)
+    {
+        c.cmd = CmdUp;
+        c.arg = val.substr(3);
+        Utils::from_string(c.arg, c.ivalue);
+    }
+    else if (val.compare(0, 5, "down ") == 0)
+    {
+        c.cmd = CmdDown;
+        c.arg = val.substr(5);
+        Utils::from_string(c.arg, c.ivalue);
+    }
+    else if (val == "hold press")
+        c.cmd = CmdHoldPress;
+    else if (val == "hold stop")
+        c.cmd = CmdHoldStop;
+    else if (val.compare(0, 8, "impulse ") == 0)
+    {
+        c.arg = val.substr(8);
+        // classic impulse, WODigital goes false after <time> miliseconds
+        if (is_of_type<int>(c.arg))
+        {
+            c.cmd = CmdImpulse;
+            Utils::from_string(c.arg, c.ivalue);
+        }
+        else
+        {
+            // extended impulse using pattern
+            c.cmd = CmdImpulseExtended;
+        }
+    }
+    else if (Utils::strStartsWith(val, "set_state "))
+    {
+        c.arg = val.substr(10);
+
+        if (c.arg == "true")
+            c.cmd = CmdSetStateOn;
+        else if (c.arg == "false")
+            c.cmd = CmdSetStateOff;
+        else if (is_of_type<int>(c.arg))
+        {
+            c.cmd = CmdSetState;
+            c.ivalue = _dimmer_percent(c.arg);
+        }
+        else
+            c.cmd = CmdNone;
+    }
+    else
+        c.cmd = CmdInvalid;
+
+    return c;
+}
+
 bool OutputLightDimmer::set_value(std::string val)
+{
+    return execCommand(parseCommand(val));
+}
+
+bool OutputLightDimmer::execCommand(const OutputCommand &c)
 {
     if (!isEnabled()) return true;
 
     bool ret = true;
 
-    cInfoDom("output") << get_param("id") << ": got action, " << val;
+    cInfoDom("output") << get_param("id") << ": got action, " << c.action;
 
     // Setting a new value will also stop any running impulse actions
     DELETE_NULL(impulseTimer);
 
-    if (val == "on" || val == "true")
+    switch (c.cmd)
     {
+    case CmdOn:
         //switch the light on only if value == 0
         if (value == 0)
         {
@@ -76,9 +165,8 @@ bool OutputLightDimmer::set_value(std::string val)
 
             cmd_state = "on";
         }
-    }
-    else if (val == "off" || val == "false")
-    {
+        break;
+    case CmdOff:
         //switch the light off only if value > 0
         if (value > 0)
         {
@@ -86,69 +174,43 @@ bool OutputLightDimmer::set_value(std::string val)
 
             cmd_state = "off";
         }
-    }
-    else if (val == "toggle")
-    {
+        break;
+    case CmdToggle:
         if (value == 0)
             set_value(true);
         else
             set_value(false);
-    }
-    else if (val.compare(0, 8, "set off ") == 0)
-    {
-        val.erase(0, 8);
-        int percent;
-        Utils::from_string(val, percent);
-        if (percent < 0) percent = 0;
-        if (percent > 100) percent = 100;
-
-        cmd_state = "set off " + Utils::to_string(percent);
+        break;
+    case CmdSetOff:
+        cmd_state = "set off " + Utils::to_string(c.ivalue);
 
         if (value > 0)
         {
-            set_value_real(percent);
-            value = percent;
+            set_value_real(c.ivalue);
+            value = c.ivalue;
         }
         else
         {
-            old_value = percent;
+            old_value = c.ivalue;
         }
-    }
-    else if (val.compare(0, 4, "set ") == 0)
-    {
-        val.erase(0, 4);
-        int percent;
-        Utils::from_string(val, percent);
-        if (percent < 0) percent = 0;
-        if (percent > 100) percent = 100;
-
-        cmd_state = "set " + Utils::to_string(percent);
-
-        set_value_real(percent);
-        value = percent;
-    }
-    else if (val.compare(0, 3, "up ") == 0)
-    {
-        val.erase(0, 3);
-        int percent;
-        Utils::from_string(val, percent);
-
-        set_dim_up_real(percent);
-
-        cmd_state = "up " + val;
-    }
-    else if (val.compare(0, 5, "down ") == 0)
-    {
-        val.erase(0, 5);
-        int percent;
-        Utils::from_string(val, percent);
-
-        cmd_state = "down " + val;
-
-        set_dim_down_real(percent);
-    }
-    else if (val == "hold press")
-    {
+        break;
+    case CmdSet:
+        cmd_state = "set " + Utils::to_string(c.ivalue);
+
+        set_value_real(c.ivalue);
+        value = c.ivalue;
+        break;
+    case CmdUp:
+        set_dim_up_real(c.ivalue);
+
+        cmd_state = "up " + c.arg;
+        break;
+    case CmdDown:
+        cmd_state = "down " + c.arg;
+
+        set_dim_down_real(c.ivalue);
+        break;
+    case CmdHoldPress:
         if (hold_timer)
         {
             //reset hold detection
@@ -158,9 +220,8 @@ bool OutputLightDimmer::set_value(std::string val)
         press_detected = false;
         stop_after_press = true;
         hold_timer = new EcoreTimer(0.5, (sigc::slot<void>)sigc::mem_fun(*this, &OutputLightDimmer::HoldPress_cb));
-    }
-    else if (val == "hold stop")
-    {
+        break;
+    case CmdHoldStop:
         //only toggle after a press and if long press is not detected
         if (!press_detected && stop_after_press)
         {
@@ -175,52 +236,31 @@ bool OutputLightDimmer::set_value(std::string val)
             hold_timer = NULL;
             press_detected = false;
         }
-    }
-    else if (val.compare(0, 8, "impulse ") == 0)
-    {
-        string tmp = val;
-        tmp.erase(0, 8);
-        // classic impulse, WODigital goes false after <time> miliseconds
-        if (is_of_type<int>(tmp))
-        {
-            int t;
-            Utils::from_string(tmp, t);
-            impulse(t);
-        }
-        else
-        {
-            // extended impulse using pattern
-            impulse_extended(tmp);
-        }
-    }
-    else if (Utils::strStartsWith(val, "set_state "))
-    {
-        val.erase(0, 10);
-
-        if (val == "true")
-        {
-            value = old_value;
-            cmd_state = "on";
-        }
-        else if (val == "false")
-        {
-            old_value = value;
-            value = 0;
-            cmd_state = "off";
-        }
-        else if (is_of_type<int>(val))
-        {
-            int percent;
-            Utils::from_string(val, percent);
-            if (percent < 0) percent = 0;
-            if (percent > 100) percent = 100;
-
-            cmd_state = "set " + Utils::to_string(percent);
-            value = percent;
-        }
-    }
-    else
+        break;
+    case CmdImpulse:
+        impulse(c.ivalue);
+        break;
+    case CmdImpulseExtended:
+        impulse_extended(c.arg);
+        break;
+    case CmdSetStateOn:
+        value = old_value;
+        cmd_state = "on";
+        break;
+    case CmdSetStateOff:
+        old_value = value;
+        value = 0;
+        cmd_state = "off";
+        break;
+    case CmdSetState:
+        cmd_state = "set " + Utils::to_string(c.ivalue);
+        value = c.ivalue;
+        break;
+    case CmdNone:
+        break;
+    default:
         return false;
+    }
 
     EmitSignalOutput();
 
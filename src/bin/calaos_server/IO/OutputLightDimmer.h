@@ -64,6 +64,13 @@ protected:
     virtual bool set_dim_up_real(int percent);
     virtual bool set_dim_down_real(int percent);
 
+    enum
+    {
+        CmdInvalid = 1, CmdNone, CmdOn, CmdOff, CmdToggle, CmdSetOff, CmdSet, CmdUp, CmdDown,
+        CmdHoldPress, CmdHoldStop, CmdImpulse, CmdImpulseExtended,
+        CmdSetStateOn, CmdSetStateOff, CmdSetState,
+    };
+
 public:
     OutputLightDimmer(Params &p);
     ~OutputLightDimmer();
@@ -73,6 +80,9 @@ public:
     bool set_value(std::string val);
     bool set_value(bool val)
     { if (val) set_value(std::string("on")); else set_value(std::string("off")); return true; }
+
+    virtual OutputCommand parseCommand(const std::string &val);
+    virtual bool execCommand(const OutputCommand &c);
     std::string get_value_string() { return Utils::to_string(value); }
     bool get_value_bool() { if (value == 0) return false; else return true; }
 
@@ -43,16 +43,94 @@ OutputLightRGB::~OutputLightRGB()
 **  off
 **  toggle
 */
+OutputCommand OutputLightRGB::parseCommand(const std::string &val)
+{
+    OutputCommand c(val);
+
+    //commands with a percent argument
+    static const struct { const char *prefix; int cmd; } percent_cmds[] =
+    {
+        { "set_red ", CmdSetRed },
+        { "set_green ", CmdSetGreen },
+        { "set_blue ", CmdSetBlue },
+        { "up_red ", CmdUpRed },
+        { "down_red ", CmdDownRed },
+        { "up_green ", CmdUpGreen },
+        { "down_green ", CmdDownGreen },
+        { "up_blue ", CmdUpBlue },
+        { "down_blue ", CmdDownBlue },
+        { "auto_change ", CmdAutoChange },
+    };
+
+    if (val == "on" || val == "true")
+        c.cmd = CmdOn;
+    else if (val == "off" || val == "false")
+        c.cmd = CmdOff;
+    else if (val.compare(0, 8, "set off ") == 0)
+    {
+        c.cmd = CmdSetOff;
+        c.color = ColorValue(val.substr(8));
+    }
+    else if (val == "toggle")
+        c.cmd = CmdToggle;
+    else if (val.compare(0, 4, "set ") == 0)
+    {
+        c.cmd = CmdSet;
+        c.color = ColorValue(val.substr(4));
+    }
+    else if (Utils::strStartsWith(val, "set_state "))
+    {
+        c.arg = val.substr(10);
+
+        if (c.arg == "true")
+            c.cmd = CmdSetStateOn;
+        else if (c.arg == "false")
+            c.cmd = CmdSetStateOff;
+        else
+        {
+            c.cmd = CmdSetState;
+            c.color = ColorValue(c.arg);
+        }
+    }
+    else
+    {
+        for (uint i = 0;i < sizeof(percent_cmds) / sizeof(percent_cmds[0]);i++)
+        {
+            size_t len = strlen(percent_cmds[i].prefix);
+            if (val.compare(0, len, percent_cmds[i].prefix) == 0)
+            {
+                c.cmd = percent_cmds[i].cmd;
+                from_string(val.substr(len), c.ivalue);
+                break;
+            }
+        }
+
+        //unknown actions are ignored
+        if (c.cmd == OutputCommand::CmdString)
+            c.cmd = CmdNone;
+    }
+
+    return c;
+}
+
 bool OutputLightRGB::set_value(std::string val)
+{
+    return execCommand(parseCommand(val));
+}
+
+bool OutputLightRGB::execCommand(const OutputCommand &c)
 {
     if (!isEnabled()) return true;
 
     bool ret = true;
 
-    cInfoDom("output") << "OutputLightRGB(" << get_param("id") << "): got action, " << val;
+    cInfoDom("output") << "OutputLightRGB(" << get_param("id") << "): got action, " << c.action;
 
-    if (val == "on" || val == "true")
+    double v = double(c.ivalue) * 255. / 100.;
+
+    switch (c.cmd)
     {
+    case CmdOn:
         //switch the light on only if it was off
         if (!state)
         {
@@ -62,9 +140,8 @@ bool OutputLightRGB::set_value(std::string val)
         }
 
         DELETE_NULL(timer_auto);
-    }
-    else if (val == "off" || val == "false")
-    {
+        break;
+    case CmdOff:
         //switch the light off only if it was on
         if (state)
         {
@@ -74,15 +151,11 @@ bool OutputLightRGB::set_value(std::string val)
         }
 
         DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 8, "set off ") == 0)
-    {
-        val.erase(0, 4);
-
-        ColorValue c(val);
-        if (c.isValid())
+        break;
+    case CmdSetOff:
+        if (c.color.isValid())
         {
-            color = c;
+            color = c.color;
             if (state)
                 setColor(color, state);
 
@@ -90,19 +163,14 @@ bool OutputLightRGB::set_value(std::string val)
 
             DELETE_NULL(timer_auto);
         }
-    }
-    else if (val == "toggle")
-    {
+        break;
+    case CmdToggle:
         set_value(!state);
-    }
-    else if (val.compare(0, 4, "set ") == 0)
-    {
-        val.erase(0, 4);
-
-        ColorValue c(val);
-        if (c.isValid())
+        break;
+    case CmdSet:
+        if (c.color.isValid())
         {
-            color = c;
+            color = c.color;
             state = true;
 
             setColor(color, state);
@@ -111,146 +179,59 @@ bool OutputLightRGB::set_value(std::string val)
 
             DELETE_NULL(timer_auto);
         }
-    }
-    else if (val.compare(0, 8, "set_red ") == 0)
-    {
-        val.erase(0, 8);
-        int percent;
-        from_string(val, percent);
+        break;
+    case CmdSetRed:
+    case CmdSetGreen:
+    case CmdSetBlue:
+    case CmdUpRed:
+    case CmdDownRed:
+    case CmdUpGreen:
+    case CmdDownGreen:
+    case CmdUpBlue:
+    case CmdDownBlue:
+        if (c.cmd == CmdSetRed) color.setRed(v);
+        else if (c.cmd == CmdSetGreen) color.setGreen(v);
+        else if (c.cmd == CmdSetBlue) color.setBlue(v);
+        else if (c.cmd == CmdUpRed) color.setRed(color.getRed() + v);
+        else if (c.cmd == CmdDownRed) color.setRed(color.getRed() - v);
+        else if (c.cmd == CmdUpGreen) color.setGreen(color.getGreen() + v);
+        else if (c.cmd == CmdDownGreen) color.setGreen(color.getGreen() - v);
+        else if (c.cmd == CmdUpBlue) color.setBlue(color.getBlue() + v);
+        else if (c.cmd == CmdDownBlue) color.setBlue(color.getBlue() - v);
 
-        color.setRed(double(percent) * 255. / 100.);
         state = true;
         setColor(color, state);
         DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 10, "set_green ") == 0)
-    {
-        val.erase(0, 10);
-        int percent;
-        from_string(val, percent);
-
-        color.setGreen(double(percent) * 255. / 100.);
-        state = true;
-        setColor(color, state);
-        DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 9, "set_blue ") == 0)
-    {
-        val.erase(0, 9);
-        int percent;
-        from_string(val, percent);
-
-        color.setBlue(double(percent) * 255. / 100.);
-        state = true;
-        setColor(color, state);
+        break;
+    case CmdAutoChange:
         DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 7, "up_red ") == 0)
-    {
-        val.erase(0, 7);
-        int percent;
-        from_string(val, percent);
-
-        color.setRed(color.getRed() + double(percent) * 255. / 100.);
-        state = true;
-        setColor(color, state);
-        DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 9, "down_red ") == 0)
-    {
-        val.erase(0, 9);
-        int percent;
-        from_string(val, percent);
-
-        color.setRed(color.getRed() - double(percent) * 255. / 100.);
-        state = true;
-        setColor(color, state);
-        DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 9, "up_green ") == 0)
-    {
-        val.erase(0, 9);
-        int percent;
-        from_string(val, percent);
-
-        color.setGreen(color.getGreen() + double(percent) * 255. / 100.);
-        state = true;
-        setColor(color, state);
-        DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 11, "down_green ") == 0)
-    {
-        val.erase(0, 11);
-        int percent;
-        from_string(val, percent);
-
-        color.setGreen(color.getGreen() - double(percent) * 255. / 100.);
-        state = true;
-        setColor(color, state);
-        DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 8, "up_blue ") == 0)
-    {
-        val.erase(0, 8);
-        int percent;
-        from_string(val, percent);
-
-        color.setBlue(color.getBlue() + double(percent) * 255. / 100.);
-        state = true;
-        setColor(color, state);
-        DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 10, "down_blue ") == 0)
-    {
-        val.erase(0, 10);
-        int percent;
-        from_string(val, percent);
-
-        color.setBlue(color.getBlue() - double(percent) * 255. / 100.);
-        state = true;
-        setColor(color, state);
-        DELETE_NULL(timer_auto);
-    }
-    else if (val.compare(0, 12, "auto_change ") == 0)
-    {
-        val.erase(0, 12);
-        int timems;
-        from_string(val, timems);
-
-        DELETE_NULL(timer_auto);
-        timer_auto = new EcoreTimer((double)timems / 1000.,
+        timer_auto = new EcoreTimer((double)c.ivalue / 1000.,
                                     (sigc::slot<void>)sigc::mem_fun(*this, &OutputLightRGB::TimerAutoChange) );
         //Directly start the first time
         TimerAutoChange();
-    }
-    else if (Utils::strStartsWith(val, "set_state "))
-    {
-        val.erase(0, 10);
-
-        if (val == "true")
-        {
-            cmd_state = "on";
-            state = true;
-            EmitSignalOutput();
-            emitChange();
-        }
-        else if (val == "false")
-        {
-            cmd_state = "off";
-            state = false;
-            EmitSignalOutput();
-            emitChange();
-        }
-        else
-        {
-            ColorValue c(val);
-            if (!c.isValid())
-                return false;
-
-            color = c;
-            cmd_state = "set " + color.toString();
-            state = true;
-        }
+        break;
+    case CmdSetStateOn:
+        cmd_state = "on";
+        state = true;
+        EmitSignalOutput();
+        emitChange();
+        break;
+    case CmdSetStateOff:
+        cmd_state = "off";
+        state = false;
+        EmitSignalOutput();
+        emitChange();
+        break;
+    case CmdSetState:
+        if (!c.color.isValid())
+            return false;
+
+        color = c.color;
+        cmd_state = "set " + color.toString();
+        state = true;
+        break;
+    default:
+        break;
     }
 
     return ret;
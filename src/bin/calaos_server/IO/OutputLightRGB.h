@@ -47,6 +47,13 @@ protected:
 
     virtual void setColorReal(const ColorValue &color, bool state) = 0;
 
+    enum
+    {
+        CmdInvalid = 1, CmdNone, CmdOn, CmdOff, CmdSetOff, CmdToggle, CmdSet,
+        CmdSetRed, CmdSetGreen, CmdSetBlue, CmdUpRed, CmdDownRed, CmdUpGreen, CmdDownGreen,
+        CmdUpBlue, CmdDownBlue, CmdAutoChange, CmdSetStateOn, CmdSetStateOff, CmdSetState,
+    };
+
 public:
     OutputLightRGB(Params &p);
     ~OutputLightRGB();
@@ -56,6 +63,9 @@ public:
     bool set_value(std::string val);
     bool set_value(bool val)
     { if (val) set_value(std::string("on")); else set_value(std::string("off")); return true; }
+
+    virtual OutputCommand parseCommand(const std::string &val);
+    virtual bool execCommand(const OutputCommand &c);
     std::string get_value_string() { return !state?"0":color.toString(); }
     bool get_value_bool() { return state; }
 
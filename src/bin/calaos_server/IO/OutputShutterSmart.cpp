@@ -101,11 +101,75 @@ void OutputShutterSmart::readConfig()
 **  impulse down
 **  calibrate
 */
+OutputCommand OutputShutterSmart::parseCommand(const std::string &val)
+{
+    OutputCommand c(val);
+
+    if (val == "up")
+        c.cmd = CmdUp;
+    else if (val == "down")
+        c.cmd = CmdDown;
+    else if (val == "toggle")
+        c.cmd = CmdToggle;
+    else if (val == "stop")
+        c.cmd = CmdStop;
+    else if (val.compare(0, 11, "impulse up ") == 0)
+    {
+        c.cmd = CmdImpulseUp;
+        from_string(val.substr(11), c.ivalue);
+    }
+    else if (val.compare(0, 13, "impulse down ") == 0)
+    {
+        c.cmd = CmdImpulseDown;
+        from_string(val.substr(13), c.ivalue);
+    }
+    else if (val.compare(0, 4, "set ") == 0)
+    {
+        c.cmd = CmdSet;
+        from_string(val.substr(4), c.ivalue);
+    }
+    else if (val.compare(0, 3, "up ") == 0)
+    {
+        c.cmd = CmdUpPercent;
+        from_string(val.substr(3), c.ivalue);
+    }
+    else if (val.compare(0, 5, "down ") == 0)
+    {
+        c.cmd = CmdDownPercent;
+        from_string(val.substr(5), c.ivalue);
+    }
+    else if (val == "calibrate")
+        c.cmd = CmdCalibrate;
+    else if (Utils::strStartsWith(val, "set_state "))
+    {
+        c.arg = val.substr(10);
+
+        if (Utils::is_of_type<int>(c.arg))
+        {
+            c.cmd = CmdSetState;
+            Utils::from_string(c.arg, c.ivalue);
+            if (c.ivalue < 0) c.ivalue = 0;
+            if (c.ivalue > 100) c.ivalue = 100;
+        }
+        else
+            c.cmd = CmdNone;
+    }
+    else
+        c.cmd = CmdInvalid;
+
+    return c;
+}
+
 bool OutputShutterSmart::set_value(std::string val)
+{
+    return execCommand(parseCommand(val));
+}
+
+bool OutputShutterSmart::execCommand(const OutputCommand &c)
 {
     if (!isEnabled()) return true;
 
-    cInfoDom("output") << "OutputShutterSmart(" << get_param("id") << "): got action, " << val;
+    cInfoDom("output") << "OutputShutterSmart(" << get_param("id") << "): got action, " << c.action;
 
     if (calibrate) return false;
 
@@ -113,80 +177,57 @@ bool OutputShutterSmart::set_value(std::string val)
 
     is_impulse_action = false;
 
-    if (val == "up")
+    switch (c.cmd)
     {
+    case CmdUp:
         UpWait();
-    }
-    else if (val == "down")
-    {
+        break;
+    case CmdDown:
         DownWait();
-    }
-    else if (val == "toggle")
-    {
+        break;
+    case CmdToggle:
         Toggle();
-    }
-    else if (val == "stop")
-    {
+        break;
+    case CmdStop:
         Stop();
-    }
-    else if (val.compare(0, 11, "impulse up ") == 0)
-    {
-        val.erase(0, 11);
-        int v;
-        from_string(val, v);
-        ImpulseUp(v);
-    }
-    else if (val.compare(0, 13, "impulse down ") == 0)
+        break;
+    case CmdImpulseUp:
+        ImpulseUp(c.ivalue);
+        break;
+    case CmdImpulseDown:
+        ImpulseDown(c.ivalue);
+        break;
+    case CmdSet:
     {
-        val.erase(0, 11);
-        int v;
-        from_string(val, v);
-        ImpulseDown(v);
-    }
-    else if (val.compare(0, 4, "set ") == 0)
-    {
-        val.erase(0, 4);
-        int percent;
-        double new_position;
-        from_string(val, percent);
-
-        cmd_state = "set " + Utils::to_string(percent);
+        cmd_state = "set " + Utils::to_string(c.ivalue);
 
-        new_position = (double)percent * (double)time_up / 100.;
+        double new_position = (double)c.ivalue * (double)time_up / 100.;
 
         if (new_position < readPosition())
             Up(new_position);
         else if (new_position > readPosition())
             Down(new_position);
+        break;
     }
-    else if (val.compare(0, 3, "up ") == 0)
+    case CmdUpPercent:
     {
-        val.erase(0, 3);
-        int percent;
-        double new_position;
-        from_string(val, percent);
-
-        cmd_state = "up " + Utils::to_string(percent);
+        cmd_state = "up " + Utils::to_string(c.ivalue);
 
-        new_position = (double)percent * (double)time_up / 100.;
+        double new_position = (double)c.ivalue * (double)time_up / 100.;
 
         Up(readPosition() - new_position);
+        break;
     }
-    else if (val.compare(0, 5, "down ") == 0)
+    case CmdDownPercent:
     {
-        val.erase(0, 5);
-        int percent;
-        double new_position;
-        from_string(val, percent);
-
-        cmd_state = "down " + Utils::to_string(percent);
+        cmd_state = "down " + Utils::to_string(c.ivalue);
 
-        new_position = (double)percent * (double)time_up / 100.;
+        double new_position = (double)c.ivalue * (double)time_up / 100.;
 
         Down(readPosition() + new_position);
+        break;
     }
-    else if (val == "calibrate")
-    {
+    case CmdCalibrate:
         calibrate = true;
 
         setOutputUp(true);
@@ -201,26 +242,21 @@ bool OutputShutterSmart::set_value(std::string val)
 
         timer_calib = new EcoreTimer((double)total_time,
                                      (sigc::slot<void>)sigc::mem_fun(*this, &OutputShutterSmart::TimerCalibrate) );
-    }
-    else if (Utils::strStartsWith(val, "set_state "))
+        break;
+    case CmdSetState:
     {
-        val.erase(0, 10);
+        cmd_state = "set " + Utils::to_string(c.ivalue);
 
-        if (Utils::is_of_type<int>(val))
-        {
-            int percent;
-            Utils::from_string(val, percent);
-            if (percent < 0) percent = 0;
-            if (percent > 100) percent = 100;
-            cmd_state = "set " + Utils::to_string(percent);
-
-            double new_position = (double)percent * (double)time_up / 100.;
-            writePosition(new_position);
-            sens = VSTOP;
-        }
+        double new_position = (double)c.ivalue * (double)time_up / 100.;
+        writePosition(new_position);
+        sens = VSTOP;
+        break;
     }
-    else
+    case CmdNone:
+        break;
+    default:
         return false;
+    }
 
     EmitSignalOutput();
 
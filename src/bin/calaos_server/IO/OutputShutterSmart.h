@@ -86,6 +86,12 @@ protected:
     virtual double readPosition();
     virtual void writePosition(double p);
 
+    enum
+    {
+        CmdInvalid = 1, CmdNone, CmdUp, CmdDown, CmdToggle, CmdStop, CmdImpulseUp, CmdImpulseDown,
+        CmdSet, CmdUpPercent, CmdDownPercent, CmdCalibrate, CmdSetState,
+    };
+
 public:
     OutputShutterSmart(Params &p);
     ~OutputShutterSmart();
@@ -96,6 +102,9 @@ public:
     virtual std::string get_value_string();
     virtual double get_value_double() { return (int)(readPosition() * 100. / (double)time_up); }
 
+    virtual OutputCommand parseCommand(const std::string &val);
+    virtual bool execCommand(const OutputCommand &c);
+
     virtual std::string get_command_string() { return cmd_state; }
 
     virtual bool check_condition_value(string cvalue, bool equal);
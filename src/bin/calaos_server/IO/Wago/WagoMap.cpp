@@ -30,12 +30,19 @@ static Eina_Bool _ecore_con_handler_data_get(void *data, int type, Ecore_Con_Eve
 
 WagoMapManager WagoMap::wagomaps;
 
+static bool isReadCommand(int command)
+{
+    return command == MBUS_READ_BITS || command == MBUS_READ_OUTBITS ||
+           command == MBUS_READ_WORDS || command == MBUS_READ_OUTWORDS;
+}
+
 WagoMap::WagoMap(std::string h, int p):
     host(h),
     port(p),
     quit_thread(false),
+    wago(NULL),
+    mbus_job_running(false),
     mutex_queue(false),
-    mutex_lock(false),
     udp_timer(NULL),
     udp_timeout_timer(NULL),
     econ(NULL)
@@ -45,6 +52,11 @@ WagoMap::WagoMap(std::string h, int p):
     input_words.resize(MBUS_MAX_WORDS, 0);
     output_words.resize(MBUS_MAX_WORDS, 0);
 
+    input_bits_time.resize(MBUS_MAX_BITS, 0.0);
+    output_bits_time.resize(MBUS_MAX_BITS, 0.0);
+    input_words_time.resize(MBUS_MAX_WORDS, 0.0);
+    output_words_time.resize(MBUS_MAX_WORDS, 0.0);
+
     sigIPC.connect(sigc::mem_fun(*this, &WagoMap::IPCCallbacks));
     IPC::Instance().AddHandler("WagoMap", "*", sigIPC, NULL);
 
@@ -59,15 +71,12 @@ WagoMap::WagoMap(std::string h, int p):
     heartbeat_timer = new EcoreTimer(0.1, (sigc::slot<void>)sigc::mem_fun(*this, &WagoMap::WagoHeartBeatTick));
     mbus_heartbeat_timer = new EcoreTimer(10.0, (sigc::slot<void>)sigc::mem_fun(*this, &WagoMap::WagoModbusHeartBeatTick));
 
-    Start();
-
     cInfoDom("wago") << host << "," << port;
 }
 
 WagoMap::~WagoMap()
 {
     quit_thread = true;
-    mutex_lock.condition_wake();
 
     ecore_event_handler_del(event_handler_data_get);
     ecore_con_server_del(econ);
@@ -75,7 +84,14 @@ WagoMap::~WagoMap()
     delete heartbeat_timer;
     delete mbus_heartbeat_timer;
 
-    End();
+    //wait for the command being sent, the others are dropped
+    if (mbus_job)
+    {
+        mbus_job->cancel();
+        mbus_job->wait();
+    }
+
+    delete wago;
 
     cInfoDom("wago");
 }
@@ -119,9 +135,35 @@ void WagoMap::IPCCallbacks(string source, string emission, void *listener_data,
 {
     if (source != "WagoMap") return;
 
+    if (emission == "mbus,read,batch")
+    {
+        //results of all reads merged by processReads()
+        vector<WagoMapCmd> *cmds = reinterpret_cast<vector<WagoMapCmd> *>(sender_data);
+        if (!cmds) return;
+
+        for (WagoMapCmd &cmd: *cmds)
+        {
+            switch (cmd.command)
+            {
+            case MBUS_READ_BITS: emitCommandResult("mbus,read,bits", &cmd); break;
+            case MBUS_READ_OUTBITS: emitCommandResult("mbus,read,outbits", &cmd); break;
+            case MBUS_READ_WORDS: emitCommandResult("mbus,read,words", &cmd); break;
+            case MBUS_READ_OUTWORDS: emitCommandResult("mbus,read,outwords", &cmd); break;
+            default: break;
+            }
+        }
+
+        return;
+    }
+
     WagoMapCmd *cmd = reinterpret_cast<WagoMapCmd *>(sender_data);
     if (!cmd) return;
 
+    emitCommandResult(emission, cmd);
+}
+
+void WagoMap::emitCommandResult(string emission, WagoMapCmd *cmd)
+{
     if (emission == "mbus,read,bits")
     {
         MultiBits_signal sig;
@@ -276,183 +318,344 @@ void WagoMap::queueAndSendCommand(WagoMapCmd cmd)
 {
     mutex_queue.lock();
     mbus_commands.push(cmd);
+    bool start = !mbus_job_running;
+    mbus_job_running = true;
     mutex_queue.unlock();
 
-    mutex_lock.condition_wake();
+    if (start)
+        mbus_job = WorkerPool::Instance().Run([this](WorkerJob &job) { processCommands(job); });
 }
 
-void WagoMap::ThreadProc()
+void WagoMap::processCommands(WorkerJob &job)
 {
-    WagoCtrl wago(host, port);
+    if (!wago)
+        wago = new WagoCtrl(host, port);
 
     while (true)
     {
-        mutex_queue.lock();
-        int queue_count = mbus_commands.size();
-        mutex_queue.unlock();
-
-        if (queue_count <= 0)
-            mutex_lock.condition_wait();
+        if (quit_thread || job.isCancelled())
+            break;
 
-        if (quit_thread)
+        mutex_queue.lock();
+        if (mbus_commands.size() <= 0)
+        {
+            //the next command will start a new job
+            mbus_job_running = false;
+            mutex_queue.unlock();
             break;
+        }
+        mutex_queue.unlock();
 
-        if (!wago.is_connected())
+        if (!wago->is_connected())
         {
             cDebugDom("wago") << "Connecting to " << host;
-            wago.Connect();
+            wago->Connect();
         }
 
         mutex_queue.lock();
-        if (mbus_commands.size() <= 0)
+        WagoMapCmd cmd = mbus_commands.front();
+        mbus_commands.pop();
+
+        if (isReadCommand(cmd.command))
         {
+            //Take all reads queued after this one, up to the first write so
+            //that a read queued after a write still gets the new value
+            vector<WagoMapCmd> reads;
+            reads.push_back(cmd);
+            while (!mbus_commands.empty() && isReadCommand(mbus_commands.front().command))
+            {
+                reads.push_back(mbus_commands.front());
+                mbus_commands.pop();
+            }
             mutex_queue.unlock();
+
+            processReads(*wago, reads);
+
             continue;
         }
-        WagoMapCmd cmd = mbus_commands.front();
-        mbus_commands.pop();
+
         mutex_queue.unlock();
 
+        //values of the image may change after a write
+        invalidateImage();
+
         switch(cmd.command)
         {
-        case MBUS_READ_BITS:
+        case MBUS_WRITE_BIT:
         {
             cmd.status = true;
-            if (!wago.read_bits(cmd.address, cmd.count, cmd.values_bits))
+            if (!wago->write_single_bit(cmd.address, cmd.value_bit))
             {
                 cDebugDom("wago") << "MBUS, reconnecting to " << host;
-                wago.Connect();
-                if (!wago.read_bits(cmd.address, cmd.count, cmd.values_bits))
+                wago->Connect();
+                if (!wago->write_single_bit(cmd.address, cmd.value_bit))
                 {
                     cmd.status = false;
                     cDebugDom("wago") << "MBUS, failed to send request";
                 }
             }
 
-            IPC::Instance().SendEvent("WagoMap", "mbus,read,bits", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
+            IPC::Instance().SendEvent("WagoMap", "mbus,write,bit", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
         }
             break;
-        case MBUS_READ_OUTBITS:
+        case MBUS_WRITE_BITS:
         {
             cmd.status = true;
-            if (!wago.read_bits(cmd.address + 0x200, cmd.count, cmd.values_bits))
+            if (!wago->write_multiple_bits(cmd.address, cmd.count, cmd.values_bits))
             {
                 cDebugDom("wago") << "MBUS, reconnecting to " << host;
-                wago.Connect();
-                if (!wago.read_bits(cmd.address + 0x200, cmd.count, cmd.values_bits))
+                wago->Connect();
+                if (!wago->write_multiple_bits(cmd.address, cmd.count, cmd.values_bits))
                 {
                     cmd.status = false;
                     cDebugDom("wago") << "MBUS, failed to send request";
                 }
             }
 
-            IPC::Instance().SendEvent("WagoMap", "mbus,read,outbits", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
+            IPC::Instance().SendEvent("WagoMap", "mbus,write,bits", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
         }
             break;
-        case MBUS_WRITE_BIT:
+        case MBUS_WRITE_WORD:
         {
             cmd.status = true;
-            if (!wago.write_single_bit(cmd.address, cmd.value_bit))
+            if (!wago->write_single_word(cmd.address, cmd.value_word))
             {
                 cDebugDom("wago") << "MBUS, reconnecting to " << host;
-                wago.Connect();
-                if (!wago.write_single_bit(cmd.address, cmd.value_bit))
+                wago->Connect();
+                if (!wago->write_single_word(cmd.address, cmd.value_word))
                 {
                     cmd.status = false;
-                    cDebugDom("wago") << "MBUS, failed to send request";
+                    cDebugDom("wago") << "WagoMap: MBUS, failed to send request";
                 }
             }
 
-            IPC::Instance().SendEvent("WagoMap", "mbus,write,bit", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
+            IPC::Instance().SendEvent("WagoMap", "mbus,write,word", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
         }
             break;
-        case MBUS_WRITE_BITS:
+        case MBUS_WRITE_WORDS:
         {
             cmd.status = true;
-            if (!wago.write_multiple_bits(cmd.address, cmd.count, cmd.values_bits))
+            if (!wago->write_multiple_words(cmd.address, cmd.count, cmd.values_words))
             {
-                cDebugDom("wago") << "MBUS, reconnecting to " << host;
-                wago.Connect();
-                if (!wago.write_multiple_bits(cmd.address, cmd.count, cmd.values_bits))
+                cDebugDom("wago") << "WagoMap: MBUS, reconnecting to " << host;
+                wago->Connect();
+                if (!wago->write_multiple_words(cmd.address, cmd.count, cmd.values_words))
                 {
                     cmd.status = false;
                     cDebugDom("wago") << "MBUS, failed to send request";
                 }
             }
 
-            IPC::Instance().SendEvent("WagoMap", "mbus,write,bits", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
+            IPC::Instance().SendEvent("WagoMap", "mbus,write,words", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
         }
             break;
-        case MBUS_READ_WORDS:
+        }
+    }
+}
+
+void WagoMap::processReads(WagoCtrl &wago, vector<WagoMapCmd> &reads)
+{
+    double now = ecore_time_get();
+    int requests = 0;
+
+    for (int command: { MBUS_READ_BITS, MBUS_READ_OUTBITS, MBUS_READ_WORDS, MBUS_READ_OUTWORDS })
+    {
+        bool is_bits = command == MBUS_READ_BITS || command == MBUS_READ_OUTBITS;
+        int gap = is_bits?MBUS_COALESCE_GAP_BITS:MBUS_COALESCE_GAP_WORDS;
+        int max_count = is_bits?MBUS_MAX_READ_BITS:MBUS_MAX_READ_WORDS;
+
+        //reads that can't be served from the image
+        vector<WagoMapCmd *> pending;
+        for (WagoMapCmd &cmd: reads)
         {
+            if (cmd.command != command) continue;
+
             cmd.status = true;
-            if (!wago.read_words(cmd.address, cmd.count, cmd.values_words))
-            {
-                cDebugDom("wago") << "MBUS, reconnecting to " << host;
-                wago.Connect();
-                if (!wago.read_words(cmd.address, cmd.count, cmd.values_words))
-                {
-                    cmd.status = false;
-                    cDebugDom("wago") << "MBUS, failed to send request";
-                }
-            }
+            cmd.values_bits.clear();
+            cmd.values_words.clear();
 
-            IPC::Instance().SendEvent("WagoMap", "mbus,read,words", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
+            if (!readFromImage(cmd, now))
+                pending.push_back(&cmd);
         }
-            break;
-        case MBUS_READ_OUTWORDS:
+
+        std::sort(pending.begin(), pending.end(), [](WagoMapCmd *a, WagoMapCmd *b)
         {
-            cmd.status = true;
-            if (!wago.read_words(cmd.address + 0x200, cmd.count, cmd.values_words))
+            return a->address < b->address;
+        });
+
+        uint i = 0;
+        while (i < pending.size())
+        {
+            //merge the following reads into one range
+            int start = pending[i]->address;
+            int end = start + pending[i]->count;
+            uint j = i + 1;
+            while (j < pending.size() &&
+                   pending[j]->address <= end + gap &&
+                   std::max(end, pending[j]->address + pending[j]->count) - start <= max_count)
             {
-                cDebugDom("wago") << "MBUS, reconnecting to " << host;
-                wago.Connect();
-                if (!wago.read_words(cmd.address + 0x200, cmd.count, cmd.values_words))
-                {
-                    cmd.status = false;
-                    cDebugDom("wago") << "MBUS, failed to send request";
-                }
+                end = std::max(end, pending[j]->address + pending[j]->count);
+                j++;
             }
 
-            IPC::Instance().SendEvent("WagoMap", "mbus,read,outwords", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
-        }
-            break;
-        case MBUS_WRITE_WORD:
-        {
-            cmd.status = true;
-            if (!wago.write_single_word(cmd.address, cmd.value_word))
+            vector<bool> bits;
+            vector<UWord> words;
+            requests++;
+
+            bool ok = readRange(wago, command, start, end - start, bits, words);
+            if (ok && (is_bits?bits.size():words.size()) < (size_t)(end - start))
+                ok = false;
+
+            if (ok)
             {
-                cDebugDom("wago") << "MBUS, reconnecting to " << host;
-                wago.Connect();
-                if (!wago.write_single_word(cmd.address, cmd.value_word))
+                updateImage(command, start, end - start, bits, words, now);
+
+                for (uint k = i;k < j;k++)
                 {
-                    cmd.status = false;
-                    cDebugDom("wago") << "WagoMap: MBUS, failed to send request";
+                    WagoMapCmd *cmd = pending[k];
+                    int offset = cmd->address - start;
+
+                    if (is_bits)
+                        cmd->values_bits.assign(bits.begin() + offset, bits.begin() + offset + cmd->count);
+                    else
+                        cmd->values_words.assign(words.begin() + offset, words.begin() + offset + cmd->count);
                 }
             }
-
-            IPC::Instance().SendEvent("WagoMap", "mbus,write,word", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
-        }
-            break;
-        case MBUS_WRITE_WORDS:
-        {
-            cmd.status = true;
-            if (!wago.write_multiple_words(cmd.address, cmd.count, cmd.values_words))
+            else if (j - i > 1)
             {
-                cDebugDom("wago") << "WagoMap: MBUS, reconnecting to " << host;
-                wago.Connect();
-                if (!wago.write_multiple_words(cmd.address, cmd.count, cmd.values_words))
+                //the merged range may cover addresses the PLC refuses, read them one by one
+                for (uint k = i;k < j;k++)
                 {
-                    cmd.status = false;
-                    cDebugDom("wago") << "MBUS, failed to send request";
+                    WagoMapCmd *cmd = pending[k];
+                    requests++;
+
+                    cmd->status = readRange(wago, command, cmd->address, cmd->count, cmd->values_bits, cmd->values_words);
+                    if (cmd->status)
+                        updateImage(command, cmd->address, cmd->count, cmd->values_bits, cmd->values_words, now);
                 }
             }
+            else
+            {
+                pending[i]->status = false;
+            }
 
-            IPC::Instance().SendEvent("WagoMap", "mbus,write,words", IPCData(new WagoMapCmd(cmd), new DeletorT<WagoMapCmd *>), true);
+            i = j;
         }
-            break;
+    }
+
+    cDebugDom("wago") << reads.size() << " reads done with " << requests << " modbus requests";
+
+    IPC::Instance().SendEvent("WagoMap", "mbus,read,batch", IPCData(new vector<WagoMapCmd>(reads), new DeletorT<vector<WagoMapCmd> *>), true);
+}
+
+bool WagoMap::readRange(WagoCtrl &wago, int command, UWord address, int count, vector<bool> &bits, vector<UWord> &words)
+{
+    for (int retry = 0;retry < 2;retry++)
+    {
+        bool ret = false;
+
+        bits.clear();
+        words.clear();
+
+        switch (command)
+        {
+        case MBUS_READ_BITS: ret = wago.read_bits(address, count, bits); break;
+        case MBUS_READ_OUTBITS: ret = wago.read_bits(address + 0x200, count, bits); break;
+        case MBUS_READ_WORDS: ret = wago.read_words(address, count, words); break;
+        case MBUS_READ_OUTWORDS: ret = wago.read_words(address + 0x200, count, words); break;
+        default: break;
         }
+
+        if (ret)
+            return true;
+
+        if (retry == 0)
+        {
+            cDebugDom("wago") << "MBUS, reconnecting to " << host;
+            wago.Connect();
+        }
+    }
+
+    cDebugDom("wago") << "MBUS, failed to send request";
+
+    return false;
+}
+
+bool WagoMap::readFromImage(WagoMapCmd &cmd, double now)
+{
+    vector<double> *times;
+    bool is_bits = true;
+
+    switch (cmd.command)
+    {
+    case MBUS_READ_BITS: times = &input_bits_time; break;
+    case MBUS_READ_OUTBITS: times = &output_bits_time; break;
+    case MBUS_READ_WORDS: times = &input_words_time; is_bits = false; break;
+    case MBUS_READ_OUTWORDS: times = &output_words_time; is_bits = false; break;
+    default: return false;
+    }
+
+    if (cmd.count <= 0 || cmd.address + cmd.count > (int)times->size())
+        return false;
+
+    for (int i = cmd.address;i < cmd.address + cmd.count;i++)
+    {
+        if (now - (*times)[i] > MBUS_IMAGE_MAX_AGE)
+            return false;
+    }
+
+    if (is_bits)
+    {
+        vector<bool> &image = cmd.command == MBUS_READ_BITS?input_bits:output_bits;
+        cmd.values_bits.assign(image.begin() + cmd.address, image.begin() + cmd.address + cmd.count);
     }
+    else
+    {
+        vector<UWord> &image = cmd.command == MBUS_READ_WORDS?input_words:output_words;
+        cmd.values_words.assign(image.begin() + cmd.address, image.begin() + cmd.address + cmd.count);
+    }
+
+    return true;
+}
+
+void WagoMap::updateImage(int command, UWord address, int count, vector<bool> &bits, vector<UWord> &words, double now)
+{
+    switch (command)
+    {
+    case MBUS_READ_BITS:
+    case MBUS_READ_OUTBITS:
+    {
+        vector<bool> &image = command == MBUS_READ_BITS?input_bits:output_bits;
+        vector<double> &times = command == MBUS_READ_BITS?input_bits_time:output_bits_time;
+        for (int i = 0;i < count && i < (int)bits.size() && address + i < (int)image.size();i++)
+        {
+            image[address + i] = bits[i];
+            times[address + i] = now;
+        }
+        break;
+    }
+    case MBUS_READ_WORDS:
+    case MBUS_READ_OUTWORDS:
+    {
+        vector<UWord> &image = command == MBUS_READ_WORDS?input_words:output_words;
+        vector<double> &times = command == MBUS_READ_WORDS?input_words_time:output_words_time;
+        for (int i = 0;i < count && i < (int)words.size() && address + i < (int)image.size();i++)
+        {
+            image[address + i] = words[i];
+            times[address + i] = now;
+        }
+        break;
+    }
+    default: break;
+    }
+}
+
+void WagoMap::invalidateImage()
+{
+    std::fill(input_bits_time.begin(), input_bits_time.end(), 0.0);
+    std::fill(output_bits_time.begin(), output_bits_time.end(), 0.0);
+    std::fill(input_words_time.begin(), input_words_time.end(), 0.0);
+    std::fill(output_words_time.begin(), output_words_time.end(), 0.0);
 }
 
 Eina_Bool _ecore_con_handler_data_get(void *data, int type, Ecore_Con_Event_Server_Data *ev)
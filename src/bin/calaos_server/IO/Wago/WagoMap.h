@@ -22,7 +22,7 @@
 #define S_WAGOMAP_H
 
 #include <Calaos.h>
-#include <CThread.h>
+#include <WorkerPool.h>
 #include <Mutex.h>
 #include <mbus.h>
 #include <EcoreTimer.h>
@@ -53,6 +53,15 @@ enum { MBUS_NONE = 0, MBUS_READ_BITS, MBUS_READ_OUTBITS, MBUS_WRITE_BIT, MBUS_WR
 #define MBUS_MAX_BITS   512
 #define MBUS_MAX_WORDS  512
 
+//Queued reads are merged into one request when the addresses are closer than this
+#define MBUS_COALESCE_GAP_BITS          64
+#define MBUS_COALESCE_GAP_WORDS         16
+//Modbus limits for one read request
+#define MBUS_MAX_READ_BITS              2000
+#define MBUS_MAX_READ_WORDS             125
+//Values of the process image younger than this (in s) are used without a new request
+#define MBUS_IMAGE_MAX_AGE              0.1
+
 class WagoMapSignals: public sigc::trackable
 {
 public:
@@ -102,6 +111,7 @@ public:
 };
 
 class WagoMap;
+class WagoCtrl;
 class WagoMapManager
 {
 public:
@@ -114,28 +124,51 @@ public:
     vector<WagoMap *> maps;
 };
 
-class WagoMap: public CThread
+class WagoMap
 {
 
 protected:
     std::string host;
     int port;
 
-    bool quit_thread;
+    std::atomic<bool> quit_thread;
+
+    //Modbus commands are run by a job of the worker pool. Only one job runs
+    //at a time for a PLC, it ends when the queue is empty.
+    WagoCtrl *wago;
+    WorkerJobPtr mbus_job;
+    bool mbus_job_running; //protected by mutex_queue
 
+    void processCommands(WorkerJob &job);
+
+    //Shadow of the PLC process image, only used by the modbus job.
+    //Reads are served from here when the values are recent enough
     vector<bool> input_bits;
     vector<bool> output_bits;
 
     vector<UWord> input_words;
     vector<UWord> output_words;
 
+    //time of the last refresh of each value of the image
+    vector<double> input_bits_time;
+    vector<double> output_bits_time;
+    vector<double> input_words_time;
+    vector<double> output_words_time;
+
+    void processReads(WagoCtrl &wago, vector<WagoMapCmd> &reads);
+    bool readFromImage(WagoMapCmd &cmd, double now);
+    bool readRange(WagoCtrl &wago, int command, UWord address, int count, vector<bool> &bits, vector<UWord> &words);
+    void updateImage(int command, UWord address, int count, vector<bool> &bits, vector<UWord> &words, double now);
+    void invalidateImage();
+
+    void emitCommandResult(string emission, WagoMapCmd *cmd);
+
     WagoMap(std::string host, int port);
 
     static WagoMapManager wagomaps;
 
     queue<WagoMapCmd> mbus_commands;
     Mutex mutex_queue;
-    Mutex mutex_lock;
     sigc::signal<void, string, string, void *, void *> sigIPC;
 
     /* Heartbeat timer that do a modbus query to avoid TCP disconnection with the Wago */
@@ -191,8 +224,6 @@ public:
 
     /* Private stuff used by C callbacks */
     void udpRequest_cb(bool status, string res);
-
-    virtual void ThreadProc();
 };
 
 }
@@ -44,6 +44,7 @@ public:
     //Standard IPCam functions.
     std::string get_mpeg_stream(); //return the mpeg4 url stream (if any)
     std::string get_mjpeg_stream(); //return the mpeg url stream
+    std::string get_mjpeg_stream_real() { return get_mjpeg_stream(); }
     std::string get_picture(); //return the url for a single frame
 
     virtual void activateCapabilities(std::string capability, std::string cmd, std::string value);
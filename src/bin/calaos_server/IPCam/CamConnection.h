@@ -22,44 +22,66 @@
 #define S_CamConnection_H
 
 #include <Calaos.h>
-#include <CThread.h>
+#include <WorkerPool.h>
 #include <tcpsocket.h>
 #include <CamManager.h>
 #include <IPCam.h>
-#include <curl/curl.h>
+#include <CamFrameProducer.h>
 
 namespace Calaos
 {
 
-class CamConnection: public CThread
+//Maximum number of workers used by the camera clients at once. Their jobs
+//block on slow clients and on cameras, the other workers are kept for the
+//rest of calaos_server (Modbus, iostates, ...)
+#define CAM_MAX_WORKERS         2
+
+/*
+ * A client of the IPCam relay. The request is read and answered by jobs of
+ * the worker pool: a snapshot is sent by one job, a stream sends the frames
+ * from a job started when the producer has a new frame. Connections don't
+ * keep a thread while they wait for frames.
+ */
+class CamConnection: public std::enable_shared_from_this<CamConnection>
 {
 protected:
 
     TCPSocket socket;
-    bool end_conn; //fin de connexion
-    bool login;
-    bool quit;
+    std::atomic<bool> end_conn; //fin de connexion
+    std::atomic<bool> quit;
+
+    bool streaming = false;
+    bool header_sent = false;
+    CamFrameProducer *producer = nullptr;
+    int viewer_id = -1;
+    uint64_t seq = 0;
 
-    char *pict_buffer;
-    unsigned long int pict_size;
+    //only one job sends frames at a time, again is set when a frame came
+    //while sending. sending is set until the stream is started
+    std::atomic<bool> sending;
+    std::atomic<bool> again;
 
+    void readRequest();
     void ProcessRequest(string &request);
 
+    void frameReady();
+    void sendLoop();
+    bool sendFrame(CamFrame &frame);
+
+    void close();
+
+    static WorkerGroup workerGroup;
+
 public:
     CamConnection(TCPSocket socket); //socket to read from
     ~CamConnection();
 
-    virtual void ThreadProc(); //redefined
+    //Read the request from a worker
+    void Start();
 
     bool get_end() { return end_conn; }
 
     void Clean();
-
-    //Lib CURL stuff
-    char *get_buffer() { return pict_buffer; }
-    void set_buffer(char *b) { pict_buffer = b; }
-    unsigned long int get_size() { return pict_size; }
-    void set_size(unsigned long int s) { pict_size = s; }
 };
 
 }
@@ -0,0 +1,408 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <CamFrameProducer.h>
+#include <Ecore.h>
+
+using namespace Calaos;
+
+Mutex CamFrameProducer::producersMutex;
+map<IPCam *, CamFrameProducer *> CamFrameProducer::producers;
+
+static size_t _CamFrameProducer_poll_callback(void *buffer, size_t size, size_t nmemb, void *data);
+
+CamFrameProducer::CamFrameProducer(IPCam *cam):
+    camera(cam),
+    quit(false)
+{
+    cDebugDom("network");
+}
+
+CamFrameProducer::~CamFrameProducer()
+{
+    cDebugDom("network");
+}
+
+CamFrameProducer *CamFrameProducer::Acquire(IPCam *camera)
+{
+    producersMutex.lock();
+
+    CamFrameProducer *producer;
+    auto it = producers.find(camera);
+    if (it != producers.end())
+        producer = it->second;
+    else
+    {
+        producer = new CamFrameProducer(camera);
+        producers[camera] = producer;
+        producer->Start();
+    }
+    producer->viewers++;
+
+    cDebugDom("network") << "Camera " << camera->get_param("id") << " has " << producer->viewers << " viewers";
+
+    producersMutex.unlock();
+
+    return producer;
+}
+
+void CamFrameProducer::Release(CamFrameProducer *producer)
+{
+    producersMutex.lock();
+
+    producer->viewers--;
+    bool last = producer->viewers <= 0;
+    if (last)
+    {
+        producers.erase(producer->camera);
+        producer->quit = true;
+    }
+
+    producersMutex.unlock();
+
+    if (last)
+    {
+        cDebugDom("network") << "No more viewers for camera " << producer->camera->get_param("id");
+
+        producer->End();
+        delete producer;
+    }
+}
+
+CamFrame CamFrameProducer::waitFrame(uint64_t &seq, double timeout)
+{
+    CamFrame f;
+    double end = ecore_time_get() + timeout;
+
+    mutex.lock();
+
+    while (frame_seq <= seq && !failed)
+    {
+        double left = end - ecore_time_get();
+        if (left <= 0.0) break;
+        mutex.condition_wait(left);
+    }
+
+    if (frame_seq > seq && frame)
+    {
+        f = frame;
+        seq = frame_seq;
+    }
+
+    mutex.unlock();
+
+    return f;
+}
+
+CamFrame CamFrameProducer::getSnapshot(double max_age)
+{
+    uint64_t seq;
+
+    mutex.lock();
+    if (frame && ecore_time_get() - frame_time <= max_age)
+    {
+        CamFrame f = frame;
+        mutex.unlock();
+
+        return f;
+    }
+    seq = frame_seq;
+    mutex.unlock();
+
+    return waitFrame(seq);
+}
+
+CamFrame CamFrameProducer::getFrame(uint64_t &seq)
+{
+    CamFrame f;
+
+    mutex.lock();
+    if (frame_seq > seq && frame)
+    {
+        f = frame;
+        seq = frame_seq;
+    }
+    mutex.unlock();
+
+    return f;
+}
+
+bool CamFrameProducer::hasFailed()
+{
+    mutex.lock();
+    bool f = failed;
+    mutex.unlock();
+
+    return f;
+}
+
+int CamFrameProducer::addViewer(std::function<void ()> cb)
+{
+    mutex.lock();
+    int id = viewer_next_id++;
+    viewer_callbacks[id] = cb;
+    mutex.unlock();
+
+    return id;
+}
+
+void CamFrameProducer::removeViewer(int id)
+{
+    mutex.lock();
+    viewer_callbacks.erase(id);
+    mutex.unlock();
+}
+
+void CamFrameProducer::notifyViewers()
+{
+    //callbacks are called unlocked, they can read the frame
+    mutex.lock();
+    vector<std::function<void ()>> callbacks;
+    callbacks.reserve(viewer_callbacks.size());
+    for (auto &it: viewer_callbacks)
+        callbacks.push_back(it.second);
+    mutex.unlock();
+
+    for (uint i = 0;i < callbacks.size();i++)
+        callbacks[i]();
+}
+
+void CamFrameProducer::pushFrame(string &data)
+{
+    const unsigned char *buf = (const unsigned char *)data.data();
+
+    //Some camera send empty or broken pictures, skip them
+    if (data.size() < 4 ||
+        buf[0] != 0xFF || buf[1] != 0xD8 || buf[2] != 0xFF)
+    {
+        cDebugDom("network") << "Error in SOI !!";
+        return;
+    }
+
+    CamFrame f = std::make_shared<const string>(std::move(data));
+
+    mutex.lock();
+    frame = f;
+    frame_seq++;
+    frame_time = ecore_time_get();
+    failed = false;
+    mutex.condition_wake(true);
+    mutex.unlock();
+
+    notifyViewers();
+
+    stream_frames++;
+}
+
+void CamFrameProducer::setFailed()
+{
+    mutex.lock();
+    failed = true;
+    mutex.condition_wake(true);
+    mutex.unlock();
+
+    notifyViewers();
+}
+
+void CamFrameProducer::setupCurl(CURL *curl, const string &url)
+{
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    /* some servers don't like requests that are made without a user-agent
+       field, so we provide one */
+    if (camera->get_param("model") == "ICA-210")
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "");
+    else
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+    curl_easy_setopt(curl, CURLOPT_ENCODING, "identity");
+    curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 0);
+    curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 0);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
+}
+
+bool CamFrameProducer::runStream(CURL *curl, const string &url)
+{
+    setupCurl(curl, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)this);
+
+    //the stream never ends, abort only if it stalls
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 4);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 10);
+
+    stream_buffer.clear();
+    stream_frames = 0;
+
+    CURLcode res = curl_easy_perform(curl);
+
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 0);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 0);
+
+    if (!quit)
+        cDebugDom("network") << "mjpeg stream ended: " << curl_easy_strerror(res);
+
+    //The stream is usable if we got frames from it
+    return stream_frames > 0;
+}
+
+bool CamFrameProducer::pollFrame(CURL *curl, const string &url, string &data)
+{
+    setupCurl(curl, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _CamFrameProducer_poll_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&data);
+
+    //timeout for request
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 4); //4 seconds timeout
+
+    return curl_easy_perform(curl) == CURLE_OK;
+}
+
+static size_t findNoCase(const string &s, const char *pattern, size_t end)
+{
+    size_t len = strlen(pattern);
+    for (size_t i = 0;i + len <= end;i++)
+    {
+        if (strncasecmp(s.c_str() + i, pattern, len) == 0)
+            return i;
+    }
+
+    return string::npos;
+}
+
+void CamFrameProducer::parseStream()
+{
+    //The multipart stream is split on jpeg markers, the Content-Length
+    //of the part is used when the camera gives one
+    while (true)
+    {
+        size_t soi = stream_buffer.find("\xFF\xD8", 0, 2);
+        if (soi == string::npos)
+        {
+            //keep the last byte, it can be the start of a marker
+            if (stream_buffer.size() > 1)
+                stream_buffer.erase(0, stream_buffer.size() - 1);
+            return;
+        }
+
+        size_t frame_size = 0;
+        size_t cl = findNoCase(stream_buffer, "content-length:", soi);
+        if (cl != string::npos)
+            frame_size = strtoul(stream_buffer.c_str() + cl + 15, NULL, 10);
+
+        if (frame_size == 0)
+        {
+            size_t eoi = stream_buffer.find("\xFF\xD9", soi + 2, 2);
+            if (eoi == string::npos) break;
+            frame_size = eoi + 2 - soi;
+        }
+
+        if (stream_buffer.size() < soi + frame_size) break;
+
+        string data = stream_buffer.substr(soi, frame_size);
+        stream_buffer.erase(0, soi + frame_size);
+
+        pushFrame(data);
+    }
+
+    //something is wrong with this stream
+    if (stream_buffer.size() > 16 * 1024 * 1024)
+    {
+        cWarningDom("network") << "mjpeg stream buffer too big, dropping data";
+        stream_buffer.clear();
+    }
+}
+
+void CamFrameProducer::ThreadProc()
+{
+    CURL *curl = curl_easy_init();
+    if (!curl)
+    {
+        setFailed();
+        return;
+    }
+
+    cDebugDom("network") << "Start frame producer for camera " << camera->get_param("id");
+
+    bool use_stream = !camera->get_mjpeg_stream_real().empty();
+    string data;
+
+    while (!quit)
+    {
+        if (use_stream)
+        {
+            //reconnect if the stream was working
+            if (runStream(curl, camera->get_mjpeg_stream_real()) || quit)
+                continue;
+
+            cWarningDom("network") << "No frame from mjpeg stream of camera "
+                                   << camera->get_param("id") << ", polling pictures instead";
+            use_stream = false;
+        }
+
+        data.clear();
+
+        if (!pollFrame(curl, camera->get_picture_real(), data))
+        {
+            if (quit) break;
+
+            //wake up viewers, they will close their connection
+            setFailed();
+
+            for (int i = 0;i < 10 && !quit;i++)
+                usleep(100000);
+
+            continue;
+        }
+
+        //the frame is moved out, reserve for the next one
+        size_t last_size = data.size();
+        pushFrame(data);
+        data.reserve(last_size);
+    }
+
+    curl_easy_cleanup(curl);
+
+    cDebugDom("network") << "Frame producer stopped for camera " << camera->get_param("id");
+}
+
+//LibCURL callbacks
+size_t CamFrameProducer::streamCallback(void *buffer, size_t size, size_t nmemb, void *data)
+{
+    CamFrameProducer *producer = reinterpret_cast<CamFrameProducer *>(data);
+
+    //returning less than given aborts the transfer
+    if (producer->quit) return 0;
+
+    producer->stream_buffer.append((const char *)buffer, size * nmemb);
+    producer->parseStream();
+
+    return size * nmemb;
+}
+
+size_t _CamFrameProducer_poll_callback(void *buffer, size_t size, size_t nmemb, void *data)
+{
+    string *s = reinterpret_cast<string *>(data);
+    s->append((const char *)buffer, size * nmemb);
+
+    return size * nmemb;
+}
@@ -0,0 +1,120 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef S_CamFrameProducer_H
+#define S_CamFrameProducer_H
+
+#include <Calaos.h>
+#include <CThread.h>
+#include <Mutex.h>
+#include <IPCam.h>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <curl/curl.h>
+
+namespace Calaos
+{
+
+//A jpeg picture, shared by all viewers of a camera
+typedef std::shared_ptr<const string> CamFrame;
+
+//A snapshot request gets the last frame if it is not older than that
+#define CAM_FRAME_MAX_AGE       1.0
+
+//Viewers give up if no frame comes for that long
+#define CAM_FRAME_TIMEOUT       10.0
+
+/*
+ * Fetch the frames of one camera for all its viewers. The mjpeg stream of
+ * the camera is used if it has one, otherwise frames are polled one by one.
+ * Only the latest frame is kept, slow viewers skip the ones they missed.
+ * The thread is stopped when the last viewer leaves.
+ *
+ * Viewers can either block in waitFrame() or register a callback with
+ * addViewer() and read the frame with getFrame() when it is called.
+ */
+class CamFrameProducer: public CThread
+{
+public:
+    //Get the producer of a camera, start it if needed
+    static CamFrameProducer *Acquire(IPCam *camera);
+
+    //Stop watching, the producer is deleted with its last viewer
+    static void Release(CamFrameProducer *producer);
+
+    //Wait for a frame newer than seq, seq is set to the returned frame.
+    //Return null on timeout or if the camera can't be reached
+    CamFrame waitFrame(uint64_t &seq, double timeout = CAM_FRAME_TIMEOUT);
+
+    //Last frame if it is recent enough, or the next one
+    CamFrame getSnapshot(double max_age = CAM_FRAME_MAX_AGE);
+
+    //Latest frame if it is newer than seq, seq is set to the returned frame.
+    //Never blocks, return null if there is no new frame
+    CamFrame getFrame(uint64_t &seq);
+
+    //true if the camera can't be reached
+    bool hasFailed();
+
+    //cb is called from the producer thread for each new frame and when the
+    //camera fails, it must not block. Return an id for removeViewer().
+    //cb can still be called by a frame being pushed while removing it.
+    int addViewer(std::function<void ()> cb);
+    void removeViewer(int id);
+
+    virtual void ThreadProc(); //redefined
+
+private:
+    CamFrameProducer(IPCam *camera);
+    ~CamFrameProducer();
+
+    static Mutex producersMutex;
+    static map<IPCam *, CamFrameProducer *> producers;
+
+    IPCam *camera;
+    int viewers = 0; //protected by producersMutex
+    std::atomic<bool> quit;
+
+    Mutex mutex;
+    CamFrame frame;
+    uint64_t frame_seq = 0;
+    double frame_time = 0.0;
+    bool failed = false;
+    map<int, std::function<void ()>> viewer_callbacks;
+    int viewer_next_id = 0;
+
+    //data from the mjpeg stream not parsed yet
+    string stream_buffer;
+    int stream_frames = 0;
+
+    void setupCurl(CURL *curl, const string &url);
+    bool runStream(CURL *curl, const string &url);
+    bool pollFrame(CURL *curl, const string &url, string &data);
+    void parseStream();
+    void pushFrame(string &data);
+    void setFailed();
+    void notifyViewers();
+
+    static size_t streamCallback(void *buffer, size_t size, size_t nmemb, void *data);
+};
+
+}
+#endif
@@ -54,20 +54,19 @@ void CamServer::ThreadProc()
         cDebugDom("network") << "Got a connection from address "
                              << socket->GetRemoteIP();
 
-        vector<CamConnection *>::iterator iter = connections.begin();
-        for (uint i = 0;i < connections.size();iter++, i++)
-        {
-            //on supprime les connections qui sont finis
-            if (connections[i]->get_end())
-            {
-                delete connections[i];
-                connections.erase(iter);
-            }
-        }
+        auto connection = std::make_shared<CamConnection>(*socket);
 
-        CamConnection *connection = new CamConnection(*socket);
+        mutex_connections.lock();
+
+        //on supprime les connections qui sont finis
+        connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                         [](const std::shared_ptr<CamConnection> &c) { return c->get_end(); }),
+                          connections.end());
         connections.push_back(connection);
-        connection->Start(); //Start thread
+
+        mutex_connections.unlock();
+
+        connection->Start();
     }
 }
 
@@ -80,6 +79,8 @@ void CamServer::Clean()
         socket->Close();
     }
 
+    mutex_connections.lock();
     for(uint i = 0;i < connections.size();i++)
         connections[i]->Clean();
+    mutex_connections.unlock();
 }
@@ -23,18 +23,21 @@
 
 #include <Calaos.h>
 #include <CThread.h>
+#include <Mutex.h>
 #include <CamConnection.h>
 #include <tcpsocket.h>
 
 namespace Calaos
 {
 
+//The thread only accepts connections, they are served by the worker pool
 class CamServer: public CThread
 {
 protected:
     int port;
     TCPSocket *socket;
-    vector<CamConnection *> connections;
+    vector<std::shared_ptr<CamConnection>> connections;
+    Mutex mutex_connections;
     bool quit;
 
 public:
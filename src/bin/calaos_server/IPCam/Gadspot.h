@@ -42,6 +42,7 @@ public:
 
     //Standard IPCam functions.
     std::string get_mjpeg_stream(); //return the mpeg url stream
+    std::string get_mjpeg_stream_real() { return get_mjpeg_stream(); }
     std::string get_picture(); //return the url for a single frame
 };
 
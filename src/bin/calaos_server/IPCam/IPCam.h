@@ -53,6 +53,7 @@ public:
 
     //this is used for internal purpose (The CamServer relay)
     virtual std::string get_picture_real() { return get_picture(); } //return the real url for a single frame
+    virtual std::string get_mjpeg_stream_real() { return ""; } //return the real mjpeg url stream, empty if only frames are available
 
     //Capabilities
     /*************************************************
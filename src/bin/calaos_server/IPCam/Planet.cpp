@@ -130,6 +130,15 @@ std::string Planet::get_picture_real()
     return url;
 }
 
+std::string Planet::get_mjpeg_stream_real()
+{
+    //ICA-210 has no mjpeg stream, get_mjpeg_stream() is our relay
+    if (param["model"] == "ICA-210" || param["model"] == "ICA-210W")
+        return "";
+
+    return get_mjpeg_stream();
+}
+
 std::string Planet::get_picture()
 {
     std::string url;
@@ -48,6 +48,7 @@ public:
     virtual std::string get_mjpeg_stream(); //return the mpeg url stream
     virtual std::string get_picture(); //return the url for a single frame
     virtual std::string get_picture_real(); //return the real url for a single frame
+    virtual std::string get_mjpeg_stream_real(); //return the real mjpeg url stream
 
     virtual void activateCapabilities(std::string cap, std::string cmd, std::string value);
 };
@@ -94,6 +94,11 @@ std::string StandardMjpeg::get_mjpeg_stream()
     return url;
 }
 
+std::string StandardMjpeg::get_mjpeg_stream_real()
+{
+    return param["url_mjpeg"];
+}
+
 std::string StandardMjpeg::get_picture()
 {
     string url;
@@ -46,6 +46,11 @@ void Input::EmitSignalInput()
     DataLogger::Instance().log(this);
 }
 
+double Input::getNextDeadline()
+{
+    return ecore_time_get() + 0.01;
+}
+
 bool Input::SaveToXml(TiXmlElement *node)
 {
     TiXmlElement *cnode = new TiXmlElement("calaos:input");
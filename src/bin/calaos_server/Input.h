@@ -45,6 +45,10 @@ public:
     virtual void EmitSignalInput();
     virtual void hasChanged() { }
 
+    //Absolute time (ecore_time_get() based) at which hasChanged() needs to be
+    //called again by the event loop. Default is to be polled every 10ms.
+    virtual double getNextDeadline();
+
     virtual bool LoadFromXml(TiXmlElement *node)
     { return false; }
     virtual bool SaveToXml(TiXmlElement *node);
@@ -22,6 +22,8 @@
 #include "HttpClient.h"
 #include "ListeRoom.h"
 #include "ListeRule.h"
+#include "DataLogger.h"
+#include "HomeModel.h"
 
 JsonApi::JsonApi(HttpClient *client):
     httpClient(client)
@@ -32,79 +34,23 @@ JsonApi::~JsonApi()
 {
 }
 
-template<typename T>
-json_t *JsonApi::buildJsonRoomIO(Room *room)
+bool JsonApi::dumpWithHome(json_t *jdata, string &res)
 {
-    json_t *jdata = json_array();
-
-    for (int i = 0;i < room->get_size<T *>();i++)
-    {
-        json_t *jinput = json_object();
-        T *io = room->get_io<T *>(i);
-
-        vector<string> params =
-        { "id", "name", "type", "hits", "var_type", "visible",
-          "chauffage_id", "rw", "unit", "gui_type", "state",
-          "auto_scenario", "step" };
-
-        for (string &param: params)
-        {
-            string value;
-
-            if (param == "state")
-            {
-                if (io->get_type() == TINT)
-                    value = Utils::to_string(io->get_value_double());
-                else if (io->get_type() == TBOOL)
-                    value = io->get_value_bool()?"true":"false";
-                else if (io->get_type() == TSTRING)
-                    value = io->get_value_string();
-            }
-            else if (param == "var_type")
-            {
-                if (io->get_type() == TINT) value = "float";
-                else if (io->get_type() == TBOOL) value = "bool";
-                else if (io->get_type() == TSTRING) value = "string";
-            }
-            else
-            {
-                if (!io->get_params().Exists(param))
-                    continue;
-                value = io->get_param(param);
-            }
+    char *d = json_dumps(jdata, JSON_COMPACT | JSON_ENSURE_ASCII);
+    json_decref(jdata);
+    if (!d)
+        return false;
 
-            json_object_set_new(jinput, param.c_str(),
-                                json_string(value.c_str()));
-        }
+    string data = d;
+    free(d);
 
-        json_array_append_new(jdata, jinput);
-    }
+    res = "{\"home\":" + HomeModel::Instance().getHomeDump();
+    if (data.size() > 2)
+        res += "," + data.substr(1);
+    else
+        res += "}";
 
-    return jdata;
-}
-
-json_t *JsonApi::buildJsonHome()
-{
-    json_t *jdata = json_array();
-
-    for (int iroom = 0;iroom < ListeRoom::Instance().size();iroom++)
-    {
-        Room *room = ListeRoom::Instance().get_room(iroom);
-        json_t *jroom = json_object();
-
-        json_t *jitems = json_pack("{s:o, s:o}",
-                                   "inputs", buildJsonRoomIO<Input>(room),
-                                   "outputs", buildJsonRoomIO<Output>(room));
-
-        json_object_set_new(jroom, "type", json_string(room->get_type().c_str()));
-        json_object_set_new(jroom, "name", json_string(room->get_name().c_str()));
-        json_object_set_new(jroom, "hits", json_string(Utils::to_string(room->get_hits()).c_str()));
-        json_object_set_new(jroom, "items", jitems);
-
-        json_array_append_new(jdata, jroom);
-    }
-
-    return jdata;
+    return true;
 }
 
 json_t *JsonApi::buildJsonCameras()
@@ -359,6 +305,76 @@ void JsonApi::buildJsonState(json_t *jroot, std::function<void(json_t *)> result
     }
 }
 
+json_t *JsonApi::buildJsonHistory(Params &jParam)
+{
+    json_t *jret = json_object();
+
+    if (jParam["id"].empty())
+    {
+        json_object_set_new(jret, "success", json_string("false"));
+        return jret;
+    }
+
+    //default to the last 24h
+    int64_t end = time(NULL);
+    int64_t start = end - 24 * 3600;
+    if (jParam.Exists("end")) from_string(jParam["end"], end);
+    if (jParam.Exists("start")) from_string(jParam["start"], start);
+
+    //-1 for raw values
+    int res = -1;
+    if (jParam["resolution"] == "hour") res = DataLogger::RES_HOUR;
+    if (jParam["resolution"] == "day") res = DataLogger::RES_DAY;
+    if (jParam["resolution"] == "month") res = DataLogger::RES_MONTH;
+
+    //Queries run on the main loop, long ranges are only given with
+    //aggregates of a coarser resolution
+    const int64_t max_range[] = { DATALOGGER_MAX_RANGE_RAW, DATALOGGER_MAX_RANGE_HOUR,
+                                  DATALOGGER_MAX_RANGE_DAY, DATALOGGER_MAX_RANGE_MONTH };
+    if (start < 0) start = 0;
+    if (end < start) end = start;
+    while (res < DataLogger::RES_MONTH && end - start > max_range[res + 1])
+        res++;
+    if (end - start > DATALOGGER_MAX_RANGE_MONTH)
+        start = end - DATALOGGER_MAX_RANGE_MONTH;
+
+    const char *res_names[] = { "raw", "hour", "day", "month" };
+
+    json_t *jvalues = json_array();
+
+    if (res >= 0)
+    {
+        vector<DataLoggerAggregate> values;
+        DataLogger::Instance().getAggregates(jParam["id"], (DataLogger::Resolution)res, start, end, values);
+
+        for (const DataLoggerAggregate &aggr: values)
+        {
+            json_array_append_new(jvalues, json_pack("{s:I, s:f, s:f, s:f, s:i}",
+                                                     "start", (json_int_t)aggr.start,
+                                                     "min", aggr.min,
+                                                     "max", aggr.max,
+                                                     "mean", aggr.mean(),
+                                                     "count", (int)aggr.count));
+        }
+    }
+    else
+    {
+        vector<DataLoggerSample> values;
+        DataLogger::Instance().getValues(jParam["id"], start, end, values);
+
+        //[timestamp, value] pairs to keep the output small
+        for (const DataLoggerSample &sample: values)
+            json_array_append_new(jvalues, json_pack("[I, f]", (json_int_t)sample.timestamp, sample.value));
+    }
+
+    json_object_set_new(jret, "success", json_string("true"));
+    json_object_set_new(jret, "id", json_string(jParam["id"].c_str()));
+    json_object_set_new(jret, "resolution", json_string(res_names[res + 1]));
+    json_object_set_new(jret, "values", jvalues);
+
+    return jret;
+}
+
 bool JsonApi::decodeSetState(Params &jParam)
 {
     bool success = true;
@@ -48,15 +48,21 @@ protected:
 
     map<string, int> playerCounts;
 
-    json_t *buildJsonHome();
     json_t *buildJsonCameras();
     json_t *buildJsonAudio();
-    template<typename T> json_t *buildJsonRoomIO(Room *room);
+
+    //Serialize jdata with the cached document of HomeModel added to it
+    //as "home", so the home is not serialized again for each client.
+    //jdata is stolen.
+    bool dumpWithHome(json_t *jdata, string &res);
 
     //result is given with a call to a lambda because we may need to wait for
     //network queries
     void buildJsonState(json_t *jroot, std::function<void(json_t *)>result_lambda);
 
+    //logged values of an IO, raw or min/max/mean per hour/day/month
+    json_t *buildJsonHistory(Params &jParam);
+
     bool decodeSetState(Params &jParam);
     void decodeGetPlaylist(Params &jParam, std::function<void(json_t *)>result_lambda);
     void getNextPlaylistItem(AudioPlayer *player, json_t *jplayer, json_t *jplaylist, int it_current, int it_count, std::function<void(json_t *)>result_lambda);
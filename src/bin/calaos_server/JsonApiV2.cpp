@@ -145,6 +145,8 @@ void JsonApiV2::processApi(const string &data)
         processGetCameraPic();
     else if (jsonParam["action"] == "config")
         processConfig(jroot);
+    else if (jsonParam["action"] == "get_history")
+        processGetHistory();
 
     json_decref(jroot);
 }
@@ -155,14 +157,7 @@ void JsonApiV2::sendJson(json_t *json)
     if (!d)
     {
         json_decref(json);
-        cDebugDom("network") << "json_dumps failed!";
-
-        Params headers;
-        headers.Add("Connection", "close");
-        headers.Add("Content-Type", "text/html");
-        string res = httpClient->buildHttpResponse(HTTP_500, headers, HTTP_500_BODY);
-        sendData.emit(res);
-        closeConnection.emit(0, string());
+        sendJsonError();
 
         return;
     }
@@ -171,6 +166,23 @@ void JsonApiV2::sendJson(json_t *json)
     string data(d);
     free(d);
 
+    sendJsonData(data);
+}
+
+void JsonApiV2::sendJsonError()
+{
+    cDebugDom("network") << "json_dumps failed!";
+
+    Params headers;
+    headers.Add("Connection", "close");
+    headers.Add("Content-Type", "text/html");
+    string res = httpClient->buildHttpResponse(HTTP_500, headers, HTTP_500_BODY);
+    sendData.emit(res);
+    closeConnection.emit(0, string());
+}
+
+void JsonApiV2::sendJsonData(const string &data)
+{
     Params headers;
     headers.Add("Connection", "Close");
     headers.Add("Cache-Control", "no-cache, must-revalidate");
@@ -185,12 +197,18 @@ void JsonApiV2::processGetHome()
 {
     json_t *jret = nullptr;
 
-    jret = json_pack("{s:o, s:o, s:o}",
-                     "home", buildJsonHome(),
+    jret = json_pack("{s:o, s:o}",
                      "cameras", buildJsonCameras(),
                      "audio", buildJsonAudio());
 
-    sendJson(jret);
+    string data;
+    if (!dumpWithHome(jret, data))
+    {
+        sendJsonError();
+        return;
+    }
+
+    sendJsonData(data);
 }
 
 void JsonApiV2::processGetState(json_t *jroot)
@@ -208,6 +226,11 @@ void JsonApiV2::processSetState()
     sendJson(jret);
 }
 
+void JsonApiV2::processGetHistory()
+{
+    sendJson(buildJsonHistory(jsonParam));
+}
+
 void JsonApiV2::processGetPlaylist()
 {
     decodeGetPlaylist(jsonParam, [=](json_t *jret)
@@ -234,7 +257,7 @@ void JsonApiV2::processPolling()
     else if (jsonParam["type"] == "get")
     {
         string uuid = jsonParam["uuid"];
-        list<CalaosEvent> events;
+        PollEvents events;
 
         bool res = PollListenner::Instance().GetEvents(uuid, events);
         if (!res)
@@ -243,13 +266,15 @@ void JsonApiV2::processPolling()
         {
             json_t *jev = json_array();
 
-            for (auto i = events.cbegin();i != events.cend();i++)
-            {
-                json_array_append_new(jev, i->toJson());
-            }
+            for (size_t i = 0;i < events.size();i++)
+                json_array_append_new(jev, events[i].toJson());
 
             json_object_set_new(jret, "success", json_string("true"));
             json_object_set_new(jret, "events", jev);
+
+            //events were lost, the client has to get the states again
+            if (events.needResync())
+                json_object_set_new(jret, "resync", json_string("true"));
         }
 
     }
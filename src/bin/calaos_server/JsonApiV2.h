@@ -45,6 +45,8 @@ private:
     Params jsonParam;
 
     void sendJson(json_t *json);
+    void sendJsonData(const string &data);
+    void sendJsonError();
 
     //processing functions
     void processGetHome();
@@ -55,6 +57,7 @@ private:
     void processGetCover();
     void processGetCameraPic();
     void processConfig(json_t *jroot);
+    void processGetHistory();
 
     void getNextPlaylistItem(AudioPlayer *player, json_t *jplayer, json_t *jplaylist, int it_current, int it_count);
 
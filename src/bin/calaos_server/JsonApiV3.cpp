@@ -32,28 +32,251 @@
 #include "InPlageHoraire.h"
 #include "HttpCodes.h"
 #include "WebSocket.h"
+#include "HomeModel.h"
+#include "MsgPack.h"
+
+#ifndef json_array_foreach
+#define json_array_foreach(array, index, value) \
+    for(index = 0; \
+    index < json_array_size(array) && (value = json_array_get(array, index)); \
+    index++)
+#endif
+
+EventSubscriptions<JsonApiV3> JsonApiV3::subscriptions;
 
 JsonApiV3::JsonApiV3(HttpClient *client):
     JsonApi(client)
 {
-    EventManager::Instance().newEvent.connect(sigc::mem_fun(*this, &JsonApiV3::handleEvents));
+    //Only one slot for all clients
+    static bool events_connected = false;
+    if (!events_connected)
+    {
+        EventManager::Instance().newEvent.connect(sigc::ptr_fun(&JsonApiV3::handleEvents));
+        events_connected = true;
+    }
+
+    subscriptions.add(this);
 }
 
 JsonApiV3::~JsonApiV3()
 {
+    subscriptions.remove(this);
+
+    for (auto &it: throttled)
+        delete it.second.timer;
 }
 
 void JsonApiV3::handleEvents(const CalaosEvent &event)
 {
-    if (!loggedin)
+    //IOs added to a room are part of the subscriptions to that room
+    if ((event.getType() == CalaosEvent::EventInputAdded ||
+         event.getType() == CalaosEvent::EventOutputAdded) &&
+        event.getParam().Exists("room_name"))
+    {
+        string room = "room:" + event.getParam()["room_name"];
+        for (JsonApiV3 *api: subscriptions.subscribers(room))
+            subscriptions.subscribe(api, "id:" + event.getParam()["id"], room);
+    }
+
+    //one message for each encoding used by the clients
+    WebSocketMessagePtr messages[2];
+
+    //A client can be closed while sending, the list is a copy
+    vector<JsonApiV3 *> clients = subscriptions.lookup(EventKeys::fromEvent(event));
+    for (JsonApiV3 *api: clients)
+    {
+        if (!subscriptions.contains(api) || !api->loggedin)
+            continue;
+
+        WebSocketMessagePtr &message = messages[api->encoding];
+        if (!message)
+        {
+            cDebugDom("network") << "Handling event: " << event.toString();
+
+            string res;
+            if (!encodeEvent(event, api->encoding, res))
+                return;
+
+            //Only the last state of an IO matters to a client lagging behind
+            string key;
+            if (event.getType() == CalaosEvent::EventInputChanged ||
+                event.getType() == CalaosEvent::EventOutputChanged)
+            {
+                key = CalaosEvent::typeToString(event.getType());
+                for (int i = 0;i < event.getParam().size();i++)
+                {
+                    string k, v;
+                    event.getParam().get_item(i, k, v);
+                    key += " " + (k == "id"?v:k);
+                }
+            }
+
+            message = std::make_shared<WebSocketMessage>(res, api->encoding == EncodingMsgPack, key);
+        }
+
+        if (event.getType() == CalaosEvent::EventInputChanged ||
+            event.getType() == CalaosEvent::EventOutputChanged)
+            api->sendThrottled(event.getType(), event.getParam()["id"], message);
+        else
+            api->sendMessage.emit(message);
+    }
+}
+
+const EventSendQueue *JsonApiV3::getEventQueue() const
+{
+    WebSocket *ws = dynamic_cast<WebSocket *>(httpClient);
+    if (!ws) return nullptr;
+    return &ws->getEventQueue();
+}
+
+bool JsonApiV3::encodeEvent(const CalaosEvent &event, int encoding, string &res)
+{
+    if (encoding == EncodingJson)
+        return encodeJson("event", event.toJson(), string(), res);
+
+    //written from the event, without a json tree
+    MsgPackWriter writer;
+    writer.writeMap(2);
+    writer.writeString("msg");
+    writer.writeString("event");
+    writer.writeString("data");
+    event.toMsgPack(writer);
+
+    res = std::move(writer.getData());
+
+    return true;
+}
+
+void JsonApiV3::sendThrottled(int type, const string &id, const WebSocketMessagePtr &message)
+{
+    auto interval = intervals.find(id);
+    if (interval == intervals.end())
+    {
+        sendMessage.emit(message);
         return;
+    }
+
+    //an input and an output can have the same id
+    string key = CalaosEvent::typeToString(type) + " " + id;
+
+    ThrottledEvent &t = throttled[key];
+    double now = ecore_time_get();
+
+    if (!t.timer && now - t.last_sent >= interval->second)
+    {
+        t.last_sent = now;
+        sendMessage.emit(message);
+        return;
+    }
+
+    //the last change is sent when the interval is over
+    t.pending = message;
+    if (!t.timer)
+    {
+        t.timer = new EcoreTimer(interval->second - (now - t.last_sent), sigc::slot<void>([=]()
+        {
+            ThrottledEvent &te = throttled[key];
+            DELETE_NULL(te.timer);
+            te.last_sent = ecore_time_get();
+
+            WebSocketMessagePtr m = te.pending;
+            te.pending.reset();
+            if (m) sendMessage.emit(m);
+        }));
+    }
+}
+
+void JsonApiV3::processSubscribe(json_t *jdata, bool subscribe, const string &client_id)
+{
+    //keys with their source, the IOs of a room are subscribed for that room
+    auto keysOf = [=](const char *name, const string &prefix)
+    {
+        vector<pair<string, string>> keys;
+        json_t *jarr = jdata?json_object_get(jdata, name):nullptr;
+        size_t idx;
+        json_t *value;
+
+        json_array_foreach(jarr, idx, value)
+        {
+            if (!json_is_string(value)) continue;
+            string v = json_string_value(value);
+            keys.push_back(make_pair(prefix + v, string()));
+
+            if (prefix == "room:")
+            {
+                for (const string &io: EventKeys::roomIOs(v))
+                    keys.push_back(make_pair(io, prefix + v));
+            }
+        }
+
+        return keys;
+    };
 
-    cDebugDom("network") << "Handling event: " << event.toString();
+    json_t *jall = jdata?json_object_get(jdata, "all"):nullptr;
 
-    sendJson("event", event.toJson());
+    if (subscribe && json_is_string(jall) && string(json_string_value(jall)) == "true")
+    {
+        //back to receiving all events
+        subscriptions.add(this);
+    }
+    else if (!subscribe && (!jdata || json_object_size(jdata) == 0))
+    {
+        subscriptions.clear(this);
+    }
+    else
+    {
+        for (auto f: { std::make_pair("ids", "id:"),
+                       std::make_pair("rooms", "room:"),
+                       std::make_pair("types", "type:"),
+                       std::make_pair("players", "player:") })
+        {
+            for (const auto &key: keysOf(f.first, f.second))
+            {
+                if (subscribe)
+                    subscriptions.subscribe(this, key.first, key.second);
+                else
+                    subscriptions.unsubscribe(this, key.first, key.second);
+            }
+        }
+    }
+
+    //"intervals": { "io id": "seconds" }, minimum time between 2 state
+    //changes sent for that IO
+    json_t *jint = jdata?json_object_get(jdata, "intervals"):nullptr;
+    const char *key;
+    json_t *value;
+    json_object_foreach(jint, key, value)
+    {
+        double sec = 0.0;
+        if (json_is_string(value))
+            Utils::from_string(json_string_value(value), sec);
+
+        if (subscribe && sec > 0.0)
+            intervals[key] = sec;
+        else
+        {
+            intervals.erase(key);
+
+            for (int type: { CalaosEvent::EventInputChanged, CalaosEvent::EventOutputChanged })
+            {
+                auto it = throttled.find(CalaosEvent::typeToString(type) + " " + key);
+                if (it == throttled.end()) continue;
+
+                //don't lose the last change
+                if (it->second.pending)
+                    sendMessage.emit(it->second.pending);
+                delete it->second.timer;
+                throttled.erase(it);
+            }
+        }
+    }
+
+    json_t *jret = json_object();
+    json_object_set_new(jret, "success", json_string("true"));
+    sendJson(subscribe?"subscribe":"unsubscribe", jret, client_id);
 }
 
-void JsonApiV3::sendJson(const string &msg_type, json_t *data, const string &client_id)
+bool JsonApiV3::encodeJson(const string &msg_type, json_t *data, const string &client_id, string &res)
 {
     json_t *jroot = json_object();
     json_object_set_new(jroot, "msg", json_string(msg_type.c_str()));
@@ -68,24 +291,64 @@ void JsonApiV3::sendJson(const string &msg_type, json_t *data, const string &cli
         cErrorDom("network") << "json_dumps failed! msg_type: " << msg_type << " data:" << data;
         json_decref(jroot);
 
+        return false;
+    }
+
+    json_decref(jroot);
+    res = d;
+    free(d);
+
+    return true;
+}
+
+bool JsonApiV3::encodeMsgPack(const string &msg_type, json_t *data, const string &client_id, string &res)
+{
+    MsgPackWriter writer;
+    writer.writeMap(1 + (client_id != ""?1:0) + (data?1:0));
+    writer.writeString("msg");
+    writer.writeString(msg_type);
+    if (client_id != "")
+    {
+        writer.writeString("msg_id");
+        writer.writeString(client_id);
+    }
+    if (data)
+    {
+        writer.writeString("data");
+        writer.writeJson(data);
+        json_decref(data);
+    }
+
+    res = std::move(writer.getData());
+
+    return true;
+}
+
+void JsonApiV3::sendJson(const string &msg_type, json_t *data, const string &client_id)
+{
+    string res;
+
+    if (encoding == EncodingMsgPack)
+    {
+        encodeMsgPack(msg_type, data, client_id, res);
+        sendBinaryData.emit(res);
+
+        return;
+    }
+
+    if (!encodeJson(msg_type, data, client_id, res))
+    {
         //close connection
         closeConnection.emit(WebSocket::CloseCodeNormal, "json_dumps failed!");
 
         return;
     }
 
-    json_decref(jroot);
-    string res(d);
-    free(d);
-
     sendData.emit(res);
 }
 
 void JsonApiV3::processApi(const string &data)
 {
-    Params jsonRoot;
-    Params jsonData;
-
     //parse the json data
     json_error_t jerr;
     json_t *jroot = json_loads(data.c_str(), 0, &jerr);
@@ -93,9 +356,34 @@ void JsonApiV3::processApi(const string &data)
     if (!jroot || !json_is_object(jroot))
     {
         cDebugDom("network") << "Error loading json : " << jerr.text;
+        if (jroot) json_decref(jroot);
         return;
     }
 
+    processRequest(jroot);
+    json_decref(jroot);
+}
+
+void JsonApiV3::processBinaryApi(const string &data)
+{
+    json_t *jroot = MsgPack::decode(data);
+
+    if (!jroot || !json_is_object(jroot))
+    {
+        cDebugDom("network") << "Error decoding MessagePack request of size " << data.size();
+        if (jroot) json_decref(jroot);
+        return;
+    }
+
+    processRequest(jroot);
+    json_decref(jroot);
+}
+
+void JsonApiV3::processRequest(json_t *jroot)
+{
+    Params jsonRoot;
+    Params jsonData;
+
     char *d = json_dumps(jroot, JSON_INDENT(4));
     if (d)
     {
@@ -140,8 +428,15 @@ void JsonApiV3::processApi(const string &data)
         }
         else
         {
+            //the encoding can also be chosen with the websocket subprotocol
+            if (jsonData["encoding"] == "msgpack")
+                encoding = EncodingMsgPack;
+            else if (jsonData["encoding"] == "json")
+                encoding = EncodingJson;
+
             json_t *jret = json_object();
             json_object_set_new(jret, "success", json_string("true"));
+            json_object_set_new(jret, "encoding", json_string(encoding == EncodingMsgPack?"msgpack":"json"));
 
             sendJson("login", jret, jsonRoot["msg_id"]);
 
@@ -152,12 +447,20 @@ void JsonApiV3::processApi(const string &data)
     {
         if (jsonRoot["msg"] == "get_home")
             processGetHome(jsonData, jsonRoot["msg_id"]);
+        else if (jsonRoot["msg"] == "get_changes")
+            processGetChanges(jsonData, jsonRoot["msg_id"]);
+        else if (jsonRoot["msg"] == "subscribe")
+            processSubscribe(jdata, true, jsonRoot["msg_id"]);
+        else if (jsonRoot["msg"] == "unsubscribe")
+            processSubscribe(jdata, false, jsonRoot["msg_id"]);
         else if (jsonRoot["msg"] == "get_state")
             processGetState(jdata, jsonRoot["msg_id"]);
         else if (jsonRoot["msg"] == "set_state")
             processSetState(jsonData, jsonRoot["msg_id"]);
         else if (jsonRoot["msg"] == "get_playlist")
             processGetPlaylist(jsonData, jsonRoot["msg_id"]);
+        else if (jsonRoot["msg"] == "get_history")
+            processGetHistory(jsonData, jsonRoot["msg_id"]);
 
 //        else if (jsonParam["action"] == "get_cover")
 //            processGetCover();
@@ -166,20 +469,100 @@ void JsonApiV3::processApi(const string &data)
 //        else if (jsonParam["action"] == "config")
 //            processConfig(jroot);
     }
-
-    json_decref(jroot);
 }
 
 void JsonApiV3::processGetHome(const Params &jsonReq, const string &client_id)
 {
     json_t *jret = nullptr;
 
-    jret = json_pack("{s:o, s:o, s:o}",
-                     "home", buildJsonHome(),
+    //seq and home_version let the client ask for the changes after this
+    //home with get_changes
+    jret = json_pack("{s:o, s:o, s:s, s:s}",
                      "cameras", buildJsonCameras(),
-                     "audio", buildJsonAudio());
+                     "audio", buildJsonAudio(),
+                     "seq", Utils::to_string(HomeModel::Instance().getSeq()).c_str(),
+                     "home_version", Utils::to_string(HomeModel::Instance().getStructureVersion()).c_str());
+
+    if (encoding == EncodingMsgPack)
+    {
+        //same for the MessagePack home
+        MsgPackWriter writer;
+        writer.writeMap(client_id != ""?3:2);
+        writer.writeString("msg");
+        writer.writeString("get_home");
+        if (client_id != "")
+        {
+            writer.writeString("msg_id");
+            writer.writeString(client_id);
+        }
+
+        writer.writeString("data");
+        writer.writeMap(json_object_size(jret) + 1);
+        writer.writeString("home");
+        writer.writeRaw(HomeModel::Instance().getHomeMsgPack());
+
+        const char *key;
+        json_t *value;
+        json_object_foreach(jret, key, value)
+        {
+            writer.writeString(key);
+            writer.writeJson(value);
+        }
+        json_decref(jret);
+
+        sendBinaryData.emit(writer.getData());
+
+        return;
+    }
+
+    //the cached home is inserted in the message as is
+    string data, res;
+    if (!dumpWithHome(jret, data) ||
+        !encodeJson("get_home", nullptr, client_id, res))
+    {
+        closeConnection.emit(WebSocket::CloseCodeNormal, "json_dumps failed!");
+        return;
+    }
 
-    sendJson("get_home", jret, client_id);
+    res.pop_back();
+    res += ",\"data\":" + data + "}";
+
+    sendData.emit(res);
+}
+
+void JsonApiV3::processGetChanges(const Params &jsonReq, const string &client_id)
+{
+    uint64_t since = 0;
+    Utils::from_string(jsonReq["seq"], since);
+
+    json_t *jret = json_object();
+    json_object_set_new(jret, "seq", json_string(Utils::to_string(HomeModel::Instance().getSeq()).c_str()));
+    json_object_set_new(jret, "home_version", json_string(Utils::to_string(HomeModel::Instance().getStructureVersion()).c_str()));
+
+    vector<HomeChange> changes;
+    if (!jsonReq.Exists("seq") ||
+        !HomeModel::Instance().getChanges(since, changes))
+    {
+        //too old, the client has to do a get_home
+        json_object_set_new(jret, "resync", json_string("true"));
+        sendJson("get_changes", jret, client_id);
+
+        return;
+    }
+
+    json_t *jchanges = json_array();
+    for (const HomeChange &c: changes)
+    {
+        json_array_append_new(jchanges, json_pack("{s:s, s:s, s:s}",
+                                                  "id", c.id.c_str(),
+                                                  "type", c.output?"output":"input",
+                                                  "state", c.state.c_str()));
+    }
+
+    json_object_set_new(jret, "resync", json_string("false"));
+    json_object_set_new(jret, "changes", jchanges);
+
+    sendJson("get_changes", jret, client_id);
 }
 
 void JsonApiV3::processGetState(json_t *jdata, const string &client_id)
@@ -215,3 +598,8 @@ void JsonApiV3::processGetPlaylist(Params &jsonReq, const string &client_id)
         sendJson("get_playlist", jret, client_id);
     });
 }
+
+void JsonApiV3::processGetHistory(Params &jsonReq, const string &client_id)
+{
+    sendJson("get_history", buildJsonHistory(jsonReq), client_id);
+}
@@ -23,6 +23,10 @@
 
 #include "JsonApi.h"
 #include "EventManager.h"
+#include "WebSocketFrame.h"
+#include "EventSubscriptions.h"
+#include "EventSendQueue.h"
+#include "EcoreTimer.h"
 
 class JsonApiV3: public JsonApi
 {
@@ -32,20 +36,65 @@ public:
 
     virtual void processApi(const string &data);
 
+    //request sent in a binary frame, encoded with MessagePack
+    void processBinaryApi(const string &data);
+
+    //encoding of the messages sent to the client, MessagePack messages
+    //have the same content as the json ones and are sent in binary frames
+    enum { EncodingJson = 0, EncodingMsgPack };
+    void setEncoding(int e) { encoding = e; }
+    int getEncoding() const { return encoding; }
+
+    static bool encodeEvent(const CalaosEvent &event, int encoding, string &res);
+
+    //websocket clients of the api, and the queue of their outbound events
+    static vector<JsonApiV3 *> getClients() { return subscriptions.getClients(); }
+    const EventSendQueue *getEventQueue() const;
+
+    //events are encoded once and the same message is given to all clients
+    sigc::signal<void, const WebSocketMessagePtr &> sendMessage;
+
+    //messages encoded with MessagePack
+    sigc::signal<void, const string &> sendBinaryData;
+
 private:
 
     sigc::signal<void, string, string, void*, void*> sig_events;
 
-    void handleEvents(const CalaosEvent &event);
+    static EventSubscriptions<JsonApiV3> subscriptions;
+    static void handleEvents(const CalaosEvent &event);
+
+    //minimum interval between 2 state changes sent for an IO
+    class ThrottledEvent
+    {
+    public:
+        double last_sent = 0.0;
+        WebSocketMessagePtr pending;
+        EcoreTimer *timer = nullptr;
+    };
+    unordered_map<string, double> intervals;
+
+    //keyed by event type and IO id
+    unordered_map<string, ThrottledEvent> throttled;
+
+    void sendThrottled(int type, const string &id, const WebSocketMessagePtr &message);
 
     bool loggedin = false;
+    int encoding = EncodingJson;
+
+    void processRequest(json_t *jroot);
 
+    static bool encodeJson(const string &msg_type, json_t *data, const string &client_id, string &res);
+    static bool encodeMsgPack(const string &msg_type, json_t *data, const string &client_id, string &res);
     void sendJson(const string &msg_type, json_t *data, const string &client_id = string());
 
     void processGetHome(const Params &jsonReq, const string &client_id = string());
+    void processGetChanges(const Params &jsonReq, const string &client_id = string());
+    void processSubscribe(json_t *jdata, bool subscribe, const string &client_id = string());
     void processGetState(json_t *jdata, const string &client_id = string());
     void processSetState(Params &jsonReq, const string &client_id = string());
     void processGetPlaylist(Params &jsonReq, const string &client_id = string());
+    void processGetHistory(Params &jsonReq, const string &client_id = string());
 };
 
 #endif // JSONAPIV3_H
@@ -70,6 +70,9 @@ void ListeRoom::addInputHash(Input *input)
     cDebugDom("room") << id;
 
     eina_hash_add(input_table, id.c_str(), input);
+
+    //var inputs used in rules conditions are resolved through this hash
+    ListeRule::Instance().invalidateRulesIndex();
 }
 
 void ListeRoom::delInputHash(Input *input)
@@ -86,6 +89,9 @@ void ListeRoom::delInputHash(Input *input)
     cDebugDom("room") << id;
 
     eina_hash_del(input_table, id.c_str(), NULL);
+
+    //var inputs used in rules conditions are resolved through this hash
+    ListeRule::Instance().invalidateRulesIndex();
 }
 
 void ListeRoom::addOutputHash(Output *output)
@@ -102,6 +108,9 @@ void ListeRoom::addOutputHash(Output *output)
     cDebugDom("room") << id;
 
     eina_hash_add(output_table, id.c_str(), output);
+
+    //var outputs used in rules actions are resolved through this hash
+    ListeRule::Instance().invalidateRulesIndex();
 }
 
 void ListeRoom::delOutputHash(Output *output)
@@ -118,6 +127,9 @@ void ListeRoom::delOutputHash(Output *output)
     cDebugDom("room") << id;
 
     eina_hash_del(output_table, id.c_str(), NULL);
+
+    //var outputs used in rules actions are resolved through this hash
+    ListeRule::Instance().invalidateRulesIndex();
 }
 
 void ListeRoom::Add(Room *p)
@@ -36,6 +36,8 @@ ListeRule::~ListeRule()
 
     rules.clear();
 
+    DELETE_NULL(event_timer);
+
     cDebugDom("rule");
 }
 
@@ -46,6 +48,8 @@ void ListeRule::Add(Rule *r)
     if (r->param_exists("auto_scenario"))
         rules_scenarios.push_back(r);
 
+    invalidateRulesIndex();
+
     cDebugDom("rule") << r->get_name() << "," << r->get_type() << ": Ok";
 }
 
@@ -60,9 +64,20 @@ void ListeRule::Remove(int pos)
     delete rules[pos];
     rules.erase(iter);
 
+    invalidateRulesIndex();
+
     cDebugDom("rule");
 }
 
+void ListeRule::Remove(Rule *obj)
+{
+    rules.erase(std::remove(rules.begin(), rules.end(), obj), rules.end());
+    rules_scenarios.erase(std::remove(rules_scenarios.begin(), rules_scenarios.end(), obj), rules_scenarios.end());
+    delete obj;
+
+    invalidateRulesIndex();
+}
+
 Rule *ListeRule::operator[] (int i) const
 {
     return rules[i];
@@ -73,128 +88,333 @@ Rule *ListeRule::get_rule(int i)
     return rules[i];
 }
 
-void ListeRule::RunEventLoop()
+void ListeRule::Add(Input *in)
 {
-    if (loop) return; //only one loop at once!
+    if (in_event.find(in) != in_event.end())
+        return;
 
-    loop = true;
+    scheduleInput(in, ecore_time_get());
+}
 
-    //detect events
-    for (uint i = 0;i < in_event.size();i++)
-        in_event[i]->hasChanged();
+void ListeRule::Remove(Input *in)
+{
+    if (in == event_current)
+        event_current_removed = true;
 
-    loop = false;
+    auto it = in_event.find(in);
+    if (it == in_event.end())
+        return;
 
-    //        cDebugDom("rule") << "ListeRule::RunEventLoop(): Loop exited";
+    in_schedule.erase(it->second);
+    in_event.erase(it);
 }
 
-void ListeRule::StopLoop()
+void ListeRule::WakeUp(Input *in)
 {
-    loop = false;
+    if (in_event.find(in) == in_event.end())
+        return;
+
+    scheduleInput(in, ecore_time_get());
 }
 
-Eina_Bool _execute_rule_signal_idler_cb(void *data)
+void ListeRule::scheduleInput(Input *in, double deadline)
 {
-    Rule_idler_cb *cb = reinterpret_cast<Rule_idler_cb *>(data);
-    if (!cb) return ECORE_CALLBACK_CANCEL;
+    auto it = in_event.find(in);
+    if (it != in_event.end())
+        in_schedule.erase(it->second);
+
+    in_event[in] = in_schedule.insert(std::make_pair(deadline, in));
+
+    updateEventTimer();
+}
+
+void ListeRule::updateEventTimer()
+{
+    //The timer is set again at the end of RunEventLoop()
+    if (loop || !event_loop_started) return;
+
+    if (in_schedule.empty())
+    {
+        DELETE_NULL(event_timer);
+        return;
+    }
+
+    double deadline = in_schedule.begin()->first;
+
+    //timer is already set for this deadline
+    if (event_timer && deadline == event_timer_deadline)
+        return;
 
-    ListeRule::Instance().ExecuteRuleSignal(cb->input);
+    double delay = deadline - ecore_time_get();
+    if (delay < 0.0) delay = 0.0;
+    if (delay > EVENT_LOOP_MAX_SLEEP) delay = EVENT_LOOP_MAX_SLEEP;
 
-    delete cb;
+    event_timer_deadline = deadline;
 
-    //delete the ecore_idler
-    return ECORE_CALLBACK_CANCEL;
+    if (!event_timer)
+        event_timer = new EcoreTimer(delay, (sigc::slot<void>)sigc::mem_fun(*this, &ListeRule::RunEventLoop));
+    else
+        event_timer->Reset(delay);
 }
 
-void ListeRule::ExecuteRuleSignal(std::string io_id)
+void ListeRule::RunEventLoop()
 {
-    if (!mutex.try_lock())
+    if (loop) return; //only one loop at once!
+
+    loop = true;
+    event_loop_started = true;
+    event_wakeups++;
+
+    //the timer has fired, it needs to be set again in any case
+    event_timer_deadline = 0.0;
+
+    double now = ecore_time_get();
+
+    //detect events, only for inputs that reached their deadline
+    while (!in_schedule.empty() && in_schedule.begin()->first <= now)
     {
-        //We can't execute rules for now. Do it later.
-        Rule_idler_cb *cb = new Rule_idler_cb;
+        Input *in = in_schedule.begin()->second;
+        in_schedule.erase(in_schedule.begin());
+        in_event.erase(in);
 
-        cb->input = io_id;
-        cb->idler = ecore_idler_add(_execute_rule_signal_idler_cb, cb);
+        event_current = in;
+        event_current_removed = false;
 
-        cDebugDom("rule") << "Mutex locked, execute rule later for input " << io_id;
+        in->hasChanged();
 
-        return;
+        event_current = NULL;
+
+        if (!loop) break; //StopLoop() was called
+
+        //the input may have been removed (and deleted) by a rule it triggered
+        if (event_current_removed) continue;
+
+        double next = in->getNextDeadline();
+        if (next < now + 0.01) next = now + 0.01;
+        if (next > now + EVENT_LOOP_MAX_SLEEP) next = now + EVENT_LOOP_MAX_SLEEP;
+
+        in_event[in] = in_schedule.insert(std::make_pair(next, in));
     }
 
-    cDebugDom("rule") << "Received signal for id " << io_id;
+    if (!loop) return; //StopLoop() was called
 
-    unordered_map<Rule *, bool> execRules;
+    loop = false;
 
-    for (uint i = 0;i < rules.size();i++)
+    updateEventTimer();
+
+    //        cDebugDom("rule") << "ListeRule::RunEventLoop(): Loop exited";
+}
+
+void ListeRule::StopLoop()
+{
+    loop = false;
+    event_loop_started = false;
+    DELETE_NULL(event_timer);
+}
+
+void ListeRule::buildRulesIndex()
+{
+    rules_index.clear();
+
+    for (Rule *rule: rules)
     {
-        Rule *rule = rules[i];
+        //all io ids that can trigger this rule
+        vector<string> ids;
+
         for (int j = 0;j < rule->get_size_conds();j++)
         {
             ConditionStd *cond = dynamic_cast<ConditionStd *>(rule->get_condition(j));
-            bool exec = false;
-            for (int k = 0;cond && k < cond->get_size();k++)
-            {
-                if (cond->get_input(k)->get_param("id") == io_id)
-                {
-                    if (cond->useForTrigger() &&
-                        rule->CheckConditions())
-                    {
-                        //Add only rules once to the exec list
-                        if (execRules.find(rule) == execRules.end())
-                            execRules[rule] = true;
-                    }
-                    exec = true;
-                }
-            }
-            if (!exec && cond)
+            if (cond && cond->useForTrigger())
             {
+                for (int k = 0;k < cond->get_size();k++)
+                    ids.push_back(cond->get_input(k)->get_param("id"));
+
                 vector<Input *> list;
                 cond->getVarIds(list);
 
                 for (uint k = 0;k < list.size();k++)
-                {
-                    if (list[k]->get_param("id") == io_id)
-                    {
-                        if (cond->useForTrigger() &&
-                            rule->CheckConditions())
-                        {
-                            if (execRules.find(rule) == execRules.end())
-                                execRules[rule] = true;
-                        }
-                        exec = true;
-                    }
-                }
+                    ids.push_back(list[k]->get_param("id"));
             }
 
             ConditionScript *scond = dynamic_cast<ConditionScript *>(rule->get_condition(j));
             for (int k = 0;scond && k < scond->get_size();k++)
+                ids.push_back(scond->get_input(k)->get_param("id"));
+
+            ConditionOutput *ocond = dynamic_cast<ConditionOutput *>(rule->get_condition(j));
+            if (ocond && ocond->getOutput() && ocond->useForTrigger())
+                ids.push_back(ocond->getOutput()->get_param("id"));
+        }
+
+        //Add each rule only once per io
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        for (const string &id: ids)
+            rules_index[id].push_back(rule);
+    }
+
+    index_dirty = false;
+
+    cDebugDom("rule") << "Rules index rebuilt: " << rules.size() << " rules, "
+                      << rules_index.size() << " ios";
+}
+
+void ListeRule::ExecuteRuleSignal(std::string io_id)
+{
+    //Queue the io only once per wave, its rules will see its last value
+    if (pending_set.insert(io_id).second)
+        pending_ios.push_back(io_id);
+
+    //The signal comes from the action of a rule, the io will be
+    //handled by the next wave of the running propagation
+    if (propagating)
+    {
+        cDebugDom("rule") << "Propagation running, queue signal for id " << io_id;
+        return;
+    }
+
+    propagate();
+}
+
+void ListeRule::propagate()
+{
+    propagating = true;
+
+    RulesPropagationStats stats;
+    double start = ecore_time_get();
+
+    //rules fired by each wave, to report the chain when a loop is detected
+    vector<vector<Rule *>> waves;
+    unordered_set<Rule *> wave_rules;
+    vector<string> ios;
+
+    while (!pending_ios.empty())
+    {
+        if (stats.depth >= RULES_MAX_DEPTH)
+        {
+            stats.loop_detected = true;
+            loops_detected++;
+
+            cErrorDom("rule") << "Rules loop detected, propagation stopped after "
+                              << stats.depth << " waves: " << loopChain(waves);
+
+            pending_ios.clear();
+            pending_set.clear();
+            break;
+        }
+
+        if (index_dirty)
+            buildRulesIndex();
+
+        ios.clear();
+        ios.swap(pending_ios);
+        pending_set.clear();
+        wave_rules.clear();
+
+        stats.depth++;
+
+        RulesWaveStats wave;
+        wave.ios = ios.size();
+        double wave_start = ecore_time_get();
+
+        vector<Rule *> execRules;
+
+        //Check conditions of all rules first, actions are executed after
+        for (const string &id: ios)
+        {
+            cDebugDom("rule") << "Received signal for id " << id;
+
+            auto it = rules_index.find(id);
+            if (it == rules_index.end()) continue;
+
+            for (Rule *rule: it->second)
             {
-                if (scond->get_input(k)->get_param("id") == io_id &&
-                    rule->CheckConditions())
-                {
-                    if (execRules.find(rule) == execRules.end())
-                        execRules[rule] = true;
-                }
+                //a rule used by several ios of the wave is checked only once
+                if (!wave_rules.insert(rule).second) continue;
+
+                wave.rules_checked++;
+                if (rule->CheckConditions())
+                    execRules.push_back(rule);
             }
+        }
 
-            ConditionOutput *ocond = dynamic_cast<ConditionOutput *>(rule->get_condition(j));
-            if (ocond && ocond->getOutput()->get_param("id") == io_id &&
-                ocond->useForTrigger() &&
-                rule->CheckConditions())
+        wave.rules_fired = execRules.size();
+
+        //Execute all rules actions now. The ios they change are queued
+        //in pending_ios for the next wave
+        for (Rule *rule: execRules)
+            rule->ExecuteActions();
+
+        waves.push_back(std::move(execRules));
+
+        wave.duration = ecore_time_get() - wave_start;
+        stats.rules_checked += wave.rules_checked;
+        stats.rules_fired += wave.rules_fired;
+        stats.waves.push_back(wave);
+
+        cDebugDom("rule") << "Wave " << stats.depth << ": " << wave.ios << " ios, "
+                          << wave.rules_checked << " rules checked, "
+                          << wave.rules_fired << " rules fired in "
+                          << wave.duration * 1000.0 << "ms";
+    }
+
+    stats.duration = ecore_time_get() - start;
+
+    last_stats = std::move(stats);
+    propagation_count++;
+    if (last_stats.depth > max_depth)
+        max_depth = last_stats.depth;
+
+    propagating = false;
+
+    cDebugDom("rule") << "Propagation done: " << last_stats.depth << " waves, "
+                      << last_stats.rules_checked << " rules checked, "
+                      << last_stats.rules_fired << " rules fired in "
+                      << last_stats.duration * 1000.0 << "ms";
+}
+
+string ListeRule::loopChain(const vector<vector<Rule *>> &waves)
+{
+    if (waves.empty()) return "";
+
+    //Find the last previous wave that fired a rule of the last wave,
+    //the waves in between are the cycle
+    const vector<Rule *> &last = waves.back();
+    int from = -1;
+    for (int i = waves.size() - 2;i >= 0 && from < 0;i--)
+    {
+        for (Rule *rule: waves[i])
+        {
+            if (std::find(last.begin(), last.end(), rule) != last.end())
             {
-                if (execRules.find(rule) == execRules.end())
-                    execRules[rule] = true;
+                from = i;
+                break;
             }
         }
     }
 
-    //Execute all rules actions now
-    for (auto it: execRules)
+    if (from < 0) from = 0;
+
+    string chain;
+    for (uint i = from;i < waves.size();i++)
     {
-        it.first->ExecuteActions();
+        if (i > (uint)from) chain += " -> ";
+
+        string names;
+        for (Rule *rule: waves[i])
+        {
+            //an action may have removed the rule
+            if (std::find(rules.begin(), rules.end(), rule) == rules.end())
+                continue;
+
+            if (!names.empty()) names += ", ";
+            names += rule->get_type() + "/" + rule->get_name();
+        }
+
+        chain += "[" + names + "]";
     }
 
-    mutex.unlock();
+    return chain;
 }
 
 void ListeRule::RemoveRule(Input *obj)
@@ -264,6 +484,8 @@ void ListeRule::updateAllRulesToInput(Input *oldio, Input *newio)
             }
         }
     }
+
+    invalidateRulesIndex();
 }
 
 void ListeRule::updateAllRulesToOutput(Output *oldio, Output *newio)
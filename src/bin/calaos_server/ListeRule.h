@@ -31,35 +31,106 @@
 #include <ListeRoom.h>
 #include <Room.h>
 #include <Ecore.h>
-#include <Mutex.h>
+#include <EcoreTimer.h>
+#include <unordered_set>
 
 using namespace std;
 
 namespace Calaos
 {
 
-typedef struct _rule_idler_cb
+//Maximum time an input of the event loop can wait before being checked again.
+//This is needed to catch up with wall clock changes (NTP, timezone, DST)
+#define EVENT_LOOP_MAX_SLEEP    60.0
+
+//Maximum number of waves of a propagation. A rule cascade that is still
+//changing ios after that is considered as a loop and is stopped.
+#define RULES_MAX_DEPTH         32
+
+//Statistics of one wave of a propagation
+class RulesWaveStats
+{
+public:
+    unsigned long ios = 0; //ios whose rules are checked
+    unsigned long rules_checked = 0;
+    unsigned long rules_fired = 0;
+    double duration = 0.0; //seconds
+};
+
+//Statistics of one propagation (an io signal and all the rules it cascaded to)
+class RulesPropagationStats
 {
-    string input;
-    Ecore_Idler *idler;
-} Rule_idler_cb;
+public:
+    unsigned long rules_checked = 0;
+    unsigned long rules_fired = 0;
+    int depth = 0; //number of waves
+    double duration = 0.0; //seconds
+    bool loop_detected = false;
+
+    vector<RulesWaveStats> waves;
+};
 
 class ListeRule: public sigc::trackable
 {
 protected:
     std::vector<Rule *> rules;
 
-    //these input's events are detected in the RunEventLoop() function
-    std::vector<Input *> in_event;
+    //these input's events are detected in the RunEventLoop() function.
+    //Inputs are ordered by the next time they need to be checked
+    typedef multimap<double, Input *> InputSchedule;
+    InputSchedule in_schedule;
+    unordered_map<Input *, InputSchedule::iterator> in_event;
+
+    //single timer set to the earliest deadline of in_schedule
+    EcoreTimer *event_timer;
+    double event_timer_deadline;
+    bool event_loop_started;
+    unsigned long event_wakeups;
+
+    //input being checked by RunEventLoop()
+    Input *event_current;
+    bool event_current_removed;
 
     //Rules for autoscenario
     list<Rule *> rules_scenarios;
 
     bool loop;
 
-    Mutex mutex;
-
-    ListeRule(): loop(false), mutex(false)
+    //ios that changed and whose rules need to be checked in the next wave
+    vector<string> pending_ios;
+    unordered_set<string> pending_set;
+    bool propagating;
+
+    RulesPropagationStats last_stats;
+    unsigned long propagation_count;
+    unsigned long loops_detected;
+    int max_depth;
+
+    //Check all rules of pending ios, wave after wave, until no more
+    //io is changed by the actions
+    void propagate();
+    string loopChain(const vector<vector<Rule *>> &waves);
+
+    //Reverse index io id -> rules to check when this io changes.
+    //It is rebuilt lazily by ExecuteRuleSignal() after a rule or an io
+    //used by a rule has been modified (see invalidateRulesIndex())
+    unordered_map<string, vector<Rule *>> rules_index;
+    bool index_dirty;
+
+    //incremented each time the index is invalidated, compiled conditions
+    //are rebuilt when it changes
+    unsigned long rules_generation;
+
+    void buildRulesIndex();
+
+    void scheduleInput(Input *in, double deadline);
+    void updateEventTimer();
+
+    ListeRule(): event_timer(NULL), event_timer_deadline(0.0),
+        event_loop_started(false), event_wakeups(0),
+        event_current(NULL), event_current_removed(false),
+        loop(false), propagating(false), propagation_count(0), loops_detected(0),
+        max_depth(0), index_dirty(true), rules_generation(0)
       { cDebugDom("rule"); }
 
 public:
@@ -70,9 +141,7 @@ public:
 
     void Add(Rule *p);
     void Remove(int i);
-    void Remove(Rule *obj)
-    { rules.erase(std::remove(rules.begin(), rules.end(), obj), rules.end());
-        rules_scenarios.erase(std::remove(rules_scenarios.begin(), rules_scenarios.end(), obj), rules_scenarios.end()); delete obj; }
+    void Remove(Rule *obj);
     void RemoveRule(Input *obj); //remove all rules containing obj
     void RemoveRule(Output *obj); //remove all rules containing obj
 
@@ -82,19 +151,41 @@ public:
     Rule *get_rule(int i);
     Rule *operator[] (int i) const;
 
-    void Add(Input *in) { in_event.push_back(in); }
-    void Remove(Input *in)
-    { in_event.erase(std::remove(in_event.begin(), in_event.end(), in), in_event.end()); }
+    void Add(Input *in);
+    void Remove(Input *in);
+    //Check this input as soon as possible. This needs to be called when
+    //something that changes the input's next deadline has been modified
+    //(params, time ranges, ...) or when a push source has new data for it
+    void WakeUp(Input *in);
     //Run a loop to detect event from inputs when time or temperature changes
+    //Only inputs that reached their deadline are checked, then the timer is
+    //set to wake up at the next deadline (see Input::getNextDeadline()).
+    //The first call starts the scheduler, StopLoop() stops it.
     void RunEventLoop();
     void StopLoop();
 
+    //Number of times the event loop woke up to check inputs
+    unsigned long getEventLoopWakeups() { return event_wakeups; }
+
     int size() { return rules.size(); }
 
+    //Needs to be called whenever conditions of a rule are changed
+    //outside of ListeRule, so that the dispatch index is updated
+    void invalidateRulesIndex() { index_dirty = true; rules_generation++; }
+    unsigned long getRulesGeneration() { return rules_generation; }
+
     //Execute all rules where the input 'input_id' is used
-    //The function is called only when a signal is emited from inputs
+    //The function is called only when a signal is emited from inputs.
+    //Signals emitted by the actions of those rules are queued and their
+    //rules are checked in the next wave, each rule at most once per wave.
     virtual void ExecuteRuleSignal(std::string input_id);
 
+    //Diagnostics of the rules propagation
+    const RulesPropagationStats &getLastPropagationStats() { return last_stats; }
+    unsigned long getPropagationCount() { return propagation_count; }
+    unsigned long getLoopsDetected() { return loops_detected; }
+    int getMaxDepth() { return max_depth; }
+
     /* This executes all rules at program startup. All rules with ConditionStart
                  * will be evaluated and executed (only once)
                  */
@@ -33,14 +33,72 @@ ScriptManager::ScriptManager()
 
 ScriptManager::~ScriptManager()
 {
+    for (ScriptState *state: statePool)
+    {
+        lua_close(state->L);
+        delete state;
+    }
+    statePool.clear();
+
     cDebugDom("script.lua");
 }
 
-bool ScriptManager::ExecuteScript(string script)
+static int Lua_readOnlyError(lua_State *L)
 {
-        bool ret = true;
-        errorScript = true;
+        return luaL_error(L, "attempt to modify a read-only table");
+}
+
+//Replace the table on top of the stack by a read-only proxy of it
+static void pushReadOnly(lua_State *L)
+{
+        lua_newtable(L);
+        lua_newtable(L);
+        lua_pushvalue(L, -3);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, Lua_readOnlyError);
+        lua_setfield(L, -2, "__newindex");
+        lua_pushboolean(L, 0);
+        lua_setfield(L, -2, "__metatable");
+        lua_setmetatable(L, -2);
+        lua_remove(L, -2);
+}
+
+static bool isReadOnly(lua_State *L, int idx)
+{
+        if (!lua_getmetatable(L, idx))
+                return false;
+
+        lua_getfield(L, -1, "__newindex");
+        bool ro = lua_tocfunction(L, -1) == Lua_readOnlyError;
+        lua_pop(L, 2);
+
+        return ro;
+}
+
+//rawset() that refuses the read-only proxies, it would bypass __newindex
+static int Lua_rawset(lua_State *L)
+{
+        luaL_checktype(L, 1, LUA_TTABLE);
+        luaL_checkany(L, 2);
+        luaL_checkany(L, 3);
+        if (isReadOnly(L, 1))
+                return Lua_readOnlyError(L);
+
+        lua_settop(L, 3);
+        lua_rawset(L, 1);
+
+        return 1;
+}
 
+//Replaces the functions removed from scripts, the name is the upvalue
+static int Lua_disabled(lua_State *L)
+{
+        return luaL_error(L, "%s() is not available in calaos scripts",
+                          lua_tostring(L, lua_upvalueindex(1)));
+}
+
+ScriptManager::ScriptState *ScriptManager::createState()
+{
         const luaL_Reg *l;
         lua_State *L = lua_open();
 
@@ -89,17 +147,119 @@ bool ScriptManager::ExecuteScript(string script)
 
         Lunar<Lua_Calaos>::Register(L);
 
-        Lua_Calaos lc;
-
-        Lunar<Lua_Calaos>::push(L, &lc);
+        Lunar<Lua_Calaos>::push(L, &luaCalaos);
         lua_setglobal(L, "calaos");
 
+        /* The state is reused by other scripts, they must not be able to
+         * change the tables shared with them. Libraries are only given as
+         * read-only proxies, their metatables and the one of strings are
+         * hidden from getmetatable() with __metatable, and the functions
+         * that could reach the global table fail with a clear error. */
+        const char *shared_libs[] = { LUA_TABLIBNAME, LUA_OSLIBNAME, LUA_STRLIBNAME,
+                                      LUA_MATHLIBNAME, LUA_COLIBNAME, NULL };
+        for (int i = 0;shared_libs[i];i++)
+        {
+                lua_getglobal(L, shared_libs[i]);
+                if (!lua_istable(L, -1))
+                {
+                        lua_pop(L, 1);
+                        continue;
+                }
+                pushReadOnly(L);
+                lua_setglobal(L, shared_libs[i]);
+        }
+
+        lua_pushstring(L, "");
+        if (lua_getmetatable(L, -1))
+        {
+                lua_pushboolean(L, 0);
+                lua_setfield(L, -2, "__metatable");
+                lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+
+        lua_register(L, "rawset", Lua_rawset);
+
+        const char *unsafe_funcs[] = { "getfenv", "setfenv", NULL };
+        for (int i = 0;unsafe_funcs[i];i++)
+        {
+                lua_pushstring(L, unsafe_funcs[i]);
+                lua_pushcclosure(L, Lua_disabled, 1);
+                lua_setglobal(L, unsafe_funcs[i]);
+        }
+
         //Set a hook to kill script in case of a wrong use (infinite loop, ...)
-        lua_sethook(L, Lua_DebugHook, LUA_MASKLINE | LUA_MASKCOUNT, 1);
+        //Time is only checked every SCRIPT_HOOK_COUNT instructions
+        lua_sethook(L, Lua_DebugHook, LUA_MASKCOUNT, SCRIPT_HOOK_COUNT);
 
-        start_time = ecore_time_get();
+        ScriptState *state = new ScriptState;
+        state->L = L;
+
+        return state;
+}
+
+void ScriptManager::releaseState(ScriptState *state)
+{
+        lua_settop(state->L, 0);
+
+        if (statePool.size() < SCRIPT_POOL_SIZE)
+        {
+                statePool.push_back(state);
+                return;
+        }
+
+        lua_close(state->L);
+        delete state;
+}
+
+//Push the compiled script on the stack, or the error message
+int ScriptManager::loadScript(ScriptState *state, const string &script)
+{
+        lua_State *L = state->L;
+
+        auto it = state->chunks.find(script);
+        if (it != state->chunks.end())
+        {
+                lua_rawgeti(L, LUA_REGISTRYINDEX, it->second);
+                return 0;
+        }
 
         int err = luaL_loadbuffer(L, script.c_str(), script.length(), "CalaosScript");
+        if (err) return err;
+
+        if (state->chunks.size() >= SCRIPT_CACHE_SIZE)
+        {
+                for (auto &chunk: state->chunks)
+                        luaL_unref(L, LUA_REGISTRYINDEX, chunk.second);
+                state->chunks.clear();
+        }
+
+        lua_pushvalue(L, -1);
+        state->chunks[script] = luaL_ref(L, LUA_REGISTRYINDEX);
+
+        return 0;
+}
+
+bool ScriptManager::ExecuteScript(const string &script)
+{
+        bool ret = true;
+        errorScript = true;
+
+        //A script can trigger another one, each run takes its own state
+        ScriptState *state;
+        if (statePool.empty())
+                state = createState();
+        else
+        {
+                state = statePool.back();
+                statePool.pop_back();
+        }
+        lua_State *L = state->L;
+
+        double prev_start_time = start_time;
+        start_time = ecore_time_get();
+
+        int err = loadScript(state, script);
         if (err)
         {
                 ret = false;
@@ -118,6 +278,20 @@ bool ScriptManager::ExecuteScript(string script)
         }
         else
         {
+                //Globals set by the script only live for this run,
+                //the shared ones are still readable. The metatable is
+                //locked so that the real globals can't be reached.
+                lua_newtable(L);
+                lua_pushvalue(L, -1);
+                lua_setfield(L, -2, "_G");
+                lua_newtable(L);
+                lua_pushvalue(L, LUA_GLOBALSINDEX);
+                lua_setfield(L, -2, "__index");
+                lua_pushboolean(L, 0);
+                lua_setfield(L, -2, "__metatable");
+                lua_setmetatable(L, -2);
+                lua_setfenv(L, -2);
+
                 if (setjmp(panic_jmp) == 1)
                 {
                         ret = false;
@@ -156,7 +330,8 @@ bool ScriptManager::ExecuteScript(string script)
                 }
         }
 
-        lua_close(L);
+        releaseState(state);
+        start_time = prev_start_time;
 
         return ret;
 }
@@ -24,6 +24,7 @@
 #include <Utils.h>
 
 #include <Ecore.h>
+#include <unordered_map>
 
 #include <ScriptBindings.h>
 
@@ -34,6 +35,15 @@ namespace Calaos
 //After that, it will be stopped.
 #define SCRIPT_MAX_EXEC_TIME    2.0
 
+//The execution time is checked every SCRIPT_HOOK_COUNT lua instructions
+#define SCRIPT_HOOK_COUNT       1000
+
+//Number of initialized lua states kept for the next scripts
+#define SCRIPT_POOL_SIZE        4
+
+//Maximum number of compiled scripts kept in each lua state
+#define SCRIPT_CACHE_SIZE       256
+
 
 static const luaL_Reg lua_libs[] =
 {
@@ -57,6 +67,21 @@ class ScriptManager
                 bool errorScript;
                 string errorMsg;
 
+                //A sandboxed lua state with the scripts already compiled in it
+                class ScriptState
+                {
+                        public:
+                                lua_State *L;
+                                unordered_map<string, int> chunks; //script -> registry ref
+                };
+
+                vector<ScriptState *> statePool;
+                Lua_Calaos luaCalaos;
+
+                ScriptState *createState();
+                void releaseState(ScriptState *state);
+                int loadScript(ScriptState *state, const string &script);
+
         public:
                 static ScriptManager &Instance()
                 {
@@ -69,7 +94,7 @@ class ScriptManager
                 /** Execute script and return true or false depending on
                   * the return value of the script
                   */
-                bool ExecuteScript(string script);
+                bool ExecuteScript(const string &script);
 
                 /** Retrieve the last error message
                   */
@@ -0,0 +1,299 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include "MsgPack.h"
+
+void MsgPackWriter::writeBE(uint64_t v, int bytes)
+{
+    for (int i = bytes - 1;i >= 0;i--)
+        buffer.push_back(char((v >> (i * 8)) & 0xFF));
+}
+
+void MsgPackWriter::writeHeader(uint8_t fix, uint8_t fixmax, uint8_t code8, uint8_t code16, uint8_t code32, uint32_t size)
+{
+    if (size <= fixmax)
+        buffer.push_back(char(fix | size));
+    else if (code8 && size <= 0xFF)
+    {
+        buffer.push_back(char(code8));
+        writeBE(size, 1);
+    }
+    else if (size <= 0xFFFF)
+    {
+        buffer.push_back(char(code16));
+        writeBE(size, 2);
+    }
+    else
+    {
+        buffer.push_back(char(code32));
+        writeBE(size, 4);
+    }
+}
+
+void MsgPackWriter::writeNil()
+{
+    buffer.push_back(char(0xC0));
+}
+
+void MsgPackWriter::writeBool(bool b)
+{
+    buffer.push_back(char(b?0xC3:0xC2));
+}
+
+void MsgPackWriter::writeInt(int64_t v)
+{
+    if (v >= 0 && v <= 0x7F)
+        buffer.push_back(char(v));
+    else if (v < 0 && v >= -32)
+        buffer.push_back(char(0xE0 | (v + 32)));
+    else if (v >= 0)
+    {
+        if (v <= 0xFF) { buffer.push_back(char(0xCC)); writeBE(v, 1); }
+        else if (v <= 0xFFFF) { buffer.push_back(char(0xCD)); writeBE(v, 2); }
+        else if (v <= 0xFFFFFFFFLL) { buffer.push_back(char(0xCE)); writeBE(v, 4); }
+        else { buffer.push_back(char(0xCF)); writeBE(v, 8); }
+    }
+    else
+    {
+        if (v >= -128) { buffer.push_back(char(0xD0)); writeBE(uint64_t(v), 1); }
+        else if (v >= -32768) { buffer.push_back(char(0xD1)); writeBE(uint64_t(v), 2); }
+        else if (v >= -2147483648LL) { buffer.push_back(char(0xD2)); writeBE(uint64_t(v), 4); }
+        else { buffer.push_back(char(0xD3)); writeBE(uint64_t(v), 8); }
+    }
+}
+
+void MsgPackWriter::writeDouble(double v)
+{
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+
+    buffer.push_back(char(0xCB));
+    writeBE(u, 8);
+}
+
+void MsgPackWriter::writeString(const char *s, size_t len)
+{
+    writeHeader(0xA0, 31, 0xD9, 0xDA, 0xDB, len);
+    buffer.append(s, len);
+}
+
+void MsgPackWriter::writeArray(uint32_t size)
+{
+    writeHeader(0x90, 15, 0, 0xDC, 0xDD, size);
+}
+
+void MsgPackWriter::writeMap(uint32_t size)
+{
+    writeHeader(0x80, 15, 0, 0xDE, 0xDF, size);
+}
+
+void MsgPackWriter::writeJson(const json_t *json)
+{
+    if (!json)
+    {
+        writeNil();
+        return;
+    }
+
+    switch (json_typeof(json))
+    {
+    case JSON_OBJECT:
+    {
+        writeMap(json_object_size(json));
+
+        const char *key;
+        json_t *value;
+        json_object_foreach((json_t *)json, key, value)
+        {
+            writeString(key, strlen(key));
+            writeJson(value);
+        }
+        break;
+    }
+    case JSON_ARRAY:
+    {
+        writeArray(json_array_size(json));
+        for (size_t i = 0;i < json_array_size(json);i++)
+            writeJson(json_array_get(json, i));
+        break;
+    }
+    case JSON_STRING:
+        writeString(json_string_value(json), strlen(json_string_value(json)));
+        break;
+    case JSON_INTEGER: writeInt(json_integer_value(json)); break;
+    case JSON_REAL: writeDouble(json_real_value(json)); break;
+    case JSON_TRUE: writeBool(true); break;
+    case JSON_FALSE: writeBool(false); break;
+    default: writeNil(); break;
+    }
+}
+
+class MsgPackReader
+{
+public:
+    MsgPackReader(const string &d): data((const uint8_t *)d.data()), size(d.size()) {}
+
+    const uint8_t *data;
+    size_t size;
+    size_t pos = 0;
+
+    bool readBE(int bytes, uint64_t &v)
+    {
+        if (size - pos < (size_t)bytes) return false;
+
+        v = 0;
+        for (int i = 0;i < bytes;i++)
+            v = (v << 8) | data[pos++];
+
+        return true;
+    }
+
+    json_t *readString(uint64_t len)
+    {
+        if (size - pos < len) return nullptr;
+
+        //json_stringn() needs jansson 2.7, it also rejects invalid UTF-8
+        string s((const char *)data + pos, len);
+        pos += len;
+
+        if (s.find('\0') != string::npos) return nullptr;
+        json_t *j = json_string(s.c_str());
+
+        return j;
+    }
+
+    json_t *read(int depth);
+};
+
+json_t *MsgPackReader::read(int depth)
+{
+    if (pos >= size || depth > MSGPACK_MAX_DEPTH)
+        return nullptr;
+
+    uint8_t c = data[pos++];
+    uint64_t v = 0;
+    uint64_t count = 0;
+    bool ismap = false;
+
+    if (c <= 0x7F) return json_integer(c);
+    if (c >= 0xE0) return json_integer(int8_t(c));
+    if ((c & 0xE0) == 0xA0) return readString(c & 0x1F);
+    if ((c & 0xF0) == 0x90) count = c & 0x0F;
+    else if ((c & 0xF0) == 0x80) { count = c & 0x0F; ismap = true; }
+    else
+    {
+        switch (c)
+        {
+        case 0xC0: return json_null();
+        case 0xC2: return json_false();
+        case 0xC3: return json_true();
+        case 0xCC: if (!readBE(1, v)) return nullptr; return json_integer(v);
+        case 0xCD: if (!readBE(2, v)) return nullptr; return json_integer(v);
+        case 0xCE: if (!readBE(4, v)) return nullptr; return json_integer(v);
+        case 0xCF: if (!readBE(8, v)) return nullptr; return json_integer(json_int_t(v));
+        case 0xD0: if (!readBE(1, v)) return nullptr; return json_integer(int8_t(v));
+        case 0xD1: if (!readBE(2, v)) return nullptr; return json_integer(int16_t(v));
+        case 0xD2: if (!readBE(4, v)) return nullptr; return json_integer(int32_t(v));
+        case 0xD3: if (!readBE(8, v)) return nullptr; return json_integer(int64_t(v));
+        case 0xCA:
+        {
+            if (!readBE(4, v)) return nullptr;
+            uint32_t u = v;
+            float f;
+            memcpy(&f, &u, sizeof(f));
+            return json_real(f);
+        }
+        case 0xCB:
+        {
+            if (!readBE(8, v)) return nullptr;
+            double d;
+            memcpy(&d, &v, sizeof(d));
+            return json_real(d);
+        }
+        //str and bin are both given as strings
+        case 0xD9: case 0xC4: if (!readBE(1, v)) return nullptr; return readString(v);
+        case 0xDA: case 0xC5: if (!readBE(2, v)) return nullptr; return readString(v);
+        case 0xDB: case 0xC6: if (!readBE(4, v)) return nullptr; return readString(v);
+        case 0xDC: if (!readBE(2, count)) return nullptr; break;
+        case 0xDD: if (!readBE(4, count)) return nullptr; break;
+        case 0xDE: if (!readBE(2, count)) return nullptr; ismap = true; break;
+        case 0xDF: if (!readBE(4, count)) return nullptr; ismap = true; break;
+        default: return nullptr; //ext types are not used
+        }
+    }
+
+    //each item is at least one byte
+    if (count > size - pos)
+        return nullptr;
+
+    json_t *j = ismap?json_object():json_array();
+    for (uint64_t i = 0;i < count;i++)
+    {
+        if (ismap)
+        {
+            json_t *key = read(depth + 1);
+            if (!key || !json_is_string(key))
+            {
+                if (key) json_decref(key);
+                json_decref(j);
+                return nullptr;
+            }
+
+            json_t *value = read(depth + 1);
+            if (!value)
+            {
+                json_decref(key);
+                json_decref(j);
+                return nullptr;
+            }
+
+            json_object_set_new(j, json_string_value(key), value);
+            json_decref(key);
+        }
+        else
+        {
+            json_t *value = read(depth + 1);
+            if (!value)
+            {
+                json_decref(j);
+                return nullptr;
+            }
+
+            json_array_append_new(j, value);
+        }
+    }
+
+    return j;
+}
+
+json_t *MsgPack::decode(const string &data)
+{
+    MsgPackReader reader(data);
+
+    json_t *j = reader.read(0);
+    if (j && reader.pos != reader.size)
+    {
+        //trailing data
+        json_decref(j);
+        return nullptr;
+    }
+
+    return j;
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef S_MsgPack_H
+#define S_MsgPack_H
+
+#include "Calaos.h"
+#include <jansson.h>
+
+using namespace Calaos;
+
+//Max nesting of arrays and maps of a decoded message
+#define MSGPACK_MAX_DEPTH       32
+
+/*
+ * MessagePack encoding of the V3 API messages, used when a client asks for
+ * it instead of JSON. Strings are written as UTF-8 without escaping.
+ *
+ * The writer appends to a string, maps and arrays are written with their
+ * number of items first. Data already encoded can be inserted with
+ * writeRaw().
+ */
+class MsgPackWriter
+{
+public:
+    MsgPackWriter() {}
+
+    void writeNil();
+    void writeBool(bool b);
+    void writeInt(int64_t v);
+    void writeDouble(double v);
+    void writeString(const char *s, size_t len);
+    void writeString(const char *s) { writeString(s, strlen(s)); }
+    void writeString(const string &s) { writeString(s.data(), s.size()); }
+    void writeArray(uint32_t size);
+    void writeMap(uint32_t size);
+    void writeRaw(const string &encoded) { buffer += encoded; }
+
+    //Encode a jansson value
+    void writeJson(const json_t *json);
+
+    const string &getData() const { return buffer; }
+    string &getData() { return buffer; }
+
+private:
+    string buffer;
+
+    void writeHeader(uint8_t fix, uint8_t fixmax, uint8_t code8, uint8_t code16, uint8_t code32, uint32_t size);
+    void writeBE(uint64_t v, int bytes);
+};
+
+namespace MsgPack
+{
+//Decode a message to a jansson value, nullptr if it is malformed.
+//Map keys must be strings.
+json_t *decode(const string &data);
+}
+
+#endif
@@ -27,6 +27,24 @@
 namespace Calaos
 {
 
+//An action string parsed once by Output::parseCommand(). Rules keep it to
+//run the action again without any string handling.
+class OutputCommand
+{
+public:
+    OutputCommand() {}
+    OutputCommand(const std::string &a): action(a) {}
+
+    //not parsed, action is given back to set_value(string)
+    enum { CmdString = 0 };
+
+    int cmd = CmdString; //command id, defined by each output type
+    std::string action; //the full action string
+    std::string arg; //string argument of the command
+    int ivalue = 0;
+    ColorValue color;
+};
+
 class Output: public IOBase
 {
 protected:
@@ -42,6 +60,12 @@ public:
     virtual bool set_value(double val)  { return false; }
     virtual bool set_value(std::string val)  { return false; }
 
+    //Parse an action string once, execCommand() can then run it as many
+    //times as needed. Outputs that don't parse their actions just get the
+    //string back in set_value(string)
+    virtual OutputCommand parseCommand(const std::string &val) { return OutputCommand(val); }
+    virtual bool execCommand(const OutputCommand &cmd) { return set_value(cmd.action); }
+
     //used to retreive the last state command of the TSTRING output
     virtual std::string get_command_string() { return ""; }
 
@@ -19,18 +19,16 @@
  **
  ******************************************************************************/
 #include <PollListenner.h>
-#include <IPC.h>
 
 using namespace Calaos;
 
-PollObject::PollObject(string _uuid):
+PollObject::PollObject(string _uuid, uint64_t _cursor):
     uuid(_uuid),
-    timeout(NULL)
+    timeout(NULL),
+    cursor(_cursor)
 {
     timeout = new EcoreTimer(TIMEOUT_POLLLISTENNER, (sigc::slot<void>)sigc::mem_fun(*this, &PollObject::Timeout_cb));
 
-    EventManager::Instance().newEvent.connect(sigc::mem_fun(*this, &PollObject::handleEvents));
-
     cDebugDom("poll_listener") << "New object for " << uuid;
 }
 
@@ -42,16 +40,9 @@ PollObject::~PollObject()
         timeout = NULL;
     }
 
-    IPC::Instance().DeleteHandler(sig_events);
-
     cDebugDom("poll_listener") << "Cleaning object " << uuid;
 }
 
-void PollObject::handleEvents(const CalaosEvent &ev)
-{
-    events.push_back(ev);
-}
-
 Eina_Bool _timeout_poll_idler_cb(void *data)
 {
     PollObject *obj = reinterpret_cast<PollObject *>(data);
@@ -73,8 +64,20 @@ void PollObject::Timeout_cb()
     ecore_idler_add(_timeout_poll_idler_cb, this);
 }
 
-PollListenner::PollListenner()
+PollListenner::PollListenner():
+    events(POLLLISTENNER_MAX_EVENTS)
 {
+    EventManager::Instance().newEvent.connect(sigc::mem_fun(*this, &PollListenner::handleEvents));
+}
+
+void PollListenner::handleEvents(const CalaosEvent &ev)
+{
+    //nobody to read it
+    if (pollobjects.empty())
+        return;
+
+    events[next_seq % events.size()] = std::make_shared<const CalaosEvent>(ev);
+    next_seq++;
 }
 
 PollListenner::~PollListenner()
@@ -93,7 +96,7 @@ string PollListenner::Register()
     ssUuid << std::setw(4) << (rand() & 0xffff) << std::setw(4) << (rand() & 0xffff)<< std::setw(4) << (rand() & 0xffff);
 
     string uuid = ssUuid.str();
-    pollobjects[uuid] = new PollObject(uuid);
+    pollobjects[uuid] = new PollObject(uuid, next_seq);
 
     cDebugDom("poll_listener") << "uuid:" << uuid;
 
@@ -118,12 +121,19 @@ bool PollListenner::Unregister(string uuid)
 
     pollobjects.erase(uuid);
 
+    //release the events nobody will read
+    if (pollobjects.empty())
+    {
+        for (auto &e: events)
+            e.reset();
+    }
+
     cDebugDom("poll_listener") << "uuid:" << uuid;
 
     return true;
 }
 
-bool PollListenner::GetEvents(string uuid, list<CalaosEvent> &events)
+bool PollListenner::GetEvents(string uuid, PollEvents &pevents)
 {
     if (pollobjects.find(uuid) == pollobjects.end())
     {
@@ -133,8 +143,21 @@ bool PollListenner::GetEvents(string uuid, list<CalaosEvent> &events)
 
     PollObject *o = pollobjects[uuid];
 
-    events = o->getEvents();
-    o->clearEvents();
+    pevents.ring = &events;
+    pevents.first = o->cursor;
+    pevents.last = next_seq;
+    pevents.resync = false;
+
+    //the oldest events of that client have been overwritten
+    if (next_seq - o->cursor > events.size())
+    {
+        cDebugDom("poll_listener") << "uuid:" << uuid << " lost " << next_seq - o->cursor - events.size() << " events";
+
+        pevents.first = next_seq;
+        pevents.resync = true;
+    }
+
+    o->cursor = next_seq;
     o->ResetTimer();
 
     return true;
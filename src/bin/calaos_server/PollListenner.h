@@ -27,40 +27,71 @@
 
 #define TIMEOUT_POLLLISTENNER   300.0
 
+//Number of events kept for all poll clients. A client that did not poll
+//before that many events came gets a resync instead of them.
+#define POLLLISTENNER_MAX_EVENTS        2048
+
 namespace Calaos
 {
 
-class PollObject
+//Events are stored once and shared by all poll clients
+typedef std::shared_ptr<const CalaosEvent> CalaosEventPtr;
+
+/*
+ * Events of a client for one GetEvents(), it points to the events of the
+ * shared ring and is only valid until the next return to the main loop.
+ */
+class PollEvents
 {
 private:
-    sigc::signal<void, string, string, void*, void*> sig_events;
+    const vector<CalaosEventPtr> *ring = nullptr;
+    uint64_t first = 0;
+    uint64_t last = 0;
+    bool resync = false;
 
+    friend class PollListenner;
+
+public:
+    size_t size() const { return last - first; }
+    const CalaosEvent &operator[](size_t i) const { return *(*ring)[(first + i) % ring->size()]; }
+
+    //true if events were lost, the client needs to read all states again
+    bool needResync() const { return resync; }
+};
+
+class PollObject
+{
+private:
     string uuid;
     EcoreTimer *timeout; //timer that invalidates uuid after some time of inactivity
 
-    //IPC callback to handle all events from the system
-    void handleEvents(const CalaosEvent &ev);
-
     //Timeout callback
     void Timeout_cb();
 
-    list<CalaosEvent> events;
+    //sequence number of the next event to give to the client
+    uint64_t cursor;
+
+    friend class PollListenner;
 
 public:
-    PollObject(string uuid);
+    PollObject(string uuid, uint64_t cursor);
     ~PollObject();
 
-    list<CalaosEvent> &getEvents() { return events; }
     string getUUID() { return uuid; }
     void ResetTimer() { timeout->Reset(); }
-    void clearEvents() { events.clear(); }
 };
 
-class PollListenner
+class PollListenner: public sigc::trackable
 {
 private:
     map<string, PollObject *> pollobjects;
 
+    //ring of the last events, event with sequence number n is at n % size
+    vector<CalaosEventPtr> events;
+    uint64_t next_seq = 0;
+
+    void handleEvents(const CalaosEvent &ev);
+
     PollListenner();
 
 public:
@@ -82,7 +113,7 @@ public:
     bool Unregister(string uuid);
 
     // Get events for the registered uuid, return false if error
-    bool GetEvents(string uuid, list<CalaosEvent> &events);
+    bool GetEvents(string uuid, PollEvents &events);
 };
 
 }
@@ -20,6 +20,7 @@
  ******************************************************************************/
 #include <Rule.h>
 #include <Rules/RulesFactory.h>
+#include <ListeRule.h>
 
 using namespace Calaos;
 
@@ -48,6 +49,8 @@ void Rule::AddCondition(Condition *cond)
 {
     conds.push_back(cond);
 
+    ListeRule::Instance().invalidateRulesIndex();
+
     cDebugDom("rule");
 }
 
@@ -111,6 +114,8 @@ void Rule::RemoveCondition(int pos)
     for (int i = 0;i < pos;iter++, i++) ;
     conds.erase(iter);
 
+    ListeRule::Instance().invalidateRulesIndex();
+
     cDebugDom("rule");
 }
 
@@ -34,111 +34,135 @@ ActionStd::~ActionStd()
 void ActionStd::Add(Output *out)
 {
     outputs.push_back(out);
+    plans_dirty = true;
 
     cDebugDom("rule.action.standard") <<  "Output(" << out->get_param("id") << ") added";
 }
 
-bool ActionStd::Execute()
+void ActionStd::compile()
 {
-    std::string tmp;
-    bool ret = true;
-    std::string sval;
-    bool bval;
-    double dval;
+    plans.clear();
+    plans.reserve(outputs.size());
 
     for (uint i = 0;i < outputs.size();i++)
     {
-        bool ovar = false;
-        switch (outputs[i]->get_type())
-        {
-        case TBOOL:
+        ActionPlan p;
+        p.output = outputs[i];
+
+        std::string id = p.output->get_param("id");
+        std::string var_id = params_var[id];
+        if (var_id != "")
         {
-            if (params_var[outputs[i]->get_param("id")] != "")
-            {
-                std::string var_id = params_var[outputs[i]->get_param("id")];
-                Output *out = ListeRoom::Instance().get_output(var_id);
-                if (out && out->get_type() == TBOOL)
-                {
-                    bval = out->get_value_bool();
-                    ovar = true;
-                }
-            }
+            Output *out = ListeRoom::Instance().get_output(var_id);
+            if (out && out->get_type() == p.output->get_type())
+                p.var = out;
+        }
 
-            if (ovar)
-            {
-                if (!outputs[i]->set_value(bval)) ret = false;
-            }
-            else if (params[outputs[i]->get_param("id")] == "true")
+        std::string tmp = params[id];
+
+        switch (p.output->get_type())
+        {
+        case TBOOL:
+            if (p.var) break;
+            if (tmp == "true")
             {
-                if (!outputs[i]->set_value(true)) ret = false;
+                p.set = ActionPlan::SetBool;
+                p.bval = true;
             }
-            else if (params[outputs[i]->get_param("id")] == "false")
+            else if (tmp == "false")
             {
-                if (!outputs[i]->set_value(false)) ret = false;
+                p.set = ActionPlan::SetBool;
+                p.bval = false;
             }
             else
             {
-                if (!outputs[i]->set_value(params[outputs[i]->get_param("id")])) ret = false;
+                p.set = ActionPlan::SetCommand;
+                p.cmd = p.output->parseCommand(tmp);
             }
             break;
-        }
         case TINT:
-        {
-            if (params_var[outputs[i]->get_param("id")] != "")
-            {
-                std::string var_id = params_var[outputs[i]->get_param("id")];
-                Output *out = ListeRoom::Instance().get_output(var_id);
-                if (out && out->get_type() == TINT)
-                {
-                    dval = out->get_value_double();
-                    ovar = true;
-                }
-            }
-            tmp = params[outputs[i]->get_param("id")];
-
-            if (ovar)
+            if (p.var) break;
+            if (is_of_type<double>(tmp))
             {
-                if (!outputs[i]->set_value(dval)) ret = false;
-            }
-            else if (is_of_type<double>(tmp))
-            {
-                if (!outputs[i]->set_value(atof(tmp.c_str()))) ret = false;
+                p.set = ActionPlan::SetDouble;
+                p.dval = atof(tmp.c_str());
             }
             else
             {
-                if (!outputs[i]->set_value(tmp)) ret = false;
+                p.set = ActionPlan::SetCommand;
+                p.cmd = p.output->parseCommand(tmp);
             }
             break;
-        }
         case TSTRING:
-        {
-            if (params_var[outputs[i]->get_param("id")] != "")
+            if (p.var) break;
+            if (tmp != "")
             {
-                std::string var_id = params_var[outputs[i]->get_param("id")];
-                Output *out = ListeRoom::Instance().get_output(var_id);
-                if (out && out->get_type() == TSTRING)
-                {
-                    sval = out->get_command_string();
-                    ovar = true;
-                }
+                p.set = ActionPlan::SetCommand;
+                p.cmd = p.output->parseCommand(tmp);
             }
-            tmp = params[outputs[i]->get_param("id")];
+            break;
+        default: break;
+        }
 
-            if (ovar)
-            {
-                if (!outputs[i]->set_value(sval)) ret = false;
-            }
-            else if (tmp != "")
+        plans.push_back(p);
+    }
+
+    plans_dirty = false;
+    plans_generation = ListeRule::Instance().getRulesGeneration();
+}
+
+bool ActionStd::Execute()
+{
+    bool ret = true;
+
+    //outputs can run this action again from their signal, plans
+    //are only rebuilt by the outer call
+    if (exec_depth == 0 &&
+        (plans_dirty || plans_generation != ListeRule::Instance().getRulesGeneration()))
+        compile();
+
+    exec_depth++;
+
+    for (uint i = 0;i < plans.size();i++)
+    {
+        const ActionPlan &p = plans[i];
+
+        if (p.var)
+        {
+            switch (p.output->get_type())
             {
-                if (!outputs[i]->set_value(tmp)) ret = false;
+            case TBOOL:
+                if (!p.output->set_value(p.var->get_value_bool())) ret = false;
+                break;
+            case TINT:
+                if (!p.output->set_value(p.var->get_value_double())) ret = false;
+                break;
+            case TSTRING:
+                if (!p.output->set_value(p.var->get_command_string())) ret = false;
+                break;
+            default: break;
             }
 
-            break;
+            continue;
         }
+
+        switch (p.set)
+        {
+        case ActionPlan::SetBool:
+            if (!p.output->set_value(p.bval)) ret = false;
+            break;
+        case ActionPlan::SetDouble:
+            if (!p.output->set_value(p.dval)) ret = false;
+            break;
+        case ActionPlan::SetCommand:
+            if (!p.output->execCommand(p.cmd)) ret = false;
+            break;
         default: break;
         }
     }
 
+    exec_depth--;
+
     if (ret)
         cDebugDom("rule.action.standard") <<  "Ok";
     else
@@ -152,6 +176,7 @@ void ActionStd::Remove(int pos)
     vector<Output *>::iterator iter = outputs.begin();
     for (int i = 0;i < pos;iter++, i++) ;
     outputs.erase(iter);
+    plans_dirty = true;
 
     cDebugDom("rule.action.standard") <<  "Ok";
 }
@@ -159,6 +184,7 @@ void ActionStd::Remove(int pos)
 void ActionStd::Assign(int i, Output *obj)
 {
     outputs[i] = obj;
+    plans_dirty = true;
 }
 
 bool ActionStd::LoadFromXml(TiXmlElement *node)
@@ -198,6 +224,8 @@ bool ActionStd::LoadFromXml(TiXmlElement *node)
         }
     }
 
+    compile();
+
     return true;
 }
 
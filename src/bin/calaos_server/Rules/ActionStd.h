@@ -38,6 +38,28 @@ protected:
     //based on another output state
     Params params_var;
 
+    //params and params_var of an output parsed for Execute()
+    class ActionPlan
+    {
+    public:
+        Output *output = nullptr;
+        Output *var = nullptr; //output to copy the state from, if any
+        enum { SetNone, SetBool, SetDouble, SetCommand };
+        int set = SetNone;
+        bool bval = false;
+        double dval = 0.0;
+        OutputCommand cmd;
+    };
+
+    std::vector<ActionPlan> plans;
+    bool plans_dirty = true;
+    unsigned long plans_generation = 0;
+    int exec_depth = 0;
+
+    //Needs to be done again if params or outputs changed, or if an output
+    //was added or removed (see ListeRule::invalidateRulesIndex())
+    void compile();
+
 public:
     ActionStd(): Action(ACTION_STD)
     { cDebugDom("rule.action.standard") <<  "New standard action"; }
@@ -49,10 +71,11 @@ public:
     void Assign(int i, Output *obj);
 
     Output *get_output(int i) { return outputs[i]; }
-    Params &get_params() { return params; }
-    void set_param(Params &p) { params = p; }
-    Params &get_params_var() { return params_var; }
-    void set_param_var(Params &p) { params_var = p; }
+    //params can be modified through the references
+    Params &get_params() { plans_dirty = true; return params; }
+    void set_param(Params &p) { params = p; plans_dirty = true; }
+    Params &get_params_var() { plans_dirty = true; return params_var; }
+    void set_param_var(Params &p) { params_var = p; plans_dirty = true; }
 
     int get_size() { return outputs.size(); }
 
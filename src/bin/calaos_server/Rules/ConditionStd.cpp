@@ -37,6 +37,9 @@ ConditionStd::~ConditionStd()
 void ConditionStd::Add(Input *in)
 {
     inputs.push_back(in);
+    compiled_dirty = true;
+
+    ListeRule::Instance().invalidateRulesIndex();
 
     cDebugDom("rule.condition.standard") <<  "Input(" << in->get_param("id") << ") added";
 }
@@ -57,122 +60,128 @@ void ConditionStd::getVarIds(vector<Input *> &list)
     }
 }
 
-bool ConditionStd::Evaluate()
+int ConditionStd::parseOperator(const string &oper)
 {
-    std::string sval, oper;
-    bool bval = false;
-    double dval = 0.0;
-    bool ret = false;
+    if (oper == "==") return OpEqual;
+    if (oper == "!=") return OpNotEqual;
+    if (oper == "SUP") return OpSup;
+    if (oper == "SUP=") return OpSupEqual;
+    if (oper == "INF") return OpInf;
+    if (oper == "INF=") return OpInfEqual;
+
+    return OpInvalid;
+}
+
+void ConditionStd::compile()
+{
+    compiled.clear();
+    compiled.reserve(inputs.size());
 
     for (uint i = 0;i < inputs.size();i++)
     {
-        bool ovar = false;
-        bool changed = false;
-        switch (inputs[i]->get_type())
+        CompiledInput c;
+        c.input = inputs[i];
+
+        std::string id = c.input->get_param("id");
+        c.oper_str = ops[id];
+        c.oper = parseOperator(c.oper_str);
+
+        std::string var_id = params_var[id];
+        if (var_id != "")
+        {
+            Input *in = ListeRoom::Instance().get_input(var_id);
+            if (in && in->get_type() == c.input->get_type())
+                c.var = in;
+        }
+
+        std::string val = params[id];
+
+        switch (c.input->get_type())
         {
         case TBOOL:
-            if (params_var[inputs[i]->get_param("id")] != "")
-            {
-                std::string var_id = params_var[inputs[i]->get_param("id")];
-                Input *in = ListeRoom::Instance().get_input(var_id);
-                if (in && in->get_type() == TBOOL)
-                {
-                    bval = in->get_value_bool();
-                    ovar = true;
-                }
-            }
+            if (c.var) break;
+            if (val == "true")
+                c.bval = true;
+            else if (val == "false")
+                c.bval = false;
+            else if (val == "changed")
+                c.changed = true;
+            else
+                c.valid = false;
+            break;
+        case TINT:
+            if (c.var) break;
+            if (val == "")
+                c.valid = false;
+            else if (val == "changed")
+                c.changed = true;
+            else
+                c.dval = atof(val.c_str());
+            break;
+        case TSTRING:
+            if (c.var) break;
+            c.sval = Utils::url_decode2(val);
+            if (c.sval == "changed") c.changed = true;
+            break;
+        default: break;
+        }
 
-            if (!ovar)
-            {
-                if (params[inputs[i]->get_param("id")] == "true")
-                    bval = true;
-                else if (params[inputs[i]->get_param("id")] == "false")
-                    bval = false;
-                else if (params[inputs[i]->get_param("id")] == "changed")
-                    changed = true;
-                else
-                {
-                    cWarningDom("rule.condition.standard") <<  "get_value(bool) not bool !";
-                    ret = false;
-                    break;
-                }
-            }
+        compiled.push_back(c);
+    }
+
+    compiled_dirty = false;
+    compiled_generation = ListeRule::Instance().getRulesGeneration();
+}
+
+bool ConditionStd::Evaluate()
+{
+    bool ret = false;
 
-            if (!changed)
+    if (compiled_dirty ||
+        compiled_generation != ListeRule::Instance().getRulesGeneration())
+        compile();
+
+    for (uint i = 0;i < compiled.size();i++)
+    {
+        const CompiledInput &c = compiled[i];
+
+        switch (c.input->get_type())
+        {
+        case TBOOL:
+            if (!c.valid)
             {
-                oper = ops[inputs[i]->get_param("id")];
-                ret = eval(inputs[i]->get_value_bool(), oper, bval);
+                cWarningDom("rule.condition.standard") <<  "get_value(bool) not bool !";
+                ret = false;
+                break;
             }
+
+            if (!c.changed)
+                ret = eval(c.input->get_value_bool(), c, c.var?c.var->get_value_bool():c.bval);
             else
-            {
                 ret = true;
-            }
             break;
         case TINT:
-            if (params_var[inputs[i]->get_param("id")] != "")
+            if (!c.valid)
             {
-                std::string var_id = params_var[inputs[i]->get_param("id")];
-                Input *in = ListeRoom::Instance().get_input(var_id);
-                if (in && in->get_type() == TINT)
-                {
-                    dval = in->get_value_double();
-                    sval = "ovar";
-                    ovar = true;
-                }
+                cWarningDom("rule.condition.standard") <<  "get_value(int) not int !";
+                break;
             }
 
-            if (!ovar)
-                sval = params[inputs[i]->get_param("id")];
-
-            if (sval != "")
-            {
-                if (!ovar)
-                {
-                    if (sval == "changed")
-                        changed = true;
-                    else
-                        dval = atof(sval.c_str());
-                }
-
-                if (!changed)
-                {
-                    oper = ops[inputs[i]->get_param("id")];
-                    ret = eval(inputs[i]->get_value_double(), oper, dval);
-                }
-                else
-                {
-                    ret = true;
-                }
-            }
+            if (!c.changed)
+                ret = eval(c.input->get_value_double(), c, c.var?c.var->get_value_double():c.dval);
             else
-                cWarningDom("rule.condition.standard") <<  "get_value(int) not int !";
+                ret = true;
             break;
         case TSTRING:
-            if (params_var[inputs[i]->get_param("id")] != "")
-            {
-                std::string var_id = params_var[inputs[i]->get_param("id")];
-                Input *in = ListeRoom::Instance().get_input(var_id);
-                if (in && in->get_type() == TSTRING)
-                {
-                    sval = in->get_value_string();
-                    ovar = true;
-                }
-            }
-            if (!ovar)
+            if (!c.changed)
             {
-                sval = Utils::url_decode2(params[inputs[i]->get_param("id")]);
-                if (sval == "changed") changed = true;
-            }
-
-            if (!changed)
-            {
-                oper = ops[inputs[i]->get_param("id")];
-                ret = eval(inputs[i]->get_value_string(), oper, sval);
+                if (c.var)
+                    ret = eval(c.input->get_value_string(), c, c.var->get_value_string());
+                else
+                    ret = eval(c.input->get_value_string(), c, c.sval);
             }
             else
-            {
                 ret = true;
-            }
             break;
         default: break;
         }
@@ -191,6 +200,9 @@ void ConditionStd::Remove(int pos)
     vector<Input *>::iterator iter = inputs.begin();
     for (int i = 0;i < pos;iter++, i++) ;
     inputs.erase(iter);
+    compiled_dirty = true;
+
+    ListeRule::Instance().invalidateRulesIndex();
 
     cDebugDom("rule.condition.standard");
 }
@@ -198,111 +210,47 @@ void ConditionStd::Remove(int pos)
 void ConditionStd::Assign(int i, Input *obj)
 {
     inputs[i] = obj;
+    compiled_dirty = true;
+
+    ListeRule::Instance().invalidateRulesIndex();
 }
 
-bool ConditionStd::eval(bool val1, std::string oper, bool val2)
+bool ConditionStd::eval(bool val1, const CompiledInput &c, bool val2)
 {
-    if (oper != "!=" && oper != "==")
-    {
-        cErrorDom("rule.condition.standard") <<  "Invalid operator (" << oper << ")";
-        return false;
-    }
+    if (c.oper == OpEqual)
+        return val1 == val2;
+    if (c.oper == OpNotEqual)
+        return val1 != val2;
 
-    if (oper == "==")
-    {
-        if (val1 == val2)
-            return true;
-        else
-            return false;
-    }
-
-    if (oper == "!=")
-    {
-        if (val1 != val2)
-            return true;
-        else
-            return false;
-    }
+    cErrorDom("rule.condition.standard") <<  "Invalid operator (" << c.oper_str << ")";
 
     return false;
 }
 
-bool ConditionStd::eval(double val1, std::string oper, double val2)
+bool ConditionStd::eval(double val1, const CompiledInput &c, double val2)
 {
-    if (oper == "==")
-    {
-        if (val1 == val2)
-            return true;
-        else
-            return false;
-    }
-
-    if (oper == "!=")
-    {
-        if (val1 != val2)
-            return true;
-        else
-            return false;
-    }
-
-    if (oper == "SUP")
-    {
-        if (val1 > val2)
-            return true;
-        else
-            return false;
-    }
-
-    if (oper == "SUP=")
-    {
-        if (val1 >= val2)
-            return true;
-        else
-            return false;
-    }
-
-    if (oper == "INF")
+    switch (c.oper)
     {
-        if (val1 < val2)
-            return true;
-        else
-            return false;
-    }
-
-    if (oper == "INF=")
-    {
-        if (val1 <= val2)
-            return true;
-        else
-            return false;
+    case OpEqual: return val1 == val2;
+    case OpNotEqual: return val1 != val2;
+    case OpSup: return val1 > val2;
+    case OpSupEqual: return val1 >= val2;
+    case OpInf: return val1 < val2;
+    case OpInfEqual: return val1 <= val2;
+    default: break;
     }
 
     return false;
 }
 
-bool ConditionStd::eval(std::string val1, std::string oper, std::string val2)
+bool ConditionStd::eval(const std::string &val1, const CompiledInput &c, const std::string &val2)
 {
-    if (oper != "!=" && oper != "==")
-    {
-        cErrorDom("rule.condition.standard") <<  "Invalid operator (" << oper << ")";
-        return false;
-    }
+    if (c.oper == OpEqual)
+        return val1 == val2;
+    if (c.oper == OpNotEqual)
+        return val1 != val2;
 
-    if (oper == "==")
-    {
-        if (val1 == val2)
-            return true;
-        else
-            return false;
-    }
-
-    if (oper == "!=")
-    {
-        if (val1 != val2)
-            return true;
-        else
-            return false;
-    }
+    cErrorDom("rule.condition.standard") <<  "Invalid operator (" << c.oper_str << ")";
 
     return false;
 }
@@ -347,6 +295,8 @@ bool ConditionStd::LoadFromXml(TiXmlElement *node)
         }
     }
 
+    compile();
+
     return true;
 }
 
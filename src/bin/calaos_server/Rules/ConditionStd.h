@@ -39,9 +39,35 @@ protected:
     Params params_var;
     bool trigger = true;
 
-    bool eval(bool val1, std::string oper, bool val2);
-    bool eval(double val1, std::string oper, double val2);
-    bool eval(std::string val1, std::string oper, std::string val2);
+    enum { OpInvalid, OpEqual, OpNotEqual, OpSup, OpSupEqual, OpInf, OpInfEqual };
+
+    //params, ops and params_var of an input parsed for Evaluate()
+    class CompiledInput
+    {
+    public:
+        Input *input = nullptr;
+        Input *var = nullptr; //input to compare with, if any
+        int oper = OpInvalid;
+        string oper_str;
+        bool changed = false;
+        bool valid = true;
+        bool bval = false;
+        double dval = 0.0;
+        string sval;
+    };
+
+    std::vector<CompiledInput> compiled;
+    bool compiled_dirty = true;
+    unsigned long compiled_generation = 0;
+
+    //Needs to be done again if params or inputs changed, or if an input
+    //used in rules was added or removed (see ListeRule::invalidateRulesIndex())
+    void compile();
+
+    static int parseOperator(const string &oper);
+    bool eval(bool val1, const CompiledInput &c, bool val2);
+    bool eval(double val1, const CompiledInput &c, double val2);
+    bool eval(const std::string &val1, const CompiledInput &c, const std::string &val2);
 
 public:
     ConditionStd();
@@ -57,12 +83,13 @@ public:
     bool useForTrigger() { return trigger; }
 
     Input *get_input(int i) { return inputs[i]; }
-    Params &get_params() { return params; }
-    Params &get_operator() { return ops; }
-    Params &get_params_var() { return params_var; }
-    void set_param(Params &p) { params = p; }
-    void set_operator(Params &p) { ops = p; }
-    void set_param_var(Params &p) { params_var = p; }
+    //params can be modified through the references
+    Params &get_params() { compiled_dirty = true; return params; }
+    Params &get_operator() { compiled_dirty = true; return ops; }
+    Params &get_params_var() { compiled_dirty = true; return params_var; }
+    void set_param(Params &p) { params = p; compiled_dirty = true; }
+    void set_operator(Params &p) { ops = p; compiled_dirty = true; }
+    void set_param_var(Params &p) { params_var = p; compiled_dirty = true; }
 
     int get_size() { return inputs.size(); }
 
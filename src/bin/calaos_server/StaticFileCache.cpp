@@ -0,0 +1,383 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include "StaticFileCache.h"
+#include "WorkerPool.h"
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//content that is worth compressing
+static const char *compressible_ext[] = { "html", "htm", "js", "css", "json", "svg", "xml", "txt", "map", "ttf", "eot", nullptr };
+
+static bool acceptsEncoding(const string &accept_encoding, const string &encoding)
+{
+    vector<string> tokens;
+    Utils::split(accept_encoding, tokens, ",");
+
+    bool any = false;
+    for (uint i = 0;i < tokens.size();i++)
+    {
+        vector<string> params;
+        Utils::split(tokens[i], params, ";");
+        if (params.empty()) continue;
+
+        string name = Utils::str_to_lower(Utils::trim(params[0]));
+        double q = 1.0;
+        for (uint j = 1;j < params.size();j++)
+        {
+            string p = Utils::trim(params[j]);
+            if (Utils::strStartsWith(p, "q="))
+                Utils::from_string(p.substr(2), q);
+        }
+
+        if (name == encoding)
+            return q > 0.0;
+        if (name == "*")
+            any = q > 0.0;
+    }
+
+    return any;
+}
+
+//webpack like file names: app.3f2a9c1b.js or app-3f2a9c1b.js
+static bool hasContentHash(const string &fileName)
+{
+    string base = fileName.substr(fileName.find_last_of('/') + 1);
+
+    vector<string> tokens;
+    Utils::split(base, tokens, ".-");
+
+    //last token is the extension
+    for (int i = 0;i < (int)tokens.size() - 1;i++)
+    {
+        const string &t = tokens[i];
+        if (t.size() < 8) continue;
+
+        bool hex = true, digit = false;
+        for (uint j = 0;j < t.size() && hex;j++)
+        {
+            hex = isxdigit((unsigned char)t[j]) && !isupper((unsigned char)t[j]);
+            if (isdigit((unsigned char)t[j])) digit = true;
+        }
+
+        if (hex && digit)
+            return true;
+    }
+
+    return false;
+}
+
+static string hashContent(const char *data, size_t size)
+{
+    //FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0;i < size;i++)
+    {
+        h ^= (uint8_t)data[i];
+        h *= 1099511628211ULL;
+    }
+
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+
+    return string(buf);
+}
+
+static bool readFile(int fd, size_t size, string &content)
+{
+    content.resize(size);
+
+    size_t pos = 0;
+    while (pos < size)
+    {
+        ssize_t r = read(fd, &content[pos], size - pos);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return false;
+        if (r == 0) break; //file truncated meanwhile
+        pos += r;
+    }
+    content.resize(pos);
+
+    return true;
+}
+
+//A file.gz or file.br made when the app was built, used if it is not
+//older than the file itself
+static bool readPrecompressed(const string &fileName, const struct stat &st, string &content)
+{
+    struct stat pst;
+    if (stat(fileName.c_str(), &pst) != 0 || !S_ISREG(pst.st_mode) ||
+        pst.st_mtime < st.st_mtime)
+        return false;
+
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    bool ret = readFile(fd, pst.st_size, content);
+    close(fd);
+
+    return ret && !content.empty();
+}
+
+static bool gzipContent(const char *data, size_t size, string &out)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    //windowBits + 16 writes a gzip header
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    out.resize(deflateBound(&zs, size));
+
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = size;
+    zs.next_out = (Bytef *)&out[0];
+    zs.avail_out = out.size();
+
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+
+    return ret == Z_STREAM_END;
+}
+
+int StaticFile::selectEncoding(const string &accept_encoding) const
+{
+    if (!brotli.empty() && acceptsEncoding(accept_encoding, "br"))
+        return EncodingBrotli;
+    if (!gzip.empty() && acceptsEncoding(accept_encoding, "gzip"))
+        return EncodingGzip;
+
+    return EncodingIdentity;
+}
+
+const char *StaticFile::getData(int encoding) const
+{
+    if (encoding == EncodingBrotli) return brotli.data();
+    if (encoding == EncodingGzip) return gzip.data();
+    return content.data();
+}
+
+size_t StaticFile::getSize(int encoding) const
+{
+    if (encoding == EncodingBrotli) return brotli.size();
+    if (encoding == EncodingGzip) return gzip.size();
+    return content.size();
+}
+
+string StaticFile::getEtag(int encoding) const
+{
+    //a strong ETag has to be different for each encoding
+    if (encoding == EncodingBrotli) return "\"" + hash + "-br\"";
+    if (encoding == EncodingGzip) return "\"" + hash + "-gzip\"";
+    return "\"" + hash + "\"";
+}
+
+string StaticFile::getContentEncoding(int encoding) const
+{
+    if (encoding == EncodingBrotli) return "br";
+    if (encoding == EncodingGzip) return "gzip";
+    return string();
+}
+
+bool StaticFile::matchEtag(const string &if_none_match, int encoding) const
+{
+    string etag = getEtag(encoding);
+
+    vector<string> tokens;
+    Utils::split(if_none_match, tokens, ",");
+
+    for (uint i = 0;i < tokens.size();i++)
+    {
+        //If-None-Match uses the weak comparison
+        string t = Utils::trim(tokens[i]);
+        if (Utils::strStartsWith(t, "W/"))
+            t.erase(0, 2);
+
+        if (t == "*" || t == etag)
+            return true;
+    }
+
+    return false;
+}
+
+StaticFilePtr StaticFileCache::get(const string &fileName)
+{
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return nullptr;
+
+    auto it = files.find(fileName);
+    if (it != files.end())
+    {
+        StaticFilePtr file = it->second;
+        if (file->inode == st.st_ino &&
+            file->file_size == st.st_size &&
+            file->mtime.tv_sec == st.st_mtim.tv_sec &&
+            file->mtime.tv_nsec == st.st_mtim.tv_nsec)
+        {
+            hits++;
+            file->last_used = ++counter;
+            return file;
+        }
+
+        cDebugDom("network") << "File changed, reloading " << fileName;
+
+        memory -= file->memoryUsed();
+        files.erase(it);
+    }
+
+    misses++;
+
+    StaticFilePtr file = load(fileName, st);
+    if (!file) return nullptr;
+
+    file->last_used = ++counter;
+
+    if (file->memoryUsed() <= STATIC_CACHE_MAX_SIZE)
+    {
+        evict(file->memoryUsed());
+        files[fileName] = file;
+        memory += file->memoryUsed();
+
+        if (file->compressing)
+            compress(file);
+    }
+
+    return file;
+}
+
+void StaticFileCache::compress(StaticFilePtr file)
+{
+    //the content is not changed once loaded, the worker can read it while
+    //the file is sent from the main loop
+    auto gzip = std::make_shared<string>();
+    WorkerPool::Instance().Run([file, gzip](WorkerJob &)
+    {
+        if (!gzipContent(file->content.data(), file->content.size(), *gzip) ||
+            gzip->size() >= file->content.size())
+            gzip->clear();
+    },
+    [this, file, gzip](WorkerJob &)
+    {
+        file->compressing = false;
+
+        //the file was evicted or reloaded meanwhile
+        auto it = files.find(file->fileName);
+        if (it == files.end() || it->second != file || gzip->empty())
+            return;
+
+        if (file->memoryUsed() + gzip->size() > STATIC_CACHE_MAX_SIZE)
+            return;
+
+        //the file itself is not evicted, it is the most recent
+        file->last_used = ++counter;
+        evict(gzip->size());
+
+        file->gzip = std::move(*gzip);
+        memory += file->gzip.size();
+
+        cDebugDom("network") << "Compressed " << file->fileName << " " << file->content.size()
+                             << " bytes, gzip: " << file->gzip.size();
+    });
+}
+
+StaticFilePtr StaticFileCache::load(const string &fileName, const struct stat &st)
+{
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        cWarningDom("network") << "Failed to open " << fileName << ": " << strerror(errno);
+        return nullptr;
+    }
+
+    StaticFilePtr file = std::make_shared<StaticFile>();
+    file->fileName = fileName;
+    file->inode = st.st_ino;
+    file->file_size = st.st_size;
+    file->mtime = st.st_mtim;
+
+    if (!readFile(fd, st.st_size, file->content))
+    {
+        cWarningDom("network") << "Failed to read " << fileName << ": " << strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+
+    close(fd);
+
+    file->hash = hashContent(file->content.data(), file->content.size());
+    file->immutable = hasContentHash(fileName);
+
+    string ext = Utils::str_to_lower(fileName.substr(fileName.find_last_of(".") + 1));
+    for (int i = 0;compressible_ext[i];i++)
+    {
+        if (ext == compressible_ext[i])
+            file->compressible = true;
+    }
+
+    if (file->compressible && file->content.size() >= STATIC_CACHE_COMPRESS_SIZE)
+    {
+        //gzip is made by a worker if it was not installed
+        if (!readPrecompressed(fileName + ".gz", st, file->gzip))
+            file->compressing = true;
+
+        //brotli is only served when precompressed
+        readPrecompressed(fileName + ".br", st, file->brotli);
+
+        //no gain, don't keep it
+        if (file->gzip.size() >= file->content.size())
+            file->gzip.clear();
+        if (file->brotli.size() >= file->content.size())
+            file->brotli.clear();
+    }
+
+    cDebugDom("network") << "Loaded " << fileName << " " << file->content.size() << " bytes"
+                         << ", gzip: " << (file->compressing?"pending":Utils::to_string(file->gzip.size()))
+                         << ", br: " << file->brotli.size();
+
+    return file;
+}
+
+void StaticFileCache::evict(size_t needed)
+{
+    //drop the least recently used files, the ones being sent are kept
+    //alive by their shared_ptr
+    while (!files.empty() && memory + needed > STATIC_CACHE_MAX_SIZE)
+    {
+        auto oldest = files.begin();
+        for (auto it = files.begin();it != files.end();++it)
+        {
+            if (it->second->last_used < oldest->second->last_used)
+                oldest = it;
+        }
+
+        memory -= oldest->second->memoryUsed();
+        files.erase(oldest);
+    }
+}
+
+void StaticFileCache::clear()
+{
+    files.clear();
+    memory = 0;
+}
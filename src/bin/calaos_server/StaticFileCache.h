@@ -0,0 +1,131 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef S_StaticFileCache_H
+#define S_StaticFileCache_H
+
+#include "Calaos.h"
+#include <unordered_map>
+#include <sys/stat.h>
+
+using namespace Calaos;
+
+//Memory used by the cache for the files and their compressed variants
+#define STATIC_CACHE_MAX_SIZE           (32 * 1024 * 1024)
+
+//Files smaller than that are not compressed
+#define STATIC_CACHE_COMPRESS_SIZE      256
+
+/*
+ * A file of the web app or debug pages, as served by HttpClient.
+ *
+ * The content is kept with a gzip variant for text files, and a brotli
+ * variant when a precompressed file.br is found next to it. The gzip
+ * variant is read from file.gz when it is installed, else it is made by
+ * the worker pool and the file is sent as is until it's done. The strong
+ * ETag is a hash of the content, suffixed for each encoding.
+ */
+class StaticFile
+{
+public:
+    StaticFile() {}
+
+    enum { EncodingIdentity = 0, EncodingGzip, EncodingBrotli };
+
+    //Best encoding accepted by the client in its Accept-Encoding header
+    int selectEncoding(const string &accept_encoding) const;
+
+    const char *getData(int encoding) const;
+    size_t getSize(int encoding) const;
+    string getEtag(int encoding) const;
+    string getContentEncoding(int encoding) const;
+
+    //True if the If-None-Match header matches the ETag of that encoding
+    bool matchEtag(const string &if_none_match, int encoding) const;
+
+    //File names with a content hash (app.3f2a9c1b.js) never change and
+    //can be cached forever by the browser
+    bool isImmutable() const { return immutable; }
+    bool isCompressible() const { return compressible; }
+
+private:
+    friend class StaticFileCache;
+
+    string fileName;
+    ino_t inode = 0;
+    off_t file_size = 0;
+    struct timespec mtime = { 0, 0 };
+
+    string content;
+    string gzip;
+    string brotli;
+
+    string hash;
+    bool immutable = false;
+    bool compressible = false;
+    bool compressing = false;
+
+    uint64_t last_used = 0;
+
+    size_t memoryUsed() const { return content.size() + gzip.size() + brotli.size(); }
+};
+
+typedef std::shared_ptr<StaticFile> StaticFilePtr;
+
+/*
+ * Cache of the static files, keyed by path and checked against the file
+ * mtime for each request.
+ * Only used from the main loop.
+ */
+class StaticFileCache
+{
+private:
+    StaticFileCache() {}
+
+    unordered_map<string, StaticFilePtr> files;
+    size_t memory = 0;
+    uint64_t counter = 0;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    StaticFilePtr load(const string &fileName, const struct stat &st);
+    void compress(StaticFilePtr file);
+    void evict(size_t needed);
+
+public:
+    static StaticFileCache &Instance()
+    {
+        static StaticFileCache inst;
+        return inst;
+    }
+
+    //Return the file from the cache, loaded again if it has changed on
+    //disk. Returns nullptr if the file can't be read or is a directory.
+    StaticFilePtr get(const string &fileName);
+
+    void clear();
+
+    uint64_t getHits() const { return hits; }
+    uint64_t getMisses() const { return misses; }
+    size_t getMemory() const { return memory; }
+};
+
+#endif
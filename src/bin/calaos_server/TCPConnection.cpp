@@ -26,7 +26,9 @@ extern NTPClock *ntpclock;
 
 TCPConnection::TCPConnection(Ecore_Con_Client *cl):
     client_conn(cl),
-    login(false)
+    login(false),
+    eventQueue([=](const string &data, int) { return sendData(data); },
+               [=]() { return data_size; })
 {
     cDebugDom("network") << this;
 }
@@ -89,7 +91,7 @@ void TCPConnection::ProcessRequest(Params &request, ProcessDone_cb callback)
 
     //"listen" is a special command that never returns unless it fails.
     //Clients can listen to all events that happens.
-    if (request["0"] == "listen") ListenCommand();
+    if (request["0"] == "listen") ListenCommand(request);
 
     if (listen_mode) return; //do not treat any other command if in listen mode
 
@@ -121,37 +123,49 @@ void TCPConnection::ProcessRequest(Params &request, ProcessDone_cb callback)
 
 void TCPConnection::ProcessData(string request)
 {
-    if (request.find('\n') == string::npos &&
-        request.find('\r') == string::npos)
+    //Keep the partial line until the rest comes
+    lines.append(request);
+
+    if (lines.size() > TCP_MAX_BUFFER)
     {
-        //We have not a complete paquet yet, buffurize it.
-        buffer += request;
+        cWarningDom("network") << "Too much data buffered, closing connection";
+        lines.clear();
+        CloseConnection();
         return;
     }
 
-    if (!buffer.empty())
-    {
-        //Put last data in buffer
-        buffer += request;
-        request = buffer;
-        buffer.clear();
-    }
+    ProcessLines();
+}
 
-    //Clean data string
-    int i = request.length() - 1;
-    while ((request[i] == '\n' || request[i] == '\r' || request[i] == '\0') && i >= 0) i--;
+void TCPConnection::ProcessLines()
+{
+    //Responses sent during the loop don't start another one
+    if (parsing) return;
+    parsing = true;
 
-    terminator = request.substr(i + 1, request.length() - i + 1);
-    request.erase(i + 1, request.length() - i + 1);
+    string line;
+    while (client_conn && pending.size() < TCP_MAX_INFLIGHT &&
+           lines.readLine(line, terminator))
+        ProcessLine(line);
 
+    lines.compact();
+
+    parsing = false;
+}
+
+void TCPConnection::ProcessLine(string request)
+{
     cDebugDom("network")
             << "New request: \"" << request << "\"";
 
+    //Nothing but events are sent to a listening client
+    if (listen_mode) return;
+
     Params p;
     p.Parse(request);
 
     //url decode all
-    for (i = 0;i < p.size();i++)
+    for (int i = 0;i < p.size();i++)
     {
         p.Add(Utils::to_string(i), Utils::url_decode(p[Utils::to_string(i)]));
     }
@@ -168,17 +182,22 @@ void TCPConnection::ProcessData(string request)
 
         listen_mode = true;
 
-        ProcessRequest(p, sigc::mem_fun(*this, &TCPConnection::ProcessingDataDone));
+        ProcessRequest(p, sigc::bind(sigc::mem_fun(*this, &TCPConnection::ProcessingDataDone), (uint64_t)0));
         //Don't bother with the responde for "listen" command,
         //it's a special command that echos all events
     }
     else
     {
-        ProcessRequest(p, sigc::mem_fun(*this, &TCPConnection::ProcessingDataDone));
+        TCPPendingRequest r;
+        r.id = ++next_request_id;
+        r.terminator = terminator;
+        pending.push_back(r);
+
+        ProcessRequest(p, sigc::bind(sigc::mem_fun(*this, &TCPConnection::ProcessingDataDone), r.id));
     }
 }
 
-void TCPConnection::ProcessingDataDone(Params &response)
+void TCPConnection::ProcessingDataDone(Params &response, uint64_t id)
 {
     std::string res = "";
 
@@ -191,27 +210,86 @@ void TCPConnection::ProcessingDataDone(Params &response)
             res += " ";
     }
 
-    cDebugDom("network")
-            << "We send: \"" << res << "\"";
-    res += terminator;
+    //Requests are numbered in order, pending is sorted
+    auto it = std::lower_bound(pending.begin(), pending.end(), id,
+                               [](const TCPPendingRequest &r, uint64_t i) { return r.id < i; });
+    if (it == pending.end() || it->id != id || it->done)
+        return;
+
+    it->done = true;
+    it->response = res + it->terminator;
+
+    SendResponses();
+}
+
+void TCPConnection::SendResponses()
+{
+    bool sent = false;
+
+    //A request waiting for an async reply holds back the next responses
+    while (!pending.empty() && pending.front().done)
+    {
+        string &res = pending.front().response;
+
+        cDebugDom("network")
+                << "We send: \"" << res << "\"";
+
+        if (!sendData(res))
+        {
+            CloseConnection();
+            pending.clear();
+
+            return;
+        }
 
-    if (!client_conn || ecore_con_client_send(client_conn, res.c_str(), res.length()) == 0)
+        pending.pop_front();
+        sent = true;
+    }
+
+    //Some requests may be waiting for a free slot
+    if (sent && !lines.empty())
+        ProcessLines();
+}
+
+bool TCPConnection::sendData(const string &data)
+{
+    if (!client_conn || ecore_con_client_send(client_conn, data.c_str(), data.length()) == 0)
     {
         cCriticalDom("network")
                 << "Error sending data ! Closing connection.";
 
-        CloseConnection();
+        return false;
     }
+
+    data_size += data.length();
+
+    return true;
+}
+
+void TCPConnection::DataWritten(int size)
+{
+    data_size -= size;
+
+    if (!eventQueue.flush())
+        CloseConnection();
 }
 
 void TCPConnection::CloseConnection()
 {
+    if (client_conn && listen_mode)
+    {
+        cDebugDom("network") << "Listen mode events: " << eventQueue.getSent() << " sent, "
+                             << eventQueue.getConflated() << " conflated, "
+                             << eventQueue.getDropped() << " dropped, max queue depth "
+                             << eventQueue.getMaxDepth();
+    }
+
     if (client_conn)
     {
         ecore_con_client_del(client_conn);
         client_conn = NULL;
     }
 
-    //Remove IPC handler if any
-    IPC::Instance().DeleteHandler(sig_events);
+    //Stop sending events if it was listening
+    listeners.remove(this);
 }
@@ -32,9 +32,20 @@
 #include <IPCam.h>
 #include <InPlageHoraire.h>
 #include <IPC.h>
+#include <EventSendQueue.h>
+#include <EventSubscriptions.h>
+#include <TCPLineBuffer.h>
+#include <deque>
 
 using namespace Calaos;
 
+//Max number of requests of a connection waiting for their response. The
+//next lines are parsed once responses are sent.
+#define TCP_MAX_INFLIGHT        32
+
+//The connection is closed if that much data is buffered
+#define TCP_MAX_BUFFER          (1024 * 1024)
+
 typedef sigc::slot<void, Params &> ProcessDone_cb;
 typedef sigc::signal<void, Params &> ProcessDone_signal;
 
@@ -49,6 +60,18 @@ public:
     Params result;
 };
 
+//A request read from the connection, responses are sent in request order
+class TCPPendingRequest
+{
+public:
+    uint64_t id;
+    bool done = false;
+    string response;
+
+    //line terminator of the request, used for its response
+    string terminator;
+};
+
 class TCPConnection: public sigc::trackable
 {
 protected:
@@ -56,11 +79,26 @@ protected:
     Ecore_Con_Client *client_conn;
 
     bool login;
-    string terminator, buffer;
+    string terminator;
+    TCPLineBuffer lines;
+
+    std::deque<TCPPendingRequest> pending;
+    uint64_t next_request_id = 0;
+    bool parsing = false;
+
+    void ProcessLines();
+    void ProcessLine(string request);
+    void SendResponses();
 
     bool listen_mode = false;
 
-    sigc::signal<void, string, string, void*, void*> sig_events;
+    //bytes given to ecore_con and not written yet
+    int data_size = 0;
+
+    //events sent in listen mode
+    EventSendQueue eventQueue;
+
+    bool sendData(const string &data);
 
     void ProcessRequest(Params &request, ProcessDone_cb callback);
 
@@ -72,15 +110,19 @@ protected:
     void RulesCommand(Params &request, ProcessDone_cb callback);
     void AudioCommand(Params &request, ProcessDone_cb callback);
     void ScenarioCommand(Params &request, ProcessDone_cb callback);
-    void ListenCommand();
+    void ListenCommand(Params &request);
 
     void CloseConnection();
 
     //IPC callback to handle all events from the system
     void HandleEventsFromSignals(string source, string emission, void *mydata, void *sender_data);
 
+    //listening clients, by the events they subscribed to
+    static EventSubscriptions<TCPConnection> listeners;
+    static void DispatchEvents(string source, string emission, void *mydata, void *sender_data);
+
     //Callback when processing data is done and we want to send data back to the client
-    void ProcessingDataDone(Params &request);
+    void ProcessingDataDone(Params &request, uint64_t id);
 
     /* Callbacks for async audio request */
     void get_volume_cb(AudioPlayerData data);
@@ -106,6 +148,11 @@ public:
 
     /* Called by TCPServer whenever data comes in */
     void ProcessData(string data);
+
+    /* Called by TCPServer whenever data has been written to client */
+    void DataWritten(int size);
+
+    const EventSendQueue &getEventQueue() const { return eventQueue; }
 };
 
 #endif
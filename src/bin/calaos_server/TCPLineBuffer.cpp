@@ -0,0 +1,57 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include "TCPLineBuffer.h"
+
+bool TCPLineBuffer::readLine(string &line, string &terminator)
+{
+    while (true)
+    {
+        size_t eol = buffer.find_first_of("\r\n", pos);
+        if (eol == string::npos)
+            return false;
+
+        size_t next = buffer.find_first_not_of("\r\n", eol);
+        if (next == string::npos) next = buffer.size();
+
+        line = buffer.substr(pos, eol - pos);
+        terminator = buffer.substr(eol, next - eol);
+        pos = next;
+
+        //old clients send a \0 at the end
+        while (!line.empty() && line[line.length() - 1] == '\0')
+            line.erase(line.length() - 1);
+
+        if (!line.empty())
+            return true;
+    }
+}
+
+void TCPLineBuffer::compact()
+{
+    buffer.erase(0, pos);
+    pos = 0;
+}
+
+void TCPLineBuffer::clear()
+{
+    buffer.clear();
+    pos = 0;
+}
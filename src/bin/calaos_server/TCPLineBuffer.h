@@ -0,0 +1,60 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef S_TCPLineBuffer_H
+#define S_TCPLineBuffer_H
+
+#include "Calaos.h"
+
+using namespace Calaos;
+
+/*
+ * Data received by a TCP connection, cut in lines.
+ *
+ * Clients terminate lines with \n, \r\n or \n\r, the terminator of each
+ * line is returned with it so the response uses the same one. Empty lines
+ * are skipped. Lines read are dropped by compact().
+ */
+class TCPLineBuffer
+{
+public:
+    TCPLineBuffer() {}
+
+    void append(const string &data) { buffer += data; }
+
+    //Next complete line, without its terminator. Returns false if no
+    //complete line is buffered.
+    bool readLine(string &line, string &terminator);
+
+    //Drop the lines already read
+    void compact();
+
+    void clear();
+
+    //Bytes buffered and not read yet
+    size_t size() const { return buffer.size() - pos; }
+    bool empty() const { return size() == 0; }
+
+private:
+    string buffer;
+    size_t pos = 0;
+};
+
+#endif
@@ -22,6 +22,8 @@
 #include <CalaosConfig.h>
 #include <NTPClock.h>
 #include <PollListenner.h>
+#include <WorkerPool.h>
+#include <JsonApiV3.h>
 
 using namespace Calaos;
 
@@ -97,6 +99,52 @@ void TCPConnection::BaseCommand(Params &request, ProcessDone_cb callback)
             sock->Close();
             delete sock;
         }
+        else if (request["1"] == "workers")
+        {
+            //diagnostics of the worker pool, times are in ms and the
+            //utilization is the % of time the workers spent running jobs
+            WorkerPoolStats stats = WorkerPool::Instance().getStats();
+
+            int i = 2;
+            result.Add(Utils::to_string(i++), "workers:" + Utils::to_string(stats.workers));
+            result.Add(Utils::to_string(i++), "jobs_done:" + Utils::to_string(stats.jobs_done));
+            result.Add(Utils::to_string(i++), "jobs_cancelled:" + Utils::to_string(stats.jobs_cancelled));
+            result.Add(Utils::to_string(i++), "jobs_queued:" + Utils::to_string(stats.jobs_queued));
+            result.Add(Utils::to_string(i++), "wait_avg:" + Utils::to_string(stats.wait_avg * 1000.0));
+            result.Add(Utils::to_string(i++), "wait_max:" + Utils::to_string(stats.wait_max * 1000.0));
+            result.Add(Utils::to_string(i++), "utilization:" + Utils::to_string(stats.utilization * 100.0));
+        }
+        else if (request["1"] == "listeners")
+        {
+            //outbound events of the listening clients, one item per client
+            //as tcp<n>:ip/depth/max_depth/sent/conflated/dropped and
+            //websocket<n>:depth/max_depth/sent/conflated/dropped
+            auto queueStats = [](const EventSendQueue &q)
+            {
+                return Utils::to_string(q.getDepth()) + "/" +
+                       Utils::to_string(q.getMaxDepth()) + "/" +
+                       Utils::to_string(q.getSent()) + "/" +
+                       Utils::to_string(q.getConflated()) + "/" +
+                       Utils::to_string(q.getDropped());
+            };
+
+            int i = 2, n = 1;
+            for (TCPConnection *conn: listeners.getClients())
+            {
+                string ip = conn->client_conn?ecore_con_client_ip_get(conn->client_conn):"";
+                result.Add(Utils::to_string(i++), "tcp" + Utils::to_string(n++) + ":" +
+                           ip + "/" + queueStats(conn->eventQueue));
+            }
+
+            n = 1;
+            for (JsonApiV3 *api: JsonApiV3::getClients())
+            {
+                const EventSendQueue *q = api->getEventQueue();
+                if (!q) continue;
+                result.Add(Utils::to_string(i++), "websocket" + Utils::to_string(n++) + ":" +
+                           queueStats(*q));
+            }
+        }
     }
     else if (request["0"] == "firmware")
     {
@@ -287,6 +287,12 @@ void TCPConnection::IOCommand(Params &request, ProcessDone_cb callback)
             {
                 input->get_params().Add(request["3"], request["4"]);
 
+                if (request["3"] == "id")
+                    ListeRule::Instance().invalidateRulesIndex();
+
+                //params may change the next time this input needs to be checked
+                ListeRule::Instance().WakeUp(input);
+
                 {
                     string sig = "input ";
                     sig += input->get_param("id") + " ";
@@ -451,6 +457,9 @@ void TCPConnection::IOCommand(Params &request, ProcessDone_cb callback)
 
                 result.Add("4", "ok");
 
+                //time ranges changed, check the input again now
+                ListeRule::Instance().WakeUp(input);
+
                 string sig = "input_range_change ";
                 sig += input->get_param("id") + " ";
                 IPC::Instance().SendEvent("events", sig);
@@ -781,6 +790,9 @@ void TCPConnection::IOCommand(Params &request, ProcessDone_cb callback)
             {
                 output->get_params().Add(request["3"], request["4"]);
 
+                if (request["3"] == "id")
+                    ListeRule::Instance().invalidateRulesIndex();
+
                 {
                     string sig = "output ";
                     sig += output->get_param("id") + " ";
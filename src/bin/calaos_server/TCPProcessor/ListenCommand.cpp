@@ -22,20 +22,94 @@
 
 using namespace Calaos;
 
+EventSubscriptions<TCPConnection> TCPConnection::listeners;
+
 void TCPConnection::HandleEventsFromSignals(string source, string emission, void *mydata, void *sender_data)
 {
     if (source != "events") return;
 
     cDebug() <<  "Sending event: " << emission;
 
+    //A newer state of the same IO property replaces a queued one
+    string key;
+    vector<string> tokens;
+    split(emission, tokens, " ", 4);
+    if (tokens.size() >= 3 &&
+        (tokens[0] == "input" || tokens[0] == "output"))
+    {
+        string prop = url_decode(tokens[2]);
+        key = tokens[0] + " " + tokens[1] + " " + prop.substr(0, prop.find(':'));
+    }
+
     emission += terminator;
 
-    ecore_con_client_send(client_conn, emission.c_str(), emission.length());
+    if (!eventQueue.push(std::make_shared<const string>(emission), key))
+        CloseConnection();
 }
 
-void TCPConnection::ListenCommand()
+void TCPConnection::ListenCommand(Params &request)
 {
-    //Attach the callback to IPC
-    sig_events.connect( sigc::mem_fun(*this, &TCPConnection::HandleEventsFromSignals) );
-    IPC::Instance().AddHandler("events", "*", sig_events);
+    //Only one IPC handler dispatches events to all listening clients
+    static bool events_connected = false;
+    if (!events_connected)
+    {
+        static sigc::signal<void, string, string, void*, void*> sig_listen;
+        sig_listen.connect(sigc::ptr_fun(&TCPConnection::DispatchEvents));
+        IPC::Instance().AddHandler("events", "*", sig_listen);
+        events_connected = true;
+    }
+
+    listeners.add(this);
+
+    //listen id:<io id> room:<room name> type:<event>
+    //Without arguments all events are sent
+    for (int i = 1;i < request.size();i++)
+    {
+        string arg = request[Utils::to_string(i)];
+
+        if (Utils::strStartsWith(arg, "id:") ||
+            Utils::strStartsWith(arg, "type:"))
+        {
+            listeners.subscribe(this, arg);
+        }
+        else if (Utils::strStartsWith(arg, "room:"))
+        {
+            listeners.subscribe(this, arg);
+            for (const string &key: EventKeys::roomIOs(arg.substr(5)))
+                listeners.subscribe(this, key, arg);
+        }
+    }
+}
+
+void TCPConnection::DispatchEvents(string source, string emission, void *mydata, void *sender_data)
+{
+    if (source != "events") return;
+
+    vector<string> keys = EventKeys::fromEmission(emission);
+
+    //IOs added to a room are part of the subscriptions to that room
+    if (Utils::strStartsWith(emission, "new_input ") ||
+        Utils::strStartsWith(emission, "new_output "))
+    {
+        string id, room;
+        for (const string &k: keys)
+        {
+            if (Utils::strStartsWith(k, "id:")) id = k;
+            if (Utils::strStartsWith(k, "room:")) room = k;
+        }
+
+        if (!id.empty() && !room.empty())
+        {
+            for (TCPConnection *conn: listeners.subscribers(room))
+                listeners.subscribe(conn, id, room);
+        }
+    }
+
+    //A client can be closed while sending, the list is a copy
+    vector<TCPConnection *> conns = listeners.lookup(keys);
+    for (TCPConnection *conn: conns)
+    {
+        if (listeners.contains(conn))
+            conn->HandleEventsFromSignals(source, emission, mydata, sender_data);
+    }
 }
@@ -66,6 +66,32 @@ void TCPConnection::RulesCommand(Params &request, ProcessDone_cb callback)
                 result.Add(Utils::to_string(i + 1), key + ":" + Utils::to_string(value));
             }
         }
+        else if (request["1"] == "stats")
+        {
+            //diagnostics of the rules propagation, the last one is
+            //given wave by wave as wave<n>:ios/checked/fired/duration(ms)
+            ListeRule &lr = ListeRule::Instance();
+            const RulesPropagationStats &stats = lr.getLastPropagationStats();
+
+            int i = 2;
+            result.Add(Utils::to_string(i++), "propagations:" + Utils::to_string(lr.getPropagationCount()));
+            result.Add(Utils::to_string(i++), "loops:" + Utils::to_string(lr.getLoopsDetected()));
+            result.Add(Utils::to_string(i++), "max_depth:" + Utils::to_string(lr.getMaxDepth()));
+            result.Add(Utils::to_string(i++), "depth:" + Utils::to_string(stats.depth));
+            result.Add(Utils::to_string(i++), "rules_checked:" + Utils::to_string(stats.rules_checked));
+            result.Add(Utils::to_string(i++), "rules_fired:" + Utils::to_string(stats.rules_fired));
+            result.Add(Utils::to_string(i++), "duration:" + Utils::to_string(stats.duration * 1000.0));
+
+            for (uint w = 0;w < stats.waves.size();w++)
+            {
+                const RulesWaveStats &wave = stats.waves[w];
+                result.Add(Utils::to_string(i++), "wave" + Utils::to_string(w + 1) + ":" +
+                           Utils::to_string(wave.ios) + "/" +
+                           Utils::to_string(wave.rules_checked) + "/" +
+                           Utils::to_string(wave.rules_fired) + "/" +
+                           Utils::to_string(wave.duration * 1000.0));
+            }
+        }
         else if (request["1"] == "add" && request["4"] != "condition" && request["4"] != "action")
         {
             //clean Params var
@@ -114,7 +140,10 @@ void TCPConnection::RulesCommand(Params &request, ProcessDone_cb callback)
                         else if (splitter[1] == "ival" && cond->get_size() > 0)
                             cond->get_params().Add(cond->get_input(0)->get_param("id"), splitter[2]);
                         else if (splitter[1] == "ivar_val" && cond->get_size() > 0)
+                        {
                             cond->get_params_var().Add(cond->get_input(0)->get_param("id"), splitter[2]);
+                            ListeRule::Instance().invalidateRulesIndex();
+                        }
                     }
                     else if (splitter[1] == "oid" || splitter[1] == "oval" || splitter[1] == "ovar_val")
                     {
@@ -254,7 +283,10 @@ void TCPConnection::RulesCommand(Params &request, ProcessDone_cb callback)
                                 if (splitter[0] == "val" && cond->get_size() > 0)
                                     cond->get_params().Add(cond->get_input(0)->get_param("id"), splitter[1]);
                                 if (splitter[0] == "var_val" && cond->get_size() > 0)
+                                {
                                     cond->get_params_var().Add(cond->get_input(0)->get_param("id"), splitter[1]);
+                                    ListeRule::Instance().invalidateRulesIndex();
+                                }
                                 if (splitter[0] == "id" && cond->get_size() > 0)
                                 {
                                     Input *in = ListeRoom::Instance().get_input(splitter[1]);
@@ -303,7 +335,10 @@ void TCPConnection::RulesCommand(Params &request, ProcessDone_cb callback)
                         if (splitter[0] == "val" && cond->get_size() > 0)
                             cond->get_params().Add(cond->get_input(0)->get_param("id"), splitter[1]);
                         if (splitter[0] == "var_val" && cond->get_size() > 0)
+                        {
                             cond->get_params_var().Add(cond->get_input(0)->get_param("id"), splitter[1]);
+                            ListeRule::Instance().invalidateRulesIndex();
+                        }
 
                         result.Add("3", "ok");
                     }
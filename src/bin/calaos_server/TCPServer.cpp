@@ -23,6 +23,7 @@
 static Eina_Bool _ecore_con_handler_client_add(void *data, int type, Ecore_Con_Event_Client_Add *ev);
 static Eina_Bool _ecore_con_handler_data_get(void *data, int type, Ecore_Con_Event_Client_Data *ev);
 static Eina_Bool _ecore_con_handler_client_del(void *data, int type, Ecore_Con_Event_Client_Del *ev);
+static Eina_Bool _ecore_con_handler_data_write(void *data, int type, Ecore_Con_Event_Client_Write *ev);
 
 TCPServer::TCPServer(int p): port(p), tcp_server(NULL)
 {
@@ -33,6 +34,7 @@ TCPServer::TCPServer(int p): port(p), tcp_server(NULL)
 
     event_handler_client_add = ecore_event_handler_add(ECORE_CON_EVENT_CLIENT_ADD, (Ecore_Event_Handler_Cb)_ecore_con_handler_client_add, this);
     event_handler_client_del = ecore_event_handler_add(ECORE_CON_EVENT_CLIENT_DATA, (Ecore_Event_Handler_Cb)_ecore_con_handler_data_get, this);
+    event_handler_client_write = ecore_event_handler_add(ECORE_CON_EVENT_CLIENT_WRITE, (Ecore_Event_Handler_Cb)_ecore_con_handler_data_write, this);
     event_handler_data_get = ecore_event_handler_add(ECORE_CON_EVENT_CLIENT_DEL, (Ecore_Event_Handler_Cb)_ecore_con_handler_client_del, this);
 
     cDebugDom("network")
@@ -49,6 +51,7 @@ TCPServer::~TCPServer()
     ecore_event_handler_del(event_handler_client_add);
     ecore_event_handler_del(event_handler_client_del);
     ecore_event_handler_del(event_handler_data_get);
+    ecore_event_handler_del(event_handler_client_write);
 
     cDebugDom("network");
 }
@@ -116,6 +119,27 @@ Eina_Bool _ecore_con_handler_data_get(void *data, int type, Ecore_Con_Event_Clie
     return ECORE_CALLBACK_RENEW;
 }
 
+Eina_Bool _ecore_con_handler_data_write(void *data, int type, Ecore_Con_Event_Client_Write *ev)
+{
+    TCPServer *tcpserver = reinterpret_cast<TCPServer *>(data);
+
+    if (ev && (tcpserver != ecore_con_server_data_get(ecore_con_client_server_get(ev->client))))
+    {
+        return ECORE_CALLBACK_PASS_ON;
+    }
+
+    if (tcpserver)
+    {
+        tcpserver->dataWritten(ev->client, ev->size);
+    }
+    else
+    {
+        cCriticalDom("network") << "failed to get TCPServer object !";
+    }
+
+    return ECORE_CALLBACK_RENEW;
+}
+
 void TCPServer::addConnection(Ecore_Con_Client *client)
 {
     cDebugDom("network")
@@ -166,3 +190,17 @@ void TCPServer::getDataConnection(Ecore_Con_Client *client, void *data, int size
 
     it->second->ProcessData(d);
 }
+
+void TCPServer::dataWritten(Ecore_Con_Client *client, int size)
+{
+    map<Ecore_Con_Client *, TCPConnection *>::iterator it = connections.find(client);
+    if (it == connections.end())
+    {
+        cCriticalDom("network")
+                << "Can't find corresponding TCPConnection !";
+
+        return;
+    }
+
+    it->second->DataWritten(size);
+}
@@ -28,10 +28,11 @@
 using namespace Calaos;
 
 const uint64_t MAX_MESSAGE_SIZE_IN_BYTES = INT_MAX - 1;
-const uint64_t FRAME_SIZE_IN_BYTES = 512 * 512 * 2;
 
 WebSocket::WebSocket(Ecore_Con_Client *cl):
-    HttpClient(cl)
+    HttpClient(cl),
+    eventQueue([=](const string &data, int tag) { return sendQueued(data, tag); },
+               [=]() { return data_size; })
 {
     reset();
 }
@@ -39,6 +40,7 @@ WebSocket::WebSocket(Ecore_Con_Client *cl):
 WebSocket::~WebSocket()
 {
     delete closeTimeout;
+    delete deflate;
     cDebugDom("websocket") << this;
 }
 
@@ -144,6 +146,17 @@ bool WebSocket::checkHandshakeRequest()
         {
             sendTextMessage(data);
         });
+        if (proto_ver == APIV3)
+        {
+            static_cast<JsonApiV3 *>(jsonApi)->sendMessage.connect([=](const WebSocketMessagePtr &msg)
+            {
+                sendMessage(msg);
+            });
+            static_cast<JsonApiV3 *>(jsonApi)->sendBinaryData.connect([=](const string &data)
+            {
+                sendBinaryMessage(data);
+            });
+        }
         jsonApi->closeConnection.connect([=](int c, const string &r)
         {
             sendCloseFrame(static_cast<uint16_t>(c), r);
@@ -215,6 +228,60 @@ bool WebSocket::checkHandshakeRequest()
     cDebugDom("websocket") << "Sec-Websocket-Accept : " << encoded_key;
     headers.Add("Sec-Websocket-Accept", encoded_key);
 
+    //API encoding, calaos.msgpack or calaos.json
+    if (proto_ver == APIV3 &&
+        request_headers.find("sec-websocket-protocol") != request_headers.end())
+    {
+        vector<string> protocols;
+        Utils::split(request_headers["sec-websocket-protocol"], protocols, ",");
+
+        string proto;
+        for (string p: protocols)
+        {
+            Utils::trim_right(p, " \t");
+            Utils::trim_left(p, " \t");
+
+            //msgpack is used if the client supports both
+            if (p == "calaos.msgpack" || (p == "calaos.json" && proto.empty()))
+                proto = p;
+        }
+
+        if (!proto.empty())
+        {
+            cDebugDom("websocket") << "Sec-WebSocket-Protocol : " << proto;
+            headers.Add("Sec-WebSocket-Protocol", proto);
+
+            static_cast<JsonApiV3 *>(jsonApi)->setEncoding(proto == "calaos.msgpack"?
+                                                               JsonApiV3::EncodingMsgPack:
+                                                               JsonApiV3::EncodingJson);
+        }
+    }
+
+    //permessage-deflate extension
+    if (request_headers.find("sec-websocket-extensions") != request_headers.end() &&
+        Utils::get_config_option("websocket_deflate") != "false")
+    {
+        WebSocketDeflate *d = new WebSocketDeflate();
+        string ext;
+        if (d->negotiate(request_headers["sec-websocket-extensions"],
+                         Utils::get_config_option("websocket_deflate_no_context_takeover") == "true",
+                         ext))
+        {
+            cDebugDom("websocket") << "Sec-WebSocket-Extensions : " << ext;
+            headers.Add("Sec-WebSocket-Extensions", ext);
+
+            delete deflate;
+            deflate = d;
+            currentFrame.setRsv1Allowed(true);
+
+            string t = Utils::get_config_option("websocket_deflate_threshold");
+            if (Utils::is_of_type<int>(t))
+                Utils::from_string(t, deflateThreshold);
+        }
+        else
+            delete d;
+    }
+
     //build response
     stringstream res;
     //HTTP code
@@ -238,6 +305,7 @@ void WebSocket::reset()
 {
     currentFrame.clear();
     isfragmented = false;
+    currentCompressed = false;
     currentData.clear();
     currentOpcode = 0;
 }
@@ -248,7 +316,7 @@ void WebSocket::processFrame(const string &data)
 
     recv_buffer += data;
 
-    while (currentFrame.processFrameData(recv_buffer))
+    while (currentFrame.processFrameData(recv_buffer, recv_pos))
     {
         if (currentFrame.isValid())
         {
@@ -281,9 +349,10 @@ void WebSocket::processFrame(const string &data)
                 {
                     currentOpcode = currentFrame.getOpcode();
                     isfragmented = !currentFrame.isFinalFrame();
+                    currentCompressed = currentFrame.getRsv1() != 0;
                 }
 
-                if (currentData.size() + currentFrame.getPayload().size() > MAX_MESSAGE_SIZE_IN_BYTES)
+                if (currentData.size() + currentFrame.getPayloadSize() > MAX_MESSAGE_SIZE_IN_BYTES)
                 {
                     reset();
                     stringstream err;
@@ -294,10 +363,30 @@ void WebSocket::processFrame(const string &data)
                     sendCloseFrame(CloseCodeTooMuchData, err.str());
                 }
 
-                currentData.append(currentFrame.getPayload());
+                if (currentFrame.getPayloadSize() > 0)
+                    currentData.append(currentFrame.getPayloadData(), currentFrame.getPayloadSize());
 
                 if (currentFrame.isFinalFrame())
                 {
+                    if (currentCompressed)
+                    {
+                        string inflated;
+                        if (!deflate || !deflate->decompress(currentData, inflated))
+                        {
+                            reset();
+                            string err = "Failed to decompress message";
+                            cWarningDom("websocket") << err;
+
+                            //Send close frame and close connection
+                            sendCloseFrame(CloseCodeProtocolError, err);
+
+                            currentFrame.clear();
+                            continue;
+                        }
+
+                        currentData = std::move(inflated);
+                    }
+
                     cDebugDom("websocket") << "Received " << (currentOpcode == WebSocketFrame::OpCodeText?"text":"binary") << " message of size " << currentData.size();
 
                     if (currentOpcode == WebSocketFrame::OpCodeText)
@@ -306,7 +395,12 @@ void WebSocket::processFrame(const string &data)
                         binaryMessageReceived.emit(currentData);
 
                     if (!echoMode && proto_ver == APIV3 && jsonApi)
-                        jsonApi->processApi(currentData);
+                    {
+                        if (currentOpcode == WebSocketFrame::OpCodeText)
+                            jsonApi->processApi(currentData);
+                        else
+                            static_cast<JsonApiV3 *>(jsonApi)->processBinaryApi(currentData);
+                    }
 
                     if (echoMode)
                     {
@@ -345,6 +439,14 @@ void WebSocket::processFrame(const string &data)
             return;
         }
     }
+
+    //drop the parsed frames once for all frames of this read, a partial
+    //frame stays at the start of the buffer
+    if (recv_pos >= recv_buffer.size())
+        recv_buffer.clear();
+    else if (recv_pos > 0)
+        recv_buffer.erase(0, recv_pos);
+    recv_pos = 0;
 }
 
 void WebSocket::sendCloseFrame(uint16_t code, const string &reason, bool forceClose)
@@ -484,73 +586,130 @@ void WebSocket::sendFrameData(const string &data, bool isbinary)
 
     cDebugDom("websocket") << "Sending " << (isbinary?"binary":"text") << " frame, payload size: " << data.size();
 
-    int numframes = data.size() / FRAME_SIZE_IN_BYTES;
-    if (data.size() % FRAME_SIZE_IN_BYTES || numframes == 0)
-        numframes++;
+    int tag = isbinary?QueueBinary:QueueText;
 
-    uint64_t current = 0;
-    uint64_t byteswritten = 0;
-    uint64_t bytesleft = data.size();
-    int header_size = 0;
+    //data is only copied if it has to wait in the queue
+    if (eventQueue.isIdle())
+        sendQueued(data, tag);
+    else
+        queueFrames(std::make_shared<const string>(data), string(), tag);
+}
 
-    cDebugDom("websocket") << "Sending " << numframes << " frames";
+void WebSocket::sendMessage(const WebSocketMessagePtr &message)
+{
+    if (!isWebsocket) return;
 
-    for (int i = 0;i < numframes;i++)
+    if (status != WSOpened)
     {
-        bool lastframe = (i == (numframes - 1));
-        bool firstframe = (i == 0);
+        cErrorDom("websocket") << "Can't send data, websocket is not connected";
+        return;
+    }
 
-        uint64_t sz = bytesleft < FRAME_SIZE_IN_BYTES?bytesleft:FRAME_SIZE_IN_BYTES;
+    cDebugDom("websocket") << "Sending shared " << (message->isBinary()?"binary":"text")
+                           << " message, payload size: " << message->getData().size();
 
-        string frame;
+    //the data is shared with the message, not copied. Compression is per
+    //connection so the prebuilt frames can't be used with it
+    if (deflate)
+        queueFrames(EventData(message, &message->getData()), message->getConflateKey(),
+                    message->isBinary()?QueueBinary:QueueText);
+    else
+        queueFrames(EventData(message, &message->getFrames()), message->getConflateKey());
+}
 
-        if (sz > 0)
-        {
-            frame = WebSocketFrame::makeFrame(firstframe?
-                                                  isbinary?WebSocketFrame::OpCodeBinary:
-                                                           WebSocketFrame::OpCodeText
-                                                         :WebSocketFrame::OpCodeContinue,
-                                              data.substr(current, sz),
-                                              lastframe);
-            header_size += frame.size() - sz;
-        }
-        else
-        {
-            frame = WebSocketFrame::makeFrame(firstframe?
-                                                  isbinary?WebSocketFrame::OpCodeBinary:
-                                                           WebSocketFrame::OpCodeText
-                                                         :WebSocketFrame::OpCodeContinue,
-                                              string(),
-                                              lastframe);
-            header_size += frame.size();
-        }
+void WebSocket::queueFrames(const EventData &frames, const string &key, int tag)
+{
+    if (!eventQueue.push(frames, key, tag) && status != WSClosed)
+    {
+        CloseConnection();
+        status = WSClosed;
+    }
+}
 
-        //send frame
-        data_size += frame.size();
-        uint n;
-        if (!client_conn ||
-            (n = ecore_con_client_send(client_conn, frame.c_str(), frame.size())) == 0)
-        {
-            cCriticalDom("network") << "Error sending data !";
-            CloseConnection();
-            status = WSClosed;
-            return;
-        }
-        if (n != frame.size())
-            cWarningDom("websocket") << "All data not sent! framesize: " << frame.size() << " sent: " << n;
-        byteswritten += n;
-        cDebugDom("websocket") << "Data written: " << n << " byteswritten: " << byteswritten;
+bool WebSocket::sendFrames(const string &frames)
+{
+    return sendRaw(frames.data(), frames.size());
+}
+
+bool WebSocket::sendPayload(const char *data, uint64_t size, int opcode, bool compressed)
+{
+    //header and payload are given separately to ecore_con which copies
+    //them in its buffer, the frame is never built in memory
+    uint64_t current = 0;
+    do
+    {
+        uint64_t sz = size - current;
+        if (sz > FRAME_SIZE_IN_BYTES) sz = FRAME_SIZE_IN_BYTES;
+
+        string header;
+        WebSocketFrame::appendHeader(header,
+                                     current == 0?opcode:WebSocketFrame::OpCodeContinue,
+                                     sz,
+                                     current + sz == size,
+                                     current == 0 && compressed);
+
+        if (!sendRaw(header.data(), header.size()))
+            return false;
+        if (sz > 0 && !sendRaw(data + current, sz))
+            return false;
 
         current += sz;
-        bytesleft -= sz;
     }
+    while (current < size);
+
+    return true;
+}
 
-    if (byteswritten != (data.size() + header_size))
+bool WebSocket::sendRaw(const char *data, size_t size)
+{
+    data_size += size;
+    uint n;
+    if (!client_conn ||
+        (n = ecore_con_client_send(client_conn, data, size)) == 0)
+    {
+        cCriticalDom("network") << "Error sending data !";
+        CloseConnection();
+        status = WSClosed;
+        return false;
+    }
+
+    cDebugDom("websocket") << "Data written: " << n;
+
+    if (n != size)
     {
-        cErrorDom("websocket") << "Error, bytes written " << byteswritten << " != " << (data.size() + header_size);
+        cErrorDom("websocket") << "Error, bytes written " << n << " != " << size;
         CloseConnection();
         status = WSClosed;
+        return false;
+    }
+
+    return true;
+}
+
+bool WebSocket::sendQueued(const string &data, int tag)
+{
+    if (tag == QueueFrames)
+        return sendFrames(data);
+
+    int opcode = tag == QueueBinary?WebSocketFrame::OpCodeBinary:WebSocketFrame::OpCodeText;
+
+    //small messages are not worth it
+    string compressed;
+    if (deflate && data.size() >= (size_t)deflateThreshold && deflate->compress(data, compressed))
+    {
+        cDebugDom("websocket") << "Compressed message " << data.size() << " -> " << compressed.size();
+        return sendPayload(compressed.data(), compressed.size(), opcode, true);
     }
+
+    return sendPayload(data.data(), data.size(), opcode, false);
+}
+
+void WebSocket::DataWritten(int size)
+{
+    HttpClient::DataWritten(size);
+
+    if (status == WSOpened && eventQueue.getDepth() > 0)
+        eventQueue.flush();
 }
 
 bool WebSocket::checkCloseStatusCode(uint16_t code)
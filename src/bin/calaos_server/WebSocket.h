@@ -26,6 +26,8 @@
 #include <unordered_map>
 #include "HttpClient.h"
 #include "WebSocketFrame.h"
+#include "EventSendQueue.h"
+#include "WebSocketDeflate.h"
 
 using namespace Calaos;
 
@@ -42,12 +44,19 @@ public:
     /* Called by JsonApiServer whenever data comes in */
     virtual void ProcessData(string data);
 
+    virtual void DataWritten(int size);
+
     void sendPing(const string &data);
     void sendCloseFrame(uint16_t code = CloseCodeNormal, const string &reason = string(), bool forceClose = false);
 
     void sendTextMessage(const string &data);
     void sendBinaryMessage(const string &data);
 
+    //Send a message already framed, used to broadcast to all clients
+    void sendMessage(const WebSocketMessagePtr &message);
+
+    const EventSendQueue &getEventQueue() const { return eventQueue; }
+
     enum CloseCode
     {
         CloseCodeNormal                 = 1000,
@@ -72,18 +81,32 @@ private:
     enum { WSConnecting, WSOpened, WSClosing, WSClosed };
     int status = WSConnecting;
 
+    //received data, frames are parsed from recv_pos
     string recv_buffer;
+    size_t recv_pos = 0;
 
     WebSocketFrame currentFrame;
     string currentData;
     int currentOpcode;
 
     bool isfragmented = false;
+    bool currentCompressed = false;
+
+    //permessage-deflate, null if not negotiated
+    WebSocketDeflate *deflate = nullptr;
+    int deflateThreshold = WS_DEFLATE_THRESHOLD;
 
     double ping_time = 0.0;
     EcoreTimer *closeTimeout = nullptr;
     bool closeReceived = false;
 
+    //data messages wait here when the client is slow
+    EventSendQueue eventQueue;
+
+    //how queued data is sent, messages are compressed when they are sent
+    //as the compressor state depends on the order of the messages
+    enum { QueueFrames = 0, QueueText, QueueBinary };
+
     void reset(); //reset state machine
 
     bool checkHandshakeRequest();
@@ -94,6 +117,11 @@ private:
     bool checkCloseStatusCode(uint16_t code);
 
     void sendFrameData(const string &data, bool isbinary);
+    bool sendFrames(const string &frames);
+    bool sendRaw(const char *data, size_t size);
+    bool sendPayload(const char *data, uint64_t size, int opcode, bool compressed);
+    bool sendQueued(const string &data, int tag);
+    void queueFrames(const EventData &frames, const string &key = string(), int tag = QueueFrames);
 };
 
 #endif
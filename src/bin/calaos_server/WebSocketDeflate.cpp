@@ -0,0 +1,259 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include "WebSocketDeflate.h"
+
+//end of a block flushed with Z_SYNC_FLUSH, not sent on the wire
+static const char deflate_tail[] = { '\x00', '\x00', '\xff', '\xff' };
+
+WebSocketDeflate::WebSocketDeflate()
+{
+    memset(&deflater, 0, sizeof(deflater));
+    memset(&inflater, 0, sizeof(inflater));
+}
+
+WebSocketDeflate::~WebSocketDeflate()
+{
+    if (deflate_init)
+        deflateEnd(&deflater);
+    if (inflate_init)
+        inflateEnd(&inflater);
+}
+
+bool WebSocketDeflate::parseOffer(const vector<string> &params)
+{
+    bool snct = false, cnct = false, smwb = false, cmwb = false;
+    int window_bits = 15;
+
+    for (uint i = 1;i < params.size();i++)
+    {
+        string name = Utils::trim(params[i]);
+        string value;
+        size_t eq = name.find('=');
+        if (eq != string::npos)
+        {
+            value = Utils::trim(name.substr(eq + 1));
+            name = Utils::trim(name.substr(0, eq));
+            if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+                value = value.substr(1, value.size() - 2);
+        }
+
+        //a parameter can only be given once
+        if (name == "server_no_context_takeover")
+        {
+            if (snct || !value.empty()) return false;
+            snct = true;
+        }
+        else if (name == "client_no_context_takeover")
+        {
+            if (cnct || !value.empty()) return false;
+            cnct = true;
+        }
+        else if (name == "server_max_window_bits")
+        {
+            if (smwb || !Utils::is_of_type<int>(value)) return false;
+            smwb = true;
+            Utils::from_string(value, window_bits);
+
+            //zlib can't make a raw deflate stream with a 256 bytes window
+            if (window_bits < 9 || window_bits > 15) return false;
+        }
+        else if (name == "client_max_window_bits")
+        {
+            //we always inflate with the biggest window, the value is only checked
+            if (cmwb) return false;
+            cmwb = true;
+            if (!value.empty())
+            {
+                int v = 0;
+                if (!Utils::is_of_type<int>(value)) return false;
+                Utils::from_string(value, v);
+                if (v < 8 || v > 15) return false;
+            }
+        }
+        else
+            return false;
+    }
+
+    server_no_context_takeover = snct;
+    client_no_context_takeover = cnct;
+    server_max_window_bits = window_bits;
+
+    return true;
+}
+
+bool WebSocketDeflate::negotiate(const string &extensions, bool server_no_context, string &response)
+{
+    vector<string> offers;
+    split(extensions, offers, ",");
+
+    for (const string &offer: offers)
+    {
+        vector<string> params;
+        split(offer, params, ";");
+
+        if (params.empty() || Utils::trim(params[0]) != "permessage-deflate")
+            continue;
+
+        if (!parseOffer(params))
+        {
+            cDebugDom("websocket") << "permessage-deflate offer declined: " << offer;
+            continue;
+        }
+
+        if (server_no_context)
+            server_no_context_takeover = true;
+
+        response = "permessage-deflate";
+        if (server_no_context_takeover)
+            response += "; server_no_context_takeover";
+        if (client_no_context_takeover)
+            response += "; client_no_context_takeover";
+        if (server_max_window_bits < 15)
+            response += "; server_max_window_bits=" + Utils::to_string(server_max_window_bits);
+
+        if (deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         -server_max_window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK ||
+            inflateInit2(&inflater, -15) != Z_OK)
+        {
+            cErrorDom("websocket") << "Failed to init zlib";
+            return false;
+        }
+        deflate_init = inflate_init = true;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool WebSocketDeflate::compress(const string &in, string &out)
+{
+    if (!deflate_init) return false;
+
+    out.clear();
+    out.resize(deflateBound(&deflater, in.size()) + 16);
+
+    deflater.next_in = (Bytef *)in.data();
+    deflater.avail_in = in.size();
+
+    size_t used = 0;
+    do
+    {
+        if (used == out.size())
+            out.resize(out.size() * 2);
+
+        deflater.next_out = (Bytef *)&out[used];
+        deflater.avail_out = out.size() - used;
+
+        int ret = deflate(&deflater, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            cErrorDom("websocket") << "deflate failed: " << ret;
+            return false;
+        }
+
+        used = out.size() - deflater.avail_out;
+    }
+    while (deflater.avail_out == 0);
+
+    //the empty block at the end of the flush is implied
+    if (used >= 4 && memcmp(&out[used - 4], deflate_tail, 4) == 0)
+        used -= 4;
+    out.resize(used);
+
+    if (server_no_context_takeover)
+        deflateReset(&deflater);
+
+    return true;
+}
+
+bool WebSocketDeflate::decompress(const string &in, string &out)
+{
+    if (!inflate_init) return false;
+
+    out.clear();
+
+    char buf[16384];
+    bool stream_end = false;
+    for (int part = 0;part < 2 && !stream_end;part++)
+    {
+        if (part == 0)
+        {
+            inflater.next_in = (Bytef *)in.data();
+            inflater.avail_in = in.size();
+        }
+        else
+        {
+            inflater.next_in = (Bytef *)deflate_tail;
+            inflater.avail_in = sizeof(deflate_tail);
+        }
+
+        do
+        {
+            inflater.next_out = (Bytef *)buf;
+            inflater.avail_out = sizeof(buf);
+
+            int ret = inflate(&inflater, Z_SYNC_FLUSH);
+            if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END)
+            {
+                cWarningDom("websocket") << "inflate failed: " << ret;
+                return false;
+            }
+
+            out.append(buf, sizeof(buf) - inflater.avail_out);
+
+            if (out.size() > WS_DEFLATE_MAX_INFLATE)
+            {
+                cWarningDom("websocket") << "inflated message is too big";
+                return false;
+            }
+
+            if (ret == Z_STREAM_END)
+                stream_end = true;
+
+            if (ret == Z_BUF_ERROR || ret == Z_STREAM_END)
+                break;
+        }
+        while (inflater.avail_in > 0 || inflater.avail_out == 0);
+    }
+
+    if (client_no_context_takeover)
+    {
+        inflateReset(&inflater);
+    }
+    else if (stream_end)
+    {
+        //The client ended the deflate stream with a BFINAL block, the
+        //inflater must be reset to read the next message, but the window
+        //is still used by the next one
+        Bytef dict[32768];
+        uInt dict_size = sizeof(dict);
+        if (inflateGetDictionary(&inflater, dict, &dict_size) != Z_OK)
+            dict_size = 0;
+
+        inflateReset(&inflater);
+
+        if (dict_size > 0)
+            inflateSetDictionary(&inflater, dict, dict_size);
+    }
+
+    return true;
+}
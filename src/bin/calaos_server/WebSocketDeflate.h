@@ -0,0 +1,75 @@
+/******************************************************************************
+ **  Copyright (c) 2007-2015, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef S_WebSocketDeflate_H
+#define S_WebSocketDeflate_H
+
+#include "Calaos.h"
+#include <zlib.h>
+
+using namespace Calaos;
+
+//Messages smaller than that are not compressed, can be changed with the
+//"websocket_deflate_threshold" option
+#define WS_DEFLATE_THRESHOLD            256
+
+//An inflated message can't be bigger than that
+#define WS_DEFLATE_MAX_INFLATE          (64 * 1024 * 1024)
+
+/*
+ * permessage-deflate extension (RFC 7692).
+ *
+ * negotiate() picks the first offer of the client we can accept and builds
+ * the Sec-WebSocket-Extensions response. Messages are compressed with the
+ * sliding window kept from one message to the next, unless a
+ * no_context_takeover parameter was agreed for that direction.
+ */
+class WebSocketDeflate
+{
+public:
+    WebSocketDeflate();
+    ~WebSocketDeflate();
+
+    //Parse the extensions header of the client, return false if no
+    //permessage-deflate offer can be accepted. server_no_context is our
+    //choice to reset the compressor for each message.
+    bool negotiate(const string &extensions, bool server_no_context, string &response);
+
+    bool compress(const string &in, string &out);
+    bool decompress(const string &in, string &out);
+
+    bool getServerNoContextTakeover() const { return server_no_context_takeover; }
+    bool getClientNoContextTakeover() const { return client_no_context_takeover; }
+    int getServerMaxWindowBits() const { return server_max_window_bits; }
+
+private:
+    bool server_no_context_takeover = false;
+    bool client_no_context_takeover = false;
+    int server_max_window_bits = 15;
+
+    z_stream deflater;
+    z_stream inflater;
+    bool deflate_init = false;
+    bool inflate_init = false;
+
+    bool parseOffer(const vector<string> &params);
+};
+
+#endif
@@ -21,6 +21,12 @@
 #include "WebSocketFrame.h"
 #include "WebSocket.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 const uint64_t MAX_FRAME_SIZE_IN_BYTES = INT_MAX - 1;
 
 WebSocketFrame::WebSocketFrame()
@@ -37,7 +43,7 @@ void WebSocketFrame::clear()
     rsv1 = rsv2 = rsv3 = 0;
     opcode = OpCodeClose;
     payload_length = 0;
-    payload.clear();
+    payload_data = nullptr;
     isvalid = false;
     maskbit = false;
     haserror = false;
@@ -45,7 +51,10 @@ void WebSocketFrame::clear()
 
 void WebSocketFrame::checkValid()
 {
-    if (rsv1 || rsv2 || rsv3)
+    //RSV1 marks the first frame of a compressed message
+    bool rsv1_valid = !rsv1 || (rsv1Allowed && isDataFrame() && !isContinuationFrame());
+
+    if (!rsv1_valid || rsv2 || rsv3)
     {
         closeCode = WebSocket::CloseCodeProtocolError;
         closeReason = "RSV fields are non zero";
@@ -82,30 +91,34 @@ void WebSocketFrame::checkValid()
         isvalid = true;
 }
 
-bool WebSocketFrame::processFrameData(string &data)
+bool WebSocketFrame::processFrameData(string &data, size_t &pos)
 {
     bool finished = false;
 
-    while (!data.empty() && !finished)
+    //bytes are read from pos, the caller drops the consumed data when it wants
+    while (pos < data.size() && !finished)
     {
+        const uint8_t *d = (const uint8_t *)data.data() + pos;
+        size_t avail = data.size() - pos;
+
         switch(state)
         {
         case StateReadHeader:
         {
-            if (data.size() >= 2)
+            if (avail >= 2)
             {
                 //first byte read FIN, RSV*, opcode
-                finalFrame = (uint8_t(data[0]) & 0x80) != 0;
-                rsv1 = (uint8_t(data[0]) & 0x40);
-                rsv2 = (uint8_t(data[0]) & 0x20);
-                rsv3 = (uint8_t(data[0]) & 0x10);
-                opcode = (uint8_t(data[0]) & 0x0F);
+                finalFrame = (d[0] & 0x80) != 0;
+                rsv1 = (d[0] & 0x40);
+                rsv2 = (d[0] & 0x20);
+                rsv3 = (d[0] & 0x10);
+                opcode = (d[0] & 0x0F);
 
                 //second byte, read mask payload length
-                maskbit = (uint8_t(data[1]) & 0x80) != 0;
-                payload_length = (uint8_t(data[1]) & 0x7F);
+                maskbit = (d[1] & 0x80) != 0;
+                payload_length = (d[1] & 0x7F);
 
-                data.erase(0, 2);
+                pos += 2;
 
                 if (payload_length == 126)
                     state = StateReadPayloadLength;
@@ -122,10 +135,10 @@ bool WebSocketFrame::processFrameData(string &data)
         }
         case StateReadPayloadLength:
         {
-            if (data.size() >= 2)
+            if (avail >= 2)
             {
-                payload_length = (uint8_t(data[0]) << 8) | uint8_t(data[1]);
-                data.erase(0, 2);
+                payload_length = (d[0] << 8) | d[1];
+                pos += 2;
 
                 if (payload_length < 126)
                 {
@@ -144,18 +157,12 @@ bool WebSocketFrame::processFrameData(string &data)
         }
         case StateReadBigPayloadLength:
         {
-            if (data.size() >= 8)
+            if (avail >= 8)
             {
-                payload_length =
-                        (uint64_t(uint8_t(data[0])) << 56) |
-                        (uint64_t(uint8_t(data[1])) << 48) |
-                        (uint64_t(uint8_t(data[2])) << 40) |
-                        (uint64_t(uint8_t(data[3])) << 32) |
-                        (uint8_t(data[4]) << 24) |
-                        (uint8_t(data[5]) << 16) |
-                        (uint8_t(data[6]) << 8) |
-                        uint8_t(data[7]);
-                data.erase(0, 8);
+                payload_length = 0;
+                for (int i = 0;i < 8;i++)
+                    payload_length = (payload_length << 8) | d[i];
+                pos += 8;
 
                 uint64_t v = 1;
                 if (payload_length & (v << 63))
@@ -183,13 +190,13 @@ bool WebSocketFrame::processFrameData(string &data)
         }
         case StateReadMask:
         {
-            if (data.size() >= 4)
+            if (avail >= 4)
             {
-                mask = (uint8_t(data[0]) << 24) |
-                       (uint8_t(data[1]) << 16) |
-                       (uint8_t(data[2]) << 8) |
-                       (uint8_t(data[3]));
-                data.erase(0, 4);
+                mask = (uint32_t(d[0]) << 24) |
+                       (uint32_t(d[1]) << 16) |
+                       (uint32_t(d[2]) << 8) |
+                       (uint32_t(d[3]));
+                pos += 4;
 
                 state = StateReadPayload;
 
@@ -223,13 +230,14 @@ bool WebSocketFrame::processFrameData(string &data)
             }
             else
             {
-                if (data.size() >= payload_length)
+                if (avail >= payload_length)
                 {
-                    payload = data.substr(0, payload_length);
-                    data.erase(0, payload_length);
+                    //the payload stays in the buffer, unmasked in place
+                    payload_data = &data[pos];
+                    pos += payload_length;
 
                     if (maskbit)
-                        processMask();
+                        unmask(payload_data, payload_length, mask);
 
                     finished = true;
                     state = StateReadHeader;
@@ -248,23 +256,50 @@ bool WebSocketFrame::processFrameData(string &data)
     return finished;
 }
 
-void WebSocketFrame::processMask()
+void WebSocketFrame::unmask(char *data, uint64_t size, uint32_t mask)
 {
-    //unmask payload
-    const uint8_t m[] = { uint8_t((mask & 0xFF000000u) >> 24),
-                          uint8_t((mask & 0x00FF0000u) >> 16),
-                          uint8_t((mask & 0x0000FF00u) >> 8),
-                          uint8_t((mask & 0x000000FFu))
+    const uint8_t m[] = { uint8_t(mask >> 24),
+                          uint8_t(mask >> 16),
+                          uint8_t(mask >> 8),
+                          uint8_t(mask)
                         };
 
-    char *p = (char *)payload.c_str();
-    int i = 0;
-    uint64_t size = payload.size();
-    std::stringstream stream;
-    stream << std::hex << mask;
-    cDebugDom("websocket") << "payload size: " << size << " mask: " << stream.str();
-    while (size-- > 0)
-        *p++ ^= m[i++ % 4];
+    //the mask repeated on 16 bytes, all blocks start on a multiple of 4
+    uint8_t m16[16];
+    for (int i = 0;i < 16;i++)
+        m16[i] = m[i & 3];
+
+    uint64_t i = 0;
+
+#if defined(__SSE2__)
+    __m128i vm = _mm_loadu_si128((const __m128i *)m16);
+    for (;i + 16 <= size;i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        _mm_storeu_si128((__m128i *)(data + i), _mm_xor_si128(v, vm));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t vm = vld1q_u8(m16);
+    for (;i + 16 <= size;i += 16)
+    {
+        uint8_t *p = (uint8_t *)data + i;
+        vst1q_u8(p, veorq_u8(vld1q_u8(p), vm));
+    }
+#endif
+
+    //memcpy is used for unaligned access, it is turned into a single load
+    uint64_t m64;
+    memcpy(&m64, m16, sizeof(m64));
+    for (;i + 8 <= size;i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, data + i, sizeof(v));
+        v ^= m64;
+        memcpy(data + i, &v, sizeof(v));
+    }
+
+    for (;i < size;i++)
+        data[i] ^= m[i & 3];
 }
 
 string WebSocketFrame::toString()
@@ -277,14 +312,16 @@ string WebSocketFrame::toString()
       << " Continue:" << (isContinuationFrame()?'1':'0')
       << " isText:" << (getOpcode() == OpCodeText?'1':'0')
       << " payloadSize:" << payload_length;
-    if (isTextFrame())
-        s << " " << (payload.size() > 40?payload.substr(0, 40):payload);
+    if (isTextFrame() && payload_data)
+        s << " " << string(payload_data, payload_length > 40?40:payload_length);
 
     return s.str();
 }
 
 void WebSocketFrame::parseCloseCodeReason(uint16_t &code, string &reason)
 {
+    string payload = getPayload();
+
     if (payload.size() == 1)
     {
         code = WebSocket::CloseCodeProtocolError;
@@ -299,35 +336,35 @@ void WebSocketFrame::parseCloseCodeReason(uint16_t &code, string &reason)
 string WebSocketFrame::makeFrame(int _opcode, const string &_payload, bool _lastframe)
 {
     string frame;
+    appendFrame(frame, _opcode, _payload.data(), _payload.size(), _lastframe);
 
-    if (_payload.size() > 0x7FFFFFFFFFFFFFFFULL)
-    {
-        cErrorDom("websocket") << "frame payload too big: " << _payload.size();
-        return frame;
-    }
+    return frame;
+}
 
-    uint8_t b = static_cast<uint8_t>((_opcode & 0x0F) | (_lastframe ? 0x80 : 0x00));
+void WebSocketFrame::appendHeader(string &frame, int _opcode, uint64_t _size, bool _lastframe, bool _rsv1)
+{
+    uint8_t b = static_cast<uint8_t>((_opcode & 0x0F) | (_lastframe ? 0x80 : 0x00) | (_rsv1 ? 0x40 : 0x00));
     frame.push_back(static_cast<char>(b));
 
     b = 0;
 
-    if (_payload.size() <= 125)
+    if (_size <= 125)
     {
-        b |= static_cast<uint8_t>(_payload.size());
+        b |= static_cast<uint8_t>(_size);
         frame.push_back(static_cast<char>(b));
     }
-    else if (_payload.size() <= 0xFFFFU)
+    else if (_size <= 0xFFFFU)
     {
         b |= 126;
         frame.push_back(static_cast<char>(b));
-        frame.push_back(static_cast<char>(_payload.size() >> 8));
-        frame.push_back(static_cast<char>(_payload.size()));
+        frame.push_back(static_cast<char>(_size >> 8));
+        frame.push_back(static_cast<char>(_size));
     }
-    else if (_payload.size() <= 0x7FFFFFFFFFFFFFFFULL)
+    else
     {
         b |= 127;
         frame.push_back(static_cast<char>(b));
-        uint64_t s = _payload.size();
+        uint64_t s = _size;
         frame.push_back(static_cast<char>((s >> 56) & 0x7F));
         frame.push_back(static_cast<char>(s >> 48));
         frame.push_back(static_cast<char>(s >> 40));
@@ -337,8 +374,53 @@ string WebSocketFrame::makeFrame(int _opcode, const string &_payload, bool _last
         frame.push_back(static_cast<char>(s >> 8));
         frame.push_back(static_cast<char>(s));
     }
+}
+
+void WebSocketFrame::appendFrame(string &frame, int _opcode, const char *_payload, uint64_t _size, bool _lastframe, bool _rsv1)
+{
+    if (_size > 0x7FFFFFFFFFFFFFFFULL)
+    {
+        cErrorDom("websocket") << "frame payload too big: " << _size;
+        return;
+    }
 
-    frame.append(_payload);
+    appendHeader(frame, _opcode, _size, _lastframe, _rsv1);
+    frame.append(_payload, _size);
+}
 
-    return frame;
+string WebSocketFrame::makeFrames(int _opcode, const string &_payload, uint64_t max_size, bool compressed)
+{
+    uint64_t numframes = _payload.size() / max_size;
+    if (_payload.size() % max_size || numframes == 0)
+        numframes++;
+
+    string frames;
+    frames.reserve(_payload.size() + numframes * 10);
+
+    uint64_t current = 0;
+    for (uint64_t i = 0;i < numframes;i++)
+    {
+        uint64_t sz = _payload.size() - current;
+        if (sz > max_size) sz = max_size;
+
+        appendFrame(frames,
+                    i == 0?_opcode:OpCodeContinue,
+                    _payload.data() + current, sz,
+                    i == numframes - 1,
+                    i == 0 && compressed);
+
+        current += sz;
+    }
+
+    return frames;
+}
+
+WebSocketMessage::WebSocketMessage(const string &_data, bool isbinary, const string &conflate_key):
+    data(_data),
+    binary(isbinary),
+    conflateKey(conflate_key)
+{
+    frames = WebSocketFrame::makeFrames(binary?WebSocketFrame::OpCodeBinary:WebSocketFrame::OpCodeText,
+                                        data,
+                                        FRAME_SIZE_IN_BYTES);
 }
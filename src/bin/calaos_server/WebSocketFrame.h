@@ -22,9 +22,13 @@
 #define S_WebSocketFrame_H
 
 #include "Calaos.h"
+#include <memory>
 
 using namespace Calaos;
 
+//Messages bigger than that are fragmented
+const uint64_t FRAME_SIZE_IN_BYTES = 512 * 512 * 2;
+
 class WebSocketFrame
 {
 public:
@@ -47,7 +51,12 @@ public:
     int getRsv2() const { return rsv2; }
     int getRsv3() const { return rsv3; }
     int getOpcode() const { return opcode; }
-    string getPayload() const { return payload; }
+    string getPayload() const { return payload_data?string(payload_data, payload_length):string(); }
+
+    //The payload is not copied, it points in the buffer given to
+    //processFrameData() and is valid until this buffer is changed
+    const char *getPayloadData() const { return payload_data; }
+    uint64_t getPayloadSize() const { return payload_data?payload_length:0; }
     bool isOpCodeReserved() { return ((opcode > OpCodeBinary) && (opcode < OpCodeClose)) || (opcode > OpCodePong); }
 
     void clear();
@@ -56,13 +65,27 @@ public:
 
     bool hasError() const { return haserror; }
 
-    bool processFrameData(string &data);
+    //Parse data from pos, pos is moved after the consumed bytes. Return true
+    //when a frame is complete. The payload is unmasked in place.
+    bool processFrameData(string &data, size_t &pos);
+
+    //xor the websocket mask on data, 16 or 8 bytes at a time
+    static void unmask(char *data, uint64_t size, uint32_t mask);
 
     string toString();
 
     void parseCloseCodeReason(uint16_t &code, string &reason);
 
     static string makeFrame(int opcode, const string &payload, bool lastframe);
+    static void appendHeader(string &frame, int opcode, uint64_t size, bool lastframe, bool rsv1 = false);
+    static void appendFrame(string &frame, int opcode, const char *payload, uint64_t size, bool lastframe, bool rsv1 = false);
+
+    //Build all frames of a message, payload is split in frames of max_size bytes.
+    //compressed sets RSV1 on the first frame (permessage-deflate)
+    static string makeFrames(int opcode, const string &payload, uint64_t max_size, bool compressed = false);
+
+    //RSV1 is used by permessage-deflate once negotiated
+    void setRsv1Allowed(bool allowed) { rsv1Allowed = allowed; }
 
     enum OpCode
     {
@@ -108,13 +131,36 @@ private:
     bool maskbit;
 
     uint64_t payload_length;
-    string payload;
+    char *payload_data;
 
     bool isvalid;
     bool haserror;
 
+    bool rsv1Allowed = false;
+
     void checkValid();
-    void processMask();
 };
 
+//A message framed once, the same buffer is sent to all connections
+class WebSocketMessage
+{
+public:
+    WebSocketMessage(const string &data, bool isbinary = false, const string &conflate_key = string());
+
+    const string &getData() const { return data; }
+    const string &getFrames() const { return frames; }
+    bool isBinary() const { return binary; }
+
+    //Messages with the same key replace each other in the queue of a slow client
+    const string &getConflateKey() const { return conflateKey; }
+
+private:
+    string data;
+    string frames;
+    bool binary;
+    string conflateKey;
+};
+
+typedef std::shared_ptr<const WebSocketMessage> WebSocketMessagePtr;
+
 #endif
@@ -35,6 +35,7 @@
 #include "HttpServer.h"
 #include "Zibase.h"
 #include "Prefix.h"
+#include "DataLogger.h"
 
 using namespace Calaos;
 
@@ -156,7 +157,8 @@ int main (int argc, char **argv)
     Utils::Watchdog("calaosd");
 
     //main loop
-    EcoreTimer *eventLoop = new EcoreTimer(10. / 1000., (sigc::slot<void>)sigc::mem_fun(ListeRule::Instance(), &ListeRule::RunEventLoop) );
+    //start checking time/temperature inputs, the event loop then reschedules itself
+    ListeRule::Instance().RunEventLoop();
     watchdogLoop = new EcoreTimer(5., (sigc::slot<void>)sigc::bind(sigc::ptr_fun(Utils::Watchdog), "calaosd") );
 
     //Check config once the main loop is started
@@ -173,7 +175,10 @@ int main (int argc, char **argv)
     Zibase::stopAllZibase();
 
     //Clean up evrything
-    delete eventLoop;
+    ListeRule::Instance().StopLoop();
+
+    //Write logged values still in memory
+    DataLogger::Instance().shutdown();
     if (watchdogLoop)
     {
         delete watchdogLoop;
@@ -27,11 +27,23 @@
 
 using namespace std;
 
-#define EinaLogDebug(a)         a->EinaDebug(__FILE__, __PRETTY_FUNCTION__, __LINE__)
-#define EinaLogInfo(a)          a->EinaInfo(__FILE__, __PRETTY_FUNCTION__, __LINE__)
-#define EinaLogWarning(a)       a->EinaWarning(__FILE__, __PRETTY_FUNCTION__, __LINE__)
-#define EinaLogError(a)         a->EinaError(__FILE__, __PRETTY_FUNCTION__, __LINE__)
-#define EinaLogCritical(a)      a->EinaCritical(__FILE__, __PRETTY_FUNCTION__, __LINE__)
+//Least important level of log compiled in (eina levels, 0 is critical and 4
+//is debug). Log statements above this level are removed by the compiler,
+//configure with --with-log-level=3 to strip debug logs from a release build.
+#ifndef CALAOS_LOG_MIN_LEVEL
+#define CALAOS_LOG_MIN_LEVEL    EINA_LOG_LEVEL_DBG
+#endif
+
+//The level is checked first, nothing is formatted if the log is disabled
+#define EinaLogLevel(a, lvl) \
+    ((lvl) > CALAOS_LOG_MIN_LEVEL || !(a)->isEnabled(lvl)) ? (void)0 : \
+    efl::eina::log::LogVoidify() & (a)->EinaLogStream(lvl, __FILE__, __PRETTY_FUNCTION__, __LINE__)
+
+#define EinaLogDebug(a)         EinaLogLevel(a, EINA_LOG_LEVEL_DBG)
+#define EinaLogInfo(a)          EinaLogLevel(a, EINA_LOG_LEVEL_INFO)
+#define EinaLogWarning(a)       EinaLogLevel(a, EINA_LOG_LEVEL_WARN)
+#define EinaLogError(a)         EinaLogLevel(a, EINA_LOG_LEVEL_ERR)
+#define EinaLogCritical(a)      EinaLogLevel(a, EINA_LOG_LEVEL_CRITICAL)
 
 namespace efl
 {
@@ -45,7 +57,7 @@ class LogStream
 private:
     struct LogData
     {
-        LogData(int d, string f, string fn, int ln, Eina_Log_Level l):
+        LogData(int d, const char *f, const char *fn, int ln, Eina_Log_Level l):
             domain(d),
             file(f),
             function(fn),
@@ -53,7 +65,7 @@ private:
             level(l)
         {}
         int domain;
-        string file, function;
+        const char *file, *function; //__FILE__ and __PRETTY_FUNCTION__
         int line;
         Eina_Log_Level level;
         ostringstream stream;
@@ -66,7 +78,7 @@ public:
         logData->stream << obj;
         return *this;
     }
-    LogStream(int d, string f, string fn, int ln, Eina_Log_Level l):
+    LogStream(int d, const char *f, const char *fn, int ln, Eina_Log_Level l):
         logData(new LogData(d, f, fn, ln, l))
     {}
 
@@ -74,8 +86,8 @@ public:
     {
         eina_log_print(logData->domain,
                        logData->level,
-                       logData->file.c_str(),
-                       logData->function.c_str(),
+                       logData->file,
+                       logData->function,
                        logData->line,
                        "%s",
                        logData->stream.str().c_str());
@@ -84,16 +96,27 @@ public:
     }
 };
 
+//Turns the log stream into void for the ?: of EinaLogLevel()
+class LogVoidify
+{
+public:
+    void operator&(const LogStream &) {}
+};
+
 class EinaLog
 {
 private:
     int domain;
     string domainName;
 
+    //level of the domain, read once when registered
+    int level;
+
 public:
     EinaLog(string dname="EinaLog"):
         domain(-1),
-        domainName(dname)
+        domainName(dname),
+        level(EINA_LOG_LEVEL_DBG)
     {
         eina_init();
         if(domain<0)
@@ -101,6 +124,7 @@ public:
             domain = eina_log_domain_register(domainName.c_str(), EINA_COLOR_CYAN);
             if(domain<0) domain = EINA_LOG_DOMAIN_GLOBAL;
         }
+        updateLevel();
     }
     ~EinaLog()
     {
@@ -108,23 +132,39 @@ public:
             eina_log_domain_unregister(domain);
     }
 
-    LogStream EinaDebug(string file, string function, int line) const
+    //Needs to be called if the level of the domain is changed at runtime
+    void updateLevel()
+    {
+        if (domain == EINA_LOG_DOMAIN_GLOBAL)
+            level = eina_log_level_get();
+        else
+            level = eina_log_domain_registered_level_get(domain);
+    }
+
+    bool isEnabled(int l) const { return l <= level; }
+
+    LogStream EinaLogStream(Eina_Log_Level l, const char *file, const char *function, int line) const
+    {
+        return LogStream(domain, file, function, line, l);
+    }
+
+    LogStream EinaDebug(const char *file, const char *function, int line) const
     {
         return LogStream(domain, file, function, line, EINA_LOG_LEVEL_DBG);
     }
-    LogStream EinaInfo(string file, string function, int line) const
+    LogStream EinaInfo(const char *file, const char *function, int line) const
     {
         return LogStream(domain, file, function, line, EINA_LOG_LEVEL_INFO);
     }
-    LogStream EinaCritical(string file, string function, int line) const
+    LogStream EinaCritical(const char *file, const char *function, int line) const
     {
         return LogStream(domain, file, function, line, EINA_LOG_LEVEL_CRITICAL);
     }
-    LogStream EinaError(string file, string function, int line) const
+    LogStream EinaError(const char *file, const char *function, int line) const
     {
         return LogStream(domain, file, function, line, EINA_LOG_LEVEL_ERR);
     }
-    LogStream EinaWarning(string file, string function, int line) const
+    LogStream EinaWarning(const char *file, const char *function, int line) const
     {
         return LogStream(domain, file, function, line, EINA_LOG_LEVEL_WARN);
     }
@@ -19,42 +19,54 @@
  **
  ******************************************************************************/
 #include <IPC.h>
+#include <sys/eventfd.h>
 
 static Eina_Bool _calaos_ipc_event(void *data, Ecore_Fd_Handler *fdh)
 {
-    //We got something from the pipe
+    //We got something from the eventfd
     IPC::Instance().BroadcastEvent();
 
     return 1;
 }
 
-IPC::IPC(): mutex(false)
+IPC::IPC():
+    fd_handler(NULL),
+    enqueue_pos(0),
+    dequeue_pos(0),
+    pending(0),
+    high_water(0),
+    overflow_count(0),
+    mutex(false),
+    overflow_used(false),
+    dispatching(0),
+    handlers_dirty(false)
 {
-    int fds[2];
+    queue = new IPCCell[IPC_QUEUE_SIZE];
+    for (size_t i = 0;i < IPC_QUEUE_SIZE;i++)
+        queue[i].seq.store(i, std::memory_order_relaxed);
 
-    if (pipe(fds) == 0)
-    {
-        fd_read = fds[0];
-        fd_write = fds[1];
-        //set the read pipe to non blocking
-        fcntl(fd_read, F_SETFL, O_NONBLOCK);
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
+    if (event_fd >= 0)
+    {
         //add to ecore
-        fd_handler = ecore_main_fd_handler_add(fd_read, ECORE_FD_READ,
+        fd_handler = ecore_main_fd_handler_add(event_fd, ECORE_FD_READ,
                                                _calaos_ipc_event, NULL,
                                                NULL, NULL);
         ecore_main_fd_handler_active_set(fd_handler, ECORE_FD_READ);
     }
     else
     {
-        cErrorDom("ipc") << "Error creating pipe !";
+        cErrorDom("ipc") << "Error creating eventfd !";
     }
 }
 
 IPC::~IPC()
 {
-    close(fd_read);
-    close(fd_write);
+    if (event_fd >= 0)
+        close(event_fd);
+
+    delete[] queue;
 }
 
 void IPC::AddHandler(string source, string emission, sigc::signal<void, std::string, std::string, void*, void*> &signal, void *data)
@@ -65,146 +77,291 @@ void IPC::AddHandler(string source, string emission, sigc::signal<void, std::str
     s.data = data;
     s.signal = &signal;
 
-    signals.push_back(s);
+    if (source == "*" || emission == "*")
+        wildcard_handlers.push_back(s);
+    else
+        handlers[source][emission].push_back(s);
 }
 
 void IPC::DeleteHandler(sigc::signal<void, std::string, std::string, void*, void*> &signal)
 {
-    list<IPCSignal>::iterator it;
+    auto remove = [this, &signal](vector<IPCSignal> &list) -> bool
+    {
+        for (uint i = 0;i < list.size();i++)
+        {
+            if (list[i].signal != &signal) continue;
 
-    for(it = signals.begin();it != signals.end();it++)
+            //the list may be used by BroadcastEvent(), only mark it
+            if (dispatching > 0)
+            {
+                list[i].signal = NULL;
+                handlers_dirty = true;
+            }
+            else
+                list.erase(list.begin() + i);
+
+            return true;
+        }
+
+        return false;
+    };
+
+    for (auto &src: handlers)
     {
-        if ((*it).signal == &signal)
+        for (auto &em: src.second)
         {
-            signals.erase(it);
-            break;
+            if (remove(em.second))
+                return;
         }
     }
+
+    remove(wildcard_handlers);
 }
 
-void IPC::SendEvent(string source, string emission, void* data)
+void IPC::cleanHandlers()
 {
-    IPCMsg msg;
-    msg.source = source;
-    msg.emission = emission;
-    msg.data = data;
-    msg.auto_delete = false;
+    auto deleted = [](const IPCSignal &s) { return s.signal == NULL; };
 
-    mutex.lock();
-    events.push_back(msg);
-    mutex.unlock();
+    for (auto src = handlers.begin();src != handlers.end();)
+    {
+        for (auto em = src->second.begin();em != src->second.end();)
+        {
+            em->second.erase(std::remove_if(em->second.begin(), em->second.end(), deleted),
+                             em->second.end());
 
-    cDebugDom("ipc") << "(" << source << " , " << emission <<
-                        ") : " << events.size() << " events waiting.";
-    /* The mutex2 slows down everything, it's faster to write everytime to the pipe */
-    //         if (mutex2.try_lock())
-    //         {
-    //                 mutex2.unlock();
-
-    //wake up the listener
-    string s = "wake_up";
-    if (write(fd_write, s.c_str(), s.length()) < 0)
+            if (em->second.empty())
+                em = src->second.erase(em);
+            else
+                em++;
+        }
+
+        if (src->second.empty())
+            src = handlers.erase(src);
+        else
+            src++;
+    }
+
+    wildcard_handlers.erase(std::remove_if(wildcard_handlers.begin(), wildcard_handlers.end(), deleted),
+                            wildcard_handlers.end());
+
+    handlers_dirty = false;
+}
+
+bool IPC::enqueue(const string &source, const string &emission, void *data,
+                  bool auto_delete, const IPCData &del_data)
+{
+    IPCCell *cell;
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        cell = &queue[pos & (IPC_QUEUE_SIZE - 1)];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            //the cell is free, try to take it
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            //queue is full
+            return false;
+        }
+        else
+        {
+            //another thread took the cell
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    //strings are copied in the buffers of the cell, no allocation
+    //once the cell has been used with the same names
+    cell->msg.source = source;
+    cell->msg.emission = emission;
+    cell->msg.data = data;
+    cell->msg.auto_delete = auto_delete;
+    cell->msg.del_data = del_data;
+
+    //publish it to the main loop
+    cell->seq.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+void IPC::pushEvent(const string &source, const string &emission, void *data,
+                    bool auto_delete, const IPCData &del_data)
+{
+    //Once the overflow list is used, events go there until the main loop
+    //has drained it, to keep the order of the events of a thread
+    if (overflow_used.load(std::memory_order_acquire) ||
+        !enqueue(source, emission, data, auto_delete, del_data))
+    {
+        IPCMsg msg;
+        msg.source = source;
+        msg.emission = emission;
+        msg.data = data;
+        msg.auto_delete = auto_delete;
+        msg.del_data = del_data;
+
+        mutex.lock();
+        overflow.push_back(msg);
+        overflow_used.store(true, std::memory_order_release);
+        mutex.unlock();
+
+        overflow_count++;
+    }
+
+    long depth = pending.fetch_add(1) + 1;
+
+    long hw = high_water.load(std::memory_order_relaxed);
+    while (depth > hw && !high_water.compare_exchange_weak(hw, depth, std::memory_order_relaxed)) ;
+
+    //wake up the main loop only if it was not already
+    if (depth == 1)
+        wakeUp();
+}
+
+void IPC::wakeUp()
+{
+    uint64_t v = 1;
+
+    if (write(event_fd, &v, sizeof(v)) < 0)
     {
-        cErrorDom("ipc") << "Error writing to pipe !";
+        cErrorDom("ipc") << "Error writing to eventfd !";
     }
-    //         }
+}
+
+void IPC::SendEvent(string source, string emission, void* data)
+{
+    pushEvent(source, emission, data, false, IPCData());
+
+    cDebugDom("ipc") << "(" << source << " , " << emission <<
+                        ") : " << getQueueDepth() << " events waiting.";
 }
 
 void IPC::SendEvent(string source, string emission, IPCData data, bool auto_delete_data)
 {
-    IPCMsg msg;
-    msg.source = source;
-    msg.emission = emission;
-    msg.data = data.data;
-    msg.auto_delete = auto_delete_data;
-    msg.del_data = data;
-
-    mutex.lock();
-    events.push_back(msg);
-    mutex.unlock();
-
-    /* The mutex2 slows down everything, it's faster to write everytime to the pipe */
-    //         if (mutex2.try_lock())
-    //         {
-    //                 mutex2.unlock();
-
-    //wake up the listener
-    string s = "wake_up";
-    if (write(fd_write, s.c_str(), s.length()) < 0)
+    pushEvent(source, emission, data.data, auto_delete_data, data);
+}
+
+void IPC::emitHandlers(vector<IPCSignal> &list, IPCMsg &msg, bool wildcard)
+{
+    //handlers added by a callback are not called for this event
+    uint count = list.size();
+
+    for (uint i = 0;i < count;i++)
     {
-        cErrorDom("ipc") << "Error writing to pipe !";
+        //deleted by a previous callback
+        if (!list[i].signal) continue;
+
+        if (wildcard &&
+            !((msg.source == list[i].source || list[i].source == "*") &&
+              (msg.emission == list[i].emission || list[i].emission == "*")))
+            continue;
+
+        //the list can grow during the call, don't keep a reference to it
+        sigc::signal<void, string, string, void*, void*> *signal = list[i].signal;
+        signal->emit(msg.source, msg.emission, list[i].data, msg.data);
     }
-    //         }
 }
 
-void IPC::BroadcastEvent()
+void IPC::dispatch(IPCMsg &msg)
 {
-    char evname[MAX_EVENT_NAME];
-    memset(evname, '\0', MAX_EVENT_NAME);
+    cDebugDom("ipc") << "(\"" <<
+                        msg.source<<"\"  ,  \""<<msg.emission<< "\" , " << Utils::to_string(msg.data) << ")";
+
+    dispatching++;
+
+    auto src = handlers.find(msg.source);
+    if (src != handlers.end())
+    {
+        auto em = src->second.find(msg.emission);
+        if (em != src->second.end())
+            emitHandlers(em->second, msg, false);
+    }
+
+    if (!wildcard_handlers.empty())
+        emitHandlers(wildcard_handlers, msg, true);
 
-    if (read(fd_read, evname, MAX_EVENT_NAME) > 0)
+    dispatching--;
+
+    //Delete data if flag is set
+    if (msg.auto_delete)
     {
-        /* The mutex2 slows down everything, it's faster to write everytime to the pipe */
-        //                mutex2.lock();
-        while(events.size() > 0)
+        if (msg.data && msg.del_data.destroy)
         {
-            mutex.lock();
-
-            /*
-                           Never remove an element from events outside of this block !
-                           Otherwise the events.begin iterator can become invalid
-                           (if there is no element in the list)
-                        */
-            list<IPCMsg>::iterator itd = events.begin();
-            if(itd == events.end())
-                break;
-            IPCMsg msg = (*itd);
-            events.erase(itd);
+            (*msg.del_data.destroy)(msg.data);
+            delete msg.del_data.destroy;
+        }
+        else
+        {
+            cErrorDom("ipc") << "(\"" <<
+                                msg.source<<"\"  ,  \""<<msg.emission<< "\") " <<
+                                "DeletorBase or data is NULL, can't delete. (Memory leak?)";
+        }
+    }
 
-            cDebugDom("ipc") << "(\"" <<
-                                msg.source<<"\"  ,  \""<<msg.emission<< "\" , " << Utils::to_string(msg.data) << ")";
+    msg.data = NULL;
+    msg.auto_delete = false;
+    msg.del_data = IPCData();
+}
 
-            list<IPCSignal>::iterator it;
+void IPC::BroadcastEvent()
+{
+    uint64_t v;
 
-            mutex.unlock();
+    if (read(event_fd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+    {
+        cErrorDom("ipc") << "Error reading from eventfd !";
+        return;
+    }
 
-            //we work on a copy to be sure we doesn't have a conflict
-            //sometimes the method call by signal->emit
-            //   call deleteHandler on the current handler
-            mutex.lock();
-            list<IPCSignal> signalsCopy = signals;
-            mutex.unlock();
-            for(it=signalsCopy.begin();it!=signalsCopy.end();it++)
-            {
-                if ( (msg.source == (*it).source || (*it).source == "*")
-                     && (msg.emission == (*it).emission || (*it).emission == "*"))
-                {
-                    (*it).signal->emit(msg.source, msg.emission,
-                                       (*it).data, msg.data);
-                }
-            }
+    //a callback is running the main loop, events are dispatched later
+    if (dispatching > 0)
+        return;
 
-            //Delete data if flag is set
-            if (msg.auto_delete)
-            {
-                if (msg.data && msg.del_data.destroy)
-                {
-                    (*msg.del_data.destroy)(msg.data);
-                    delete msg.del_data.destroy;
-                }
-                else
-                {
-                    cErrorDom("ipc") << "(\"" <<
-                                        msg.source<<"\"  ,  \""<<msg.emission<< "\") " <<
-                                        "DeletorBase or data is NULL, can't delete. (Memory leak?)";
-                }
-            }
+    long count = 0;
 
-        }
-        //                mutex2.unlock();
+    while (count < IPC_BATCH_MAX)
+    {
+        IPCCell *cell = &queue[dequeue_pos & (IPC_QUEUE_SIZE - 1)];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+
+        if ((intptr_t)seq - (intptr_t)(dequeue_pos + 1) < 0)
+            break; //queue is empty
+
+        //the cell can't be reused until it is released, dispatch in place
+        dispatch(cell->msg);
+
+        cell->seq.store(dequeue_pos + IPC_QUEUE_SIZE, std::memory_order_release);
+        dequeue_pos++;
+        count++;
     }
-    else
+
+    //Events that did not fit in the queue are always after the ones in the
+    //queue, dispatch them once the queue is empty
+    if (count < IPC_BATCH_MAX && overflow_used.load(std::memory_order_acquire))
     {
-        cErrorDom("ipc") << "Error reading from pipe !";
+        list<IPCMsg> l;
+
+        mutex.lock();
+        l.swap(overflow);
+        overflow_used.store(false, std::memory_order_release);
+        mutex.unlock();
+
+        for (IPCMsg &msg: l)
+            dispatch(msg);
+
+        count += l.size();
     }
+
+    if (handlers_dirty)
+        cleanHandlers();
+
+    //events are still waiting, continue at the next main loop iteration
+    if (pending.fetch_sub(count) - count > 0)
+        wakeUp();
 }
@@ -25,12 +25,20 @@
 #include <Mutex.h>
 #include <sigc++/sigc++.h>
 #include <Ecore.h>
+#include <atomic>
 
 using namespace Utils;
 
 //maximum string length for an event name
 #define MAX_EVENT_NAME          512
 
+//Number of events the queue can hold, must be a power of 2.
+//When full, events go to a locked overflow list.
+#define IPC_QUEUE_SIZE          1024
+
+//Maximum number of events dispatched per main loop iteration
+#define IPC_BATCH_MAX           256
+
 class IPCData
 {
 public:
@@ -52,7 +60,7 @@ public:
     bool auto_delete;       //If set, data will be auto deleted after use
     IPCData del_data;
 
-    IPCMsg(): source("*"), emission("*"), data(NULL)
+    IPCMsg(): source("*"), emission("*"), data(NULL), auto_delete(false)
     { }
 };
 
@@ -66,19 +74,62 @@ public:
 };
 
 /**
- * Do not remove an element from the list events outside the method IPC::BroadcastEvent() (see the method for more information)
+ * Events are sent from any thread and dispatched in the main loop.
+ *
+ * SendEvent() puts the event in a bounded lock-free queue (multiple producers,
+ * the main loop is the only consumer). The eventfd is only written when the
+ * queue goes from empty to non empty, the main loop then dispatches up to
+ * IPC_BATCH_MAX events per iteration.
+ *
+ * Handlers are stored in a table indexed by source and emission, handlers
+ * using "*" are in a separate list checked for every event.
  */
 class IPC
 {
 private:
-    int fd_read;
-    int fd_write;
+    class IPCCell
+    {
+    public:
+        std::atomic<size_t> seq;
+        IPCMsg msg;
+    };
+
+    int event_fd;
 
     Ecore_Fd_Handler *fd_handler;
+
+    //queue of events, cells are reused (and their strings buffers)
+    IPCCell *queue;
+    std::atomic<size_t> enqueue_pos;
+    size_t dequeue_pos;
+
+    //events pushed and not dispatched yet
+    std::atomic<long> pending;
+    std::atomic<long> high_water;
+    std::atomic<unsigned long> overflow_count;
+
+    //used when the queue is full
     Mutex mutex;
+    list<IPCMsg> overflow;
+    std::atomic<bool> overflow_used;
+
+    //source -> emission -> handlers
+    unordered_map<string, unordered_map<string, vector<IPCSignal>>> handlers;
+    vector<IPCSignal> wildcard_handlers;
+
+    //handlers deleted during a dispatch are removed after it
+    int dispatching;
+    bool handlers_dirty;
 
-    list<IPCMsg> events;
-    list<IPCSignal> signals;
+    void pushEvent(const string &source, const string &emission, void *data,
+                   bool auto_delete, const IPCData &del_data);
+    bool enqueue(const string &source, const string &emission, void *data,
+                 bool auto_delete, const IPCData &del_data);
+    void wakeUp();
+
+    void dispatch(IPCMsg &msg);
+    void emitHandlers(vector<IPCSignal> &list, IPCMsg &msg, bool wildcard);
+    void cleanHandlers();
 
     //ctor
     IPC();
@@ -114,6 +165,12 @@ public:
 
     //called by _calaos_ipc_event()
     void BroadcastEvent();
+
+    //Number of events waiting to be dispatched, and the maximum reached
+    long getQueueDepth() { long d = pending; return d < 0?0:d; }
+    long getHighWaterMark() { return high_water; }
+    //Number of events that did not fit in the queue
+    unsigned long getOverflowCount() { return overflow_count; }
 };
 
 #endif
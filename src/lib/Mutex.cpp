@@ -77,6 +77,24 @@ bool Mutex::condition_wait()
         return false;
 }
 
+bool Mutex::condition_wait(double timeout)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)timeout;
+    ts.tv_nsec += (long)((timeout - (time_t)timeout) * 1000000000.0);
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    if (pthread_cond_timedwait(&condition, &mutex, &ts) == 0)
+        return true;
+    else
+        return false;
+}
+
 bool Mutex::condition_wake(bool all)
 {
     if (all)
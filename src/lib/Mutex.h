@@ -49,6 +49,7 @@ public:
 
     //Condition locking
     bool condition_wait();
+    bool condition_wait(double timeout); //false if timeout is reached
     bool condition_wake(bool all = false);
 
 private:
@@ -22,6 +22,11 @@
 
 #include <Ecore_File.h>
 #include <tcpsocket.h>
+#include "Mutex.h"
+
+#if defined(__linux__) || defined(__linux) || defined(linux)
+#include <sys/inotify.h>
+#endif
 
 using namespace Utils;
 
@@ -553,152 +558,345 @@ void Utils::initConfigOptions(char *configdir, char *cachedir, bool quiet)
     }
 }
 
-string Utils::get_config_option(string _key)
+/*
+ * Options of local_config.xml are parsed once and kept in memory. Changes of
+ * the file made by other processes are detected with inotify (or by checking
+ * its mtime if inotify is not available) and it is parsed again on next
+ * access. Options are read from other threads (WagoMap, cameras), all
+ * accesses are protected by the mutex.
+ */
+class ConfigOptionsCache
 {
-    string value = "";
-    TiXmlDocument document(getConfigFile(LOCAL_CONFIG).c_str());
-
-    if (!document.LoadFile())
+public:
+    static ConfigOptionsCache &Instance()
     {
-        cError() <<  "There was an exception in XML parsing.";
-        cError() <<  "Parse error: " << document.ErrorDesc();
-        cError() <<  " At line " << document.ErrorRow();
-
-        return value;
+        static ConfigOptionsCache inst;
+        return inst;
     }
 
-    TiXmlHandle docHandle(&document);
+    Mutex mutex;
 
-    TiXmlElement *key_node = docHandle.FirstChildElement("calaos:config").FirstChildElement().ToElement();
-    if (key_node)
+    std::map<string, string> options;
+
+    //Reload options if the file has changed, mutex needs to be locked
+    bool update();
+
+    //Load the file into the document for a modification
+    bool loadDocument(TiXmlDocument &document);
+    //Save the modified document and update the options from it
+    bool saveDocument(TiXmlDocument &document);
+
+    //Force a reload on next access (config path changed)
+    void reset();
+
+private:
+    ConfigOptionsCache();
+    ~ConfigOptionsCache();
+
+    bool loaded;
+    string file;
+    int inotify_fd;
+
+    struct stat file_stat;
+
+    void readOptions(TiXmlDocument &document);
+    void watchFile();
+    bool fileChanged();
+};
+
+ConfigOptionsCache::ConfigOptionsCache():
+    loaded(false),
+    inotify_fd(-1)
+{
+    memset(&file_stat, 0, sizeof(file_stat));
+}
+
+ConfigOptionsCache::~ConfigOptionsCache()
+{
+    if (inotify_fd >= 0)
+        close(inotify_fd);
+}
+
+void ConfigOptionsCache::reset()
+{
+    loaded = false;
+    if (inotify_fd >= 0)
+        close(inotify_fd);
+    inotify_fd = -1;
+}
+
+void ConfigOptionsCache::watchFile()
+{
+    if (stat(file.c_str(), &file_stat) < 0)
+        memset(&file_stat, 0, sizeof(file_stat));
+
+#if defined(__linux__) || defined(__linux) || defined(linux)
+    if (inotify_fd >= 0)
+        return;
+
+    //the directory is watched as the file is replaced when it is saved
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0 &&
+        inotify_add_watch(inotify_fd, getConfigFile("").c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE) < 0)
+    {
+        cWarning() << "Failed to watch config directory, using file modification time: " << strerror(errno);
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+#endif
+}
+
+bool ConfigOptionsCache::fileChanged()
+{
+#if defined(__linux__) || defined(__linux) || defined(linux)
+    if (inotify_fd >= 0)
     {
-        for(; key_node; key_node = key_node->NextSiblingElement())
+        bool changed = false;
+        char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        ssize_t len;
+
+        //read all pending events, the fd is non blocking
+        while ((len = read(inotify_fd, buf, sizeof(buf))) > 0)
         {
-            if (key_node->ValueStr() == "calaos:option" &&
-                key_node->Attribute("name") &&
-                key_node->Attribute("name") == _key &&
-                key_node->Attribute("value"))
+            for (char *ptr = buf;ptr < buf + len;)
             {
-                value = key_node->Attribute("value");
-                break;
+                struct inotify_event *ev = (struct inotify_event *)ptr;
+                if (ev->mask & IN_Q_OVERFLOW)
+                    changed = true;
+                else if (ev->len > 0 && strcmp(ev->name, LOCAL_CONFIG) == 0)
+                    changed = true;
+                ptr += sizeof(struct inotify_event) + ev->len;
             }
         }
+
+        return changed;
     }
+#endif
 
-    return value;
+    struct stat st;
+    if (stat(file.c_str(), &st) < 0)
+        memset(&st, 0, sizeof(st));
+
+    return st.st_ino != file_stat.st_ino ||
+           st.st_size != file_stat.st_size ||
+           st.st_mtime != file_stat.st_mtime;
 }
 
-bool Utils::set_config_option(string key, string value)
+void ConfigOptionsCache::readOptions(TiXmlDocument &document)
 {
-    TiXmlDocument document(getConfigFile(LOCAL_CONFIG).c_str());
+    options.clear();
+
+    TiXmlHandle docHandle(&document);
 
-    if (!document.LoadFile())
+    TiXmlElement *key_node = docHandle.FirstChildElement("calaos:config").FirstChildElement().ToElement();
+    for(; key_node; key_node = key_node->NextSiblingElement())
+    {
+        if (key_node->ValueStr() == "calaos:option" &&
+            key_node->Attribute("name") &&
+            key_node->Attribute("value"))
+        {
+            options[key_node->Attribute("name")] = key_node->Attribute("value");
+        }
+    }
+}
+
+bool ConfigOptionsCache::loadDocument(TiXmlDocument &document)
+{
+    if (!document.LoadFile(file))
     {
         cError() <<  "There was an exception in XML parsing.";
         cError() <<  "Parse error: " << document.ErrorDesc();
-        cError() <<  "In file " << getConfigFile(LOCAL_CONFIG) << " At line " << document.ErrorRow();
+        cError() <<  "In file " << file << " At line " << document.ErrorRow();
 
         return false;
     }
 
-    TiXmlHandle docHandle(&document);
-    bool found = false;
+    return true;
+}
 
-    TiXmlElement *key_node = docHandle.FirstChildElement("calaos:config").FirstChildElement().ToElement();
-    if (key_node)
+bool ConfigOptionsCache::update()
+{
+    string f = getConfigFile(LOCAL_CONFIG);
+    if (f != file)
     {
-        for(; key_node; key_node = key_node->NextSiblingElement())
-        {
-            if (key_node->ValueStr() == "calaos:option" &&
-                key_node->Attribute("name") &&
-                key_node->Attribute("name") == key)
-            {
-                key_node->SetAttribute("value", value);
-                found = true;
-                break;
-            }
-        }
+        reset();
+        file = f;
+    }
 
-        //the option was not found, we create it
-        if (!found)
-        {
-            TiXmlElement *element = new TiXmlElement("calaos:option");
-            element->SetAttribute("name", key);
-            element->SetAttribute("value", value);
-            docHandle.FirstChild("calaos:config").ToElement()->LinkEndChild(element);
-        }
+    if (loaded && !fileChanged())
+        return true;
+
+    //start watching before reading, to not miss a change done meanwhile
+    watchFile();
 
-        document.SaveFile();
+    TiXmlDocument document;
+    if (!loadDocument(document))
+    {
+        loaded = false;
+        options.clear();
+        return false;
     }
 
+    readOptions(document);
+    loaded = true;
+
     return true;
 }
 
-bool Utils::del_config_option(string key)
+bool ConfigOptionsCache::saveDocument(TiXmlDocument &document)
 {
-    TiXmlDocument document(getConfigFile(LOCAL_CONFIG).c_str());
+    //write to a temp file and rename it, readers never see a partial file
+    string tmpfile = file + ".tmp";
+    if (!document.SaveFile(tmpfile))
+    {
+        cError() << "Failed to write " << tmpfile;
+        return false;
+    }
 
-    if (!document.LoadFile())
+    int fd = open(tmpfile.c_str(), O_RDONLY);
+    if (fd >= 0)
     {
-        cError() <<  "There was an exception in XML parsing.";
-        cError() <<  "Parse error: " << document.ErrorDesc();
-        cError() <<  "In file " << getConfigFile(LOCAL_CONFIG) << " At line " << document.ErrorRow();
+        fsync(fd);
+        close(fd);
+    }
 
+    if (rename(tmpfile.c_str(), file.c_str()) < 0)
+    {
+        cError() << "Failed to replace " << file << ": " << strerror(errno);
+        unlink(tmpfile.c_str());
         return false;
     }
 
-    TiXmlHandle docHandle(&document);
+    //drop events of our own write, options are updated from the document
+    fileChanged();
+    if (stat(file.c_str(), &file_stat) < 0)
+        memset(&file_stat, 0, sizeof(file_stat));
 
-    TiXmlElement *key_node = docHandle.FirstChildElement("calaos:config").FirstChildElement().ToElement();
-    if (key_node)
-    {
-        for(; key_node; key_node = key_node->NextSiblingElement())
-        {
-            if (key_node->ValueStr() == "calaos:option" &&
-                key_node->Attribute("name") &&
-                key_node->Attribute("name") == key)
-            {
-                docHandle.FirstChild("calaos:config").Element()->RemoveChild(key_node);
-                break;
-            }
-        }
+    readOptions(document);
+    loaded = true;
+
+    return true;
+}
+
+string Utils::get_config_option(string _key)
+{
+    ConfigOptionsCache &cache = ConfigOptionsCache::Instance();
+    string value = "";
+
+    cache.mutex.lock();
 
-        document.SaveFile();
+    if (cache.update())
+    {
+        auto it = cache.options.find(_key);
+        if (it != cache.options.end())
+            value = it->second;
     }
 
-    return true;
+    cache.mutex.unlock();
+
+    return value;
 }
 
-bool Utils::get_config_options(Params &options)
+bool Utils::set_config_option(string key, string value)
 {
-    TiXmlDocument document(getConfigFile(LOCAL_CONFIG).c_str());
+    ConfigOptionsCache &cache = ConfigOptionsCache::Instance();
+    bool ret = false;
 
-    if (!document.LoadFile())
+    cache.mutex.lock();
+
+    TiXmlDocument document;
+    if (cache.update() && cache.loadDocument(document))
     {
-        cError() <<  "There was an exception in XML parsing.";
-        cError() <<  "Parse error: " << document.ErrorDesc();
-        cError() <<  "In file " << getConfigFile(LOCAL_CONFIG) << " At line " << document.ErrorRow();
+        TiXmlHandle docHandle(&document);
+        bool found = false;
 
-        return false;
+        TiXmlElement *key_node = docHandle.FirstChildElement("calaos:config").FirstChildElement().ToElement();
+        if (key_node)
+        {
+            for(; key_node; key_node = key_node->NextSiblingElement())
+            {
+                if (key_node->ValueStr() == "calaos:option" &&
+                    key_node->Attribute("name") &&
+                    key_node->Attribute("name") == key)
+                {
+                    key_node->SetAttribute("value", value);
+                    found = true;
+                    break;
+                }
+            }
+
+            //the option was not found, we create it
+            if (!found)
+            {
+                TiXmlElement *element = new TiXmlElement("calaos:option");
+                element->SetAttribute("name", key);
+                element->SetAttribute("value", value);
+                docHandle.FirstChild("calaos:config").ToElement()->LinkEndChild(element);
+            }
+
+            ret = cache.saveDocument(document);
+        }
     }
 
-    TiXmlHandle docHandle(&document);
+    cache.mutex.unlock();
 
-    TiXmlElement *key_node = docHandle.FirstChildElement("calaos:config").FirstChildElement().ToElement();
-    if (key_node)
+    return ret;
+}
+
+bool Utils::del_config_option(string key)
+{
+    ConfigOptionsCache &cache = ConfigOptionsCache::Instance();
+    bool ret = false;
+
+    cache.mutex.lock();
+
+    TiXmlDocument document;
+    if (cache.update() && cache.loadDocument(document))
     {
-        for(; key_node; key_node = key_node->NextSiblingElement())
+        TiXmlHandle docHandle(&document);
+        ret = true;
+
+        TiXmlElement *key_node = docHandle.FirstChildElement("calaos:config").FirstChildElement().ToElement();
+        if (key_node)
         {
-            if (key_node->ValueStr() == "calaos:option" &&
-                key_node->Attribute("name") &&
-                key_node->Attribute("value"))
+            for(; key_node; key_node = key_node->NextSiblingElement())
             {
-                options.Add(key_node->Attribute("name"), key_node->Attribute("value"));
+                if (key_node->ValueStr() == "calaos:option" &&
+                    key_node->Attribute("name") &&
+                    key_node->Attribute("name") == key)
+                {
+                    docHandle.FirstChild("calaos:config").Element()->RemoveChild(key_node);
+                    break;
+                }
             }
+
+            ret = cache.saveDocument(document);
         }
     }
 
-    return true;
+    cache.mutex.unlock();
+
+    return ret;
+}
+
+bool Utils::get_config_options(Params &options)
+{
+    ConfigOptionsCache &cache = ConfigOptionsCache::Instance();
+    bool ret = false;
+
+    cache.mutex.lock();
+
+    if (cache.update())
+    {
+        for (auto it = cache.options.begin();it != cache.options.end();it++)
+            options.Add(it->first, it->second);
+        ret = true;
+    }
+
+    cache.mutex.unlock();
+
+    return ret;
 }
 
 void Utils::Watchdog(std::string fname)
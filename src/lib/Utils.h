@@ -195,11 +195,14 @@ int CURL_writebuf_callback(void *buffer, size_t size, size_t nmemb, void *stream
 #define cError() EinaLogError(Utils::einaLogger())
 #define cCritical() EinaLogCritical(Utils::einaLogger())
 
-#define cDebugDom(domain) EinaLogDebug(Utils::einaLogger(domain))
-#define cInfoDom(domain) EinaLogInfo(Utils::einaLogger(domain))
-#define cWarningDom(domain) EinaLogWarning(Utils::einaLogger(domain))
-#define cErrorDom(domain) EinaLogError(Utils::einaLogger(domain))
-#define cCriticalDom(domain) EinaLogCritical(Utils::einaLogger(domain))
+//The logger of a domain is looked up only once for each log statement
+#define cLoggerDom(domain) ([]() -> EinaLog * { static EinaLog *_logger = Utils::einaLogger(domain); return _logger; }())
+
+#define cDebugDom(domain) EinaLogDebug(cLoggerDom(domain))
+#define cInfoDom(domain) EinaLogInfo(cLoggerDom(domain))
+#define cWarningDom(domain) EinaLogWarning(cLoggerDom(domain))
+#define cErrorDom(domain) EinaLogError(cLoggerDom(domain))
+#define cCriticalDom(domain) EinaLogCritical(cLoggerDom(domain))
 
 //-----------------------------------------------------------------------------
 namespace Utils
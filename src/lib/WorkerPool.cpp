@@ -0,0 +1,292 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#include <WorkerPool.h>
+#include <chrono>
+
+//index of the worker running on this thread, -1 for other threads
+static thread_local int current_worker = -1;
+
+static double _worker_time()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void WorkerJob::wait()
+{
+    mutex.lock();
+    while (!finished)
+        mutex.condition_wait();
+    mutex.unlock();
+}
+
+WorkerPool::WorkerPool():
+    next_worker(0),
+    queued(0),
+    quit(false),
+    wake_seq(0)
+{
+    start_time = _worker_time();
+
+    int count = WORKER_POOL_SIZE;
+    string opt = Utils::get_config_option("worker_threads");
+    if (!opt.empty())
+        Utils::from_string(opt, count);
+    if (count < 1) count = 1;
+
+    sigDone.connect(sigc::mem_fun(*this, &WorkerPool::jobDone));
+    IPC::Instance().AddHandler("WorkerPool", "done", sigDone, NULL);
+
+    for (int i = 0;i < count;i++)
+    {
+        Worker *worker = new Worker();
+        worker->pool = this;
+        worker->index = i;
+        workers.push_back(worker);
+    }
+
+    //workers look at the queues of the others, start them once all exist
+    for (Worker *worker: workers)
+        worker->Start();
+
+    cInfoDom("threads") << "Worker pool started with " << count << " threads";
+}
+
+WorkerPool::~WorkerPool()
+{
+    quit = true;
+
+    sleep_mutex.lock();
+    sleep_mutex.condition_wake(true);
+    sleep_mutex.unlock();
+
+    //a worker can still steal from another one until it has stopped
+    for (Worker *worker: workers)
+        worker->End();
+
+    for (Worker *worker: workers)
+    {
+        //release the waiters of the jobs that will never run
+        for (WorkerJobPtr &job: worker->jobs)
+        {
+            job->cancelled = true;
+
+            job->mutex.lock();
+            job->finished = true;
+            job->mutex.condition_wake(true);
+            job->mutex.unlock();
+        }
+
+        delete worker;
+    }
+
+    workers.clear();
+
+    IPC::Instance().DeleteHandler(sigDone);
+}
+
+void WorkerPool::wakeWorkers(bool all)
+{
+    sleep_mutex.lock();
+    wake_seq++;
+    sleep_mutex.condition_wake(all);
+    sleep_mutex.unlock();
+}
+
+WorkerJobPtr WorkerPool::Run(WorkerJob::Func work, WorkerJob::Func done, WorkerGroup *group)
+{
+    WorkerJobPtr job = std::make_shared<WorkerJob>();
+    job->work = work;
+    job->done = done;
+    job->group = group;
+    job->queued_time = _worker_time();
+
+    //a job started by a job goes to the same worker
+    int index = current_worker;
+    if (index < 0)
+        index = next_worker++ % workers.size();
+
+    Worker *worker = workers[index];
+    worker->mutex.lock();
+    worker->jobs.push_back(job);
+    worker->mutex.unlock();
+
+    queued++;
+
+    wakeWorkers(false);
+
+    return job;
+}
+
+bool WorkerPool::reserveGroup(WorkerGroup *group)
+{
+    //at least one worker is left for the jobs out of the group
+    int limit = std::min(group->max_running, (int)workers.size() - 1);
+    if (limit < 1) limit = 1;
+
+    int running = group->running;
+    while (running < limit)
+    {
+        if (group->running.compare_exchange_weak(running, running + 1))
+            return true;
+    }
+
+    return false;
+}
+
+//Take the oldest (or newest) job of the queue that can run now
+WorkerJobPtr WorkerPool::popJob(Worker *worker, bool oldest)
+{
+    WorkerJobPtr job;
+
+    worker->mutex.lock();
+    for (size_t i = 0;i < worker->jobs.size();i++)
+    {
+        auto it = oldest?worker->jobs.begin() + i:worker->jobs.end() - 1 - i;
+        if ((*it)->group && !reserveGroup((*it)->group))
+            continue;
+
+        job = *it;
+        worker->jobs.erase(it);
+        break;
+    }
+    worker->mutex.unlock();
+
+    return job;
+}
+
+WorkerJobPtr WorkerPool::takeJob(int index)
+{
+    //The worker runs its own jobs in order
+    WorkerJobPtr job = popJob(workers[index], true);
+
+    //Otherwise it steals from the other end of a busy worker queue,
+    //the job that would wait the longest there
+    for (uint i = 1;!job && i < workers.size();i++)
+        job = popJob(workers[(index + i) % workers.size()], false);
+
+    if (job) queued--;
+
+    return job;
+}
+
+void WorkerPool::runJob(Worker *worker, WorkerJobPtr job)
+{
+    double start = _worker_time();
+
+    bool cancelled = job->cancelled;
+    if (!cancelled)
+        job->work(*job);
+
+    //release what the function holds as soon as possible
+    job->work = nullptr;
+
+    double end = _worker_time();
+
+    stats_mutex.lock();
+    double wait = start - job->queued_time;
+    wait_total += wait;
+    if (wait > wait_max) wait_max = wait;
+    worker->busy += end - start;
+    if (cancelled)
+        jobs_cancelled++;
+    else
+        jobs_done++;
+    stats_mutex.unlock();
+
+    job->mutex.lock();
+    job->finished = true;
+    job->mutex.condition_wake(true);
+    job->mutex.unlock();
+
+    //jobs of the group left in the queues can run now
+    if (job->group)
+    {
+        job->group->running--;
+        wakeWorkers(true);
+    }
+
+    if (job->done)
+        IPC::Instance().SendEvent("WorkerPool", "done",
+                                  IPCData(new WorkerJobPtr(job), new DeletorT<WorkerJobPtr *>), true);
+}
+
+void WorkerPool::jobDone(string source, string emission, void *listener_data, void *sender_data)
+{
+    WorkerJobPtr job = *reinterpret_cast<WorkerJobPtr *>(sender_data);
+
+    if (job->done)
+        job->done(*job);
+
+    job->done = nullptr;
+}
+
+void WorkerPool::Worker::ThreadProc()
+{
+    current_worker = index;
+
+    while (!pool->quit)
+    {
+        unsigned int seq = pool->wake_seq;
+
+        WorkerJobPtr job = pool->takeJob(index);
+        if (job)
+        {
+            pool->runJob(this, job);
+            continue;
+        }
+
+        //nothing was queued or finished since the queues were checked,
+        //the jobs left (if any) are waiting for their group
+        pool->sleep_mutex.lock();
+        if (pool->wake_seq == seq && !pool->quit)
+            pool->sleep_mutex.condition_wait();
+        pool->sleep_mutex.unlock();
+    }
+}
+
+WorkerPoolStats WorkerPool::getStats()
+{
+    WorkerPoolStats s;
+
+    stats_mutex.lock();
+
+    s.workers = workers.size();
+    s.jobs_done = jobs_done;
+    s.jobs_cancelled = jobs_cancelled;
+    s.jobs_queued = queued;
+    s.wait_max = wait_max;
+
+    unsigned long nb = jobs_done + jobs_cancelled;
+    if (nb > 0)
+        s.wait_avg = wait_total / nb;
+
+    double busy = 0.0;
+    for (Worker *worker: workers)
+        busy += worker->busy;
+
+    double elapsed = (_worker_time() - start_time) * workers.size();
+    if (elapsed > 0.0)
+        s.utilization = busy / elapsed;
+
+    stats_mutex.unlock();
+
+    return s;
+}
@@ -0,0 +1,177 @@
+/******************************************************************************
+ **  Copyright (c) 2006-2014, Calaos. All Rights Reserved.
+ **
+ **  This file is part of Calaos.
+ **
+ **  Calaos is free software; you can redistribute it and/or modify
+ **  it under the terms of the GNU General Public License as published by
+ **  the Free Software Foundation; either version 3 of the License, or
+ **  (at your option) any later version.
+ **
+ **  Calaos is distributed in the hope that it will be useful,
+ **  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ **  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ **  GNU General Public License for more details.
+ **
+ **  You should have received a copy of the GNU General Public License
+ **  along with Foobar; if not, write to the Free Software
+ **  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ **
+ ******************************************************************************/
+#ifndef CALAOS_WorkerPool_h
+#define CALAOS_WorkerPool_h
+
+#include <Utils.h>
+#include <Mutex.h>
+#include <CThread.h>
+#include <IPC.h>
+#include <deque>
+#include <atomic>
+
+//Default number of worker threads, can be changed with the
+//"worker_threads" option
+#define WORKER_POOL_SIZE        4
+
+class WorkerJob;
+typedef std::shared_ptr<WorkerJob> WorkerJobPtr;
+
+/*
+ * Jobs that can block for a long time (slow network clients, ...) are run
+ * in a group that limits the number of workers they hold at once. The
+ * other workers stay available for the rest of the jobs. A group never
+ * gets all the workers of the pool.
+ */
+class WorkerGroup
+{
+public:
+    WorkerGroup(int max): max_running(max), running(0) { }
+
+    const int max_running;
+
+private:
+    friend class WorkerPool;
+
+    std::atomic<int> running;
+};
+
+class WorkerJob
+{
+public:
+    typedef std::function<void (WorkerJob &job)> Func;
+
+    //Ask the job to stop. A job that is not started yet will not run, a
+    //running job needs to check isCancelled(). The done callback is called
+    //in any case.
+    void cancel() { cancelled = true; }
+    bool isCancelled() { return cancelled; }
+
+    //true once the work function has returned (or was skipped)
+    bool isFinished() { return finished; }
+
+    //Block until the job is finished. Never call it from a worker for a
+    //job that is queued after the caller.
+    void wait();
+
+private:
+    friend class WorkerPool;
+
+    Func work;
+    Func done; //called from the main loop
+    WorkerGroup *group = nullptr;
+
+    std::atomic<bool> cancelled;
+    std::atomic<bool> finished;
+    double queued_time = 0.0;
+
+    Mutex mutex;
+
+public:
+    WorkerJob(): cancelled(false), finished(false) { }
+};
+
+class WorkerPoolStats
+{
+public:
+    int workers = 0;
+    unsigned long jobs_done = 0;
+    unsigned long jobs_cancelled = 0;
+    int jobs_queued = 0;
+    double wait_avg = 0.0; //time between Run() and the start of the job
+    double wait_max = 0.0;
+    double utilization = 0.0; //time spent running jobs / time of all workers
+};
+
+/*
+ * A fixed number of threads to run blocking work (network, files, ...).
+ *
+ * Each worker has its own queue of jobs and runs them in the order they were
+ * queued. When its queue is empty it steals the newest job of another
+ * worker, the one that would wait the longest there. Jobs are queued to the
+ * workers in turn, a job started from a worker is queued to this worker.
+ * The done callback of a job is called from the main loop through IPC.
+ *
+ * The queue wait and utilization statistics are given by getStats(), and
+ * by the 'system workers' TCP command.
+ */
+class WorkerPool
+{
+private:
+    class Worker: public CThread
+    {
+    public:
+        WorkerPool *pool;
+        int index;
+
+        Mutex mutex;
+        std::deque<WorkerJobPtr> jobs;
+
+        double busy = 0.0; //protected by the pool stats_mutex
+
+        virtual void ThreadProc();
+    };
+
+    vector<Worker *> workers;
+    std::atomic<unsigned int> next_worker;
+    std::atomic<int> queued;
+    std::atomic<bool> quit;
+
+    //idle workers wait on it, wake_seq changes when a job can be taken
+    Mutex sleep_mutex;
+    std::atomic<unsigned int> wake_seq;
+
+    Mutex stats_mutex;
+    double start_time;
+    unsigned long jobs_done = 0;
+    unsigned long jobs_cancelled = 0;
+    double wait_total = 0.0;
+    double wait_max = 0.0;
+
+    sigc::signal<void, string, string, void*, void*> sigDone;
+
+    WorkerJobPtr takeJob(int index);
+    WorkerJobPtr popJob(Worker *worker, bool oldest);
+    bool reserveGroup(WorkerGroup *group);
+    void wakeWorkers(bool all);
+    void runJob(Worker *worker, WorkerJobPtr job);
+    void jobDone(string source, string emission, void *listener_data, void *sender_data);
+
+    WorkerPool();
+
+public:
+    static WorkerPool &Instance()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    ~WorkerPool();
+
+    //Queue work to be run by a worker, done is called in the main loop
+    //once work has finished. The job counts in the limit of group.
+    WorkerJobPtr Run(WorkerJob::Func work, WorkerJob::Func done = nullptr,
+                     WorkerGroup *group = nullptr);
+
+    WorkerPoolStats getStats();
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "ListeRoom.h"
+#include "ListeRule.h"
+#include "ActionStd.h"
+#include "ServerTestEnvironment.h"
+#include <gtest/gtest.h>
+
+using namespace Calaos;
+
+static Internal *createInternal(const string &type, const string &id)
+{
+    return createTestInternal("action_test", type, id);
+}
+
+class ActionStdTest: public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        action = new ActionStd();
+    }
+
+    virtual void TearDown()
+    {
+        delete action;
+    }
+
+    void set(Output *out, const string &value)
+    {
+        action->get_params().Add(out->get_param("id"), value);
+    }
+
+    ActionStd *action;
+};
+
+TEST_F(ActionStdTest, Bool)
+{
+    Internal *out = createInternal("InternalBool", "action_bool");
+    ASSERT_NE(nullptr, out);
+    action->Add(out);
+
+    set(out, "true");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_TRUE(out->get_value_bool());
+
+    set(out, "false");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_FALSE(out->get_value_bool());
+
+    //commands are parsed once and run on each execution
+    set(out, "toggle");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_TRUE(out->get_value_bool());
+    EXPECT_TRUE(action->Execute());
+    EXPECT_FALSE(out->get_value_bool());
+
+    set(out, "on");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_TRUE(out->get_value_bool());
+
+    set(out, "unknown");
+    EXPECT_FALSE(action->Execute());
+    EXPECT_TRUE(out->get_value_bool());
+}
+
+TEST_F(ActionStdTest, Int)
+{
+    Internal *out = createInternal("InternalInt", "action_int");
+    ASSERT_NE(nullptr, out);
+    action->Add(out);
+
+    set(out, "12.5");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_DOUBLE_EQ(12.5, out->get_value_double());
+
+    set(out, "inc 2");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_DOUBLE_EQ(14.5, out->get_value_double());
+    EXPECT_TRUE(action->Execute());
+    EXPECT_DOUBLE_EQ(16.5, out->get_value_double());
+
+    set(out, "dec");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_DOUBLE_EQ(15.5, out->get_value_double());
+
+    set(out, "-3");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_DOUBLE_EQ(-3.0, out->get_value_double());
+
+    set(out, "toggle");
+    EXPECT_FALSE(action->Execute());
+    EXPECT_DOUBLE_EQ(-3.0, out->get_value_double());
+}
+
+TEST_F(ActionStdTest, String)
+{
+    Internal *out = createInternal("InternalString", "action_string");
+    ASSERT_NE(nullptr, out);
+    action->Add(out);
+
+    set(out, "hello world");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_EQ("hello world", out->get_value_string());
+
+    //an empty value does nothing
+    set(out, "");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_EQ("hello world", out->get_value_string());
+}
+
+TEST_F(ActionStdTest, SeveralOutputs)
+{
+    Internal *b = createInternal("InternalBool", "action_multi_bool");
+    Internal *i = createInternal("InternalInt", "action_multi_int");
+    ASSERT_NE(nullptr, b);
+    ASSERT_NE(nullptr, i);
+    action->Add(b);
+    action->Add(i);
+
+    set(b, "true");
+    set(i, "42");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_TRUE(b->get_value_bool());
+    EXPECT_DOUBLE_EQ(42.0, i->get_value_double());
+
+    //removing an output compiles the action again
+    action->Remove(0);
+    set(b, "false");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_TRUE(b->get_value_bool());
+}
+
+TEST_F(ActionStdTest, CopyFromOutput)
+{
+    Internal *out = createInternal("InternalInt", "action_var_out");
+    Internal *var = createInternal("InternalInt", "action_var");
+    ASSERT_NE(nullptr, out);
+    ASSERT_NE(nullptr, var);
+    action->Add(out);
+
+    set(out, "1");
+    action->get_params_var().Add("action_var_out", "action_var");
+
+    //the value of the other output is read for each execution
+    var->set_value(5.0);
+    EXPECT_TRUE(action->Execute());
+    EXPECT_DOUBLE_EQ(5.0, out->get_value_double());
+
+    var->set_value(8.0);
+    EXPECT_TRUE(action->Execute());
+    EXPECT_DOUBLE_EQ(8.0, out->get_value_double());
+
+    //an output of another type is not used
+    Internal *other = createInternal("InternalBool", "action_var_bool");
+    ASSERT_NE(nullptr, other);
+    action->get_params_var().Add("action_var_out", "action_var_bool");
+    EXPECT_TRUE(action->Execute());
+    EXPECT_DOUBLE_EQ(1.0, out->get_value_double());
+}
+
+TEST_F(ActionStdTest, OutputAddedLater)
+{
+    Internal *out = createInternal("InternalBool", "action_late_out");
+    ASSERT_NE(nullptr, out);
+    action->Add(out);
+
+    set(out, "false");
+    action->get_params_var().Add("action_late_out", "action_late");
+
+    //the var output doesn't exist, the value of the params is used
+    out->set_value(true);
+    EXPECT_TRUE(action->Execute());
+    EXPECT_FALSE(out->get_value_bool());
+
+    //a new output changes the generation of the rules, the action is
+    //compiled again and now copies its state
+    Internal *var = createInternal("InternalBool", "action_late");
+    ASSERT_NE(nullptr, var);
+    var->set_value(true);
+    EXPECT_TRUE(action->Execute());
+    EXPECT_TRUE(out->get_value_bool());
+}
@@ -0,0 +1,213 @@
+#include "ListeRoom.h"
+#include "ListeRule.h"
+#include "ConditionStd.h"
+#include "ServerTestEnvironment.h"
+#include <gtest/gtest.h>
+
+using namespace Calaos;
+
+static Internal *createInternal(const string &type, const string &id)
+{
+    return createTestInternal("condition_test", type, id);
+}
+
+class ConditionStdTest: public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        cond = new ConditionStd();
+    }
+
+    virtual void TearDown()
+    {
+        delete cond;
+    }
+
+    void set(Input *in, const string &oper, const string &value)
+    {
+        cond->get_operator().Add(in->get_param("id"), oper);
+        cond->get_params().Add(in->get_param("id"), value);
+    }
+
+    ConditionStd *cond;
+};
+
+TEST_F(ConditionStdTest, Bool)
+{
+    Internal *in = createInternal("InternalBool", "cond_bool");
+    ASSERT_NE(nullptr, in);
+    cond->Add(in);
+
+    set(in, "==", "true");
+    in->set_value(true);
+    EXPECT_TRUE(cond->Evaluate());
+    in->set_value(false);
+    EXPECT_FALSE(cond->Evaluate());
+
+    //the compiled condition follows changes of its params
+    set(in, "!=", "true");
+    EXPECT_TRUE(cond->Evaluate());
+
+    set(in, "==", "false");
+    EXPECT_TRUE(cond->Evaluate());
+
+    set(in, "==", "changed");
+    EXPECT_TRUE(cond->Evaluate());
+    in->set_value(true);
+    EXPECT_TRUE(cond->Evaluate());
+
+    //not a bool value
+    set(in, "==", "1");
+    EXPECT_FALSE(cond->Evaluate());
+
+    //bools can only be compared for equality
+    set(in, "SUP", "false");
+    EXPECT_FALSE(cond->Evaluate());
+}
+
+TEST_F(ConditionStdTest, Int)
+{
+    Internal *in = createInternal("InternalInt", "cond_int");
+    ASSERT_NE(nullptr, in);
+    cond->Add(in);
+    in->set_value(12.0);
+
+    struct { const char *oper, *value; bool result; } cases[] =
+    {
+        { "==", "12", true }, { "==", "12.5", false },
+        { "!=", "12", false }, { "!=", "3", true },
+        { "SUP", "10", true }, { "SUP", "12", false },
+        { "SUP=", "12", true }, { "SUP=", "12.01", false },
+        { "INF", "12.5", true }, { "INF", "12", false },
+        { "INF=", "12", true }, { "INF=", "-4", false },
+        { "==", "changed", true },
+        { "==", "", false },
+        { "~", "12", false },
+    };
+
+    for (auto &c: cases)
+    {
+        set(in, c.oper, c.value);
+        EXPECT_EQ(c.result, cond->Evaluate()) << "12 " << c.oper << " " << c.value;
+    }
+}
+
+TEST_F(ConditionStdTest, String)
+{
+    Internal *in = createInternal("InternalString", "cond_string");
+    ASSERT_NE(nullptr, in);
+    cond->Add(in);
+    in->set_value(string("hello world"));
+
+    //the value is url encoded in the rules
+    set(in, "==", "hello%20world");
+    EXPECT_TRUE(cond->Evaluate());
+
+    set(in, "!=", "hello%20world");
+    EXPECT_FALSE(cond->Evaluate());
+
+    set(in, "==", "hello");
+    EXPECT_FALSE(cond->Evaluate());
+
+    set(in, "SUP", "hello");
+    EXPECT_FALSE(cond->Evaluate());
+}
+
+TEST_F(ConditionStdTest, CompareWithInput)
+{
+    Internal *in = createInternal("InternalInt", "cond_var_in");
+    Internal *var = createInternal("InternalInt", "cond_var");
+    ASSERT_NE(nullptr, in);
+    ASSERT_NE(nullptr, var);
+    cond->Add(in);
+
+    set(in, "SUP", "100");
+    cond->get_params_var().Add("cond_var_in", "cond_var");
+
+    in->set_value(7.0);
+    var->set_value(5.0);
+    EXPECT_TRUE(cond->Evaluate());
+
+    //the value of the other input is read for each evaluation
+    var->set_value(9.0);
+    EXPECT_FALSE(cond->Evaluate());
+
+    //an input of another type is not used
+    Internal *other = createInternal("InternalBool", "cond_var_bool");
+    ASSERT_NE(nullptr, other);
+    cond->get_params_var().Add("cond_var_in", "cond_var_bool");
+    set(in, "SUP", "6");
+    EXPECT_TRUE(cond->Evaluate());
+}
+
+TEST_F(ConditionStdTest, InputAddedLater)
+{
+    Internal *in = createInternal("InternalInt", "cond_late_in");
+    ASSERT_NE(nullptr, in);
+    cond->Add(in);
+
+    set(in, "==", "1");
+    cond->get_params_var().Add("cond_late_in", "cond_late");
+    in->set_value(1.0);
+
+    //the var input doesn't exist, the value of the params is used
+    EXPECT_TRUE(cond->Evaluate());
+
+    //a new input changes the generation of the rules, the condition is
+    //compiled again and now compares with it
+    Internal *var = createInternal("InternalInt", "cond_late");
+    ASSERT_NE(nullptr, var);
+    var->set_value(2.0);
+    EXPECT_FALSE(cond->Evaluate());
+
+    var->set_value(1.0);
+    EXPECT_TRUE(cond->Evaluate());
+}
+
+TEST_F(ConditionStdTest, XmlRoundTrip)
+{
+    Internal *i = createInternal("InternalInt", "cond_xml_int");
+    Internal *b = createInternal("InternalBool", "cond_xml_bool");
+    Internal *s = createInternal("InternalString", "cond_xml_string");
+    Internal *v = createInternal("InternalInt", "cond_xml_var");
+    Internal *ref = createInternal("InternalInt", "cond_xml_ref");
+    ASSERT_TRUE(i && b && s && v && ref);
+
+    //attributes in the order SaveToXml() writes them
+    const char *xml =
+        "<calaos:condition type=\"standard\" trigger=\"false\">"
+        "<calaos:input id=\"cond_xml_int\" oper=\"SUP=\" val=\"10\" />"
+        "<calaos:input id=\"cond_xml_bool\" oper=\"==\" val=\"true\" />"
+        "<calaos:input id=\"cond_xml_string\" oper=\"!=\" val=\"hello%20world\" />"
+        "<calaos:input id=\"cond_xml_var\" oper=\"INF\" val=\"0\" val_var=\"cond_xml_ref\" />"
+        "</calaos:condition>";
+
+    TiXmlDocument doc;
+    doc.Parse(xml);
+    ASSERT_FALSE(doc.Error()) << doc.ErrorDesc();
+    ASSERT_TRUE(cond->LoadFromXml(doc.RootElement()));
+    EXPECT_FALSE(cond->useForTrigger());
+
+    i->set_value(12.0);
+    b->set_value(true);
+    s->set_value(string("hello"));
+    v->set_value(3.0);
+    ref->set_value(5.0);
+    EXPECT_TRUE(cond->Evaluate());
+
+    ref->set_value(1.0);
+    EXPECT_FALSE(cond->Evaluate());
+
+    //the compiled form is not written back, the rule is saved as loaded
+    TiXmlElement rule("calaos:rule");
+    ASSERT_TRUE(cond->SaveToXml(&rule));
+    ASSERT_NE(nullptr, rule.FirstChildElement());
+
+    TiXmlPrinter in, out;
+    in.SetStreamPrinting();
+    out.SetStreamPrinting();
+    doc.RootElement()->Accept(&in);
+    rule.FirstChildElement()->Accept(&out);
+    EXPECT_EQ(string(in.CStr()), string(out.CStr()));
+}
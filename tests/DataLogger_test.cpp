@@ -0,0 +1,110 @@
+#include "DataLogger.h"
+#include <gtest/gtest.h>
+
+using namespace Calaos;
+
+//Periods are computed in local time, run the tests in a timezone with DST.
+//The rules of Europe/Paris are given as a POSIX TZ, tzdata is not needed.
+class DataLoggerPeriodTest: public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        const char *tz = getenv("TZ");
+        has_tz = tz != nullptr;
+        if (has_tz) old_tz = tz;
+
+        setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+        tzset();
+    }
+
+    virtual void TearDown()
+    {
+        if (has_tz)
+            setenv("TZ", old_tz.c_str(), 1);
+        else
+            unsetenv("TZ");
+        tzset();
+    }
+
+    bool has_tz;
+    string old_tz;
+};
+
+//Local times, CET is UTC+1 and CEST UTC+2
+static const int64_t mar26_0000 = 1679785200; //CET
+static const int64_t mar26_0300 = 1679792400; //CEST, 02:00 is skipped
+static const int64_t mar27_0000 = 1679868000;
+static const int64_t oct29_0000 = 1698530400; //CEST
+static const int64_t oct30_0000 = 1698620400; //CET, 02:00 is repeated
+
+TEST_F(DataLoggerPeriodTest, HourDstStart)
+{
+    //01:30 CET, the next hour is 03:00 CEST
+    int64_t t = mar26_0000 + 5400;
+    int64_t s = DataLogger::periodStart(DataLogger::RES_HOUR, t);
+    EXPECT_EQ(mar26_0000 + 3600, s);
+    EXPECT_EQ(mar26_0300, DataLogger::periodNext(DataLogger::RES_HOUR, s));
+}
+
+TEST_F(DataLoggerPeriodTest, HourDstEnd)
+{
+    //01:00 CEST, 02:00 CEST, 02:00 CET and 03:00 CET are one hour apart
+    int64_t h = oct29_0000 + 3600;
+    for (int i = 0;i < 4;i++, h += 3600)
+    {
+        EXPECT_EQ(h, DataLogger::periodStart(DataLogger::RES_HOUR, h)) << "hour " << i;
+        EXPECT_EQ(h, DataLogger::periodStart(DataLogger::RES_HOUR, h + 1800)) << "hour " << i;
+        EXPECT_EQ(h + 3600, DataLogger::periodNext(DataLogger::RES_HOUR, h)) << "hour " << i;
+    }
+}
+
+TEST_F(DataLoggerPeriodTest, Day)
+{
+    //a 23 hours day
+    EXPECT_EQ(mar26_0000, DataLogger::periodStart(DataLogger::RES_DAY, mar26_0000 + 14 * 3600));
+    EXPECT_EQ(mar26_0000, DataLogger::periodStart(DataLogger::RES_DAY, mar26_0300));
+    EXPECT_EQ(mar27_0000, DataLogger::periodNext(DataLogger::RES_DAY, mar26_0000));
+    EXPECT_EQ(23 * 3600, mar27_0000 - mar26_0000);
+
+    //a 25 hours day
+    EXPECT_EQ(oct29_0000, DataLogger::periodStart(DataLogger::RES_DAY, oct29_0000 + 3 * 3600));
+    EXPECT_EQ(oct29_0000, DataLogger::periodStart(DataLogger::RES_DAY, oct30_0000 - 1));
+    EXPECT_EQ(oct30_0000, DataLogger::periodNext(DataLogger::RES_DAY, oct29_0000));
+    EXPECT_EQ(25 * 3600, oct30_0000 - oct29_0000);
+}
+
+TEST_F(DataLoggerPeriodTest, Month)
+{
+    const int64_t mar01 = 1677625200, apr01 = 1680300000;
+    const int64_t oct01 = 1696111200, nov01 = 1698793200;
+
+    EXPECT_EQ(mar01, DataLogger::periodStart(DataLogger::RES_MONTH, 1678881600));
+    EXPECT_EQ(mar01, DataLogger::periodStart(DataLogger::RES_MONTH, mar26_0300));
+    EXPECT_EQ(apr01, DataLogger::periodNext(DataLogger::RES_MONTH, mar01));
+
+    EXPECT_EQ(oct01, DataLogger::periodStart(DataLogger::RES_MONTH, oct30_0000 - 1));
+    EXPECT_EQ(nov01, DataLogger::periodNext(DataLogger::RES_MONTH, oct01));
+}
+
+TEST_F(DataLoggerPeriodTest, WholeYear)
+{
+    //every half hour of 2023: t is in [start, next), and periods follow
+    //each other without gap
+    const int64_t jan01 = 1672527600, jan01_2024 = 1704063600;
+
+    for (int r = 0;r < DataLogger::RES_COUNT;r++)
+    {
+        DataLogger::Resolution res = (DataLogger::Resolution)r;
+        for (int64_t t = jan01;t < jan01_2024;t += 1800)
+        {
+            int64_t s = DataLogger::periodStart(res, t);
+            int64_t n = DataLogger::periodNext(res, s);
+
+            ASSERT_LE(s, t) << "res " << r << " t " << t;
+            ASSERT_GT(n, t) << "res " << r << " t " << t;
+            ASSERT_EQ(s, DataLogger::periodStart(res, s)) << "res " << r << " t " << t;
+            ASSERT_EQ(n, DataLogger::periodStart(res, n)) << "res " << r << " t " << t;
+        }
+    }
+}
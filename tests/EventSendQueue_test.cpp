@@ -0,0 +1,174 @@
+#include "EventSendQueue.h"
+#include <gtest/gtest.h>
+
+//A socket that keeps the data given to it as not written until drain()
+class EventSendQueueTest: public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        queue = new EventSendQueue([this](const string &data, int tag)
+        {
+            if (fail) return false;
+            sent.push_back(data);
+            tags.push_back(tag);
+            pending += data.size();
+            return true;
+        },
+        [this]() { return pending; });
+    }
+
+    virtual void TearDown()
+    {
+        delete queue;
+    }
+
+    static EventData event(const string &s) { return std::make_shared<const string>(s); }
+
+    //fill the socket over the high water mark
+    void block()
+    {
+        ASSERT_TRUE(queue->push(event(string(EVENTQUEUE_HIGH_WATER, 'x'))));
+        sent.clear();
+        tags.clear();
+    }
+
+    void drain() { pending = 0; }
+
+    EventSendQueue *queue;
+    vector<string> sent;
+    vector<int> tags;
+    int pending = 0;
+    bool fail = false;
+};
+
+TEST_F(EventSendQueueTest, SentWhileIdle)
+{
+    EXPECT_TRUE(queue->isIdle());
+    EXPECT_TRUE(queue->push(event("a"), "io_1", 3));
+    EXPECT_TRUE(queue->push(event("b"), "io_1"));
+
+    //nothing is conflated while the socket keeps up
+    ASSERT_EQ(2u, sent.size());
+    EXPECT_EQ("a", sent[0]);
+    EXPECT_EQ(3, tags[0]);
+    EXPECT_EQ("b", sent[1]);
+    EXPECT_EQ(0, queue->getDepth());
+    EXPECT_EQ(0u, queue->getConflated());
+    EXPECT_EQ(2u, queue->getSent());
+}
+
+TEST_F(EventSendQueueTest, QueuedOverHighWater)
+{
+    block();
+    EXPECT_FALSE(queue->isIdle());
+
+    EXPECT_TRUE(queue->push(event("a")));
+    EXPECT_TRUE(queue->push(event("b")));
+    EXPECT_TRUE(sent.empty());
+    EXPECT_EQ(2, queue->getDepth());
+
+    //still blocked
+    EXPECT_TRUE(queue->flush());
+    EXPECT_TRUE(sent.empty());
+
+    drain();
+    EXPECT_TRUE(queue->flush());
+    ASSERT_EQ(2u, sent.size());
+    EXPECT_EQ("a", sent[0]);
+    EXPECT_EQ("b", sent[1]);
+    EXPECT_EQ(0, queue->getDepth());
+    EXPECT_EQ(2, queue->getMaxDepth());
+    EXPECT_TRUE(queue->isIdle());
+}
+
+TEST_F(EventSendQueueTest, Conflation)
+{
+    block();
+
+    EXPECT_TRUE(queue->push(event("io_1=1"), "io_1", 1));
+    EXPECT_TRUE(queue->push(event("room"), string()));
+    EXPECT_TRUE(queue->push(event("io_2=1"), "io_2"));
+    EXPECT_TRUE(queue->push(event("io_1=2"), "io_1", 2));
+    EXPECT_TRUE(queue->push(event("room"), string()));
+    EXPECT_TRUE(queue->push(event("io_1=3"), "io_1", 5));
+
+    //events without key are never conflated
+    EXPECT_EQ(4, queue->getDepth());
+    EXPECT_EQ(2u, queue->getConflated());
+
+    drain();
+    EXPECT_TRUE(queue->flush());
+
+    //the last value is sent in place of the first one
+    ASSERT_EQ(4u, sent.size());
+    EXPECT_EQ("io_1=3", sent[0]);
+    EXPECT_EQ(5, tags[0]);
+    EXPECT_EQ("room", sent[1]);
+    EXPECT_EQ("io_2=1", sent[2]);
+    EXPECT_EQ("room", sent[3]);
+}
+
+TEST_F(EventSendQueueTest, KeyAfterFlush)
+{
+    block();
+    EXPECT_TRUE(queue->push(event("io_1=1"), "io_1"));
+
+    drain();
+    EXPECT_TRUE(queue->flush());
+    ASSERT_EQ(1u, sent.size());
+
+    //a sent event is not replaced, the new value is queued again
+    EXPECT_TRUE(queue->push(event(string(EVENTQUEUE_HIGH_WATER, 'x'))));
+    EXPECT_TRUE(queue->push(event("io_1=2"), "io_1"));
+    EXPECT_EQ(1, queue->getDepth());
+    EXPECT_EQ(0u, queue->getConflated());
+
+    drain();
+    EXPECT_TRUE(queue->flush());
+    EXPECT_EQ("io_1=2", sent.back());
+}
+
+TEST_F(EventSendQueueTest, FlushStopsAtHighWater)
+{
+    block();
+
+    string big(EVENTQUEUE_HIGH_WATER / 2, 'y');
+    for (int i = 0;i < 4;i++)
+        EXPECT_TRUE(queue->push(event(big)));
+
+    drain();
+    EXPECT_TRUE(queue->flush());
+    EXPECT_EQ(2u, sent.size());
+    EXPECT_EQ(2, queue->getDepth());
+}
+
+TEST_F(EventSendQueueTest, TooSlow)
+{
+    block();
+
+    EXPECT_TRUE(queue->push(event("io_1=1"), "io_1"));
+    for (int i = 1;i < EVENTQUEUE_MAX_EVENTS;i++)
+        EXPECT_TRUE(queue->push(event("e")));
+
+    //a conflated event doesn't make the queue longer
+    EXPECT_TRUE(queue->push(event("io_1=2"), "io_1"));
+    EXPECT_EQ(0u, queue->getDropped());
+    EXPECT_FALSE(queue->push(event("e")));
+    EXPECT_EQ(EVENTQUEUE_MAX_EVENTS, queue->getDepth());
+    EXPECT_EQ(1u, queue->getDropped());
+}
+
+TEST_F(EventSendQueueTest, SendError)
+{
+    fail = true;
+    EXPECT_FALSE(queue->push(event("a")));
+
+    fail = false;
+    block();
+    EXPECT_TRUE(queue->push(event("b")));
+
+    fail = true;
+    drain();
+    EXPECT_FALSE(queue->flush());
+}
@@ -0,0 +1,183 @@
+#include "MsgPack.h"
+#include <gtest/gtest.h>
+
+static json_t *roundTrip(json_t *json)
+{
+    MsgPackWriter w;
+    w.writeJson(json);
+    return MsgPack::decode(w.getData());
+}
+
+static ::testing::AssertionResult sameJson(json_t *a, json_t *b)
+{
+    if (!b)
+        return ::testing::AssertionFailure() << "not decoded";
+    if (!json_equal(a, b))
+        return ::testing::AssertionFailure() << "decoded value differs";
+    return ::testing::AssertionSuccess();
+}
+
+class MsgPackTest: public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        //the kind of message sent by the V3 API
+        message = json_object();
+        json_object_set_new(message, "msg", json_string("event"));
+
+        json_t *data = json_object();
+        json_object_set_new(data, "id", json_string("output_12"));
+        json_object_set_new(data, "state", json_string("Pièce ☀"));
+        json_object_set_new(data, "value", json_real(21.5));
+        json_object_set_new(data, "enabled", json_true());
+        json_object_set_new(data, "visible", json_false());
+        json_object_set_new(data, "room", json_null());
+
+        json_t *arr = json_array();
+        for (int i = 0;i < 40;i++)
+            json_array_append_new(arr, json_integer(i * 1000 - 20000));
+        json_object_set_new(data, "values", arr);
+
+        json_object_set_new(message, "data", data);
+
+        MsgPackWriter w;
+        w.writeJson(message);
+        encoded = w.getData();
+    }
+
+    virtual void TearDown()
+    {
+        json_decref(message);
+    }
+
+    json_t *message;
+    string encoded;
+};
+
+TEST(MsgPackWriterTest, Integers)
+{
+    MsgPackWriter w;
+    w.writeInt(1);
+    w.writeInt(-1);
+    w.writeInt(-33);
+    w.writeInt(200);
+    w.writeInt(70000);
+    w.writeInt(-200);
+    w.writeInt(5000000000LL);
+
+    string expected("\x01\xff\xd0\xdf\xcc\xc8\xce\x00\x01\x11\x70\xd1\xff\x38"
+                    "\xcf\x00\x00\x00\x01\x2a\x05\xf2\x00", 23);
+    EXPECT_EQ(expected, w.getData());
+}
+
+TEST(MsgPackWriterTest, Headers)
+{
+    MsgPackWriter w;
+    w.writeMap(2);
+    w.writeString("compact");
+    w.writeBool(true);
+    w.writeString("schema");
+    w.writeInt(0);
+
+    string expected("\x82\xa7" "compact" "\xc3\xa6" "schema" "\x00", 18);
+    EXPECT_EQ(expected, w.getData());
+
+    MsgPackWriter big;
+    big.writeArray(16);
+    big.writeMap(70000);
+    big.writeString(string(40, 'x'));
+    EXPECT_EQ(string("\xdc\x00\x10\xdf\x00\x01\x11\x70\xd9\x28", 10), big.getData().substr(0, 10));
+}
+
+TEST(MsgPackRoundTripTest, Scalars)
+{
+    json_t *values[] = { json_integer(0), json_integer(127), json_integer(-32),
+                         json_integer(-129), json_integer(65536), json_integer(-2147483649LL),
+                         json_integer(9223372036854775807LL), json_real(-0.125),
+                         json_string(""), json_string(string(300, 'a').c_str()),
+                         json_string(string(70000, 'b').c_str()),
+                         json_true(), json_false(), json_null() };
+
+    for (json_t *v: values)
+    {
+        json_t *d = roundTrip(v);
+        EXPECT_TRUE(sameJson(v, d));
+
+        if (d) json_decref(d);
+        json_decref(v);
+    }
+}
+
+TEST_F(MsgPackTest, Message)
+{
+    json_t *d = MsgPack::decode(encoded);
+    EXPECT_TRUE(sameJson(message, d));
+    if (d) json_decref(d);
+}
+
+TEST_F(MsgPackTest, BigContainers)
+{
+    json_t *obj = json_object();
+    for (int i = 0;i < 20;i++)
+        json_object_set_new(obj, ("key" + Utils::to_string(i)).c_str(), json_integer(i));
+
+    json_t *arr = json_array();
+    for (int i = 0;i < 70000;i++)
+        json_array_append_new(arr, json_integer(i % 100));
+    json_object_set_new(obj, "arr", arr);
+
+    json_t *d = roundTrip(obj);
+    EXPECT_TRUE(sameJson(obj, d));
+
+    if (d) json_decref(d);
+    json_decref(obj);
+}
+
+TEST_F(MsgPackTest, Truncated)
+{
+    for (size_t n = 0;n < encoded.size();n++)
+        EXPECT_EQ(nullptr, MsgPack::decode(encoded.substr(0, n))) << "size " << n;
+}
+
+TEST_F(MsgPackTest, TrailingData)
+{
+    EXPECT_EQ(nullptr, MsgPack::decode(encoded + "a"));
+    EXPECT_EQ(nullptr, MsgPack::decode(encoded + encoded));
+}
+
+TEST(MsgPackDecodeTest, Malformed)
+{
+    //too deep
+    string deep(MSGPACK_MAX_DEPTH + 2, '\x91');
+    deep += '\x01';
+    EXPECT_EQ(nullptr, MsgPack::decode(deep));
+
+    string ok(MSGPACK_MAX_DEPTH, '\x91');
+    ok += '\x01';
+    json_t *d = MsgPack::decode(ok);
+    EXPECT_NE(nullptr, d);
+    if (d) json_decref(d);
+
+    //sizes bigger than the data
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\xdd\xff\xff\xff\xff", 5)));
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\xdf\xff\xff\xff\xff", 5)));
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\xdb\xff\xff\xff\xff" "abc", 8)));
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\xc6\x00\x00\x00\x04" "abc", 8)));
+
+    //map keys must be strings
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\x81\x01\x01", 3)));
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\x81\xc0\x01", 3)));
+
+    //a key without value
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\x81\xa1k", 3)));
+
+    //strings can't hold a NUL
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\xa3" "a\0b", 4)));
+
+    //ext types are not used
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\xd4\x01\x01", 3)));
+    EXPECT_EQ(nullptr, MsgPack::decode(string("\xc1", 1)));
+
+    EXPECT_EQ(nullptr, MsgPack::decode(string()));
+}
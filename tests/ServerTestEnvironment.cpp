@@ -0,0 +1,64 @@
+#include "ServerTestEnvironment.h"
+#include "ListeRoom.h"
+#include "ListeRule.h"
+#include <Ecore.h>
+#include <Ecore_File.h>
+#include <gtest/gtest.h>
+
+using namespace Calaos;
+
+//Server set up for the tests linked with the server sources: config and
+//cache in a temporary directory, and the singletons created in the same
+//order as the server does
+class ServerTestEnvironment: public ::testing::Environment
+{
+public:
+    virtual void SetUp()
+    {
+        char tmpl[] = "/tmp/calaos_test_XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(tmpl));
+        dir = tmpl;
+
+        Utils::initConfigOptions(tmpl, tmpl, true);
+
+        //Ensure calling order of destructors
+        ListeRule::Instance();
+        ListeRoom::Instance();
+
+        eina_init();
+        ecore_init();
+        ecore_file_init();
+    }
+
+    virtual void TearDown()
+    {
+        ecore_file_recursive_rm(dir.c_str());
+
+        ecore_file_shutdown();
+        ecore_shutdown();
+        eina_shutdown();
+    }
+
+private:
+    string dir;
+};
+
+static ::testing::Environment *const server_env =
+        ::testing::AddGlobalTestEnvironment(new ServerTestEnvironment);
+
+Internal *createTestInternal(const string &room, const string &type, const string &id)
+{
+    Room *r = ListeRoom::Instance().searchRoomByNameAndType(room, "test");
+    if (!r)
+    {
+        r = new Room(room, "test", 0);
+        ListeRoom::Instance().Add(r);
+    }
+
+    Params p;
+    p.Add("type", type);
+    p.Add("name", id);
+    p.Add("id", id);
+
+    return dynamic_cast<Internal *>(ListeRoom::Instance().createInput(p, r));
+}
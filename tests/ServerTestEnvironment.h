@@ -0,0 +1,11 @@
+#ifndef SERVER_TEST_ENVIRONMENT_H
+#define SERVER_TEST_ENVIRONMENT_H
+
+#include "Calaos.h"
+#include "IntValue.h"
+
+//Create an InternalBool/Int/String io in the test room named room, the room
+//is created with the first io
+Calaos::Internal *createTestInternal(const string &room, const string &type, const string &id);
+
+#endif
@@ -0,0 +1,114 @@
+#include "TCPLineBuffer.h"
+#include <gtest/gtest.h>
+
+class TCPLineBufferTest: public ::testing::Test
+{
+protected:
+    //all complete lines, with their terminator
+    vector<pair<string, string>> readAll()
+    {
+        vector<pair<string, string>> res;
+        string line, term;
+        while (lines.readLine(line, term))
+            res.push_back(make_pair(line, term));
+        lines.compact();
+        return res;
+    }
+
+    TCPLineBuffer lines;
+};
+
+TEST_F(TCPLineBufferTest, Terminators)
+{
+    lines.append("version?\nhome?\r\nio get id_1\n\rlast");
+
+    auto res = readAll();
+    ASSERT_EQ(3u, res.size());
+    EXPECT_EQ("version?", res[0].first);
+    EXPECT_EQ("\n", res[0].second);
+    EXPECT_EQ("home?", res[1].first);
+    EXPECT_EQ("\r\n", res[1].second);
+    EXPECT_EQ("io get id_1", res[2].first);
+    EXPECT_EQ("\n\r", res[2].second);
+
+    //the last line is not complete
+    EXPECT_EQ(4u, lines.size());
+}
+
+TEST_F(TCPLineBufferTest, PartialLines)
+{
+    string line, term;
+
+    lines.append("io se");
+    EXPECT_FALSE(lines.readLine(line, term));
+
+    lines.append("t id_1 tr");
+    EXPECT_FALSE(lines.readLine(line, term));
+    EXPECT_EQ(14u, lines.size());
+
+    lines.append("ue\r\nio get");
+    ASSERT_TRUE(lines.readLine(line, term));
+    EXPECT_EQ("io set id_1 true", line);
+    EXPECT_EQ("\r\n", term);
+    EXPECT_FALSE(lines.readLine(line, term));
+
+    lines.compact();
+    EXPECT_EQ(6u, lines.size());
+
+    lines.append(" id_1\n");
+    ASSERT_TRUE(lines.readLine(line, term));
+    EXPECT_EQ("io get id_1", line);
+    EXPECT_EQ("\n", term);
+    EXPECT_TRUE(lines.empty());
+}
+
+TEST_F(TCPLineBufferTest, EmptyLinesAndNul)
+{
+    //old clients end their lines with a \0
+    lines.append(string("\r\n\r\nhome?\0\r\n\n\0\0\nbye\n", 20));
+
+    auto res = readAll();
+    ASSERT_EQ(2u, res.size());
+    EXPECT_EQ("home?", res[0].first);
+    EXPECT_EQ("\r\n\n", res[0].second);
+    EXPECT_EQ("bye", res[1].first);
+    EXPECT_EQ("\n", res[1].second);
+    EXPECT_TRUE(lines.empty());
+}
+
+TEST_F(TCPLineBufferTest, PipelinedTerminators)
+{
+    //each request keeps its own terminator even when all lines are read
+    //before the first response is sent
+    lines.append("a\nb\r\nc\n\r");
+
+    string l[3], t[3];
+    for (int i = 0;i < 3;i++)
+        ASSERT_TRUE(lines.readLine(l[i], t[i]));
+
+    EXPECT_EQ("\n", t[0]);
+    EXPECT_EQ("\r\n", t[1]);
+    EXPECT_EQ("\n\r", t[2]);
+}
+
+TEST_F(TCPLineBufferTest, ReadWithoutCompact)
+{
+    string line, term;
+
+    //lines read stay in the buffer until compact(), but are not counted
+    lines.append("one\ntwo\n");
+    ASSERT_TRUE(lines.readLine(line, term));
+    EXPECT_EQ(4u, lines.size());
+
+    lines.append("three\n");
+    ASSERT_TRUE(lines.readLine(line, term));
+    EXPECT_EQ("two", line);
+    ASSERT_TRUE(lines.readLine(line, term));
+    EXPECT_EQ("three", line);
+    EXPECT_TRUE(lines.empty());
+
+    lines.append("four");
+    lines.clear();
+    EXPECT_TRUE(lines.empty());
+    EXPECT_FALSE(lines.readLine(line, term));
+}
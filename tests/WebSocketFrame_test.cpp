@@ -0,0 +1,244 @@
+#include "WebSocketFrame.h"
+#include "WebSocket.h"
+#include <gtest/gtest.h>
+
+static const uint32_t testMask = 0x37fa213d;
+
+//A frame as sent by a client, with the payload masked
+static string clientFrame(int opcode, const string &payload, bool lastframe = true,
+                          bool rsv1 = false, uint32_t mask = testMask)
+{
+    string frame;
+    WebSocketFrame::appendHeader(frame, opcode, payload.size(), lastframe, rsv1);
+    frame[1] = char(frame[1] | 0x80);
+
+    const uint8_t m[] = { uint8_t(mask >> 24), uint8_t(mask >> 16), uint8_t(mask >> 8), uint8_t(mask) };
+    frame.append((const char *)m, 4);
+
+    for (uint i = 0;i < payload.size();i++)
+        frame.push_back(char(payload[i] ^ m[i & 3]));
+
+    return frame;
+}
+
+static string makePayload(size_t size)
+{
+    string s(size, 0);
+    for (size_t i = 0;i < size;i++)
+        s[i] = char(i * 7 + (i >> 8));
+    return s;
+}
+
+TEST(WebSocketFrameTest, Unmask)
+{
+    //every size around the 16 and 8 bytes blocks, from an unaligned start
+    for (uint32_t mask: { 0x00000000u, 0xffffffffu, testMask })
+    {
+        for (size_t size = 0;size < 80;size++)
+        {
+            for (size_t offset = 0;offset < 4;offset++)
+            {
+                string payload = makePayload(size);
+                string masked = clientFrame(WebSocketFrame::OpCodeBinary, payload, true, false, mask).substr(6);
+
+                string buf = string(offset, 'x') + masked;
+                WebSocketFrame::unmask(&buf[offset], size, mask);
+
+                EXPECT_EQ(payload, buf.substr(offset)) << "size " << size << " offset " << offset;
+                EXPECT_EQ(string(offset, 'x'), buf.substr(0, offset));
+            }
+        }
+    }
+}
+
+TEST(WebSocketFrameTest, ParseMaskedFrame)
+{
+    string data = clientFrame(WebSocketFrame::OpCodeText, "Hello calaos");
+    size_t pos = 0;
+
+    WebSocketFrame frame;
+    ASSERT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_EQ(data.size(), pos);
+    EXPECT_TRUE(frame.isValid());
+    EXPECT_FALSE(frame.hasError());
+    EXPECT_TRUE(frame.isTextFrame());
+    EXPECT_TRUE(frame.isFinalFrame());
+    EXPECT_TRUE(frame.hasMask());
+    EXPECT_EQ(testMask, frame.getMask());
+    EXPECT_EQ("Hello calaos", frame.getPayload());
+
+    //the payload is unmasked in place
+    EXPECT_EQ(data.data() + 6, frame.getPayloadData());
+}
+
+TEST(WebSocketFrameTest, PayloadLengths)
+{
+    for (size_t size: { (size_t)125, (size_t)126, (size_t)65535, (size_t)65536, (size_t)200000 })
+    {
+        string payload = makePayload(size);
+        string data = clientFrame(WebSocketFrame::OpCodeBinary, payload);
+        size_t pos = 0;
+
+        WebSocketFrame frame;
+        ASSERT_TRUE(frame.processFrameData(data, pos)) << "size " << size;
+        EXPECT_EQ(data.size(), pos);
+        EXPECT_TRUE(frame.isValid());
+        EXPECT_EQ(size, frame.getPayloadSize());
+        EXPECT_EQ(payload, frame.getPayload());
+    }
+}
+
+TEST(WebSocketFrameTest, ByteByByte)
+{
+    //frames received in small parts, the cursor only moves on complete fields
+    string payload = makePayload(300);
+    string full = clientFrame(WebSocketFrame::OpCodeBinary, payload);
+
+    string data;
+    size_t pos = 0;
+    WebSocketFrame frame;
+
+    for (uint i = 0;i < full.size() - 1;i++)
+    {
+        data.push_back(full[i]);
+        ASSERT_FALSE(frame.processFrameData(data, pos)) << "byte " << i;
+        EXPECT_LE(pos, data.size());
+    }
+
+    data.push_back(full[full.size() - 1]);
+    ASSERT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_EQ(data.size(), pos);
+    EXPECT_EQ(payload, frame.getPayload());
+}
+
+TEST(WebSocketFrameTest, SeveralFramesInBuffer)
+{
+    string data = clientFrame(WebSocketFrame::OpCodeText, "first", false) +
+                  clientFrame(WebSocketFrame::OpCodePing, "ping") +
+                  clientFrame(WebSocketFrame::OpCodeContinue, "second") +
+                  clientFrame(WebSocketFrame::OpCodeClose, string("\x03\xe8" "bye", 5));
+    size_t pos = 0;
+
+    WebSocketFrame frame;
+    ASSERT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_TRUE(frame.isTextFrame());
+    EXPECT_FALSE(frame.isFinalFrame());
+    EXPECT_EQ("first", frame.getPayload());
+
+    frame.clear();
+    ASSERT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_TRUE(frame.isPingFrame());
+    EXPECT_TRUE(frame.isControlFrame());
+    EXPECT_EQ("ping", frame.getPayload());
+
+    frame.clear();
+    ASSERT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_TRUE(frame.isContinuationFrame());
+    EXPECT_TRUE(frame.isFinalFrame());
+    EXPECT_EQ("second", frame.getPayload());
+
+    frame.clear();
+    ASSERT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_TRUE(frame.isCloseFrame());
+
+    uint16_t code = 0;
+    string reason;
+    frame.parseCloseCodeReason(code, reason);
+    EXPECT_EQ(1000, code);
+    EXPECT_EQ("bye", reason);
+
+    EXPECT_EQ(data.size(), pos);
+
+    frame.clear();
+    EXPECT_FALSE(frame.processFrameData(data, pos));
+}
+
+TEST(WebSocketFrameTest, InvalidFrames)
+{
+    struct
+    {
+        string data;
+        bool rsv1Allowed;
+    } bad[] =
+    {
+        { clientFrame(WebSocketFrame::OpCodeReserved3, "abc"), false },
+        { clientFrame(WebSocketFrame::OpCodeReservedB, "abc"), false },
+        { clientFrame(WebSocketFrame::OpCodeText, "abc", true, true), false },
+        { clientFrame(WebSocketFrame::OpCodeContinue, "abc", true, true), true },
+        { clientFrame(WebSocketFrame::OpCodePing, "abc", true, true), true },
+        { clientFrame(WebSocketFrame::OpCodePing, makePayload(126)), false },
+        { clientFrame(WebSocketFrame::OpCodePing, "abc", false), false },
+    };
+
+    for (uint i = 0;i < sizeof(bad) / sizeof(bad[0]);i++)
+    {
+        size_t pos = 0;
+        WebSocketFrame frame;
+        frame.setRsv1Allowed(bad[i].rsv1Allowed);
+        frame.processFrameData(bad[i].data, pos);
+
+        EXPECT_TRUE(frame.hasError()) << "frame " << i;
+        EXPECT_FALSE(frame.isValid()) << "frame " << i;
+        EXPECT_EQ(WebSocket::CloseCodeProtocolError, frame.getCloseCode()) << "frame " << i;
+    }
+
+    //RSV1 is only allowed on the first frame of a compressed message
+    string data = clientFrame(WebSocketFrame::OpCodeText, "abc", true, true);
+    size_t pos = 0;
+    WebSocketFrame frame;
+    frame.setRsv1Allowed(true);
+    ASSERT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_TRUE(frame.isValid());
+    EXPECT_TRUE(frame.getRsv1());
+}
+
+TEST(WebSocketFrameTest, LengthNotMinimal)
+{
+    //16 bits length used for a small payload
+    string data("\x81\xfe\x00\x05", 4);
+    data += string("\x00\x00\x00\x00" "hello", 9);
+    size_t pos = 0;
+
+    WebSocketFrame frame;
+    EXPECT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_FALSE(frame.isValid());
+    EXPECT_EQ(WebSocket::CloseCodeProtocolError, frame.getCloseCode());
+
+    //64 bits length used for a payload that fits in 16 bits
+    data = string("\x82\xff\x00\x00\x00\x00\x00\x00\x01\x00", 10);
+    pos = 0;
+    frame.clear();
+    EXPECT_TRUE(frame.processFrameData(data, pos));
+    EXPECT_FALSE(frame.isValid());
+    EXPECT_EQ(WebSocket::CloseCodeProtocolError, frame.getCloseCode());
+}
+
+TEST(WebSocketFrameTest, MakeFrames)
+{
+    string payload = makePayload(250);
+    string data = WebSocketFrame::makeFrames(WebSocketFrame::OpCodeText, payload, 100, true);
+    size_t pos = 0;
+    string message;
+
+    for (int i = 0;i < 3;i++)
+    {
+        WebSocketFrame frame;
+        frame.setRsv1Allowed(true);
+        ASSERT_TRUE(frame.processFrameData(data, pos)) << "frame " << i;
+        EXPECT_TRUE(frame.isValid());
+        EXPECT_FALSE(frame.hasMask());
+        EXPECT_EQ(i == 0?WebSocketFrame::OpCodeText:WebSocketFrame::OpCodeContinue, frame.getOpcode());
+        EXPECT_EQ(i == 0, frame.getRsv1() != 0);
+        EXPECT_EQ(i == 2, frame.isFinalFrame());
+        EXPECT_EQ(i == 2?50u:100u, frame.getPayloadSize());
+
+        message += frame.getPayload();
+    }
+
+    EXPECT_EQ(data.size(), pos);
+    EXPECT_EQ(payload, message);
+
+    //an empty message is one frame
+    data = WebSocketFrame::makeFrames(WebSocketFrame::OpCodeBinary, string(), 100);
+    EXPECT_EQ(string("\x82\x00", 2), data);
+}
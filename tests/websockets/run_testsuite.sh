@@ -1,4 +1,12 @@
 #!/bin/sh
 
+# Run the whole suite, or only the permessage-deflate cases with:
+#   ./run_testsuite.sh deflate
+
+spec=fuzzingclient.json
+if [ "$1" = "deflate" ]; then
+    spec=fuzzingclient_deflate.json
+fi
+
 mkdir -p reports
-wstest -m fuzzingclient -s fuzzingclient.json
+wstest -m fuzzingclient -s $spec